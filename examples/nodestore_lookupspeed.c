@@ -0,0 +1,128 @@
+/* This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information. */
+
+/* This example is just to see how fast nodes are found in the nodestore. The
+   nodestore is filled with numeric NodeIds (dense and sparse) and with string
+   NodeIds. Then the nodes are looked up in random order. The sizes can be
+   given as arguments. */
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef UA_NO_AMALGAMATION
+# include "ua_types.h"
+# include "ua_types_generated.h"
+# include "ua_server.h"
+#else
+# include "open62541.h"
+/* include guards to prevent double definitions with open62541.h */
+# define UA_TYPES_H_
+# define UA_SERVER_H_
+# define UA_CONNECTION_H_
+# define UA_TYPES_GENERATED_H_
+#endif
+
+#include "server/ua_nodestore.h"
+#include "server/ua_server_internal.h"
+
+#define LOOKUPS 10000000
+
+typedef enum {
+    IDS_DENSE,
+    IDS_SPARSE,
+    IDS_STRING
+} IdKind;
+
+static const char *idKindNames[] = {"dense numeric", "sparse numeric", "string"};
+
+static void
+makeNodeId(UA_NodeId *id, IdKind kind, UA_UInt32 i, char *buf) {
+    switch(kind) {
+    case IDS_DENSE:
+        *id = UA_NODEID_NUMERIC(1, i);
+        break;
+    case IDS_SPARSE:
+        *id = UA_NODEID_NUMERIC(1, i * 7919);
+        break;
+    default:
+        sprintf(buf, "node.%u", i);
+        *id = UA_NODEID_STRING(1, buf);
+    }
+}
+
+static double
+elapsed(clock_t begin) {
+    return (double)(clock() - begin) / CLOCKS_PER_SEC;
+}
+
+static void
+benchmark(UA_UInt32 nodes, IdKind kind) {
+    char buf[32];
+    UA_NodeStore *ns = UA_NodeStore_new();
+
+    clock_t begin = clock();
+    for(UA_UInt32 i = 1; i <= nodes; ++i) {
+        UA_Node *node = UA_NodeStore_newNode(ns, UA_NODECLASS_OBJECT);
+        UA_NodeId id;
+        makeNodeId(&id, kind, i, buf);
+        UA_NodeId_copy(&id, &node->nodeId);
+        UA_NodeStore_insert(ns, node);
+    }
+    double insertTime = elapsed(begin);
+
+    /* Time for creating the NodeIds alone. Subtracted from the lookup time. */
+    volatile UA_UInt32 sink = 0;
+    UA_NodeId id;
+    begin = clock();
+    for(UA_UInt32 i = 0; i < LOOKUPS; ++i) {
+        makeNodeId(&id, kind, (UA_UInt32)((i * 2654435761u) % nodes) + 1, buf);
+        sink += id.identifier.numeric;
+    }
+    double idTime = elapsed(begin);
+
+    /* Random order with a multiplicative hash */
+    size_t found = 0;
+    begin = clock();
+    for(UA_UInt32 i = 0; i < LOOKUPS; ++i) {
+        makeNodeId(&id, kind, (UA_UInt32)((i * 2654435761u) % nodes) + 1, buf);
+        if(UA_NodeStore_get(ns, &id))
+            ++found;
+    }
+    double lookupTime = elapsed(begin) - idTime;
+
+    printf("%9u nodes, %-14s: insert %6.1f ns/node, lookup %6.1f ns (%u found)\n",
+           nodes, idKindNames[kind], insertTime * 1e9 / nodes,
+           lookupTime * 1e9 / LOOKUPS, (unsigned)found);
+    UA_NodeStore_delete(ns);
+}
+
+int main(int argc, char** argv) {
+#ifdef UA_ENABLE_MULTITHREADING
+    rcu_init();
+    rcu_register_thread();
+#endif
+    UA_RCU_LOCK();
+
+    UA_UInt32 defaultSizes[] = {10000, 1000000, 10000000};
+    size_t sizesCount = 3;
+    if(argc > 1)
+        sizesCount = (size_t)argc - 1;
+    for(size_t i = 0; i < sizesCount; ++i) {
+        UA_UInt32 nodes;
+        if(argc > 1)
+            nodes = (UA_UInt32)strtoul(argv[i+1], NULL, 10);
+        else
+            nodes = defaultSizes[i];
+        if(nodes == 0)
+            continue;
+        for(int kind = IDS_DENSE; kind <= IDS_STRING; ++kind)
+            benchmark(nodes, (IdKind)kind);
+    }
+
+    UA_RCU_UNLOCK();
+#ifdef UA_ENABLE_MULTITHREADING
+    rcu_unregister_thread();
+#endif
+    return 0;
+}
@@ -0,0 +1,126 @@
+/* This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information. */
+
+/* This example is just to see how fast a large information model is added.
+   The model has objects below the objects folder with ten variables each. It
+   is added node by node and then with the bulk loading API. The number of
+   nodes can be given as an argument. A second argument limits the number of
+   nodes that are added node by node (slow with multithreading, where every
+   added reference copies the node). */
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef UA_NO_AMALGAMATION
+# include "ua_types.h"
+# include "ua_types_generated.h"
+# include "ua_server.h"
+# include "ua_config_standard.h"
+#else
+# include "open62541.h"
+#endif
+
+#define VARIABLES_PER_OBJECT 10
+
+static double
+elapsed(clock_t begin) {
+    return (double)(clock() - begin) / CLOCKS_PER_SEC;
+}
+
+/* Node i is an object if i is a multiple of VARIABLES_PER_OBJECT+1. Otherwise
+   a variable of the preceding object. */
+static UA_NodeId
+parentOf(UA_UInt32 i) {
+    if(i % (VARIABLES_PER_OBJECT + 1) == 0)
+        return UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    return UA_NODEID_NUMERIC(1, 1000 + i - i % (VARIABLES_PER_OBJECT + 1));
+}
+
+static void
+addOneByOne(UA_Server *server, UA_UInt32 nodes) {
+    UA_ObjectAttributes oattr;
+    UA_ObjectAttributes_init(&oattr);
+    UA_VariableAttributes vattr;
+    UA_VariableAttributes_init(&vattr);
+    UA_Double value = 0.0;
+    UA_Variant_setScalar(&vattr.value, &value, &UA_TYPES[UA_TYPES_DOUBLE]);
+
+    clock_t begin = clock();
+    for(UA_UInt32 i = 0; i < nodes; ++i) {
+        UA_NodeId id = UA_NODEID_NUMERIC(1, 1000 + i);
+        if(i % (VARIABLES_PER_OBJECT + 1) == 0)
+            UA_Server_addObjectNode(server, id, parentOf(i),
+                                    UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                    UA_QUALIFIEDNAME(1, "object"), UA_NODEID_NULL,
+                                    oattr, NULL, NULL);
+        else
+            UA_Server_addVariableNode(server, id, parentOf(i),
+                                      UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT),
+                                      UA_QUALIFIEDNAME(1, "variable"), UA_NODEID_NULL,
+                                      vattr, NULL, NULL);
+    }
+    printf("%9u nodes, one by one: %8.3f s\n", nodes, elapsed(begin));
+}
+
+static void
+addBulk(UA_Server *server, UA_UInt32 nodes) {
+    UA_ObjectAttributes oattr;
+    UA_ObjectAttributes_init(&oattr);
+    UA_VariableAttributes vattr;
+    UA_VariableAttributes_init(&vattr);
+    UA_Double value = 0.0;
+    UA_Variant_setScalar(&vattr.value, &value, &UA_TYPES[UA_TYPES_DOUBLE]);
+
+    UA_AddNodesItem *items = malloc(sizeof(UA_AddNodesItem) * nodes);
+    for(UA_UInt32 i = 0; i < nodes; ++i) {
+        UA_AddNodesItem *item = &items[i];
+        UA_AddNodesItem_init(item);
+        item->requestedNewNodeId.nodeId = UA_NODEID_NUMERIC(1, 1000 + i);
+        item->parentNodeId.nodeId = parentOf(i);
+        item->nodeAttributes.encoding = UA_EXTENSIONOBJECT_DECODED_NODELETE;
+        if(i % (VARIABLES_PER_OBJECT + 1) == 0) {
+            item->nodeClass = UA_NODECLASS_OBJECT;
+            item->referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES);
+            item->browseName = UA_QUALIFIEDNAME(1, "object");
+            item->nodeAttributes.content.decoded.type = &UA_TYPES[UA_TYPES_OBJECTATTRIBUTES];
+            item->nodeAttributes.content.decoded.data = &oattr;
+        } else {
+            item->nodeClass = UA_NODECLASS_VARIABLE;
+            item->referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT);
+            item->browseName = UA_QUALIFIEDNAME(1, "variable");
+            item->nodeAttributes.content.decoded.type = &UA_TYPES[UA_TYPES_VARIABLEATTRIBUTES];
+            item->nodeAttributes.content.decoded.data = &vattr;
+        }
+    }
+
+    clock_t begin = clock();
+    UA_StatusCode retval = UA_Server_addNodesBulk(server, nodes, items, 0, NULL, NULL, NULL);
+    printf("%9u nodes, bulk:       %8.3f s (%s)\n", nodes, elapsed(begin),
+           UA_StatusCode_name(retval));
+    free(items);
+}
+
+int main(int argc, char** argv) {
+    UA_UInt32 nodes = 1000000;
+    if(argc > 1)
+        nodes = (UA_UInt32)strtoul(argv[1], NULL, 10);
+    UA_UInt32 oneByOneNodes = nodes;
+    if(argc > 2)
+        oneByOneNodes = (UA_UInt32)strtoul(argv[2], NULL, 10);
+
+    UA_ServerConfig config = UA_ServerConfig_standard;
+    config.logger = NULL;
+
+    UA_Server *server;
+    if(oneByOneNodes > 0) {
+        server = UA_Server_new(config);
+        addOneByOne(server, oneByOneNodes);
+        UA_Server_delete(server);
+    }
+
+    server = UA_Server_new(config);
+    addBulk(server, nodes);
+    UA_Server_delete(server);
+    return 0;
+}
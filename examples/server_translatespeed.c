@@ -0,0 +1,106 @@
+/* This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information. */
+
+/* This example is just to see how fast browse paths are translated to NodeIds.
+   The model is a chain of objects below the objects folder. Every object in the
+   chain has many components, one of them is the next object in the chain. The
+   translated paths lead through the whole chain to one of the components of
+   the last object. The depth of the chain, the number of components per object
+   and the number of translated paths can be given as arguments. */
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef UA_NO_AMALGAMATION
+# include "ua_types.h"
+# include "ua_types_generated.h"
+# include "ua_server.h"
+# include "ua_config_standard.h"
+#else
+# include "open62541.h"
+#endif
+
+static UA_QualifiedName
+componentName(char *buf, size_t bufSize, UA_UInt32 i) {
+    snprintf(buf, bufSize, "component%u", i);
+    return UA_QUALIFIEDNAME(1, buf);
+}
+
+int main(int argc, char** argv) {
+    UA_UInt32 depth = 10;
+    UA_UInt32 components = 500;
+    UA_UInt32 paths = 100000;
+    if(argc > 1)
+        depth = (UA_UInt32)strtoul(argv[1], NULL, 10);
+    if(argc > 2)
+        components = (UA_UInt32)strtoul(argv[2], NULL, 10);
+    if(argc > 3)
+        paths = (UA_UInt32)strtoul(argv[3], NULL, 10);
+    if(depth == 0 || components == 0)
+        return 1;
+
+    UA_ServerConfig config = UA_ServerConfig_standard;
+    config.logger = NULL;
+    UA_Server *server = UA_Server_new(config);
+
+    /* The chain continues with the middle component of every object */
+    UA_ObjectAttributes oattr;
+    UA_ObjectAttributes_init(&oattr);
+    char name[32];
+    UA_NodeId parent = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    UA_UInt32 next = components / 2;
+    UA_UInt32 id = 1000;
+    for(UA_UInt32 level = 0; level < depth; ++level) {
+        UA_NodeId chain = UA_NODEID_NUMERIC(1, id + next);
+        for(UA_UInt32 i = 0; i < components; ++i) {
+            UA_StatusCode retval =
+                UA_Server_addObjectNode(server, UA_NODEID_NUMERIC(1, id + i), parent,
+                                        UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT),
+                                        componentName(name, sizeof(name), i),
+                                        UA_NODEID_NULL, oattr, NULL, NULL);
+            if(retval != UA_STATUSCODE_GOOD) {
+                printf("Could not add the node: %s\n", UA_StatusCode_name(retval));
+                return 1;
+            }
+        }
+        parent = chain;
+        id += components;
+    }
+
+    /* The elements of the path. The last element is changed for every path. */
+    char (*names)[32] = malloc(sizeof(*names) * depth);
+    UA_RelativePathElement *elements =
+        malloc(sizeof(UA_RelativePathElement) * depth);
+    for(UA_UInt32 i = 0; i < depth; ++i) {
+        UA_RelativePathElement_init(&elements[i]);
+        elements[i].referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_HIERARCHICALREFERENCES);
+        elements[i].includeSubtypes = true;
+        elements[i].targetName = componentName(names[i], sizeof(names[i]), next);
+    }
+    UA_BrowsePath bp;
+    UA_BrowsePath_init(&bp);
+    bp.startingNode = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    bp.relativePath.elements = elements;
+    bp.relativePath.elementsSize = depth;
+
+    size_t failed = 0;
+    clock_t begin = clock();
+    for(UA_UInt32 p = 0; p < paths; ++p) {
+        elements[depth - 1].targetName =
+            componentName(names[depth - 1], sizeof(names[depth - 1]), p % components);
+        UA_BrowsePathResult result = UA_Server_translateBrowsePathToNodeIds(server, &bp);
+        if(result.statusCode != UA_STATUSCODE_GOOD)
+            ++failed;
+        UA_BrowsePathResult_deleteMembers(&result);
+    }
+    double duration = (double)(clock() - begin) / CLOCKS_PER_SEC;
+    printf("%u paths of depth %u (%u components per object): %.3f s, %.2f us per path "
+           "(%lu failed)\n", paths, depth, components, duration,
+           duration * 1000000.0 / (double)paths, (unsigned long)failed);
+
+    free(elements);
+    free(names);
+    UA_Server_delete(server);
+    return 0;
+}
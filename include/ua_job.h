@@ -17,6 +17,16 @@ typedef struct UA_Server UA_Server;
 
 typedef void (*UA_ServerCallback)(UA_Server *server, void *data);
 
+/* Jobs are dispatched to the worker threads in priority classes (only if
+ * multithreading is enabled). Workers always take the next job from the
+ * highest-priority class that has waiting jobs. */
+typedef enum {
+    UA_JOBPRIORITY_REALTIME = 0,  /* Time-critical jobs, e.g. sampling and publishing */
+    UA_JOBPRIORITY_NORMAL = 1,    /* E.g. processing of service requests */
+    UA_JOBPRIORITY_BACKGROUND = 2 /* Housekeeping, e.g. cleanup and delayed frees */
+} UA_JobPriority;
+#define UA_JOBPRIORITIESSIZE 3
+
 /* Jobs describe work that is executed once or repeatedly in the server */
 typedef struct {
     enum {
@@ -50,11 +50,21 @@ struct UA_ServerNetworkLayer {
      * @param jobs When the returned integer is >0, *jobs points to an array of
      *        UA_Job of the returned size.
      * @param timeout The timeout during which an event must arrive in
-     *        microseconds
+     *        milliseconds. UA_UINT16_MAX means that the network layer waits
+     *        until an event arrives or wakeup is called.
      * @return The size of the jobs array. If the result is negative,
      *         an error has occurred. */
     size_t (*getJobs)(UA_ServerNetworkLayer *nl, UA_Job **jobs, UA_UInt16 timeout);
 
+    /* Interrupts a getJobs call that currently waits for events. If getJobs
+     * is not waiting, the next call returns without delay. This is the only
+     * function of the network layer that can be called from any thread.
+     * Network layers that cannot be woken up leave the pointer NULL. The
+     * server then polls the network layer in short intervals instead.
+     *
+     * @param nl The network layer */
+    void (*wakeup)(UA_ServerNetworkLayer *nl);
+
     /* Closes the network connection and returns all the jobs that need to be
      * finished before the network layer can be safely deleted.
      *
@@ -69,6 +79,56 @@ struct UA_ServerNetworkLayer {
     void (*deleteMembers)(UA_ServerNetworkLayer *nl);
 };
 
+/**
+ * .. _nodestore:
+ *
+ * Nodestore
+ * ---------
+ * The nodestore holds the nodes of the information model. The server accesses
+ * the nodes only through the following interface. So specialized nodestores
+ * (e.g. sharded or read-optimized) can replace the default nodestore. The node
+ * structures are defined in the section on :ref:`information-modelling`. The
+ * functions have the same semantics as those of the default nodestore in
+ * ``src/server/ua_nodestore.h``. */
+struct UA_Node;
+struct UA_NodeStoreImage;
+
+typedef void (*UA_NodeStore_nodeVisitor)(void *visitorContext, const struct UA_Node *node);
+
+typedef struct {
+    /* Create and delete the nodestore. The returned handle is passed to the
+     * other functions. */
+    void * (*newNodeStore)(void);
+    void (*deleteNodeStore)(void *handle);
+
+    /* Nodes are allocated by the nodestore. Nodes that are not inserted are
+     * deleted with deleteNode. */
+    struct UA_Node * (*newNode)(void *handle, UA_NodeClass nodeClass);
+    void (*deleteNode)(void *handle, struct UA_Node *node);
+
+    UA_StatusCode (*insert)(void *handle, struct UA_Node *node);
+    const struct UA_Node * (*get)(void *handle, const UA_NodeId *nodeId);
+    struct UA_Node * (*getCopy)(void *handle, const UA_NodeId *nodeId);
+    UA_StatusCode (*replace)(void *handle, struct UA_Node *node);
+    UA_StatusCode (*remove)(void *handle, const UA_NodeId *nodeId);
+    void (*iterate)(void *handle, void *visitorContext, UA_NodeStore_nodeVisitor visitor);
+
+    /* Optional. Without linkImage, the nodes of read-only images (namespace 0,
+     * snapshots) are copied into the nodestore. Without isImmutable, all nodes
+     * are editable. Without releaseString, the names of nodes are not shared
+     * and are freed when they are overwritten. The reserve hint is given before
+     * the nodes (not yet inserted) of a bulk load are inserted. */
+    UA_StatusCode (*linkImage)(void *handle, const struct UA_NodeStoreImage *image);
+    UA_Boolean (*isImmutable)(void *handle, const struct UA_Node *node);
+    void (*releaseString)(void *handle, UA_String *s);
+    UA_StatusCode (*reserve)(void *handle, size_t nodesSize,
+                             struct UA_Node * const *nodes);
+} UA_NodeStoreInterface;
+
+/* The nodestore of the server if none is configured. Custom nodestores can
+ * forward to its functions, e.g. to add instrumentation or access control. */
+UA_EXPORT extern const UA_NodeStoreInterface UA_NodeStoreInterface_default;
+
 /**
  * Server Configuration
  * --------------------
@@ -88,6 +148,12 @@ typedef struct {
     UA_Double max;
 } UA_DoubleRange;
 
+/* A set of CPU indices a thread may run on */
+typedef struct {
+    size_t cpusSize;
+    UA_UInt16 *cpus;
+} UA_CpuSet;
+
 typedef struct {
     UA_UInt16 nThreads; /* only if multithreading is enabled */
     UA_Logger logger;
@@ -101,6 +167,38 @@ typedef struct {
     size_t networkLayersSize;
     UA_ServerNetworkLayer *networkLayers;
 
+    /* Thread Placement (only if supported by the platform). Empty CPU sets
+     * leave the placement to the scheduler. */
+    UA_CpuSet networkCpuSet; /* Thread that runs the main loop and polls the
+                                networklayers */
+    size_t workerCpuSetsSize; /* Worker i uses workerCpuSets[i % size] */
+    UA_CpuSet *workerCpuSets;
+
+    /* Job Priorities */
+    UA_JobPriority samplingJobPriority; /* Sampling of MonitoredItems */
+    UA_JobPriority publishJobPriority;  /* Publishing of Subscriptions */
+    UA_JobPriority messageJobPriority;  /* Messages from the networklayers */
+    UA_JobPriority repeatedJobPriority; /* Jobs from UA_Server_addRepeatedJob */
+
+    /* Memory Reclamation */
+    UA_UInt32 reclamationBudget; /* Max. number of delayed jobs processed per
+                                    main loop iteration (only if multithreading
+                                    is enabled). 0 -> unlimited */
+
+    /* Intra-request Parallelism (only if multithreading is enabled). The
+     * items of Read, Write, Browse and Call requests with at least this many
+     * items are split into ranges that are processed by the workers in
+     * parallel. 0 -> never */
+    UA_UInt32 parallelItemsThreshold;
+
+    /* Browse Cache. The results of Browse requests that are answered without
+     * a continuation point are cached in a table with this many entries
+     * (rounded down to a power of two). 0 -> disabled */
+    UA_UInt32 browseCacheSize;
+
+    /* Nodestore. The default nodestore is used if newNodeStore is NULL. */
+    UA_NodeStoreInterface nodestore;
+
     /* Login */
     UA_Boolean enableAnonymousLogin;
     UA_Boolean enableUsernamePasswordLogin;
@@ -114,6 +212,18 @@ typedef struct {
     /* Limits for Sessions */
     UA_UInt16 maxSessions;
     UA_Double maxSessionTimeout; /* in ms */
+    UA_UInt16 maxContinuationPoints; /* Per session, for Browse/BrowseNext */
+    UA_UInt32 maxRegisteredNodes; /* Per session. Beyond, RegisterNodes returns
+                                     the NodeIds unchanged. */
+    UA_UInt16 maxQueryContinuationPoints; /* Per session, for QueryFirst/QueryNext */
+    UA_UInt32 maxQueryDataSets; /* Per QueryFirst/QueryNext response */
+
+    /* Asynchronous DataSource reads are answered with UA_STATUSCODE_BADTIMEOUT
+     * after this time (or the timeoutHint of the request if it is shorter) */
+    UA_UInt32 asyncReadTimeout; /* in ms */
+
+    /* The same for asynchronous method calls */
+    UA_UInt32 asyncCallTimeout; /* in ms */
 
     /* Limits for Subscriptions */
     UA_DoubleRange publishingIntervalLimits;
@@ -157,17 +267,47 @@ UA_StatusCode UA_EXPORT UA_Server_run_startup(UA_Server *server);
  *
  * @param server The server object.
  * @param waitInternal Should we wait for messages in the networklayer?
- *        Otherwise, the timouts for the networklayers are set to zero.
- *        The default max wait time is 50millisec.
+ *        Otherwise, the timouts for the networklayers are set to zero. The
+ *        networklayer waits until the next repeated job is due. If the
+ *        networklayer cannot be woken up, the max wait time is 50millisec.
  * @return Returns how long we can wait until the next scheduled
- *         job (in millisec) */
+ *         job (in millisec). At most 50millisec are returned, since jobs
+ *         from other threads cannot wake up an external wait. */
 UA_UInt16 UA_EXPORT
 UA_Server_run_iterate(UA_Server *server, UA_Boolean waitInternal);
 
+/* Interrupts the main loop while it waits for events in the networklayer. Can
+ * be called from any thread. Call this after the running-flag of UA_Server_run
+ * was set to false from another thread, so that the server shuts down without
+ * delay. */
+void UA_EXPORT UA_Server_wakeup(UA_Server *server);
+
 /* The epilogue part of UA_Server_run (no need to use if you call
  * UA_Server_run) */
 UA_StatusCode UA_EXPORT UA_Server_run_shutdown(UA_Server *server);
 
+/**
+ * Snapshots
+ * ---------
+ * A snapshot stores the nodes of the information model in a file. Loading the
+ * snapshot maps the file into memory without decoding or copying the nodes. So
+ * a server with a large information model restarts quickly. The nodes are
+ * copied from the snapshot when they are edited.
+ *
+ * The nodes of the snapshot replace the information model of the server,
+ * except for the nodes that have callbacks or handles when the snapshot is
+ * loaded (e.g. the data sources of the server status). DataSources, value callbacks, method callbacks, lifecycle
+ * management and instance handles are not stored in the snapshot and need to
+ * be set again after loading. The namespace array is not stored either.
+ * Snapshots can only be loaded by a build of the same version and platform.
+ * Only one snapshot can be loaded per server. Load the snapshot before the
+ * server is started. */
+UA_StatusCode UA_EXPORT
+UA_Server_saveSnapshot(UA_Server *server, const char *path);
+
+UA_StatusCode UA_EXPORT
+UA_Server_loadSnapshot(UA_Server *server, const char *path);
+
 /**
  * Repeated jobs
  * ------------- */
@@ -195,6 +335,92 @@ UA_Server_addRepeatedJob(UA_Server *server, UA_Job job,
 UA_StatusCode UA_EXPORT
 UA_Server_removeRepeatedJob(UA_Server *server, UA_Guid jobId);
 
+/**
+ * Job Statistics
+ * -------------- */
+typedef struct {
+    size_t queueDepth;       /* Jobs waiting for a worker thread */
+    UA_UInt64 processedJobs; /* Jobs processed since the server was created */
+    UA_Double meanWaitTime;  /* Mean time (in ms) between a job becoming due
+                                and the start of its processing */
+    UA_Double maxWaitTime;   /* Max wait time (in ms) */
+} UA_JobStatistics;
+
+/* Get the statistics of a job priority class. The counters are not
+ * synchronized and may be slightly outdated while the server is running.
+ *
+ * @param server The server object.
+ * @param priority The priority class.
+ * @param stats The statistics are written here.
+ * @return Returns UA_STATUSCODE_BADINVALIDARGUMENT for an unknown priority
+ *         class and UA_STATUSCODE_GOOD otherwise. */
+UA_StatusCode UA_EXPORT
+UA_Server_getJobStatistics(UA_Server *server, UA_JobPriority priority,
+                           UA_JobStatistics *stats);
+
+/* Memory that could still be accessed from concurrent threads is freed in
+ * delayed jobs. They are processed once all worker threads have finished the
+ * jobs that were dispatched before. */
+typedef struct {
+    size_t pendingJobs;       /* Delayed jobs waiting to be processed */
+    size_t pendingBytes;      /* Memory (in bytes) held by the pending jobs */
+    UA_UInt64 reclaimedJobs;  /* Delayed jobs processed since the server was
+                                 created */
+    UA_UInt64 reclaimedBytes; /* Memory (in bytes) freed by the delayed jobs */
+    UA_Double maxLatency;     /* Max time (in ms) between adding a delayed job
+                                 and its processing */
+} UA_ReclamationStatistics;
+
+void UA_EXPORT
+UA_Server_getReclamationStatistics(UA_Server *server,
+                                   UA_ReclamationStatistics *stats);
+
+/**
+ * Browse Cache Statistics
+ * ----------------------- */
+typedef struct {
+    size_t size;      /* Entries of the cache (0 if disabled) */
+    UA_UInt32 hits;   /* Browse results taken from the cache */
+    UA_UInt32 misses; /* Browse results that had to be computed. The counters
+                         wrap around. */
+} UA_BrowseCacheStatistics;
+
+void UA_EXPORT
+UA_Server_getBrowseCacheStatistics(UA_Server *server,
+                                   UA_BrowseCacheStatistics *stats);
+
+/**
+ * Thread Placement
+ * ----------------
+ * The threads of the server are pinned to the CPU sets from the configuration
+ * during :c:func:`UA_Server_run_startup`. The worker threads allocate their
+ * data structures after pinning, so that the memory is placed on the local
+ * NUMA node. */
+typedef struct {
+    UA_Boolean pinned;  /* The CPU set from the configuration was applied */
+    UA_Int32 cpu;       /* CPU the thread ran on at startup. -1 if unknown */
+    UA_Int32 numaNode;  /* NUMA node of the CPU. -1 if unknown */
+    size_t cpusSize;    /* Number of CPUs the thread may run on. 0 if unknown */
+} UA_ThreadPlacement;
+
+/* Get the effective placement of a server thread.
+ *
+ * @param server The server object.
+ * @param thread Index 0 is the main loop thread. The worker threads (only if
+ *        multithreading is enabled) follow from index 1 while the server runs.
+ * @param placement The placement is written here.
+ * @return Returns UA_STATUSCODE_BADINVALIDARGUMENT for an unknown thread and
+ *         UA_STATUSCODE_GOOD otherwise. */
+UA_StatusCode UA_EXPORT
+UA_Server_getThreadPlacement(UA_Server *server, size_t thread,
+                             UA_ThreadPlacement *placement);
+
+/* Platform-specific functions for the calling thread (implemented in
+ * plugins/ua_affinity.c). Returns UA_STATUSCODE_BADNOTSUPPORTED if the
+ * platform does not support setting the affinity. */
+UA_StatusCode UA_EXPORT UA_Thread_setAffinity(const UA_CpuSet *cpuSet);
+void UA_EXPORT UA_Thread_getPlacement(UA_ThreadPlacement *placement);
+
 /**
  * Reading and Writing Node Attributes
  * -----------------------------------
@@ -564,6 +790,8 @@ UA_Server_call(UA_Server *server, const UA_CallMethodRequest *request);
  *
  * It is expected that the read callback is implemented. The write callback can
  * be set to a null-pointer. */
+typedef struct UA_ReadToken UA_ReadToken;
+
 typedef struct {
     void *handle; /* A custom pointer to reuse the same datasource functions for
                      multiple sources */
@@ -588,6 +816,18 @@ typedef struct {
                           UA_Boolean includeSourceTimeStamp,
                           const UA_NumericRange *range, UA_DataValue *value);
 
+    /* Read asynchronously from the data source (optional). If set, the Read
+     * service uses readAsync instead of read. Then the data source can return
+     * UA_STATUSCODE_GOODCOMPLETESASYNCHRONOUSLY and keep the token to set the
+     * value later with :c:func:`UA_Server_completeRead`. The Read service
+     * issues all reads of a request before waiting for the completions. Other
+     * return values behave as with read. The range is only valid during the
+     * call. Local reads and the sampling of MonitoredItems always use read. */
+    UA_StatusCode (*readAsync)(void *handle, const UA_NodeId nodeid,
+                               UA_Boolean includeSourceTimeStamp,
+                               const UA_NumericRange *range, UA_DataValue *value,
+                               UA_ReadToken *token);
+
     /* Write into a data source. The write member of UA_DataSource can be empty
      * if the operation is unsupported.
      *
@@ -607,6 +847,20 @@ UA_StatusCode UA_EXPORT
 UA_Server_setVariableNode_dataSource(UA_Server *server, const UA_NodeId nodeId,
                                      const UA_DataSource dataSource);
 
+/* Completes an asynchronous read. The value is copied. The token is no longer
+ * valid afterwards. Every token has to be completed, also after the read has
+ * timed out. With multithreading, this can be called from any thread.
+ * Otherwise only from the thread that runs the server.
+ *
+ * @param server The server object.
+ * @param token The token from the readAsync callback of the data source.
+ * @param value The value that was read.
+ * @return Returns UA_STATUSCODE_BADTIMEOUT if the response was already sent
+ *         without the value. */
+UA_StatusCode UA_EXPORT
+UA_Server_completeRead(UA_Server *server, UA_ReadToken *token,
+                       const UA_DataValue *value);
+
 /**
  * .. _value-callback:
  *
@@ -679,6 +933,50 @@ UA_Server_setMethodNode_callback(UA_Server *server, const UA_NodeId methodNodeId
                                  UA_MethodCallback method, void *handle);
 #endif
 
+/* Asynchronous method callbacks do not block the server while the method is
+ * executed. The callback returns UA_STATUSCODE_GOODCOMPLETESASYNCHRONOUSLY and
+ * keeps the token. The call is later completed with
+ * :c:func:`UA_Server_completeMethodCall`. Meanwhile, the server continues to
+ * process other requests (also from the same session). The CallResponse is
+ * sent when all methods of the CallRequest have completed. Other return
+ * values complete the method call immediately with the content of output.
+ * The input is only valid during the callback. */
+typedef struct UA_MethodCallToken UA_MethodCallToken;
+
+typedef UA_StatusCode
+(*UA_AsyncMethodCallback)(void *methodHandle, const UA_NodeId objectId,
+                          size_t inputSize, const UA_Variant *input,
+                          size_t outputSize, UA_Variant *output,
+                          UA_MethodCallToken *token);
+
+#ifdef UA_ENABLE_METHODCALLS
+/* Replaces a (synchronous) callback that was set before */
+UA_StatusCode UA_EXPORT
+UA_Server_setMethodNode_asyncCallback(UA_Server *server, const UA_NodeId methodNodeId,
+                                      UA_AsyncMethodCallback method, void *handle);
+
+/* Completes a pending method call. The output is copied. The token is no
+ * longer valid afterwards. Every token has to be completed, also after the
+ * call has timed out (see asyncCallTimeout in the server configuration) or the
+ * session was closed. With multithreading, this can be called from any
+ * thread. Otherwise only from the thread that runs the server.
+ *
+ * @param server The server object.
+ * @param token The token from the asynchronous method callback.
+ * @param result The statuscode of the method call.
+ * @param outputSize Must match the number of output arguments of the method.
+ *        Otherwise, the method call fails with UA_STATUSCODE_BADINTERNALERROR.
+ * @param output The output arguments.
+ * @return Returns UA_STATUSCODE_BADINVALIDARGUMENT if the output does not match
+ *         the output arguments. The method call is completed regardless.
+ *         Returns UA_STATUSCODE_BADTIMEOUT if the response was already sent
+ *         (or discarded) without the output. */
+UA_StatusCode UA_EXPORT
+UA_Server_completeMethodCall(UA_Server *server, UA_MethodCallToken *token,
+                             UA_StatusCode result, size_t outputSize,
+                             const UA_Variant *output);
+#endif
+
 /**
  * .. _addnodes:
  *
@@ -882,6 +1180,33 @@ UA_Server_deleteReference(UA_Server *server, const UA_NodeId sourceNodeId,
                           const UA_ExpandedNodeId targetNodeId,
                           UA_Boolean deleteBidirectional);
 
+/**
+ * Bulk Loading
+ * ------------
+ * Large information models (e.g. generated from a nodeset) are added faster as
+ * a batch of nodes and references than node by node. The nodestore is grown
+ * once for the entire batch. The consistency checks of AddNodes (parent node,
+ * reference type, type definition) run once for the batch after all nodes were
+ * created. The references are linked in one pass with a single edit of each
+ * existing node.
+ *
+ * The nodes must have a NodeId, so that the batch can refer to them. The
+ * parents and types may be defined later in the batch. But the variable types
+ * of variables need to precede them. Objects and variables reference their
+ * type definition and the object constructor is called. But the children of
+ * the type are not instantiated. The batch is expected to contain all nodes of
+ * the model.
+ *
+ * The status codes for the nodes and references are written to the optional
+ * result arrays. A node fails if its parent fails. The first failing status
+ * code is returned. If the bulk loading is aborted with an internal error,
+ * some of the nodes may have been added. */
+UA_StatusCode UA_EXPORT
+UA_Server_addNodesBulk(UA_Server *server,
+                       size_t nodesSize, const UA_AddNodesItem *nodes,
+                       size_t referencesSize, const UA_AddReferencesItem *references,
+                       UA_StatusCode *nodeResults, UA_StatusCode *referenceResults);
+
 #ifdef __cplusplus
 }
 #endif
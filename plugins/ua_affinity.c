@@ -0,0 +1,54 @@
+/* This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information. */
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+# define _GNU_SOURCE /* sched_setaffinity, CPU_SET */
+#endif
+
+#include "ua_server.h"
+
+#ifdef __linux__
+# include <sched.h>
+# include <unistd.h>
+# include <sys/syscall.h>
+#endif
+
+/* CPU_SET is only defined if the system headers were included with
+ * _GNU_SOURCE. Otherwise (e.g. in the amalgamated build), the placement is
+ * left to the scheduler. */
+
+UA_StatusCode UA_Thread_setAffinity(const UA_CpuSet *cpuSet) {
+#if defined(__linux__) && defined(CPU_SET)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for(size_t i = 0; i < cpuSet->cpusSize; ++i) {
+        if(cpuSet->cpus[i] >= CPU_SETSIZE)
+            return UA_STATUSCODE_BADINVALIDARGUMENT;
+        CPU_SET(cpuSet->cpus[i], &set);
+    }
+    if(sched_setaffinity(0, sizeof(cpu_set_t), &set) != 0)
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+    return UA_STATUSCODE_GOOD;
+#else
+    return UA_STATUSCODE_BADNOTSUPPORTED;
+#endif
+}
+
+void UA_Thread_getPlacement(UA_ThreadPlacement *placement) {
+    placement->pinned = false;
+    placement->cpu = -1;
+    placement->numaNode = -1;
+    placement->cpusSize = 0;
+#if defined(__linux__) && defined(CPU_SET)
+    cpu_set_t set;
+    if(sched_getaffinity(0, sizeof(cpu_set_t), &set) == 0)
+        placement->cpusSize = (size_t)CPU_COUNT(&set);
+# ifdef SYS_getcpu
+    unsigned int cpu, node;
+    if(syscall(SYS_getcpu, &cpu, &node, NULL) == 0) {
+        placement->cpu = (UA_Int32)cpu;
+        placement->numaNode = (UA_Int32)node;
+    }
+# endif
+#endif
+}
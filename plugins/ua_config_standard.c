@@ -69,6 +69,29 @@ const UA_EXPORT UA_ServerConfig UA_ServerConfig_standard = {
     .networkLayersSize = 0,
     .networkLayers = NULL,
 
+    /* Thread Placement */
+    .networkCpuSet = {.cpusSize = 0, .cpus = NULL},
+    .workerCpuSetsSize = 0,
+    .workerCpuSets = NULL,
+
+    /* Job Priorities */
+    .samplingJobPriority = UA_JOBPRIORITY_REALTIME,
+    .publishJobPriority = UA_JOBPRIORITY_REALTIME,
+    .messageJobPriority = UA_JOBPRIORITY_NORMAL,
+    .repeatedJobPriority = UA_JOBPRIORITY_NORMAL,
+
+    /* Memory Reclamation */
+    .reclamationBudget = 1000,
+
+    /* Intra-request Parallelism */
+    .parallelItemsThreshold = 1000,
+
+    /* Browse Cache */
+    .browseCacheSize = 0, /* disabled */
+
+    /* Nodestore (the default nodestore) */
+    .nodestore = {.newNodeStore = NULL},
+
     /* Login */
     .enableAnonymousLogin = true,
     .enableUsernamePasswordLogin = true,
@@ -82,6 +105,13 @@ const UA_EXPORT UA_ServerConfig UA_ServerConfig_standard = {
     /* Limits for Sessions */
     .maxSessions = 100,
     .maxSessionTimeout = 60.0 * 60.0 * 1000.0, /* 1h */
+    .maxContinuationPoints = 5,
+    .maxRegisteredNodes = 10000,
+    .maxQueryContinuationPoints = 5,
+    .maxQueryDataSets = 1000,
+
+    .asyncReadTimeout = 10000, /* 10s */
+    .asyncCallTimeout = 10000, /* 10s */
 
     /* Limits for Subscriptions */
     .publishingIntervalLimits = { .min = 100.0, .max = 3600.0 * 1000.0 },
@@ -251,7 +251,11 @@ static void FreeConnectionCallback(UA_Server *server, void *ptr) {
  *   return a workitem that is delayed, i.e. that is called only after all
  *   workitems created before are finished in all threads. This workitems
  *   contains a callback that goes through the linked list of connections to be
- *   freed. */
+ *   freed.
+ *
+ * The select in GetJobs can be interrupted from other threads via a
+ * self-pipe. Wakeup writes a byte into the pipe, GetJobs drains it. (Not on
+ * Windows where select only works on sockets.) */
 
 #define MAXBACKLOG 100
 
@@ -267,6 +271,11 @@ typedef struct {
         UA_Connection *connection;
         UA_Int32 sockfd;
     } *mappings;
+
+#ifndef _WIN32
+    /* self-pipe to interrupt the select. -1 if not open. */
+    int wakeupPipe[2];
+#endif
 } ServerNetworkLayerTCP;
 
 static UA_StatusCode
@@ -297,9 +306,36 @@ setFDSet(ServerNetworkLayerTCP *layer, fd_set *fdset) {
         if(layer->mappings[i].sockfd > highestfd)
             highestfd = layer->mappings[i].sockfd;
     }
+#ifndef _WIN32
+    if(layer->wakeupPipe[0] >= 0) {
+        UA_fd_set(layer->wakeupPipe[0], fdset);
+        if(layer->wakeupPipe[0] > highestfd)
+            highestfd = layer->wakeupPipe[0];
+    }
+#endif
     return highestfd;
 }
 
+#ifndef _WIN32
+/* callback triggered from the server (possibly from a different thread) */
+static void
+ServerNetworkLayerTCP_wakeup(UA_ServerNetworkLayer *nl) {
+    ServerNetworkLayerTCP *layer = nl->handle;
+    if(layer->wakeupPipe[1] < 0)
+        return;
+    /* If the pipe is full, a wakeup is pending anyway */
+    char c = 0;
+    ssize_t n = write(layer->wakeupPipe[1], &c, 1);
+    (void)n;
+}
+
+static void
+drainWakeupPipe(ServerNetworkLayerTCP *layer) {
+    char buf[64];
+    while(read(layer->wakeupPipe[0], buf, sizeof(buf)) > 0) {}
+}
+#endif
+
 /* callback triggered from the server */
 static void
 ServerNetworkLayerTCP_closeConnection(UA_Connection *connection) {
@@ -434,6 +470,28 @@ ServerNetworkLayerTCP_start(UA_ServerNetworkLayer *nl, UA_Logger logger) {
     }
 
     layer->serversockfd = (UA_Int32)newsock; /* cast on win32 */
+
+#ifndef _WIN32
+    /* Open the self-pipe for wakeups. Without it, the server falls back to
+       polling the networklayer. */
+    if(layer->wakeupPipe[0] < 0) {
+        if(pipe(layer->wakeupPipe) != 0 ||
+           socket_set_nonblocking(layer->wakeupPipe[0]) != UA_STATUSCODE_GOOD ||
+           socket_set_nonblocking(layer->wakeupPipe[1]) != UA_STATUSCODE_GOOD) {
+            UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK,
+                           "Could not open the wakeup pipe");
+            if(layer->wakeupPipe[0] >= 0) {
+                close(layer->wakeupPipe[0]);
+                close(layer->wakeupPipe[1]);
+            }
+            layer->wakeupPipe[0] = -1;
+            layer->wakeupPipe[1] = -1;
+        } else {
+            nl->wakeup = ServerNetworkLayerTCP_wakeup;
+        }
+    }
+#endif
+
     UA_LOG_INFO(layer->logger, UA_LOGCATEGORY_NETWORK,
                 "TCP network layer listening on %.*s",
                 nl->discoveryUrl.length, nl->discoveryUrl.data);
@@ -446,13 +504,24 @@ ServerNetworkLayerTCP_getJobs(UA_ServerNetworkLayer *nl, UA_Job **jobs, UA_UInt1
     fd_set fdset, errset;
     UA_Int32 highestfd = setFDSet(layer, &fdset);
     setFDSet(layer, &errset);
-    struct timeval tmptv = {0, timeout * 1000};
-    UA_Int32 resultsize = select(highestfd+1, &fdset, NULL, &errset, &tmptv);
+    struct timeval tmptv = {timeout / 1000, (timeout % 1000) * 1000};
+    struct timeval *tv = &tmptv;
+    if(timeout == UA_UINT16_MAX)
+        tv = NULL; /* wait until an event arrives */
+    UA_Int32 resultsize = select(highestfd+1, &fdset, NULL, &errset, tv);
     if(resultsize <= 0) {
         *jobs = NULL;
         return 0;
     }
 
+#ifndef _WIN32
+    /* we have been woken up */
+    if(layer->wakeupPipe[0] >= 0 && UA_fd_isset(layer->wakeupPipe[0], &fdset)) {
+        --resultsize;
+        drainWakeupPipe(layer);
+    }
+#endif
+
     /* accept new connections (can only be a single one) */
     if(UA_fd_isset(layer->serversockfd, &fdset)) {
         --resultsize;
@@ -549,6 +618,15 @@ ServerNetworkLayerTCP_stop(UA_ServerNetworkLayer *nl, UA_Job **jobs) {
 /* run only when the server is stopped */
 static void ServerNetworkLayerTCP_deleteMembers(UA_ServerNetworkLayer *nl) {
     ServerNetworkLayerTCP *layer = nl->handle;
+#ifndef _WIN32
+    /* Closed only here, since other threads might call wakeup until the
+       server is stopped */
+    nl->wakeup = NULL;
+    if(layer->wakeupPipe[0] >= 0) {
+        close(layer->wakeupPipe[0]);
+        close(layer->wakeupPipe[1]);
+    }
+#endif
     free(layer->mappings);
     free(layer);
     UA_String_deleteMembers(&nl->discoveryUrl);
@@ -571,6 +649,10 @@ UA_ServerNetworkLayerTCP(UA_ConnectionConfig conf, UA_UInt16 port) {
     
     layer->conf = conf;
     layer->port = port;
+#ifndef _WIN32
+    layer->wakeupPipe[0] = -1;
+    layer->wakeupPipe[1] = -1;
+#endif
 
     nl.handle = layer;
     nl.start = ServerNetworkLayerTCP_start;
@@ -7,6 +7,13 @@
 #include "ua_nodestore.h"
 #include "ua_util.h"
 
+#ifdef UA_ENABLE_MULTITHREADING
+# include <sched.h> /* sched_yield */
+#endif
+
+static void deleteReferenceIndex(UA_ReferenceIndex *index);
+static UA_StatusCode indexReferences(UA_Node *node);
+
 void UA_Node_deleteMembersAnyNodeClass(UA_Node *node) {
     /* delete standard content */
     UA_NodeId_deleteMembers(&node->nodeId);
@@ -17,6 +24,10 @@ void UA_Node_deleteMembersAnyNodeClass(UA_Node *node) {
                     &UA_TYPES[UA_TYPES_REFERENCENODE]);
     node->references = NULL;
     node->referencesSize = 0;
+    if(node->referencesIndex) {
+        deleteReferenceIndex(node->referencesIndex);
+        node->referencesIndex = NULL;
+    }
 
     /* delete unique content of the nodeclass */
     switch(node->nodeClass) {
@@ -77,6 +88,10 @@ UA_CommonVariableNode_copy(const UA_VariableNode *src, UA_VariableNode *dst) {
         dst->value.data.callback = src->value.data.callback;
     } else
         dst->value.dataSource = src->value.dataSource;
+#ifdef UA_ENABLE_MULTITHREADING
+    /* The copy shares the value cell */
+    dst->valueCell = src->valueCell;
+#endif
     return retval;
 }
 
@@ -105,6 +120,7 @@ UA_MethodNode_copy(const UA_MethodNode *src, UA_MethodNode *dst) {
     dst->userExecutable = src->userExecutable;
     dst->methodHandle  = src->methodHandle;
     dst->attachedMethod = src->attachedMethod;
+    dst->asyncMethod = src->asyncMethod;
     return UA_STATUSCODE_GOOD;
 }
 
@@ -150,6 +166,7 @@ UA_StatusCode UA_Node_copyAnyNodeClass(const UA_Node *src, UA_Node *dst) {
     retval |= UA_LocalizedText_copy(&src->description, &dst->description);
     dst->writeMask = src->writeMask;
     dst->userWriteMask = src->userWriteMask;
+    dst->version = src->version;
     if(retval != UA_STATUSCODE_GOOD) {
         UA_Node_deleteMembersAnyNodeClass(dst);
         return retval;
@@ -162,6 +179,9 @@ UA_StatusCode UA_Node_copyAnyNodeClass(const UA_Node *src, UA_Node *dst) {
         return retval;
     }
     dst->referencesSize = src->referencesSize;
+    dst->referencesIndex = NULL;
+    if(src->referencesIndex)
+        indexReferences(dst); /* the copy can be used without the index */
 
     /* copy unique content of the nodeclass */
     switch(src->nodeClass) {
@@ -205,3 +225,650 @@ UA_StatusCode UA_Node_copyAnyNodeClass(const UA_Node *src, UA_Node *dst) {
 
     return retval;
 }
+
+/**************/
+/* References */
+/**************/
+
+/* Nodes get an index when they have at least this many references */
+#define UA_REFERENCEINDEX_MINREFS 64
+
+typedef struct {
+    UA_NodeId referenceTypeId;
+    UA_Boolean isInverse;
+    size_t count;
+} UA_ReferenceGroup;
+
+/* The slots of the hash-map (with linear probing) contain the position+1 of
+ * the references. Zero marks an empty slot. */
+#define UA_REFERENCEINDEX_TOMBSTONE (~(size_t)0)
+
+struct UA_ReferenceIndex {
+    size_t capacity; /* of the references array, grows geometrically */
+    size_t groupsSize;
+    UA_ReferenceGroup *groups; /* in the order of the references array */
+    size_t *slots;
+    size_t slotsSize; /* power of two */
+    size_t slotsUsed; /* including tombstones */
+};
+
+static size_t
+referenceHash(const UA_NodeId *referenceTypeId, UA_Boolean isInverse,
+              const UA_NodeId *targetId) {
+    return (size_t)(UA_NodeId_hash(targetId) ^
+                    (UA_NodeId_hash(referenceTypeId) * 31) ^ (UA_UInt32)isInverse);
+}
+
+static void
+deleteReferenceIndex(UA_ReferenceIndex *index) {
+    for(size_t i = 0; i < index->groupsSize; ++i)
+        UA_NodeId_deleteMembers(&index->groups[i].referenceTypeId);
+    UA_free(index->groups);
+    UA_free(index->slots);
+    UA_free(index);
+}
+
+/* Returns groupsSize if the group is not found. Begin is set to the position
+ * of the first reference in the group (or after the last group). */
+static size_t
+findGroup(const UA_ReferenceIndex *index, const UA_NodeId *referenceTypeId,
+          UA_Boolean isInverse, size_t *begin) {
+    *begin = 0;
+    size_t i = 0;
+    for(; i < index->groupsSize; ++i) {
+        const UA_ReferenceGroup *g = &index->groups[i];
+        if(g->isInverse == isInverse && UA_NodeId_equal(&g->referenceTypeId, referenceTypeId))
+            break;
+        *begin += g->count;
+    }
+    return i;
+}
+
+static UA_StatusCode
+addGroup(UA_ReferenceIndex *index, const UA_NodeId *referenceTypeId, UA_Boolean isInverse) {
+    UA_ReferenceGroup *groups =
+        UA_realloc(index->groups, sizeof(UA_ReferenceGroup) * (index->groupsSize + 1));
+    if(!groups)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    index->groups = groups;
+    UA_ReferenceGroup *g = &groups[index->groupsSize];
+    UA_StatusCode retval = UA_NodeId_copy(referenceTypeId, &g->referenceTypeId);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    g->isInverse = isInverse;
+    g->count = 0;
+    ++index->groupsSize;
+    return UA_STATUSCODE_GOOD;
+}
+
+static void
+insertSlot(UA_ReferenceIndex *index, const UA_ReferenceNode *refs, size_t pos) {
+    const UA_ReferenceNode *ref = &refs[pos];
+    size_t mask = index->slotsSize - 1;
+    size_t i = referenceHash(&ref->referenceTypeId, ref->isInverse,
+                             &ref->targetId.nodeId) & mask;
+    while(index->slots[i] != 0 && index->slots[i] != UA_REFERENCEINDEX_TOMBSTONE)
+        i = (i + 1) & mask;
+    if(index->slots[i] == 0)
+        ++index->slotsUsed;
+    index->slots[i] = pos + 1;
+}
+
+/* Returns the slot that points to the reference at the position */
+static size_t *
+findSlotOfPosition(UA_ReferenceIndex *index, const UA_ReferenceNode *refs, size_t pos) {
+    const UA_ReferenceNode *ref = &refs[pos];
+    size_t mask = index->slotsSize - 1;
+    size_t i = referenceHash(&ref->referenceTypeId, ref->isInverse,
+                             &ref->targetId.nodeId) & mask;
+    while(index->slots[i] != pos + 1) {
+        UA_assert(index->slots[i] != 0);
+        i = (i + 1) & mask;
+    }
+    return &index->slots[i];
+}
+
+static size_t *
+findReferenceSlot(UA_ReferenceIndex *index, const UA_ReferenceNode *refs,
+                  const UA_NodeId *referenceTypeId, UA_Boolean isInverse,
+                  const UA_NodeId *targetId) {
+    size_t mask = index->slotsSize - 1;
+    size_t i = referenceHash(referenceTypeId, isInverse, targetId) & mask;
+    for(; index->slots[i] != 0; i = (i + 1) & mask) {
+        if(index->slots[i] == UA_REFERENCEINDEX_TOMBSTONE)
+            continue;
+        const UA_ReferenceNode *ref = &refs[index->slots[i] - 1];
+        if(ref->isInverse == isInverse &&
+           UA_NodeId_equal(&ref->targetId.nodeId, targetId) &&
+           UA_NodeId_equal(&ref->referenceTypeId, referenceTypeId))
+            return &index->slots[i];
+    }
+    return NULL;
+}
+
+/* The hash-map is at most half full */
+static UA_StatusCode
+rehashSlots(UA_ReferenceIndex *index, const UA_ReferenceNode *refs, size_t refsSize) {
+    size_t nsize = 128;
+    while(nsize < refsSize * 4)
+        nsize *= 2;
+    size_t *nslots = UA_calloc(nsize, sizeof(size_t));
+    if(!nslots)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    UA_free(index->slots);
+    index->slots = nslots;
+    index->slotsSize = nsize;
+    index->slotsUsed = 0;
+    for(size_t i = 0; i < refsSize; ++i)
+        insertSlot(index, refs, i);
+    return UA_STATUSCODE_GOOD;
+}
+
+static void
+moveReference(UA_ReferenceIndex *index, UA_ReferenceNode *refs, size_t from, size_t to) {
+    size_t *slot = findSlotOfPosition(index, refs, from);
+    refs[to] = refs[from];
+    *slot = to + 1;
+}
+
+/* Sorts the references into groups (keeping the order within the groups) and
+ * creates the index. If this fails, the node is left unchanged. */
+static UA_StatusCode
+indexReferences(UA_Node *node) {
+    UA_ReferenceIndex *index = UA_calloc(1, sizeof(UA_ReferenceIndex));
+    if(!index)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+
+    /* Count the references per group */
+    size_t begin;
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    for(size_t i = 0; i < node->referencesSize && retval == UA_STATUSCODE_GOOD; ++i) {
+        const UA_ReferenceNode *ref = &node->references[i];
+        size_t g = findGroup(index, &ref->referenceTypeId, ref->isInverse, &begin);
+        if(g == index->groupsSize)
+            retval = addGroup(index, &ref->referenceTypeId, ref->isInverse);
+        if(retval == UA_STATUSCODE_GOOD)
+            ++index->groups[g].count;
+    }
+
+    /* Move the references into the groups */
+    index->capacity = UA_REFERENCEINDEX_MINREFS;
+    while(index->capacity < node->referencesSize)
+        index->capacity *= 2;
+    UA_ReferenceNode *refs = NULL;
+    size_t *next = NULL;
+    if(retval == UA_STATUSCODE_GOOD) {
+        refs = UA_malloc(sizeof(UA_ReferenceNode) * index->capacity);
+        next = UA_malloc(sizeof(size_t) * (index->groupsSize + 1));
+        if(!refs || !next)
+            retval = UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    if(retval == UA_STATUSCODE_GOOD) {
+        next[0] = 0;
+        for(size_t g = 0; g < index->groupsSize; ++g)
+            next[g+1] = next[g] + index->groups[g].count;
+        for(size_t i = 0; i < node->referencesSize; ++i) {
+            const UA_ReferenceNode *ref = &node->references[i];
+            size_t g = findGroup(index, &ref->referenceTypeId, ref->isInverse, &begin);
+            refs[next[g]++] = *ref;
+        }
+        retval = rehashSlots(index, refs, node->referencesSize);
+    }
+    UA_free(next);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_free(refs);
+        deleteReferenceIndex(index);
+        return retval;
+    }
+    UA_free(node->references);
+    node->references = refs;
+    node->referencesIndex = index;
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_Node_addReference(UA_Node *node, const UA_NodeId *referenceTypeId,
+                     UA_Boolean isInverse, const UA_ExpandedNodeId *targetId) {
+    UA_ReferenceIndex *index = node->referencesIndex;
+    size_t size = node->referencesSize;
+
+    /* Make room */
+    if(!index) {
+        size_t refssize = (size+1) | 3; // so the realloc is not necessary every time
+        UA_ReferenceNode *new_refs =
+            UA_realloc(node->references, sizeof(UA_ReferenceNode) * refssize);
+        if(!new_refs)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        node->references = new_refs;
+    } else {
+        if(size == index->capacity) {
+            UA_ReferenceNode *new_refs =
+                UA_realloc(node->references, sizeof(UA_ReferenceNode) * size * 2);
+            if(!new_refs)
+                return UA_STATUSCODE_BADOUTOFMEMORY;
+            node->references = new_refs;
+            index->capacity = size * 2;
+        }
+        if((index->slotsUsed + 1) * 2 > index->slotsSize &&
+           rehashSlots(index, node->references, size) != UA_STATUSCODE_GOOD)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+
+    UA_ReferenceNode ref;
+    UA_ReferenceNode_init(&ref);
+    UA_StatusCode retval = UA_NodeId_copy(referenceTypeId, &ref.referenceTypeId);
+    retval |= UA_ExpandedNodeId_copy(targetId, &ref.targetId);
+    ref.isInverse = isInverse;
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_ReferenceNode_deleteMembers(&ref);
+        return retval;
+    }
+
+    /* Append without an index */
+    if(!index) {
+        node->references[size] = ref;
+        node->referencesSize = size + 1;
+        /* Without the index, the references are only slower to find */
+        if(node->referencesSize >= UA_REFERENCEINDEX_MINREFS)
+            indexReferences(node);
+        return UA_STATUSCODE_GOOD;
+    }
+
+    /* Insert at the end of the group. The first reference of each following
+     * group moves to the end of its group. */
+    size_t begin;
+    size_t g = findGroup(index, referenceTypeId, isInverse, &begin);
+    if(g == index->groupsSize) {
+        retval = addGroup(index, referenceTypeId, isInverse);
+        if(retval != UA_STATUSCODE_GOOD) {
+            UA_ReferenceNode_deleteMembers(&ref);
+            return retval;
+        }
+    }
+    size_t pos = size;
+    for(size_t h = index->groupsSize - 1; h > g; --h) {
+        size_t first = pos - index->groups[h].count;
+        moveReference(index, node->references, first, pos);
+        pos = first;
+    }
+    node->references[pos] = ref;
+    node->referencesSize = size + 1;
+    ++index->groups[g].count;
+    insertSlot(index, node->references, pos);
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_Node_deleteReference(UA_Node *node, const UA_NodeId *referenceTypeId,
+                        UA_Boolean isInverse, const UA_NodeId *targetId) {
+    UA_ReferenceIndex *index = node->referencesIndex;
+    if(!index) {
+        UA_Boolean edited = false;
+        for(size_t i = node->referencesSize; i > 0; --i) {
+            UA_ReferenceNode *ref = &node->references[i-1];
+            if(!UA_NodeId_equal(targetId, &ref->targetId.nodeId))
+                continue;
+            if(!UA_NodeId_equal(referenceTypeId, &ref->referenceTypeId))
+                continue;
+            if(isInverse != ref->isInverse)
+                continue;
+            UA_ReferenceNode_deleteMembers(ref);
+            /* move the last entry to override the current position */
+            node->references[i-1] = node->references[node->referencesSize-1];
+            --node->referencesSize;
+            edited = true;
+            break;
+        }
+        if(!edited)
+            return UA_STATUSCODE_UNCERTAINREFERENCENOTDELETED;
+    } else {
+        size_t *slot = findReferenceSlot(index, node->references, referenceTypeId,
+                                         isInverse, targetId);
+        if(!slot)
+            return UA_STATUSCODE_UNCERTAINREFERENCENOTDELETED;
+        size_t hole = *slot - 1;
+        *slot = UA_REFERENCEINDEX_TOMBSTONE;
+        UA_ReferenceNode_deleteMembers(&node->references[hole]);
+
+        /* Close the gap. The last reference of the group and of each following
+         * group moves down. */
+        size_t begin;
+        size_t g = findGroup(index, referenceTypeId, isInverse, &begin);
+        size_t last = begin + index->groups[g].count - 1;
+        if(last != hole)
+            moveReference(index, node->references, last, hole);
+        hole = last;
+        for(size_t h = g + 1; h < index->groupsSize; ++h) {
+            last = hole + index->groups[h].count;
+            moveReference(index, node->references, last, hole);
+            hole = last;
+        }
+        --node->referencesSize;
+
+        /* Remove the empty group */
+        if(--index->groups[g].count == 0) {
+            UA_NodeId_deleteMembers(&index->groups[g].referenceTypeId);
+            memmove(&index->groups[g], &index->groups[g+1],
+                    sizeof(UA_ReferenceGroup) * (index->groupsSize - g - 1));
+            --index->groupsSize;
+        }
+    }
+
+    /* we removed the last reference */
+    if(node->referencesSize == 0) {
+        UA_free(node->references);
+        node->references = NULL;
+        if(node->referencesIndex) {
+            deleteReferenceIndex(node->referencesIndex);
+            node->referencesIndex = NULL;
+        }
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+size_t
+UA_Node_referenceGroupEnd(const UA_Node *node, size_t position) {
+    const UA_ReferenceIndex *index = node->referencesIndex;
+    if(!index)
+        return position + 1;
+    size_t end = 0;
+    for(size_t i = 0; i < index->groupsSize; ++i) {
+        end += index->groups[i].count;
+        if(position < end)
+            return end;
+    }
+    return position + 1;
+}
+
+/***************/
+/* Value Cells */
+/***************/
+
+const UA_DataValue * UA_VariableNode_getValue(const UA_VariableNode *node) {
+#ifdef UA_ENABLE_MULTITHREADING
+    if(node->valueCell)
+        return &rcu_dereference(node->valueCell->version)->value;
+#endif
+    return &node->value.data.value;
+}
+
+#ifdef UA_ENABLE_MULTITHREADING
+
+UA_ValueCellVersion * UA_ValueCellVersion_new(void) {
+    return (UA_ValueCellVersion*)UA_calloc(1, sizeof(UA_ValueCellVersion));
+}
+
+void UA_ValueCellVersion_delete(UA_ValueCellVersion *version) {
+    UA_DataValue_deleteMembers(&version->value);
+    UA_free(version);
+}
+
+static void deleteValueCellVersion(struct rcu_head *head) {
+    UA_ValueCellVersion *version = container_of(head, UA_ValueCellVersion, rcu_head);
+    UA_ValueCellVersion_delete(version);
+}
+
+void UA_ValueCellVersion_retire(UA_ValueCellVersion *version) {
+    call_rcu(&version->rcu_head, deleteValueCellVersion);
+}
+
+UA_StatusCode UA_VariableNode_createValueCell(UA_VariableNode *node) {
+    UA_ValueCell *cell = (UA_ValueCell*)UA_malloc(sizeof(UA_ValueCell));
+    if(!cell)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    cell->version = UA_ValueCellVersion_new();
+    if(!cell->version) {
+        UA_free(cell);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    /* Move the value */
+    cell->version->value = node->value.data.value;
+    UA_DataValue_init(&node->value.data.value);
+    node->valueCell = cell;
+    return UA_STATUSCODE_GOOD;
+}
+
+void UA_ValueCell_delete(UA_ValueCell *cell) {
+    UA_ValueCellVersion_delete(cell->version);
+    UA_free(cell);
+}
+
+/* The members of the value were moved to the next version */
+static void freeValueCellVersion(struct rcu_head *head) {
+    UA_free(container_of(head, UA_ValueCellVersion, rcu_head));
+}
+
+/* The lock is held only for the replace of a node. Spin for a short while and
+ * then give up the processor, so that the thread holding the lock can run. */
+#define UA_VALUECELL_SPINS 100
+
+void UA_ValueCell_wait(size_t *spins) {
+    if(*spins < UA_VALUECELL_SPINS) {
+        ++*spins;
+        UA_atomic_sync();
+        return;
+    }
+    sched_yield();
+}
+
+UA_ValueCellVersion * UA_ValueCell_lock(UA_ValueCell *cell) {
+    UA_ValueCellVersion *locked = UA_ValueCellVersion_new();
+    if(!locked)
+        return NULL;
+    locked->locked = true;
+    size_t spins = 0;
+    while(true) {
+        UA_ValueCellVersion *old = rcu_dereference(cell->version);
+        if(old->locked) {
+            UA_ValueCell_wait(&spins);
+            continue;
+        }
+        /* The value is immutable and readers of the old version can still
+         * access it. So the members are shared and not copied. */
+        locked->value = old->value;
+        if(rcu_cmpxchg_pointer(&cell->version, old, locked) == old) {
+            call_rcu(&old->rcu_head, freeValueCellVersion);
+            return locked;
+        }
+    }
+}
+
+void UA_ValueCell_unlock(UA_ValueCellVersion *locked) {
+    UA_atomic_sync(); /* The replaced node is visible before the unlock */
+    locked->locked = false;
+}
+
+UA_Boolean
+UA_VariableNode_sameConstraints(const UA_VariableNode *n1, const UA_VariableNode *n2) {
+    if(n1->valueRank != n2->valueRank ||
+       n1->arrayDimensionsSize != n2->arrayDimensionsSize ||
+       !UA_NodeId_equal(&n1->dataType, &n2->dataType))
+        return false;
+    for(size_t i = 0; i < n1->arrayDimensionsSize; ++i) {
+        if(n1->arrayDimensions[i] != n2->arrayDimensions[i])
+            return false;
+    }
+    return true;
+}
+
+#endif /* UA_ENABLE_MULTITHREADING */
+
+/******************/
+/* Interned Names */
+/******************/
+
+#define UA_STRINGTABLE_MINSIZE 64 /* power of two */
+
+typedef struct UA_StringTableEntry {
+    struct UA_StringTableEntry *next;
+    UA_UInt32 hash;
+    UA_UInt32 refCount;
+    size_t length;
+    UA_Byte data[1]; /* the actual size is length */
+} UA_StringTableEntry;
+
+struct UA_StringTable {
+    UA_StringTableEntry **buckets;
+    size_t size;
+    size_t count;
+#ifdef UA_ENABLE_MULTITHREADING
+    /* Nodes are released from the rcu callbacks in another thread */
+    pthread_mutex_t mutex;
+#endif
+};
+
+#ifdef UA_ENABLE_MULTITHREADING
+# define UA_STRINGTABLE_LOCK(st) pthread_mutex_lock(&(st)->mutex)
+# define UA_STRINGTABLE_UNLOCK(st) pthread_mutex_unlock(&(st)->mutex)
+#else
+# define UA_STRINGTABLE_LOCK(st)
+# define UA_STRINGTABLE_UNLOCK(st)
+#endif
+
+/* FNV-1a */
+static UA_UInt32
+stringHash(const UA_String *s) {
+    UA_UInt32 h = 2166136261u;
+    for(size_t i = 0; i < s->length; ++i) {
+        h ^= s->data[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static UA_StringTableEntry **
+findStringEntry(UA_StringTable *st, const UA_String *s, UA_UInt32 hash) {
+    UA_StringTableEntry **e = &st->buckets[hash & (st->size - 1)];
+    for(; *e; e = &(*e)->next) {
+        if((*e)->hash == hash && (*e)->length == s->length &&
+           memcmp((*e)->data, s->data, s->length) == 0)
+            break;
+    }
+    return e;
+}
+
+static void
+growStringTable(UA_StringTable *st) {
+    size_t nsize = st->size * 2;
+    UA_StringTableEntry **nbuckets = UA_calloc(nsize, sizeof(UA_StringTableEntry*));
+    if(!nbuckets)
+        return; /* continue with longer chains */
+    for(size_t i = 0; i < st->size; ++i) {
+        UA_StringTableEntry *e = st->buckets[i];
+        while(e) {
+            UA_StringTableEntry *next = e->next;
+            e->next = nbuckets[e->hash & (nsize - 1)];
+            nbuckets[e->hash & (nsize - 1)] = e;
+            e = next;
+        }
+    }
+    UA_free(st->buckets);
+    st->buckets = nbuckets;
+    st->size = nsize;
+}
+
+UA_StringTable * UA_StringTable_new(void) {
+    UA_StringTable *st = UA_malloc(sizeof(UA_StringTable));
+    if(!st)
+        return NULL;
+    st->buckets = UA_calloc(UA_STRINGTABLE_MINSIZE, sizeof(UA_StringTableEntry*));
+    if(!st->buckets) {
+        UA_free(st);
+        return NULL;
+    }
+    st->size = UA_STRINGTABLE_MINSIZE;
+    st->count = 0;
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_init(&st->mutex, NULL);
+#endif
+    return st;
+}
+
+void UA_StringTable_delete(UA_StringTable *st) {
+    UA_assert(st->count == 0);
+    for(size_t i = 0; i < st->size; ++i) {
+        UA_StringTableEntry *e = st->buckets[i];
+        while(e) {
+            UA_StringTableEntry *next = e->next;
+            UA_free(e);
+            e = next;
+        }
+    }
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_destroy(&st->mutex);
+#endif
+    UA_free(st->buckets);
+    UA_free(st);
+}
+
+void UA_StringTable_intern(UA_StringTable *st, UA_String *s) {
+    if(s->length == 0)
+        return;
+    UA_UInt32 hash = stringHash(s);
+    UA_STRINGTABLE_LOCK(st);
+    UA_StringTableEntry **e = findStringEntry(st, s, hash);
+    if(*e) {
+        if((*e)->data == s->data) {
+            /* Interned already. Happens if the node is inserted again. */
+            UA_STRINGTABLE_UNLOCK(st);
+            return;
+        }
+        ++(*e)->refCount;
+    } else {
+        UA_StringTableEntry *new =
+            UA_malloc(offsetof(UA_StringTableEntry, data) + s->length);
+        if(!new) {
+            UA_STRINGTABLE_UNLOCK(st);
+            return;
+        }
+        new->next = NULL;
+        new->hash = hash;
+        new->refCount = 1;
+        new->length = s->length;
+        memcpy(new->data, s->data, s->length);
+        *e = new;
+        ++st->count;
+    }
+    UA_free(s->data);
+    s->data = (*e)->data;
+    if(st->count > st->size)
+        growStringTable(st);
+    UA_STRINGTABLE_UNLOCK(st);
+}
+
+void UA_StringTable_release(UA_StringTable *st, UA_String *s) {
+    if(s->length > 0) {
+        UA_UInt32 hash = stringHash(s);
+        UA_STRINGTABLE_LOCK(st);
+        UA_StringTableEntry **e = findStringEntry(st, s, hash);
+        if(*e && (*e)->data == s->data) {
+            if(--(*e)->refCount == 0) {
+                UA_StringTableEntry *old = *e;
+                *e = old->next;
+                UA_free(old);
+                --st->count;
+            }
+            UA_STRINGTABLE_UNLOCK(st);
+            UA_String_init(s);
+            return;
+        }
+        UA_STRINGTABLE_UNLOCK(st);
+    }
+    UA_String_deleteMembers(s);
+}
+
+void UA_Node_internNames(UA_StringTable *st, UA_Node *node) {
+    UA_StringTable_intern(st, &node->browseName.name);
+    UA_StringTable_intern(st, &node->displayName.locale);
+    UA_StringTable_intern(st, &node->displayName.text);
+    UA_StringTable_intern(st, &node->description.locale);
+    UA_StringTable_intern(st, &node->description.text);
+}
+
+void UA_Node_releaseNames(UA_StringTable *st, UA_Node *node) {
+    UA_StringTable_release(st, &node->browseName.name);
+    UA_StringTable_release(st, &node->displayName.locale);
+    UA_StringTable_release(st, &node->displayName.text);
+    UA_StringTable_release(st, &node->description.locale);
+    UA_StringTable_release(st, &node->description.text);
+}
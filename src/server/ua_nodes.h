@@ -32,10 +32,11 @@ extern "C" {
  * section on :ref:`ReferenceTypes <referencetypenode>` for more details on
  * possible references and their semantics.
  *
- * The structures defined in this section are *not user-facing*. The interaction
- * with the information model is possible only via the OPC UA :ref:`services`.
- * Still, we reproduce how nodes are represented internally so that users may
- * have a clear mental model.
+ * The interaction with the information model is possible only via the OPC UA
+ * :ref:`services`. The structures defined in this section are used directly
+ * only by custom implementations of the :ref:`nodestore` interface. Still, we
+ * reproduce how nodes are represented internally so that users may have a
+ * clear mental model.
  *
  * Base Node Attributes
  * --------------------
@@ -47,7 +48,17 @@ extern "C" {
  *
  * Internally, open62541 uses ``UA_Node`` in places where the exact node type is
  * not known or not important. The ``nodeClass`` attribute is used to ensure the
- * correctness of casting from ``UA_Node`` to a specific node type. */
+ * correctness of casting from ``UA_Node`` to a specific node type.
+ *
+ * Nodes with many references have an additional index (otherwise NULL). Then,
+ * the references with the same ReferenceType and direction are stored next to
+ * each other and can be found by their target NodeId.
+ *
+ * The version is increased with every edit of the node in the nodestore.
+ * Caches of information derived from the node compare the version to detect
+ * changes. */
+typedef struct UA_ReferenceIndex UA_ReferenceIndex;
+
 #define UA_NODE_BASEATTRIBUTES                  \
     UA_NodeId nodeId;                           \
     UA_NodeClass nodeClass;                     \
@@ -57,9 +68,11 @@ extern "C" {
     UA_UInt32 writeMask;                        \
     UA_UInt32 userWriteMask;                    \
     size_t referencesSize;                      \
-    UA_ReferenceNode *references;
+    UA_ReferenceNode *references;               \
+    UA_ReferenceIndex *referencesIndex;         \
+    UA_UInt32 version;
 
-typedef struct {
+typedef struct UA_Node {
     UA_NODE_BASEATTRIBUTES
 } UA_Node;
 
@@ -135,6 +148,16 @@ typedef enum {
     UA_VALUESOURCE_DATASOURCE
 } UA_ValueSource;
 
+/* In multithreaded builds, the value of a variable is moved into a value cell
+ * when the node is inserted into the nodestore. The cell is shared by all
+ * versions of the node, so that writing the value does not copy the node. */
+#ifdef UA_ENABLE_MULTITHREADING
+struct UA_ValueCell;
+# define UA_NODE_VALUECELL struct UA_ValueCell *valueCell;
+#else
+# define UA_NODE_VALUECELL
+#endif
+
 #define UA_NODE_VARIABLEATTRIBUTES                                      \
     /* Constraints on possible values */                                \
     UA_NodeId dataType;                                                 \
@@ -150,7 +173,8 @@ typedef enum {
             UA_ValueCallback callback;                                  \
         } data;                                                         \
         UA_DataSource dataSource;                                       \
-    } value;
+    } value;                                                            \
+    UA_NODE_VALUECELL
 
 typedef struct {
     UA_NODE_BASEATTRIBUTES
@@ -205,6 +229,7 @@ typedef struct {
     /* Members specific to open62541 */
     void *methodHandle;
     UA_MethodCallback attachedMethod;
+    UA_AsyncMethodCallback asyncMethod; /* Used instead of attachedMethod if set */
 } UA_MethodNode;
 
 /**
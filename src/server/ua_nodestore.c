@@ -15,14 +15,68 @@ typedef struct UA_NodeStoreEntry {
     UA_Node node;
 } UA_NodeStoreEntry;
 
+/* Nodes are allocated from slabs. There is one pool of slabs for each
+ * NodeClass. So the NodeClass of a node must not be changed. Deleted entries
+ * are kept in a free-list (linked via the orig pointer) and reused. The slabs
+ * are freed with the nodestore. */
+#define UA_NODESTORE_SLABSIZE 256 /* entries per slab */
+#define UA_NODESTORE_POOLS 8 /* one for each NodeClass */
+
+typedef struct UA_NodeStoreSlab {
+    struct UA_NodeStoreSlab *next;
+    UA_UInt64 entries[1]; /* the actual size is UA_NODESTORE_SLABSIZE entries */
+} UA_NodeStoreSlab;
+
+typedef struct {
+    size_t entrySize;
+    UA_NodeStoreSlab *slabs; /* the first slab is filled up */
+    size_t slabUsed; /* used entries in the first slab */
+    UA_NodeStoreEntry *freeList;
+} UA_NodeStorePool;
+
 #define UA_NODESTORE_TOMBSTONE ((UA_NodeStoreEntry*)0x01)
 
-struct UA_NodeStore {
-    UA_NodeStoreEntry **entries;
+/* Numeric NodeIds are stored in a direct-indexed array per namespace if the
+ * identifiers are dense. The array always covers the identifiers from zero to
+ * size-1. The size is a power of two. The array grows if it stays filled to at
+ * least 1/UA_NODESTORE_DENSEFILL or if it is below the minimum size. */
+#define UA_NODESTORE_DENSEMINSIZE 16384
+#define UA_NODESTORE_DENSEFILL 8
+
+typedef struct {
+    UA_NodeStoreEntry **entries; /* NULL for empty slots */
     UA_UInt32 size;
     UA_UInt32 count;
+} UA_NodeStoreDense;
+
+/* The hash is stored next to the pointer. Most probes that don't match are
+ * rejected without touching the node. */
+typedef struct {
+    UA_NodeStoreEntry *entry;
+    UA_UInt32 hash;
+} UA_NodeStoreSlot;
+
+typedef struct {
+    /* Hash-map for all NodeIds that are not in a dense array */
+    UA_NodeStoreSlot *entries;
+    UA_UInt32 size;
+    UA_UInt32 count;
+    UA_UInt32 tombstones; /* Removed entries. Probes continue past them. */
     UA_UInt32 sizePrimeIndex;
-};
+
+    /* Dense arrays indexed by the namespace index */
+    UA_NodeStoreDense *dense;
+    UA_UInt16 denseSize;
+
+    UA_NodeStorePool pools[UA_NODESTORE_POOLS];
+
+    /* Read-only nodes. They are hidden when a node with the same NodeId is in
+     * the nodestore or when they were removed. */
+    UA_NodeStoreImages images;
+
+    /* The names of the stored nodes are interned */
+    UA_StringTable *strings;
+} UA_DefaultNodeStore;
 
 /* The size of the hash-map is always a prime number. They are chosen to be
  * close to the next power of 2. So the size ca. doubles with each prime. */
@@ -51,8 +105,9 @@ higher_prime_index(UA_UInt32 n) {
     return low;
 }
 
-static UA_NodeStoreEntry *
-instantiateEntry(UA_NodeClass nodeClass) {
+/* Returns zero for an unknown NodeClass */
+static size_t
+entrySize(UA_NodeClass nodeClass) {
     size_t size = sizeof(UA_NodeStoreEntry) - sizeof(UA_Node);
     switch(nodeClass) {
     case UA_NODECLASS_OBJECT:
@@ -80,36 +135,97 @@ instantiateEntry(UA_NodeClass nodeClass) {
         size += sizeof(UA_ViewNode);
         break;
     default:
-        return NULL;
+        return 0;
     }
-    UA_NodeStoreEntry *entry = UA_calloc(1, size);
-    if(!entry)
+    /* Align the entries in the slab */
+    return (size + sizeof(UA_UInt64) - 1) & ~(sizeof(UA_UInt64) - 1);
+}
+
+/* The NodeClass enum values are single bits */
+static UA_Byte
+poolIndex(UA_NodeClass nodeClass) {
+    UA_Byte index = 0;
+    UA_UInt32 c = (UA_UInt32)nodeClass;
+    while(c > 1) {
+        c >>= 1;
+        ++index;
+    }
+    return index;
+}
+
+static UA_NodeStoreEntry *
+instantiateEntry(UA_DefaultNodeStore *ns, UA_NodeClass nodeClass) {
+    if(entrySize(nodeClass) == 0)
         return NULL;
+    UA_Byte index = poolIndex(nodeClass);
+    UA_NodeStorePool *pool = &ns->pools[index];
+
+    /* Take an entry from the free-list or from the first slab */
+    UA_NodeStoreEntry *entry = pool->freeList;
+    if(entry) {
+        pool->freeList = entry->orig;
+    } else {
+        if(!pool->slabs || pool->slabUsed == UA_NODESTORE_SLABSIZE) {
+            UA_NodeStoreSlab *slab =
+                UA_malloc(offsetof(UA_NodeStoreSlab, entries) +
+                          (pool->entrySize * UA_NODESTORE_SLABSIZE));
+            if(!slab)
+                return NULL;
+            slab->next = pool->slabs;
+            pool->slabs = slab;
+            pool->slabUsed = 0;
+        }
+        entry = (UA_NodeStoreEntry*)((uintptr_t)pool->slabs->entries +
+                                     (pool->slabUsed * pool->entrySize));
+        ++pool->slabUsed;
+    }
+
+    memset(entry, 0, pool->entrySize);
     entry->node.nodeClass = nodeClass;
     return entry;
 }
 
 static void
-deleteEntry(UA_NodeStoreEntry *entry) {
+deleteEntry(UA_DefaultNodeStore *ns, UA_NodeStoreEntry *entry) {
+    UA_NodeStorePool *pool = &ns->pools[poolIndex(entry->node.nodeClass)];
+    UA_Node_releaseNames(ns->strings, &entry->node);
     UA_Node_deleteMembersAnyNodeClass(&entry->node);
-    UA_free(entry);
+    entry->orig = pool->freeList;
+    pool->freeList = entry;
+}
+
+/* Returns the slot in the dense array if the NodeId is covered by one. Then
+ * the NodeId is never in the hash-map. */
+static UA_NodeStoreEntry **
+findDenseSlot(const UA_DefaultNodeStore *ns, const UA_NodeId *nodeid) {
+    if(nodeid->identifierType != UA_NODEIDTYPE_NUMERIC ||
+       nodeid->namespaceIndex >= ns->denseSize)
+        return NULL;
+    const UA_NodeStoreDense *dense = &ns->dense[nodeid->namespaceIndex];
+    if(nodeid->identifier.numeric >= dense->size)
+        return NULL;
+    return &dense->entries[nodeid->identifier.numeric];
 }
 
 /* returns slot of a valid node or null */
 static UA_NodeStoreEntry **
-findNode(const UA_NodeStore *ns, const UA_NodeId *nodeid) {
+findNode(const UA_DefaultNodeStore *ns, const UA_NodeId *nodeid) {
+    UA_NodeStoreEntry **slot = findDenseSlot(ns, nodeid);
+    if(slot)
+        return *slot ? slot : NULL;
+
     UA_UInt32 h = UA_NodeId_hash(nodeid);
     UA_UInt32 size = ns->size;
     UA_UInt32 idx = mod(h, size);
     UA_UInt32 hash2 = mod2(h, size);
 
     while(true) {
-        UA_NodeStoreEntry *e = ns->entries[idx];
-        if(!e)
+        UA_NodeStoreSlot *s = &ns->entries[idx];
+        if(!s->entry)
             return NULL;
-        if(e > UA_NODESTORE_TOMBSTONE &&
-           UA_NodeId_equal(&e->node.nodeId, nodeid))
-            return &ns->entries[idx];
+        if(s->hash == h && s->entry > UA_NODESTORE_TOMBSTONE &&
+           UA_NodeId_equal(&s->entry->node.nodeId, nodeid))
+            return &s->entry;
         idx += hash2;
         if(idx >= size)
             idx -= size;
@@ -120,57 +236,76 @@ findNode(const UA_NodeStore *ns, const UA_NodeId *nodeid) {
 }
 
 /* returns an empty slot or null if the nodeid exists */
-static UA_NodeStoreEntry **
-findSlot(const UA_NodeStore *ns, const UA_NodeId *nodeid) {
-    UA_UInt32 h = UA_NodeId_hash(nodeid);
+static UA_NodeStoreSlot *
+findSlot(const UA_DefaultNodeStore *ns, const UA_NodeId *nodeid, UA_UInt32 h) {
     UA_UInt32 size = ns->size;
     UA_UInt32 idx = mod(h, size);
     UA_UInt32 hash2 = mod2(h, size);
 
     while(true) {
-        UA_NodeStoreEntry *e = ns->entries[idx];
-        if(e > UA_NODESTORE_TOMBSTONE &&
-           UA_NodeId_equal(&e->node.nodeId, nodeid))
+        UA_NodeStoreSlot *s = &ns->entries[idx];
+        if(s->entry <= UA_NODESTORE_TOMBSTONE)
+            break;
+        if(s->hash == h && UA_NodeId_equal(&s->entry->node.nodeId, nodeid))
             return NULL;
-        if(ns->entries[idx] <= UA_NODESTORE_TOMBSTONE)
-            return &ns->entries[idx];
         idx += hash2;
         if(idx >= size)
             idx -= size;
     }
 
-    /* NOTREACHED */
-    return NULL;
+    /* The nodeid might still exist after a tombstone */
+    UA_NodeStoreSlot *empty = &ns->entries[idx];
+    while(ns->entries[idx].entry) {
+        UA_NodeStoreSlot *s = &ns->entries[idx];
+        if(s->hash == h && s->entry > UA_NODESTORE_TOMBSTONE &&
+           UA_NodeId_equal(&s->entry->node.nodeId, nodeid))
+            return NULL;
+        idx += hash2;
+        if(idx >= size)
+            idx -= size;
+    }
+    return empty;
 }
 
-/* The occupancy of the table after the call will be about 50% */
+/* Returns the image node if it was not removed. A node with the same NodeId
+ * in the nodestore takes precedence and needs to be checked before. */
+static const UA_Node *
+findImageNode(const UA_DefaultNodeStore *ns, const UA_NodeId *nodeid) {
+    return UA_NodeStoreImages_find(&ns->images, nodeid);
+}
+
+/* Rehash into a table sized for the given number of entries. The occupancy
+ * will be about 50% at that count. */
 static UA_StatusCode
-expand(UA_NodeStore *ns) {
+resize(UA_DefaultNodeStore *ns, UA_UInt32 targetCount) {
     UA_UInt32 osize = ns->size;
     UA_UInt32 count = ns->count;
-    /* Resize only when table after removal of unused elements is either too
-       full or too empty */
-    if(count * 2 < osize && (count * 8 > osize || osize <= UA_NODESTORE_MINSIZE))
-        return UA_STATUSCODE_GOOD;
-
-    UA_NodeStoreEntry **oentries = ns->entries;
-    UA_UInt32 nindex = higher_prime_index(count * 2);
+    UA_NodeStoreSlot *oentries = ns->entries;
+    UA_UInt32 nindex = higher_prime_index(targetCount * 2);
     UA_UInt32 nsize = primes[nindex];
-    UA_NodeStoreEntry **nentries = UA_calloc(nsize, sizeof(UA_NodeStoreEntry*));
+    UA_NodeStoreSlot *nentries = UA_calloc(nsize, sizeof(UA_NodeStoreSlot));
     if(!nentries)
         return UA_STATUSCODE_BADOUTOFMEMORY;
 
     ns->entries = nentries;
     ns->size = nsize;
+    ns->tombstones = 0;
     ns->sizePrimeIndex = nindex;
 
-    /* recompute the position of every entry and insert the pointer */
+    /* recompute the position of every entry from the stored hash. the nodeids
+     * are unique, so the first empty slot is taken. */
     for(size_t i = 0, j = 0; i < osize && j < count; ++i) {
-        if(oentries[i] <= UA_NODESTORE_TOMBSTONE)
+        if(oentries[i].entry <= UA_NODESTORE_TOMBSTONE)
             continue;
-        UA_NodeStoreEntry **e = findSlot(ns, &oentries[i]->node.nodeId);
-        UA_assert(e);
-        *e = oentries[i];
+        UA_UInt32 h = oentries[i].hash;
+        UA_UInt32 idx = mod(h, nsize);
+        UA_UInt32 hash2 = mod2(h, nsize);
+        while(nentries[idx].entry) {
+            idx += hash2;
+            if(idx >= nsize)
+                idx -= nsize;
+        }
+        nentries[idx] = oentries[i];
         ++j;
     }
 
@@ -178,56 +313,173 @@ expand(UA_NodeStore *ns) {
     return UA_STATUSCODE_GOOD;
 }
 
+static UA_StatusCode
+expand(UA_DefaultNodeStore *ns) {
+    UA_UInt32 osize = ns->size;
+    UA_UInt32 count = ns->count;
+    /* Resize only when table after removal of unused elements is either too
+       full or too empty. The tombstones are cleared by the rehash. Probes stop
+       only at empty slots, so the table must never fill up with them. */
+    if((count + ns->tombstones) * 4 < osize * 3 && count * 2 < osize &&
+       (count * 8 > osize || osize <= UA_NODESTORE_MINSIZE))
+        return UA_STATUSCODE_GOOD;
+    return resize(ns, count);
+}
+
+/* Grows the dense array of the namespace to cover the identifier, if the array
+ * stays dense enough with the added nodes. Nodes with a covered identifier are
+ * moved from the hash-map into the array. */
+static UA_StatusCode
+growDense(UA_DefaultNodeStore *ns, UA_UInt16 nsIndex, UA_UInt32 identifier,
+          UA_UInt32 added) {
+    if(nsIndex < ns->denseSize && identifier < ns->dense[nsIndex].size)
+        return UA_STATUSCODE_GOOD;
+
+    /* Compute the new size */
+    UA_UInt32 count = added;
+    if(nsIndex < ns->denseSize)
+        count += ns->dense[nsIndex].count;
+    if(identifier >= UA_UINT32_MAX / 2)
+        return UA_STATUSCODE_GOOD;
+    UA_UInt32 nsize = 64;
+    while(nsize <= identifier)
+        nsize *= 2;
+    if(nsize > UA_NODESTORE_DENSEMINSIZE &&
+       nsize / UA_NODESTORE_DENSEFILL > count)
+        return UA_STATUSCODE_GOOD;
+
+    /* Add the namespace */
+    if(nsIndex >= ns->denseSize) {
+        UA_NodeStoreDense *ndense =
+            UA_realloc(ns->dense, sizeof(UA_NodeStoreDense) * (size_t)(nsIndex + 1));
+        if(!ndense)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        memset(&ndense[ns->denseSize], 0,
+               sizeof(UA_NodeStoreDense) * (size_t)(nsIndex + 1 - ns->denseSize));
+        ns->dense = ndense;
+        ns->denseSize = (UA_UInt16)(nsIndex + 1);
+    }
+
+    /* Grow the array */
+    UA_NodeStoreDense *dense = &ns->dense[nsIndex];
+    UA_NodeStoreEntry **nentries =
+        UA_realloc(dense->entries, sizeof(UA_NodeStoreEntry*) * nsize);
+    if(!nentries)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    memset(&nentries[dense->size], 0, sizeof(UA_NodeStoreEntry*) * (nsize - dense->size));
+    UA_UInt32 osize = dense->size;
+    dense->entries = nentries;
+    dense->size = nsize;
+
+    /* Move the covered nodes out of the hash-map */
+    for(UA_UInt32 i = 0; i < ns->size; ++i) {
+        UA_NodeStoreEntry *e = ns->entries[i].entry;
+        if(e <= UA_NODESTORE_TOMBSTONE)
+            continue;
+        const UA_NodeId *id = &e->node.nodeId;
+        if(id->identifierType != UA_NODEIDTYPE_NUMERIC || id->namespaceIndex != nsIndex ||
+           id->identifier.numeric < osize || id->identifier.numeric >= nsize)
+            continue;
+        dense->entries[id->identifier.numeric] = e;
+        ++dense->count;
+        ns->entries[i].entry = UA_NODESTORE_TOMBSTONE;
+        --ns->count;
+        ++ns->tombstones;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
 /**********************/
 /* Exported functions */
 /**********************/
 
-UA_NodeStore *
-UA_NodeStore_new(void) {
-    UA_NodeStore *ns = UA_malloc(sizeof(UA_NodeStore));
+static void *
+DefaultNodeStore_new(void) {
+    UA_DefaultNodeStore *ns = UA_malloc(sizeof(UA_DefaultNodeStore));
     if(!ns)
         return NULL;
     ns->sizePrimeIndex = higher_prime_index(UA_NODESTORE_MINSIZE);
     ns->size = primes[ns->sizePrimeIndex];
     ns->count = 0;
-    ns->entries = UA_calloc(ns->size, sizeof(UA_NodeStoreEntry*));
-    if(!ns->entries) {
+    ns->tombstones = 0;
+    ns->entries = UA_calloc(ns->size, sizeof(UA_NodeStoreSlot));
+    ns->strings = UA_StringTable_new();
+    if(!ns->entries || !ns->strings) {
+        if(ns->strings)
+            UA_StringTable_delete(ns->strings);
+        UA_free(ns->entries);
         UA_free(ns);
         return NULL;
     }
+    ns->dense = NULL;
+    ns->denseSize = 0;
+    UA_NodeStoreImages_init(&ns->images);
+    for(UA_Byte i = 0; i < UA_NODESTORE_POOLS; ++i) {
+        UA_NodeStorePool *pool = &ns->pools[i];
+        pool->entrySize = entrySize((UA_NodeClass)(1 << i));
+        pool->slabs = NULL;
+        pool->slabUsed = 0;
+        pool->freeList = NULL;
+    }
     return ns;
 }
 
-void
-UA_NodeStore_delete(UA_NodeStore *ns) {
+static void
+DefaultNodeStore_delete(void *handle) {
+    UA_DefaultNodeStore *ns = (UA_DefaultNodeStore*)handle;
     UA_UInt32 size = ns->size;
-    UA_NodeStoreEntry **entries = ns->entries;
+    UA_NodeStoreSlot *entries = ns->entries;
     for(UA_UInt32 i = 0; i < size; ++i) {
-        if(entries[i] > UA_NODESTORE_TOMBSTONE)
-            deleteEntry(entries[i]);
+        if(entries[i].entry <= UA_NODESTORE_TOMBSTONE)
+            continue;
+        UA_Node_releaseNames(ns->strings, &entries[i].entry->node);
+        UA_Node_deleteMembersAnyNodeClass(&entries[i].entry->node);
     }
+    for(UA_UInt16 i = 0; i < ns->denseSize; ++i) {
+        UA_NodeStoreDense *dense = &ns->dense[i];
+        for(UA_UInt32 j = 0; j < dense->size; ++j) {
+            if(!dense->entries[j])
+                continue;
+            UA_Node_releaseNames(ns->strings, &dense->entries[j]->node);
+            UA_Node_deleteMembersAnyNodeClass(&dense->entries[j]->node);
+        }
+        UA_free(dense->entries);
+    }
+    UA_free(ns->dense);
+    for(UA_Byte i = 0; i < UA_NODESTORE_POOLS; ++i) {
+        UA_NodeStoreSlab *slab = ns->pools[i].slabs;
+        while(slab) {
+            UA_NodeStoreSlab *next = slab->next;
+            UA_free(slab);
+            slab = next;
+        }
+    }
+    UA_StringTable_delete(ns->strings);
+    UA_NodeStoreImages_deleteMembers(&ns->images);
     UA_free(ns->entries);
     UA_free(ns);
 }
 
-UA_Node *
-UA_NodeStore_newNode(UA_NodeClass nodeClass) {
-    UA_NodeStoreEntry *entry = instantiateEntry(nodeClass);
+static UA_Node *
+DefaultNodeStore_newNode(void *handle, UA_NodeClass nodeClass) {
+    UA_DefaultNodeStore *ns = (UA_DefaultNodeStore*)handle;
+    UA_NodeStoreEntry *entry = instantiateEntry(ns, nodeClass);
     if(!entry)
         return NULL;
     return &entry->node;
 }
 
-void
-UA_NodeStore_deleteNode(UA_Node *node) {
+static void
+DefaultNodeStore_deleteNode(void *handle, UA_Node *node) {
+    UA_DefaultNodeStore *ns = (UA_DefaultNodeStore*)handle;
     UA_NodeStoreEntry *entry = container_of(node, UA_NodeStoreEntry, node);
     UA_assert(&entry->node == node);
-    deleteEntry(entry);
+    deleteEntry(ns, entry);
 }
 
-UA_StatusCode
-UA_NodeStore_insert(UA_NodeStore *ns, UA_Node *node) {
-    if(ns->size * 3 <= ns->count * 4) {
+static UA_StatusCode
+insertEntry(UA_DefaultNodeStore *ns, UA_Node *node) {
+    if(ns->size * 3 <= (ns->count + ns->tombstones) * 4) {
         if(expand(ns) != UA_STATUSCODE_GOOD)
             return UA_STATUSCODE_BADINTERNALERROR;
     }
@@ -235,98 +487,266 @@ UA_NodeStore_insert(UA_NodeStore *ns, UA_Node *node) {
     UA_NodeId tempNodeid;
     tempNodeid = node->nodeId;
     tempNodeid.namespaceIndex = 0;
-    UA_NodeStoreEntry **entry;
     if(UA_NodeId_isNull(&tempNodeid)) {
-        /* create a random nodeid */
+        /* create a fresh nodeid. the identifiers are taken sequentially, so
+         * that they can be stored in the dense array. */
+        node->nodeId.identifierType = UA_NODEIDTYPE_NUMERIC;
         if(node->nodeId.namespaceIndex == 0)
             node->nodeId.namespaceIndex = 1;
         UA_UInt32 identifier = ns->count+1; // start value
-        UA_UInt32 size = ns->size;
-        UA_UInt32 increase = mod2(identifier, size);
+        if(node->nodeId.namespaceIndex < ns->denseSize)
+            identifier += ns->dense[node->nodeId.namespaceIndex].count;
         while(true) {
             node->nodeId.identifier.numeric = identifier;
-            entry = findSlot(ns, &node->nodeId);
-            if(entry)
+            if(!findNode(ns, &node->nodeId) && !findImageNode(ns, &node->nodeId))
                 break;
-            identifier += increase;
-            if(identifier >= size)
-                identifier -= size;
+            ++identifier;
+        }
+    }
+
+    /* Try the dense array for numeric NodeIds */
+    UA_NodeStoreEntry **entry = NULL;
+    if(node->nodeId.identifierType == UA_NODEIDTYPE_NUMERIC) {
+        growDense(ns, node->nodeId.namespaceIndex,
+                  node->nodeId.identifier.numeric, 1); // the hash-map is the fallback
+        entry = findDenseSlot(ns, &node->nodeId);
+    }
+    if(entry) {
+        if(*entry) {
+            DefaultNodeStore_deleteNode(ns, node);
+            return UA_STATUSCODE_BADNODEIDEXISTS;
         }
+        ++ns->dense[node->nodeId.namespaceIndex].count;
     } else {
-        entry = findSlot(ns, &node->nodeId);
-        if(!entry) {
-            UA_NodeStore_deleteNode(node);
+        UA_UInt32 h = UA_NodeId_hash(&node->nodeId);
+        UA_NodeStoreSlot *slot = findSlot(ns, &node->nodeId, h);
+        if(!slot) {
+            DefaultNodeStore_deleteNode(ns, node);
             return UA_STATUSCODE_BADNODEIDEXISTS;
         }
+        if(slot->entry == UA_NODESTORE_TOMBSTONE)
+            --ns->tombstones;
+        slot->hash = h;
+        entry = &slot->entry;
+        ++ns->count;
     }
 
     *entry = container_of(node, UA_NodeStoreEntry, node);
-    ++ns->count;
     UA_assert(&(*entry)->node == node);
+    UA_Node_internNames(ns->strings, node);
     return UA_STATUSCODE_GOOD;
 }
 
-UA_StatusCode
-UA_NodeStore_replace(UA_NodeStore *ns, UA_Node *node) {
-    UA_NodeStoreEntry **entry = findNode(ns, &node->nodeId);
-    if(!entry)
-        return UA_STATUSCODE_BADNODEIDUNKNOWN;
+static UA_StatusCode
+DefaultNodeStore_insert(void *handle, UA_Node *node) {
+    UA_DefaultNodeStore *ns = (UA_DefaultNodeStore*)handle;
+    if(findImageNode(ns, &node->nodeId)) {
+        DefaultNodeStore_deleteNode(ns, node);
+        return UA_STATUSCODE_BADNODEIDEXISTS;
+    }
+    return insertEntry(ns, node);
+}
+
+/* Grows the dense arrays to the largest numeric identifier of each namespace
+ * (if they stay dense enough) and the hash-map for the remaining nodes */
+static UA_StatusCode
+DefaultNodeStore_reserve(void *handle, size_t nodesSize, UA_Node * const *nodes) {
+    UA_DefaultNodeStore *ns = (UA_DefaultNodeStore*)handle;
+    size_t nsSize = 0;
+    for(size_t i = 0; i < nodesSize; ++i) {
+        const UA_NodeId *id = &nodes[i]->nodeId;
+        if(id->identifierType == UA_NODEIDTYPE_NUMERIC && id->namespaceIndex >= nsSize)
+            nsSize = (size_t)id->namespaceIndex + 1;
+    }
+
+    /* Count the numeric identifiers per namespace */
+    if(nsSize > 0) {
+        UA_UInt32 *counts = UA_calloc(nsSize * 2, sizeof(UA_UInt32));
+        if(!counts)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        UA_UInt32 *maxima = &counts[nsSize];
+        for(size_t i = 0; i < nodesSize; ++i) {
+            const UA_NodeId *id = &nodes[i]->nodeId;
+            if(id->identifierType != UA_NODEIDTYPE_NUMERIC)
+                continue;
+            ++counts[id->namespaceIndex];
+            if(id->identifier.numeric > maxima[id->namespaceIndex])
+                maxima[id->namespaceIndex] = id->identifier.numeric;
+        }
+        UA_StatusCode retval = UA_STATUSCODE_GOOD;
+        for(size_t i = 0; i < nsSize && retval == UA_STATUSCODE_GOOD; ++i) {
+            if(counts[i] > 0)
+                retval = growDense(ns, (UA_UInt16)i, maxima[i], counts[i]);
+        }
+        UA_free(counts);
+        if(retval != UA_STATUSCODE_GOOD)
+            return retval;
+    }
+
+    /* Size the hash-map for the nodes that don't fit into a dense array */
+    UA_UInt32 hashed = 0;
+    for(size_t i = 0; i < nodesSize; ++i) {
+        if(!findDenseSlot(ns, &nodes[i]->nodeId))
+            ++hashed;
+    }
+    if(hashed == 0 || (UA_UInt64)ns->count + hashed >= UA_UINT32_MAX / 4)
+        return UA_STATUSCODE_GOOD;
+    UA_UInt32 count = ns->count + hashed;
+    if(ns->size * 3 > (count + ns->tombstones) * 4)
+        return UA_STATUSCODE_GOOD;
+    return resize(ns, count);
+}
+
+static UA_StatusCode
+DefaultNodeStore_replace(void *handle, UA_Node *node) {
+    UA_DefaultNodeStore *ns = (UA_DefaultNodeStore*)handle;
     UA_NodeStoreEntry *newEntry = container_of(node, UA_NodeStoreEntry, node);
+    UA_NodeStoreEntry **entry = findNode(ns, &node->nodeId);
+    if(!entry) {
+        /* Copy on write of an image node */
+        if(newEntry->orig || !findImageNode(ns, &node->nodeId)) {
+            deleteEntry(ns, newEntry);
+            return UA_STATUSCODE_BADNODEIDUNKNOWN;
+        }
+        return insertEntry(ns, node);
+    }
     if(*entry != newEntry->orig) {
         // the node was replaced since the copy was made
-        deleteEntry(newEntry);
+        deleteEntry(ns, newEntry);
         return UA_STATUSCODE_BADINTERNALERROR;
     }
-    deleteEntry(*entry);
+    UA_Node_internNames(ns->strings, node);
+    deleteEntry(ns, *entry);
     *entry = newEntry;
     return UA_STATUSCODE_GOOD;
 }
 
-const UA_Node *
-UA_NodeStore_get(UA_NodeStore *ns, const UA_NodeId *nodeid) {
+static const UA_Node *
+DefaultNodeStore_get(void *handle, const UA_NodeId *nodeid) {
+    UA_DefaultNodeStore *ns = (UA_DefaultNodeStore*)handle;
     UA_NodeStoreEntry **entry = findNode(ns, nodeid);
     if(!entry)
-        return NULL;
+        return findImageNode(ns, nodeid);
     return (const UA_Node*)&(*entry)->node;
 }
 
-UA_Node *
-UA_NodeStore_getCopy(UA_NodeStore *ns, const UA_NodeId *nodeid) {
+static UA_Node *
+DefaultNodeStore_getCopy(void *handle, const UA_NodeId *nodeid) {
+    UA_DefaultNodeStore *ns = (UA_DefaultNodeStore*)handle;
     UA_NodeStoreEntry **slot = findNode(ns, nodeid);
-    if(!slot)
-        return NULL;
-    UA_NodeStoreEntry *entry = *slot;
-    UA_NodeStoreEntry *new = instantiateEntry(entry->node.nodeClass);
+    UA_NodeStoreEntry *entry = NULL;
+    const UA_Node *node;
+    if(slot) {
+        entry = *slot;
+        node = &entry->node;
+    } else {
+        node = findImageNode(ns, nodeid);
+        if(!node)
+            return NULL;
+    }
+    UA_NodeStoreEntry *new = instantiateEntry(ns, node->nodeClass);
     if(!new)
         return NULL;
-    if(UA_Node_copyAnyNodeClass(&entry->node, &new->node) != UA_STATUSCODE_GOOD) {
-        deleteEntry(new);
+    if(UA_Node_copyAnyNodeClass(node, &new->node) != UA_STATUSCODE_GOOD) {
+        deleteEntry(ns, new);
         return NULL;
     }
     new->orig = entry; // store the pointer to the original
     return &new->node;
 }
 
-UA_StatusCode
-UA_NodeStore_remove(UA_NodeStore *ns, const UA_NodeId *nodeid) {
-    UA_NodeStoreEntry **slot = findNode(ns, nodeid);
+static UA_StatusCode
+removeEntry(UA_DefaultNodeStore *ns, const UA_NodeId *nodeid) {
+    UA_NodeStoreEntry **slot = findDenseSlot(ns, nodeid);
+    if(slot) {
+        if(!*slot)
+            return UA_STATUSCODE_BADNODEIDUNKNOWN;
+        deleteEntry(ns, *slot);
+        *slot = NULL;
+        --ns->dense[nodeid->namespaceIndex].count;
+        return UA_STATUSCODE_GOOD;
+    }
+
+    slot = findNode(ns, nodeid);
     if(!slot)
         return UA_STATUSCODE_BADNODEIDUNKNOWN;
-    deleteEntry(*slot);
+    deleteEntry(ns, *slot);
     *slot = UA_NODESTORE_TOMBSTONE;
     --ns->count;
+    ++ns->tombstones;
     /* Downsize the hashmap if it is very empty */
     if(ns->count * 8 < ns->size && ns->size > 32)
         expand(ns); // this can fail. we just continue with the bigger hashmap.
     return UA_STATUSCODE_GOOD;
 }
 
-void
-UA_NodeStore_iterate(UA_NodeStore *ns, UA_NodeStore_nodeVisitor visitor) {
+static UA_StatusCode
+DefaultNodeStore_remove(void *handle, const UA_NodeId *nodeid) {
+    UA_DefaultNodeStore *ns = (UA_DefaultNodeStore*)handle;
+    UA_StatusCode retval = removeEntry(ns, nodeid);
+    if(UA_NodeStoreImages_remove(&ns->images, nodeid))
+        retval = UA_STATUSCODE_GOOD;
+    return retval;
+}
+
+static void
+DefaultNodeStore_iterate(void *handle, void *visitorContext,
+                         UA_NodeStore_nodeVisitor visitor) {
+    UA_DefaultNodeStore *ns = (UA_DefaultNodeStore*)handle;
+    for(UA_UInt16 i = 0; i < ns->denseSize; ++i) {
+        UA_NodeStoreDense *dense = &ns->dense[i];
+        for(UA_UInt32 j = 0; j < dense->size; ++j) {
+            if(dense->entries[j])
+                visitor(visitorContext, (UA_Node*)&dense->entries[j]->node);
+        }
+    }
     for(UA_UInt32 i = 0; i < ns->size; ++i) {
-        if(ns->entries[i] > UA_NODESTORE_TOMBSTONE)
-            visitor((UA_Node*)&ns->entries[i]->node);
+        if(ns->entries[i].entry > UA_NODESTORE_TOMBSTONE)
+            visitor(visitorContext, (UA_Node*)&ns->entries[i].entry->node);
     }
+    for(size_t i = 0; i < ns->images.imagesSize; ++i) {
+        const UA_NodeStoreImage *image = ns->images.images[i];
+        for(size_t j = 0; j < image->nodesSize; ++j) {
+            const UA_Node *node = image->nodes[j];
+            if(findImageNode(ns, &node->nodeId) == node && !findNode(ns, &node->nodeId))
+                visitor(visitorContext, node);
+        }
+    }
+}
+
+static UA_StatusCode
+DefaultNodeStore_linkImage(void *handle, const UA_NodeStoreImage *image) {
+    UA_DefaultNodeStore *ns = (UA_DefaultNodeStore*)handle;
+    return UA_NodeStoreImages_link(&ns->images, image);
+}
+
+static UA_Boolean
+DefaultNodeStore_isImmutable(void *handle, const UA_Node *node) {
+    UA_DefaultNodeStore *ns = (UA_DefaultNodeStore*)handle;
+    return UA_NodeStoreImages_contains(&ns->images, node);
+}
+
+static void
+DefaultNodeStore_releaseString(void *handle, UA_String *s) {
+    UA_DefaultNodeStore *ns = (UA_DefaultNodeStore*)handle;
+    UA_StringTable_release(ns->strings, s);
 }
 
+const UA_NodeStoreInterface UA_NodeStoreInterface_default = {
+    .newNodeStore = DefaultNodeStore_new,
+    .deleteNodeStore = DefaultNodeStore_delete,
+    .newNode = DefaultNodeStore_newNode,
+    .deleteNode = DefaultNodeStore_deleteNode,
+    .insert = DefaultNodeStore_insert,
+    .get = DefaultNodeStore_get,
+    .getCopy = DefaultNodeStore_getCopy,
+    .replace = DefaultNodeStore_replace,
+    .remove = DefaultNodeStore_remove,
+    .iterate = DefaultNodeStore_iterate,
+    .linkImage = DefaultNodeStore_linkImage,
+    .isImmutable = DefaultNodeStore_isImmutable,
+    .releaseString = DefaultNodeStore_releaseString,
+    .reserve = DefaultNodeStore_reserve
+};
+
 #endif /* UA_ENABLE_MULTITHREADING */
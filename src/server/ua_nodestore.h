@@ -15,17 +15,24 @@ extern "C" {
 /**
  * Nodestore
  * ---------
- * Stores nodes that can be indexed by their NodeId. Internally, it is based on
- * a hash-map implementation. */
-struct UA_NodeStore;
-typedef struct UA_NodeStore UA_NodeStore;
+ * Stores nodes that can be indexed by their NodeId. The server accesses the
+ * nodestore through the functions of a :ref:`UA_NodeStoreInterface
+ * <nodestore>` from the configuration. The default nodestore is based on a
+ * hash-map implementation. */
+typedef struct UA_NodeStore {
+    UA_NodeStoreInterface interface;
+    void *handle;
+} UA_NodeStore;
 
 /**
  * Nodestore Lifecycle
  * ^^^^^^^^^^^^^^^^^^^ */
-/* Create a new nodestore */
+/* Create a new default nodestore */
 UA_NodeStore * UA_NodeStore_new(void);
 
+/* Create a nodestore with the given implementation */
+UA_NodeStore * UA_NodeStore_newWithInterface(const UA_NodeStoreInterface *interface);
+
 /* Delete the nodestore and all nodes in it. Do not call from a read-side
    critical section (multithreading). */
 void UA_NodeStore_delete(UA_NodeStore *ns);
@@ -37,28 +44,36 @@ void UA_NodeStore_delete(UA_NodeStore *ns);
  * The following definitions are used to create empty nodes of the different
  * node types. The memory is managed by the nodestore. Therefore, the node has
  * to be removed via a special deleteNode function. (If the new node is not
- * added to the nodestore.) */
+ * added to the nodestore.) The node can only be inserted into (or deleted
+ * from) the nodestore it was created with. */
 /* Create an editable node of the given NodeClass. */
-UA_Node * UA_NodeStore_newNode(UA_NodeClass nodeClass);
-#define UA_NodeStore_newObjectNode() \
-    (UA_ObjectNode*)UA_NodeStore_newNode(UA_NODECLASS_OBJECT)
-#define UA_NodeStore_newVariableNode() \
-    (UA_VariableNode*)UA_NodeStore_newNode(UA_NODECLASS_VARIABLE)
-#define UA_NodeStore_newMethodNode() \
-    (UA_MethodNode*)UA_NodeStore_newNode(UA_NODECLASS_METHOD)
-#define UA_NodeStore_newObjectTypeNode() \
-    (UA_ObjectTypeNode*)UA_NodeStore_newNode(UA_NODECLASS_OBJECTTYPE)
-#define UA_NodeStore_newVariableTypeNode() \
-    (UA_VariableTypeNode*)UA_NodeStore_newNode(UA_NODECLASS_VARIABLETYPE)
-#define UA_NodeStore_newReferenceTypeNode() \
-    (UA_ReferenceTypeNode*)UA_NodeStore_newNode(UA_NODECLASS_REFERENCETYPE)
-#define UA_NodeStore_newDataTypeNode() \
-    (UA_DataTypeNode*)UA_NodeStore_newNode(UA_NODECLASS_DATATYPE)
-#define UA_NodeStore_newViewNode() \
-    (UA_ViewNode*)UA_NodeStore_newNode(UA_NODECLASS_VIEW)
+static UA_INLINE UA_Node *
+UA_NodeStore_newNode(UA_NodeStore *ns, UA_NodeClass nodeClass) {
+    return ns->interface.newNode(ns->handle, nodeClass);
+}
+
+#define UA_NodeStore_newObjectNode(ns) \
+    (UA_ObjectNode*)UA_NodeStore_newNode(ns, UA_NODECLASS_OBJECT)
+#define UA_NodeStore_newVariableNode(ns) \
+    (UA_VariableNode*)UA_NodeStore_newNode(ns, UA_NODECLASS_VARIABLE)
+#define UA_NodeStore_newMethodNode(ns) \
+    (UA_MethodNode*)UA_NodeStore_newNode(ns, UA_NODECLASS_METHOD)
+#define UA_NodeStore_newObjectTypeNode(ns) \
+    (UA_ObjectTypeNode*)UA_NodeStore_newNode(ns, UA_NODECLASS_OBJECTTYPE)
+#define UA_NodeStore_newVariableTypeNode(ns) \
+    (UA_VariableTypeNode*)UA_NodeStore_newNode(ns, UA_NODECLASS_VARIABLETYPE)
+#define UA_NodeStore_newReferenceTypeNode(ns) \
+    (UA_ReferenceTypeNode*)UA_NodeStore_newNode(ns, UA_NODECLASS_REFERENCETYPE)
+#define UA_NodeStore_newDataTypeNode(ns) \
+    (UA_DataTypeNode*)UA_NodeStore_newNode(ns, UA_NODECLASS_DATATYPE)
+#define UA_NodeStore_newViewNode(ns) \
+    (UA_ViewNode*)UA_NodeStore_newNode(ns, UA_NODECLASS_VIEW)
 
 /* Delete an editable node. */
-void UA_NodeStore_deleteNode(UA_Node *node);
+static UA_INLINE void
+UA_NodeStore_deleteNode(UA_NodeStore *ns, UA_Node *node) {
+    ns->interface.deleteNode(ns->handle, node);
+}
 
 /**
  * Insert / Get / Replace / Remove
@@ -66,32 +81,150 @@ void UA_NodeStore_deleteNode(UA_Node *node);
 /* Inserts a new node into the nodestore. If the nodeid is zero, then a fresh
  * numeric nodeid from namespace 1 is assigned. If insertion fails, the node is
  * deleted. */
-UA_StatusCode UA_NodeStore_insert(UA_NodeStore *ns, UA_Node *node);
+static UA_INLINE UA_StatusCode
+UA_NodeStore_insert(UA_NodeStore *ns, UA_Node *node) {
+    return ns->interface.insert(ns->handle, node);
+}
+
+/* Prepares the nodestore for the insertion of the given (editable) nodes. The
+ * nodes are not inserted. This is only a hint to grow the tables once instead
+ * of step by step. */
+static UA_INLINE UA_StatusCode
+UA_NodeStore_reserve(UA_NodeStore *ns, size_t nodesSize, UA_Node * const *nodes) {
+    if(!ns->interface.reserve)
+        return UA_STATUSCODE_GOOD;
+    return ns->interface.reserve(ns->handle, nodesSize, nodes);
+}
 
 /* The returned node is immutable. */
-const UA_Node * UA_NodeStore_get(UA_NodeStore *ns, const UA_NodeId *nodeid);
+static UA_INLINE const UA_Node *
+UA_NodeStore_get(UA_NodeStore *ns, const UA_NodeId *nodeid) {
+    return ns->interface.get(ns->handle, nodeid);
+}
 
 /* Returns an editable copy of a node (needs to be deleted with the deleteNode
    function or inserted / replaced into the nodestore). */
-UA_Node * UA_NodeStore_getCopy(UA_NodeStore *ns, const UA_NodeId *nodeid);
+static UA_INLINE UA_Node *
+UA_NodeStore_getCopy(UA_NodeStore *ns, const UA_NodeId *nodeid) {
+    return ns->interface.getCopy(ns->handle, nodeid);
+}
 
 /* To replace a node, get an editable copy of the node, edit and replace with
  * this function. If the node was already replaced since the copy was made,
  * UA_STATUSCODE_BADINTERNALERROR is returned. If the nodeid is not found,
  * UA_STATUSCODE_BADNODEIDUNKNOWN is returned. In both error cases, the editable
  * node is deleted. */
-UA_StatusCode UA_NodeStore_replace(UA_NodeStore *ns, UA_Node *node);
+static UA_INLINE UA_StatusCode
+UA_NodeStore_replace(UA_NodeStore *ns, UA_Node *node) {
+    return ns->interface.replace(ns->handle, node);
+}
 
 /* Remove a node in the nodestore. */
-UA_StatusCode UA_NodeStore_remove(UA_NodeStore *ns, const UA_NodeId *nodeid);
+static UA_INLINE UA_StatusCode
+UA_NodeStore_remove(UA_NodeStore *ns, const UA_NodeId *nodeid) {
+    return ns->interface.remove(ns->handle, nodeid);
+}
 
 /**
  * Iteration
  * ^^^^^^^^^
  * The following definitions are used to call a callback for every node in the
  * nodestore. */
-typedef void (*UA_NodeStore_nodeVisitor)(const UA_Node *node);
-void UA_NodeStore_iterate(UA_NodeStore *ns, UA_NodeStore_nodeVisitor visitor);
+static UA_INLINE void
+UA_NodeStore_iterate(UA_NodeStore *ns, void *visitorContext,
+                     UA_NodeStore_nodeVisitor visitor) {
+    ns->interface.iterate(ns->handle, visitorContext, visitor);
+}
+
+/**
+ * Read-only Image
+ * ^^^^^^^^^^^^^^^
+ * An image is a set of nodes in read-only memory. The nodes of a linked image
+ * are found in the nodestore without being copied. They are copied into the
+ * nodestore when they are replaced (copy on write). The image of namespace 0 is
+ * compiled into the binary. It is generated during the build from
+ * ``tools/generate_namespace0_image.py``. Snapshots of the entire nodestore are
+ * loaded as images as well. */
+typedef struct UA_NodeStoreImage {
+    size_t nodesSize;
+    const UA_Node * const *nodes; /* Ordered by the NodeId */
+    /* The nodes of earlier images that are not in a complete image are
+     * hidden when it is linked */
+    UA_Boolean complete;
+} UA_NodeStoreImage;
+
+extern const UA_NodeStoreImage UA_NodeStoreImage_ns0;
+
+/* The order of the nodes in an image. First by the namespace index, then by
+ * the identifier type and the identifier. */
+int UA_NodeStoreImage_order(const UA_NodeId *n1, const UA_NodeId *n2);
+
+/* Returns the node with the given NodeId and its position in the image (or
+ * NULL) */
+const UA_Node *
+UA_NodeStoreImage_find(const UA_NodeStoreImage *image, const UA_NodeId *nodeid,
+                       size_t *index);
+
+/* Link the image into the nodestore. Nodes in later images take precedence
+ * over nodes with the same NodeId in earlier images. Nodes that are inserted
+ * into the nodestore take precedence over all images. The image must outlive
+ * the nodestore. If the nodestore cannot link images, the nodes are copied
+ * into the nodestore (existing nodes are kept). */
+UA_StatusCode UA_NodeStore_linkImage(UA_NodeStore *ns, const UA_NodeStoreImage *image);
+
+/* Nodes from the image cannot be edited in place */
+static UA_INLINE UA_Boolean
+UA_NodeStore_isImmutable(UA_NodeStore *ns, const UA_Node *node) {
+    if(!ns->interface.isImmutable)
+        return false;
+    return ns->interface.isImmutable(ns->handle, node);
+}
+
+/**
+ * Snapshots
+ * ^^^^^^^^^
+ * A snapshot stores all nodes of a nodestore in a binary file. The file is
+ * mapped into memory when it is loaded. The pointers in the nodes are stored
+ * as offsets in the file and relocated when the snapshot is loaded. No nodes
+ * are copied. The loaded snapshot is then linked into a nodestore as a
+ * complete image. So the nodestore contains the same nodes as when the
+ * snapshot was taken (plus the nodes that were inserted into the nodestore
+ * before).
+ *
+ * The file can only be loaded by a build with the same memory layout of the
+ * nodes. Callbacks and handles (DataSources, value callbacks, methods, the
+ * lifecycle management of ObjectTypes and the instanceHandle of Objects) are
+ * not stored in the snapshot. They have to be set again after loading.
+ * Variables with a DataSource contain an empty value. Values with types that
+ * are not in ``UA_TYPES`` cannot be stored. */
+UA_StatusCode UA_NodeStore_saveSnapshot(UA_NodeStore *ns, const char *path);
+
+struct UA_NodeStoreSnapshot;
+typedef struct UA_NodeStoreSnapshot UA_NodeStoreSnapshot;
+
+UA_StatusCode UA_NodeStoreSnapshot_load(const char *path, UA_NodeStoreSnapshot **snapshot);
+
+/* The image with the nodes of the snapshot */
+const UA_NodeStoreImage * UA_NodeStoreSnapshot_getImage(const UA_NodeStoreSnapshot *snapshot);
+
+/* Delete only after the nodestores the snapshot is linked into */
+void UA_NodeStoreSnapshot_delete(UA_NodeStoreSnapshot *snapshot);
+
+/**
+ * Interned Names
+ * ^^^^^^^^^^^^^^
+ * The strings in the BrowseName, DisplayName and Description of stored nodes
+ * are shared between nodes with the same text. They must not be changed in
+ * place. Before a name of a node is overwritten, the string is released with
+ * the following function. It also frees strings that are not shared. */
+static UA_INLINE void
+UA_NodeStore_releaseString(UA_NodeStore *ns, UA_String *s) {
+    if(!ns->interface.releaseString) {
+        UA_String_deleteMembers(s);
+        return;
+    }
+    ns->interface.releaseString(ns->handle, s);
+}
 
 #ifdef __cplusplus
 } // extern "C"
@@ -9,14 +9,26 @@
 #ifdef UA_ENABLE_MULTITHREADING /* conditional compilation */
 #include <urcu/rculfhash.h>
 
+typedef struct {
+    struct cds_lfht *ht;
+
+    /* Read-only nodes. They are hidden when a node with the same NodeId is in
+     * the hashtable or when they were removed. */
+    UA_NodeStoreImages images;
+
+    /* The names of the stored nodes are interned */
+    UA_StringTable *strings;
+} UA_DefaultNodeStore;
+
 struct nodeEntry {
     struct cds_lfht_node htn; ///< Contains the next-ptr for urcu-hashmap
     struct rcu_head rcu_head; ///< For call-rcu
     struct nodeEntry *orig; //< the version this is a copy from (or NULL)
+    UA_StringTable *strings; ///< For releasing the names in the rcu callback
     UA_Node node; ///< Might be cast from any _bigger_ UA_Node* type. Allocate enough memory!
 };
 
-static struct nodeEntry * instantiateEntry(UA_NodeClass class) {
+static struct nodeEntry * instantiateEntry(UA_DefaultNodeStore *ns, UA_NodeClass class) {
     size_t size = sizeof(struct nodeEntry) - sizeof(UA_Node);
     switch(class) {
     case UA_NODECLASS_OBJECT:
@@ -50,15 +62,35 @@ static struct nodeEntry * instantiateEntry(UA_NodeClass class) {
     if(!entry)
         return NULL;
     entry->node.nodeClass = class;
+    entry->strings = ns->strings;
     return entry;
 }
 
+/* The value cell is shared by all versions of a node. It is not deleted
+ * together with replaced versions. */
 static void deleteEntry(struct rcu_head *head) {
     struct nodeEntry *entry = container_of(head, struct nodeEntry, rcu_head);
+    UA_Node_releaseNames(entry->strings, &entry->node);
     UA_Node_deleteMembersAnyNodeClass(&entry->node);
     UA_free(entry);
 }
 
+static UA_ValueCell * getValueCell(UA_Node *node) {
+    if(node->nodeClass != UA_NODECLASS_VARIABLE &&
+       node->nodeClass != UA_NODECLASS_VARIABLETYPE)
+        return NULL;
+    return ((UA_VariableNode*)node)->valueCell;
+}
+
+/* Delete the entry of a node that is removed from the nodestore */
+static void deleteEntryAndValueCell(struct rcu_head *head) {
+    struct nodeEntry *entry = container_of(head, struct nodeEntry, rcu_head);
+    UA_ValueCell *cell = getValueCell(&entry->node);
+    if(cell)
+        UA_ValueCell_delete(cell);
+    deleteEntry(head);
+}
+
 /* We are in a rcu_read lock. So the node will not be freed under our feet. */
 static int compare(struct cds_lfht_node *htn, const void *orig) {
     const UA_NodeId *origid = (const UA_NodeId *)orig;
@@ -67,48 +99,88 @@ static int compare(struct cds_lfht_node *htn, const void *orig) {
     return UA_NodeId_equal(newid, origid);
 }
 
-UA_NodeStore * UA_NodeStore_new() {
+/* Returns the image node if it was not removed. A node with the same NodeId
+ * in the hashtable takes precedence and needs to be checked before. */
+static const UA_Node * findImageNode(UA_DefaultNodeStore *ns, const UA_NodeId *nodeid) {
+    return UA_NodeStoreImages_find(&ns->images, nodeid);
+}
+
+static void * DefaultNodeStore_new(void) {
+    UA_DefaultNodeStore *ns = UA_malloc(sizeof(UA_DefaultNodeStore));
+    if(!ns)
+        return NULL;
     /* 64 is the minimum size for the hashtable. */
-    return (UA_NodeStore*)cds_lfht_new(64, 64, 0, CDS_LFHT_AUTO_RESIZE, NULL);
+    ns->ht = cds_lfht_new(64, 64, 0, CDS_LFHT_AUTO_RESIZE, NULL);
+    if(!ns->ht) {
+        UA_free(ns);
+        return NULL;
+    }
+    ns->strings = UA_StringTable_new();
+    if(!ns->strings) {
+        cds_lfht_destroy(ns->ht, NULL);
+        UA_free(ns);
+        return NULL;
+    }
+    UA_NodeStoreImages_init(&ns->images);
+    return ns;
 }
 
 /* do not call with read-side critical section held!! */
-void UA_NodeStore_delete(UA_NodeStore *ns) {
+static void DefaultNodeStore_delete(void *handle) {
+    UA_DefaultNodeStore *ns = (UA_DefaultNodeStore*)handle;
     UA_ASSERT_RCU_LOCKED();
-    struct cds_lfht *ht = (struct cds_lfht*)ns;
+    struct cds_lfht *ht = ns->ht;
     struct cds_lfht_iter iter;
     cds_lfht_first(ht, &iter);
     while(iter.node) {
         if(!cds_lfht_del(ht, iter.node)) {
             /* points to the htn entry, which is first */
             struct nodeEntry *entry = (struct nodeEntry*) iter.node;
-            call_rcu(&entry->rcu_head, deleteEntry);
+            call_rcu(&entry->rcu_head, deleteEntryAndValueCell);
         }
         cds_lfht_next(ht, &iter);
     }
     UA_RCU_UNLOCK();
     cds_lfht_destroy(ht, NULL);
+    rcu_barrier(); /* the rcu callbacks release the names */
     UA_RCU_LOCK();
+    UA_StringTable_delete(ns->strings);
+    UA_NodeStoreImages_deleteMembers(&ns->images);
+    UA_free(ns);
 }
 
-UA_Node * UA_NodeStore_newNode(UA_NodeClass class) {
-    struct nodeEntry *entry = instantiateEntry(class);
+static UA_Node * DefaultNodeStore_newNode(void *handle, UA_NodeClass class) {
+    UA_DefaultNodeStore *ns = (UA_DefaultNodeStore*)handle;
+    struct nodeEntry *entry = instantiateEntry(ns, class);
     if(!entry)
         return NULL;
     return (UA_Node*)&entry->node;
 }
 
-void UA_NodeStore_deleteNode(UA_Node *node) {
+static void DefaultNodeStore_deleteNode(void *handle, UA_Node *node) {
     struct nodeEntry *entry = container_of(node, struct nodeEntry, node);
     deleteEntry(&entry->rcu_head);
 }
 
-UA_StatusCode UA_NodeStore_insert(UA_NodeStore *ns, UA_Node *node) {
-    UA_ASSERT_RCU_LOCKED();
-    struct nodeEntry *entry = container_of(node, struct nodeEntry, node);
-    struct cds_lfht *ht = (struct cds_lfht*)ns;
+static UA_StatusCode insertEntry(UA_DefaultNodeStore *ns, struct nodeEntry *entry) {
+    UA_Node *node = &entry->node;
+    struct cds_lfht *ht = ns->ht;
     cds_lfht_node_init(&entry->htn);
     struct cds_lfht_node *result;
+
+    /* Move the value into a cell before the node becomes visible */
+    if((node->nodeClass == UA_NODECLASS_VARIABLE ||
+        node->nodeClass == UA_NODECLASS_VARIABLETYPE) &&
+       ((UA_VariableNode*)node)->valueSource == UA_VALUESOURCE_DATA &&
+       !((UA_VariableNode*)node)->valueCell) {
+        if(UA_VariableNode_createValueCell((UA_VariableNode*)node) != UA_STATUSCODE_GOOD) {
+            deleteEntry(&entry->rcu_head);
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        }
+    }
+
+    UA_Node_internNames(ns->strings, node);
+
     //namespace index is assumed to be valid
     UA_NodeId tempNodeid;
     tempNodeid = node->nodeId;
@@ -118,7 +190,7 @@ UA_StatusCode UA_NodeStore_insert(UA_NodeStore *ns, UA_Node *node) {
         result = cds_lfht_add_unique(ht, h, compare, &node->nodeId, &entry->htn);
         /* If the nodeid exists already */
         if(result != &entry->htn) {
-            deleteEntry(&entry->rcu_head);
+            deleteEntryAndValueCell(&entry->rcu_head);
             return UA_STATUSCODE_BADNODEIDEXISTS;
         }
     } else {
@@ -144,17 +216,47 @@ UA_StatusCode UA_NodeStore_insert(UA_NodeStore *ns, UA_Node *node) {
     return UA_STATUSCODE_GOOD;
 }
 
-UA_StatusCode UA_NodeStore_replace(UA_NodeStore *ns, UA_Node *node) {
+static UA_StatusCode DefaultNodeStore_insert(void *handle, UA_Node *node) {
+    UA_DefaultNodeStore *ns = (UA_DefaultNodeStore*)handle;
     UA_ASSERT_RCU_LOCKED();
     struct nodeEntry *entry = container_of(node, struct nodeEntry, node);
-    struct cds_lfht *ht = (struct cds_lfht*)ns;
+    if(findImageNode(ns, &node->nodeId)) {
+        deleteEntry(&entry->rcu_head);
+        return UA_STATUSCODE_BADNODEIDEXISTS;
+    }
+    return insertEntry(ns, entry);
+}
+
+static UA_StatusCode DefaultNodeStore_replace(void *handle, UA_Node *node) {
+    UA_DefaultNodeStore *ns = (UA_DefaultNodeStore*)handle;
+    UA_ASSERT_RCU_LOCKED();
+    struct nodeEntry *entry = container_of(node, struct nodeEntry, node);
+    struct cds_lfht *ht = ns->ht;
 
     /* Get the current version */
     UA_UInt32 h = UA_NodeId_hash(&node->nodeId);
     struct cds_lfht_iter iter;
     cds_lfht_lookup(ht, h, compare, &node->nodeId, &iter);
-    if(!iter.node)
-        return UA_STATUSCODE_BADNODEIDUNKNOWN;
+    if(!iter.node) {
+        /* Copy on write of an image node. Fails if another thread has
+         * inserted its copy first. */
+        if(entry->orig || !findImageNode(ns, &node->nodeId)) {
+            deleteEntry(&entry->rcu_head);
+            return UA_STATUSCODE_BADNODEIDUNKNOWN;
+        }
+        if(insertEntry(ns, entry) != UA_STATUSCODE_GOOD)
+            return UA_STATUSCODE_BADINTERNALERROR;
+        /* A concurrent remove hides the image node before it removes the node
+         * from the hashtable. Take the copy back out if the image node was
+         * hidden in the meantime. Otherwise the remove sees the copy. */
+        UA_atomic_sync();
+        if(!findImageNode(ns, &node->nodeId)) {
+            if(cds_lfht_del(ht, &entry->htn) == 0)
+                call_rcu(&entry->rcu_head, deleteEntryAndValueCell);
+            return UA_STATUSCODE_BADNODEIDUNKNOWN;
+        }
+        return UA_STATUSCODE_GOOD;
+    }
 
     /* We try to replace an obsolete version of the node */
     struct nodeEntry *oldEntry = (struct nodeEntry*)iter.node;
@@ -163,6 +265,7 @@ UA_StatusCode UA_NodeStore_replace(UA_NodeStore *ns, UA_Node *node) {
         return UA_STATUSCODE_BADINTERNALERROR;
     }
     
+    UA_Node_internNames(ns->strings, node);
     cds_lfht_node_init(&entry->htn);
     if(cds_lfht_replace(ht, &iter, h, compare, &node->nodeId, &entry->htn) != 0) {
         /* Replacing failed. Maybe the node got replaced just before this thread tried to.*/
@@ -175,44 +278,59 @@ UA_StatusCode UA_NodeStore_replace(UA_NodeStore *ns, UA_Node *node) {
     return UA_STATUSCODE_GOOD;
 }
 
-UA_StatusCode UA_NodeStore_remove(UA_NodeStore *ns, const UA_NodeId *nodeid) {
+static UA_StatusCode DefaultNodeStore_remove(void *handle, const UA_NodeId *nodeid) {
+    UA_DefaultNodeStore *ns = (UA_DefaultNodeStore*)handle;
     UA_ASSERT_RCU_LOCKED();
-    struct cds_lfht *ht = (struct cds_lfht*)ns;
+    UA_StatusCode retval = UA_STATUSCODE_BADNODEIDUNKNOWN;
+
+    /* Hide the image node first. A copy-on-write replace of the image node
+     * checks the flag after it has inserted the copy. */
+    if(UA_NodeStoreImages_remove(&ns->images, nodeid))
+        retval = UA_STATUSCODE_GOOD;
+
+    struct cds_lfht *ht = ns->ht;
     UA_UInt32 h = UA_NodeId_hash(nodeid);
     struct cds_lfht_iter iter;
     cds_lfht_lookup(ht, h, compare, nodeid, &iter);
-    if(!iter.node || cds_lfht_del(ht, iter.node) != 0)
-        return UA_STATUSCODE_BADNODEIDUNKNOWN;
-    struct nodeEntry *entry = (struct nodeEntry*)iter.node;
-    call_rcu(&entry->rcu_head, deleteEntry);
-    return UA_STATUSCODE_GOOD;
+    if(iter.node && cds_lfht_del(ht, iter.node) == 0) {
+        struct nodeEntry *entry = (struct nodeEntry*)iter.node;
+        call_rcu(&entry->rcu_head, deleteEntryAndValueCell);
+        retval = UA_STATUSCODE_GOOD;
+    }
+    return retval;
 }
 
-const UA_Node * UA_NodeStore_get(UA_NodeStore *ns, const UA_NodeId *nodeid) {
+static const UA_Node * DefaultNodeStore_get(void *handle, const UA_NodeId *nodeid) {
+    UA_DefaultNodeStore *ns = (UA_DefaultNodeStore*)handle;
     UA_ASSERT_RCU_LOCKED();
-    struct cds_lfht *ht = (struct cds_lfht*)ns;
     UA_UInt32 h = UA_NodeId_hash(nodeid);
     struct cds_lfht_iter iter;
-    cds_lfht_lookup(ht, h, compare, nodeid, &iter);
+    cds_lfht_lookup(ns->ht, h, compare, nodeid, &iter);
     struct nodeEntry *found_entry = (struct nodeEntry*)iter.node;
     if(!found_entry)
-        return NULL;
+        return findImageNode(ns, nodeid);
     return &found_entry->node;
 }
 
-UA_Node * UA_NodeStore_getCopy(UA_NodeStore *ns, const UA_NodeId *nodeid) {
+static UA_Node * DefaultNodeStore_getCopy(void *handle, const UA_NodeId *nodeid) {
+    UA_DefaultNodeStore *ns = (UA_DefaultNodeStore*)handle;
     UA_ASSERT_RCU_LOCKED();
-    struct cds_lfht *ht = (struct cds_lfht*)ns;
     UA_UInt32 h = UA_NodeId_hash(nodeid);
     struct cds_lfht_iter iter;
-    cds_lfht_lookup(ht, h, compare, nodeid, &iter);
+    cds_lfht_lookup(ns->ht, h, compare, nodeid, &iter);
     struct nodeEntry *entry = (struct nodeEntry*)iter.node;
-    if(!entry)
-        return NULL;
-    struct nodeEntry *new = instantiateEntry(entry->node.nodeClass);
+    const UA_Node *node;
+    if(entry) {
+        node = &entry->node;
+    } else {
+        node = findImageNode(ns, nodeid); /* the copy has no orig */
+        if(!node)
+            return NULL;
+    }
+    struct nodeEntry *new = instantiateEntry(ns, node->nodeClass);
     if(!new)
         return NULL;
-    if(UA_Node_copyAnyNodeClass(&entry->node, &new->node) != UA_STATUSCODE_GOOD) {
+    if(UA_Node_copyAnyNodeClass(node, &new->node) != UA_STATUSCODE_GOOD) {
         deleteEntry(&new->rcu_head);
         return NULL;
     }
@@ -220,16 +338,61 @@ UA_Node * UA_NodeStore_getCopy(UA_NodeStore *ns, const UA_NodeId *nodeid) {
     return &new->node;
 }
 
-void UA_NodeStore_iterate(UA_NodeStore *ns, UA_NodeStore_nodeVisitor visitor) {
+static void DefaultNodeStore_iterate(void *handle, void *visitorContext,
+                                     UA_NodeStore_nodeVisitor visitor) {
+    UA_DefaultNodeStore *ns = (UA_DefaultNodeStore*)handle;
     UA_ASSERT_RCU_LOCKED();
-    struct cds_lfht *ht = (struct cds_lfht*)ns;
+    struct cds_lfht *ht = ns->ht;
     struct cds_lfht_iter iter;
     cds_lfht_first(ht, &iter);
     while(iter.node != NULL) {
         struct nodeEntry *found_entry = (struct nodeEntry*)iter.node;
-        visitor(&found_entry->node);
+        visitor(visitorContext, &found_entry->node);
         cds_lfht_next(ht, &iter);
     }
+    for(size_t i = 0; i < ns->images.imagesSize; ++i) {
+        const UA_NodeStoreImage *image = ns->images.images[i];
+        for(size_t j = 0; j < image->nodesSize; ++j) {
+            const UA_Node *node = image->nodes[j];
+            if(findImageNode(ns, &node->nodeId) != node)
+                continue;
+            cds_lfht_lookup(ht, UA_NodeId_hash(&node->nodeId), compare, &node->nodeId, &iter);
+            if(!iter.node)
+                visitor(visitorContext, node);
+        }
+    }
+}
+
+/* Link before the nodestore is used by several threads */
+static UA_StatusCode DefaultNodeStore_linkImage(void *handle, const UA_NodeStoreImage *image) {
+    UA_DefaultNodeStore *ns = (UA_DefaultNodeStore*)handle;
+    return UA_NodeStoreImages_link(&ns->images, image);
+}
+
+static UA_Boolean DefaultNodeStore_isImmutable(void *handle, const UA_Node *node) {
+    UA_DefaultNodeStore *ns = (UA_DefaultNodeStore*)handle;
+    return UA_NodeStoreImages_contains(&ns->images, node);
 }
 
+static void DefaultNodeStore_releaseString(void *handle, UA_String *s) {
+    UA_DefaultNodeStore *ns = (UA_DefaultNodeStore*)handle;
+    UA_StringTable_release(ns->strings, s);
+}
+
+const UA_NodeStoreInterface UA_NodeStoreInterface_default = {
+    .newNodeStore = DefaultNodeStore_new,
+    .deleteNodeStore = DefaultNodeStore_delete,
+    .newNode = DefaultNodeStore_newNode,
+    .deleteNode = DefaultNodeStore_deleteNode,
+    .insert = DefaultNodeStore_insert,
+    .get = DefaultNodeStore_get,
+    .getCopy = DefaultNodeStore_getCopy,
+    .replace = DefaultNodeStore_replace,
+    .remove = DefaultNodeStore_remove,
+    .iterate = DefaultNodeStore_iterate,
+    .linkImage = DefaultNodeStore_linkImage,
+    .isImmutable = DefaultNodeStore_isImmutable,
+    .releaseString = DefaultNodeStore_releaseString
+};
+
 #endif /* UA_ENABLE_MULTITHREADING */
@@ -0,0 +1,951 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+*  License, v. 2.0. If a copy of the MPL was not distributed with this
+*  file, You can obtain one at http://mozilla.org/MPL/2.0/.*/
+
+#include "ua_nodestore.h"
+#include "ua_server_internal.h"
+#include "ua_util.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef _WIN32
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+#endif
+
+/* A snapshot file begins with the header. All pointers in the file are stored
+ * as offsets from the beginning of the file. The positions of the pointers are
+ * listed in the relocations. The positions of the pointers to data types are
+ * listed in the type relocations. There, the index in UA_TYPES is stored.
+ *
+ * The file is written and read with the memory layout of the nodes. The layout
+ * hash ensures that the file is only loaded by compatible builds. */
+
+#define UA_SNAPSHOT_MAGIC "UANSSNAP"
+#define UA_SNAPSHOT_VERSION 1
+#define UA_SNAPSHOT_ALIGN 8
+
+typedef struct {
+    char magic[8];
+    UA_UInt32 version;
+    UA_UInt32 layout;
+    UA_UInt64 size;
+    UA_UInt64 nodesSize;
+    UA_UInt64 nodes;
+    UA_UInt64 relocationsSize;
+    UA_UInt64 relocations;
+    UA_UInt64 typeRelocationsSize;
+    UA_UInt64 typeRelocations;
+} UA_SnapshotHeader;
+
+struct UA_NodeStoreSnapshot {
+    UA_NodeStoreImage image;
+    UA_Byte *data;
+    size_t size;
+    UA_Boolean mapped;
+};
+
+static UA_UInt32
+layoutHash(void) {
+    const UA_UInt32 endianness = 1;
+    UA_UInt32 layout[] = {
+        (UA_UInt32)sizeof(void*), (UA_UInt32)sizeof(size_t),
+        (UA_UInt32)*(const UA_Byte*)&endianness, UA_TYPES_COUNT,
+        (UA_UInt32)sizeof(UA_Variant), (UA_UInt32)sizeof(UA_DataValue),
+        (UA_UInt32)sizeof(UA_VariableNode), (UA_UInt32)sizeof(UA_VariableTypeNode),
+        (UA_UInt32)sizeof(UA_MethodNode), (UA_UInt32)sizeof(UA_ObjectNode),
+        (UA_UInt32)sizeof(UA_ObjectTypeNode), (UA_UInt32)sizeof(UA_ReferenceTypeNode),
+        (UA_UInt32)sizeof(UA_DataTypeNode), (UA_UInt32)sizeof(UA_ViewNode) };
+    UA_UInt32 h = 2166136261u; /* FNV-1a */
+    for(size_t i = 0; i < sizeof(layout) / sizeof(UA_UInt32); ++i) {
+        h ^= layout[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static size_t
+nodeSize(UA_NodeClass nodeClass) {
+    switch(nodeClass) {
+    case UA_NODECLASS_OBJECT: return sizeof(UA_ObjectNode);
+    case UA_NODECLASS_VARIABLE: return sizeof(UA_VariableNode);
+    case UA_NODECLASS_METHOD: return sizeof(UA_MethodNode);
+    case UA_NODECLASS_OBJECTTYPE: return sizeof(UA_ObjectTypeNode);
+    case UA_NODECLASS_VARIABLETYPE: return sizeof(UA_VariableTypeNode);
+    case UA_NODECLASS_REFERENCETYPE: return sizeof(UA_ReferenceTypeNode);
+    case UA_NODECLASS_DATATYPE: return sizeof(UA_DataTypeNode);
+    case UA_NODECLASS_VIEW: return sizeof(UA_ViewNode);
+    default: return 0;
+    }
+}
+
+/**********/
+/* Writer */
+/**********/
+
+/* The nodes are written into a growing buffer. Positions in the buffer are
+ * offsets, as the buffer is moved when it grows. */
+typedef struct {
+    UA_Byte *data;
+    size_t size;
+    size_t capacity;
+    size_t *relocations;
+    size_t relocationsSize;
+    size_t relocationsCapacity;
+    size_t *typeRelocations;
+    size_t typeRelocationsSize;
+    size_t typeRelocationsCapacity;
+} UA_SnapshotWriter;
+
+static UA_StatusCode
+writerAlloc(UA_SnapshotWriter *w, size_t size, size_t *offset) {
+    size_t pos = (w->size + UA_SNAPSHOT_ALIGN - 1) & ~(size_t)(UA_SNAPSHOT_ALIGN - 1);
+    if(pos + size > w->capacity) {
+        size_t capacity = w->capacity * 2;
+        if(capacity < pos + size)
+            capacity = pos + size + 4096;
+        UA_Byte *data = UA_realloc(w->data, capacity);
+        if(!data)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        memset(&data[w->capacity], 0, capacity - w->capacity);
+        w->data = data;
+        w->capacity = capacity;
+    }
+    w->size = pos + size;
+    *offset = pos;
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+appendOffset(size_t **list, size_t *size, size_t *capacity, size_t offset) {
+    if(*size == *capacity) {
+        size_t ncapacity = (*capacity == 0) ? 256 : *capacity * 2;
+        size_t *nlist = UA_realloc(*list, sizeof(size_t) * ncapacity);
+        if(!nlist)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        *list = nlist;
+        *capacity = ncapacity;
+    }
+    (*list)[*size] = offset;
+    ++*size;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Store the offset of the target in the pointer at ptrPos */
+static UA_StatusCode
+writePointer(UA_SnapshotWriter *w, size_t ptrPos, size_t target) {
+    uintptr_t value = (uintptr_t)target;
+    memcpy(&w->data[ptrPos], &value, sizeof(uintptr_t));
+    return appendOffset(&w->relocations, &w->relocationsSize,
+                        &w->relocationsCapacity, ptrPos);
+}
+
+/* Store the index of the data type in the pointer at ptrPos */
+static UA_StatusCode
+writeTypePointer(UA_SnapshotWriter *w, size_t ptrPos, const UA_DataType *type) {
+    if(type < UA_TYPES || type >= &UA_TYPES[UA_TYPES_COUNT])
+        return UA_STATUSCODE_BADNOTSUPPORTED;
+    uintptr_t value = (uintptr_t)type->typeIndex;
+    memcpy(&w->data[ptrPos], &value, sizeof(uintptr_t));
+    return appendOffset(&w->typeRelocations, &w->typeRelocationsSize,
+                        &w->typeRelocationsCapacity, ptrPos);
+}
+
+static UA_StatusCode
+writeMembers(UA_SnapshotWriter *w, const void *src, size_t pos, const UA_DataType *type);
+
+/* Copy the array into the buffer and point to it from ptrPos. Empty arrays
+ * are stored as NULL or the empty array sentinel. */
+static UA_StatusCode
+writeArray(UA_SnapshotWriter *w, const void *src, size_t size,
+           size_t ptrPos, const UA_DataType *type) {
+    if(size == 0 || (uintptr_t)src <= (uintptr_t)UA_EMPTY_ARRAY_SENTINEL) {
+        const void *empty = src ? UA_EMPTY_ARRAY_SENTINEL : NULL;
+        memcpy(&w->data[ptrPos], &empty, sizeof(void*));
+        return UA_STATUSCODE_GOOD;
+    }
+    size_t pos;
+    UA_StatusCode retval = writerAlloc(w, size * type->memSize, &pos);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    memcpy(&w->data[pos], src, size * type->memSize);
+    if(!type->fixedSize) {
+        uintptr_t ptr = (uintptr_t)src;
+        for(size_t i = 0; i < size && retval == UA_STATUSCODE_GOOD; ++i) {
+            retval = writeMembers(w, (const void*)ptr, pos + (i * type->memSize), type);
+            ptr += type->memSize;
+        }
+    }
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    return writePointer(w, ptrPos, pos);
+}
+
+/* Copy a single value (e.g. the scalar in a variant) into the buffer */
+static UA_StatusCode
+writeScalar(UA_SnapshotWriter *w, const void *src, size_t ptrPos, const UA_DataType *type) {
+    size_t pos;
+    UA_StatusCode retval = writerAlloc(w, type->memSize, &pos);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    memcpy(&w->data[pos], src, type->memSize);
+    if(!type->fixedSize)
+        retval = writeMembers(w, src, pos, type);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    return writePointer(w, ptrPos, pos);
+}
+
+static UA_StatusCode
+writeString(UA_SnapshotWriter *w, const UA_String *src, size_t pos) {
+    return writeArray(w, src->data, src->length, pos + offsetof(UA_String, data),
+                      &UA_TYPES[UA_TYPES_BYTE]);
+}
+
+static UA_StatusCode
+writeVariant(UA_SnapshotWriter *w, const UA_Variant *src, size_t pos) {
+    UA_Variant *dst = (UA_Variant*)&w->data[pos];
+    if(!src->type) {
+        memset(dst, 0, sizeof(UA_Variant));
+        return UA_STATUSCODE_GOOD;
+    }
+    dst->storageType = UA_VARIANT_DATA;
+    UA_StatusCode retval = writeTypePointer(w, pos + offsetof(UA_Variant, type), src->type);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    if(UA_Variant_isScalar(src))
+        retval = writeScalar(w, src->data, pos + offsetof(UA_Variant, data), src->type);
+    else
+        retval = writeArray(w, src->data, src->arrayLength,
+                            pos + offsetof(UA_Variant, data), src->type);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    return writeArray(w, src->arrayDimensions, src->arrayDimensionsSize,
+                      pos + offsetof(UA_Variant, arrayDimensions),
+                      &UA_TYPES[UA_TYPES_UINT32]);
+}
+
+/* Replaces the pointers in the copy at pos (that still point to the original
+ * memory) with offsets of copies in the buffer */
+static UA_StatusCode
+writeMembers(UA_SnapshotWriter *w, const void *src, size_t pos, const UA_DataType *type) {
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    if(type->fixedSize)
+        return retval;
+    if(type->builtin) {
+        switch(type->typeIndex) {
+        case UA_TYPES_STRING:
+        case UA_TYPES_BYTESTRING:
+        case UA_TYPES_XMLELEMENT:
+            return writeString(w, (const UA_String*)src, pos);
+        case UA_TYPES_NODEID: {
+            const UA_NodeId *id = (const UA_NodeId*)src;
+            if(id->identifierType != UA_NODEIDTYPE_STRING &&
+               id->identifierType != UA_NODEIDTYPE_BYTESTRING)
+                return retval;
+            return writeString(w, &id->identifier.string,
+                               pos + offsetof(UA_NodeId, identifier.string));
+        }
+        case UA_TYPES_EXPANDEDNODEID: {
+            const UA_ExpandedNodeId *id = (const UA_ExpandedNodeId*)src;
+            retval = writeMembers(w, &id->nodeId, pos + offsetof(UA_ExpandedNodeId, nodeId),
+                                  &UA_TYPES[UA_TYPES_NODEID]);
+            if(retval != UA_STATUSCODE_GOOD)
+                return retval;
+            return writeString(w, &id->namespaceUri,
+                               pos + offsetof(UA_ExpandedNodeId, namespaceUri));
+        }
+        case UA_TYPES_QUALIFIEDNAME:
+            return writeString(w, &((const UA_QualifiedName*)src)->name,
+                               pos + offsetof(UA_QualifiedName, name));
+        case UA_TYPES_LOCALIZEDTEXT: {
+            const UA_LocalizedText *lt = (const UA_LocalizedText*)src;
+            retval = writeString(w, &lt->locale, pos + offsetof(UA_LocalizedText, locale));
+            if(retval != UA_STATUSCODE_GOOD)
+                return retval;
+            return writeString(w, &lt->text, pos + offsetof(UA_LocalizedText, text));
+        }
+        case UA_TYPES_EXTENSIONOBJECT: {
+            const UA_ExtensionObject *eo = (const UA_ExtensionObject*)src;
+            if(eo->encoding < UA_EXTENSIONOBJECT_DECODED) {
+                retval = writeMembers(w, &eo->content.encoded.typeId,
+                                      pos + offsetof(UA_ExtensionObject, content.encoded.typeId),
+                                      &UA_TYPES[UA_TYPES_NODEID]);
+                if(retval != UA_STATUSCODE_GOOD)
+                    return retval;
+                return writeString(w, &eo->content.encoded.body,
+                                   pos + offsetof(UA_ExtensionObject, content.encoded.body));
+            }
+            ((UA_ExtensionObject*)&w->data[pos])->encoding = UA_EXTENSIONOBJECT_DECODED;
+            const UA_DataType *contentType = eo->content.decoded.type;
+            retval = writeTypePointer(w, pos + offsetof(UA_ExtensionObject, content.decoded.type),
+                                      contentType);
+            if(retval != UA_STATUSCODE_GOOD)
+                return retval;
+            return writeScalar(w, eo->content.decoded.data,
+                               pos + offsetof(UA_ExtensionObject, content.decoded.data),
+                               contentType);
+        }
+        case UA_TYPES_DATAVALUE:
+            return writeVariant(w, &((const UA_DataValue*)src)->value,
+                                pos + offsetof(UA_DataValue, value));
+        case UA_TYPES_VARIANT:
+            return writeVariant(w, (const UA_Variant*)src, pos);
+        case UA_TYPES_DIAGNOSTICINFO: {
+            const UA_DiagnosticInfo *di = (const UA_DiagnosticInfo*)src;
+            if(di->hasInnerDiagnosticInfo)
+                return UA_STATUSCODE_BADNOTSUPPORTED;
+            return writeString(w, &di->additionalInfo,
+                               pos + offsetof(UA_DiagnosticInfo, additionalInfo));
+        }
+        default:
+            return UA_STATUSCODE_BADNOTSUPPORTED;
+        }
+    }
+
+    /* Structures. Only types from UA_TYPES are stored. */
+    if(type < UA_TYPES || type >= &UA_TYPES[UA_TYPES_COUNT])
+        return UA_STATUSCODE_BADNOTSUPPORTED;
+    uintptr_t ptr = (uintptr_t)src;
+    size_t dst = pos;
+    for(size_t i = 0; i < type->membersSize && retval == UA_STATUSCODE_GOOD; ++i) {
+        const UA_DataTypeMember *m = &type->members[i];
+        const UA_DataType *mt = &UA_TYPES[m->memberTypeIndex];
+        ptr += m->padding;
+        dst += m->padding;
+        if(!m->isArray) {
+            retval = writeMembers(w, (const void*)ptr, dst, mt);
+            ptr += mt->memSize;
+            dst += mt->memSize;
+        } else {
+            size_t size = *(const size_t*)ptr;
+            ptr += sizeof(size_t);
+            dst += sizeof(size_t);
+            retval = writeArray(w, *(void* const*)ptr, size, dst, mt);
+            ptr += sizeof(void*);
+            dst += sizeof(void*);
+        }
+    }
+    return retval;
+}
+
+static UA_StatusCode
+writeNode(UA_SnapshotWriter *w, const UA_Node *node, size_t *nodePos) {
+    size_t size = nodeSize(node->nodeClass);
+    if(size == 0)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    size_t pos;
+    UA_StatusCode retval = writerAlloc(w, size, &pos);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    memcpy(&w->data[pos], node, size);
+    *nodePos = pos;
+
+    /* Base attributes */
+    ((UA_Node*)&w->data[pos])->referencesIndex = NULL;
+    retval |= writeMembers(w, &node->nodeId, pos + offsetof(UA_Node, nodeId),
+                           &UA_TYPES[UA_TYPES_NODEID]);
+    retval |= writeMembers(w, &node->browseName, pos + offsetof(UA_Node, browseName),
+                           &UA_TYPES[UA_TYPES_QUALIFIEDNAME]);
+    retval |= writeMembers(w, &node->displayName, pos + offsetof(UA_Node, displayName),
+                           &UA_TYPES[UA_TYPES_LOCALIZEDTEXT]);
+    retval |= writeMembers(w, &node->description, pos + offsetof(UA_Node, description),
+                           &UA_TYPES[UA_TYPES_LOCALIZEDTEXT]);
+    retval |= writeArray(w, node->references, node->referencesSize,
+                         pos + offsetof(UA_Node, references),
+                         &UA_TYPES[UA_TYPES_REFERENCENODE]);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+
+    /* Attributes of the NodeClass. Callbacks and handles are not stored. */
+    switch(node->nodeClass) {
+    case UA_NODECLASS_VARIABLE:
+    case UA_NODECLASS_VARIABLETYPE: {
+        /* VariableTypeNodes have the same layout up to the value */
+        const UA_VariableNode *vn = (const UA_VariableNode*)node;
+        UA_VariableNode *dst = (UA_VariableNode*)&w->data[pos];
+        dst->valueSource = UA_VALUESOURCE_DATA;
+        memset(&dst->value, 0, sizeof(dst->value));
+#ifdef UA_ENABLE_MULTITHREADING
+        dst->valueCell = NULL;
+#endif
+        retval |= writeMembers(w, &vn->dataType, pos + offsetof(UA_VariableNode, dataType),
+                               &UA_TYPES[UA_TYPES_NODEID]);
+        retval |= writeArray(w, vn->arrayDimensions, vn->arrayDimensionsSize,
+                             pos + offsetof(UA_VariableNode, arrayDimensions),
+                             &UA_TYPES[UA_TYPES_UINT32]);
+        if(retval != UA_STATUSCODE_GOOD || vn->valueSource != UA_VALUESOURCE_DATA)
+            break;
+        const UA_DataValue *value = UA_VariableNode_getValue(vn);
+        size_t valuePos = pos + offsetof(UA_VariableNode, value.data.value);
+        memcpy(&w->data[valuePos], value, sizeof(UA_DataValue));
+        retval = writeMembers(w, value, valuePos, &UA_TYPES[UA_TYPES_DATAVALUE]);
+        break;
+    }
+    case UA_NODECLASS_METHOD: {
+        UA_MethodNode *dst = (UA_MethodNode*)&w->data[pos];
+        dst->methodHandle = NULL;
+        dst->attachedMethod = NULL;
+        dst->asyncMethod = NULL;
+        break;
+    }
+    case UA_NODECLASS_OBJECT:
+        ((UA_ObjectNode*)&w->data[pos])->instanceHandle = NULL;
+        break;
+    case UA_NODECLASS_OBJECTTYPE: {
+        UA_ObjectTypeNode *dst = (UA_ObjectTypeNode*)&w->data[pos];
+        memset(&dst->lifecycleManagement, 0, sizeof(UA_ObjectLifecycleManagement));
+        break;
+    }
+    case UA_NODECLASS_REFERENCETYPE: {
+        const UA_ReferenceTypeNode *rn = (const UA_ReferenceTypeNode*)node;
+        retval = writeMembers(w, &rn->inverseName, pos + offsetof(UA_ReferenceTypeNode, inverseName),
+                              &UA_TYPES[UA_TYPES_LOCALIZEDTEXT]);
+        break;
+    }
+    default:
+        break;
+    }
+    return retval;
+}
+
+typedef struct {
+    size_t nodesSize;
+    size_t nodesCapacity;
+    const UA_Node **nodes;
+    UA_StatusCode retval;
+} UA_SnapshotNodes;
+
+static void
+collectNode(void *visitorContext, const UA_Node *node) {
+    UA_SnapshotNodes *sn = (UA_SnapshotNodes*)visitorContext;
+    if(sn->retval != UA_STATUSCODE_GOOD)
+        return;
+    if(sn->nodesSize == sn->nodesCapacity) {
+        size_t capacity = (sn->nodesCapacity == 0) ? 1024 : sn->nodesCapacity * 2;
+        const UA_Node **nodes = UA_realloc((void*)sn->nodes, sizeof(UA_Node*) * capacity);
+        if(!nodes) {
+            sn->retval = UA_STATUSCODE_BADOUTOFMEMORY;
+            return;
+        }
+        sn->nodes = nodes;
+        sn->nodesCapacity = capacity;
+    }
+    sn->nodes[sn->nodesSize] = node;
+    ++sn->nodesSize;
+}
+
+static int
+compareNodes(const void *a, const void *b) {
+    const UA_Node *n1 = *(const UA_Node * const *)a;
+    const UA_Node *n2 = *(const UA_Node * const *)b;
+    return UA_NodeStoreImage_order(&n1->nodeId, &n2->nodeId);
+}
+
+static UA_StatusCode
+writeSnapshot(UA_SnapshotWriter *w, UA_SnapshotNodes *sn) {
+    size_t headerPos;
+    UA_StatusCode retval = writerAlloc(w, sizeof(UA_SnapshotHeader), &headerPos);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+
+    /* The nodes, then the array of pointers to the nodes */
+    size_t *nodePos = UA_malloc(sizeof(size_t) * (sn->nodesSize + 1));
+    if(!nodePos)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    for(size_t i = 0; i < sn->nodesSize && retval == UA_STATUSCODE_GOOD; ++i)
+        retval = writeNode(w, sn->nodes[i], &nodePos[i]);
+    size_t nodesPos = 0;
+    if(retval == UA_STATUSCODE_GOOD)
+        retval = writerAlloc(w, sizeof(UA_Node*) * sn->nodesSize, &nodesPos);
+    for(size_t i = 0; i < sn->nodesSize && retval == UA_STATUSCODE_GOOD; ++i)
+        retval = writePointer(w, nodesPos + (i * sizeof(UA_Node*)), nodePos[i]);
+    UA_free(nodePos);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+
+    /* The relocation tables (the last entries are not relocated themselves) */
+    size_t relocationsPos, typeRelocationsPos;
+    retval = writerAlloc(w, sizeof(size_t) * w->relocationsSize, &relocationsPos);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    memcpy(&w->data[relocationsPos], w->relocations, sizeof(size_t) * w->relocationsSize);
+    retval = writerAlloc(w, sizeof(size_t) * w->typeRelocationsSize, &typeRelocationsPos);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    memcpy(&w->data[typeRelocationsPos], w->typeRelocations,
+           sizeof(size_t) * w->typeRelocationsSize);
+
+    UA_SnapshotHeader *header = (UA_SnapshotHeader*)&w->data[headerPos];
+    memcpy(header->magic, UA_SNAPSHOT_MAGIC, 8);
+    header->version = UA_SNAPSHOT_VERSION;
+    header->layout = layoutHash();
+    header->size = w->size;
+    header->nodesSize = sn->nodesSize;
+    header->nodes = nodesPos;
+    header->relocationsSize = w->relocationsSize;
+    header->relocations = relocationsPos;
+    header->typeRelocationsSize = w->typeRelocationsSize;
+    header->typeRelocations = typeRelocationsPos;
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_NodeStore_saveSnapshot(UA_NodeStore *ns, const char *path) {
+    /* Collect the nodes in the order of the image */
+    UA_SnapshotNodes sn;
+    memset(&sn, 0, sizeof(UA_SnapshotNodes));
+    UA_NodeStore_iterate(ns, &sn, collectNode);
+    if(sn.retval != UA_STATUSCODE_GOOD) {
+        UA_free((void*)sn.nodes);
+        return sn.retval;
+    }
+    if(sn.nodesSize > 0)
+        qsort((void*)sn.nodes, sn.nodesSize, sizeof(UA_Node*), compareNodes);
+
+    UA_SnapshotWriter w;
+    memset(&w, 0, sizeof(UA_SnapshotWriter));
+    UA_StatusCode retval = writeSnapshot(&w, &sn);
+    UA_free((void*)sn.nodes);
+
+    if(retval == UA_STATUSCODE_GOOD) {
+        FILE *f = fopen(path, "wb");
+        if(!f) {
+            retval = UA_STATUSCODE_BADNOTFOUND;
+        } else {
+            if(fwrite(w.data, 1, w.size, f) != w.size)
+                retval = UA_STATUSCODE_BADINTERNALERROR;
+            if(fclose(f) != 0)
+                retval = UA_STATUSCODE_BADINTERNALERROR;
+        }
+    }
+    UA_free(w.data);
+    UA_free(w.relocations);
+    UA_free(w.typeRelocations);
+    return retval;
+}
+
+/**********/
+/* Loader */
+/**********/
+
+/* The loader does not trust the file. The relocated positions are marked, so
+ * that every pointer in the nodes can be checked to be a relocated pointer into
+ * the file before it is followed. */
+#define UA_SNAPSHOT_MARK_POINTER 1
+#define UA_SNAPSHOT_MARK_TYPE 2
+
+/* Bounds the nesting of variants and extension objects */
+#define UA_SNAPSHOT_MAXDEPTH 32
+
+typedef struct {
+    const UA_Byte *data;
+    size_t size;
+    UA_Byte *marks; /* One entry per pointer-aligned position */
+
+    /* The content reachable from the nodes cannot be larger than the file,
+     * unless pointers are shared. This bounds the validation effort. */
+    size_t budget;
+} UA_SnapshotChecker;
+
+static UA_Boolean
+isZero(const void *p, size_t size) {
+    const UA_Byte *b = (const UA_Byte*)p;
+    for(size_t i = 0; i < size; ++i) {
+        if(b[i] != 0)
+            return false;
+    }
+    return true;
+}
+
+static UA_Byte
+getMark(const UA_SnapshotChecker *c, const void *field) {
+    size_t offset = (size_t)((const UA_Byte*)field - c->data);
+    if(offset % sizeof(uintptr_t) != 0)
+        return 0;
+    return c->marks[offset / sizeof(uintptr_t)];
+}
+
+/* The pointer at field points to count elements of memSize inside the file */
+static UA_Boolean
+checkTarget(UA_SnapshotChecker *c, void * const *field, size_t count, size_t memSize) {
+    if(getMark(c, field) != UA_SNAPSHOT_MARK_POINTER)
+        return false;
+    size_t offset = (size_t)((const UA_Byte*)*field - c->data);
+    if(offset % UA_SNAPSHOT_ALIGN != 0 || count > (c->size - offset) / memSize)
+        return false;
+    if(count * memSize > c->budget)
+        return false;
+    c->budget -= count * memSize;
+    return true;
+}
+
+static UA_Boolean
+checkMembers(UA_SnapshotChecker *c, const void *p, const UA_DataType *type, size_t depth);
+
+static UA_Boolean
+checkArray(UA_SnapshotChecker *c, void * const *field, size_t size,
+           const UA_DataType *type, size_t depth) {
+    if(size == 0)
+        return getMark(c, field) == 0 &&
+            (uintptr_t)*field <= (uintptr_t)UA_EMPTY_ARRAY_SENTINEL;
+    if(!checkTarget(c, field, size, type->memSize))
+        return false;
+    if(type->fixedSize)
+        return true;
+    uintptr_t ptr = (uintptr_t)*field;
+    for(size_t i = 0; i < size; ++i) {
+        if(!checkMembers(c, (const void*)ptr, type, depth + 1))
+            return false;
+        ptr += type->memSize;
+    }
+    return true;
+}
+
+static UA_Boolean
+checkString(UA_SnapshotChecker *c, const UA_String *s) {
+    return checkArray(c, (void * const *)&s->data, s->length, &UA_TYPES[UA_TYPES_BYTE], 0);
+}
+
+static UA_Boolean
+checkVariant(UA_SnapshotChecker *c, const UA_Variant *v, size_t depth) {
+    if(!v->type)
+        return isZero(v, sizeof(UA_Variant));
+    if(v->storageType != UA_VARIANT_DATA || getMark(c, &v->type) != UA_SNAPSHOT_MARK_TYPE)
+        return false;
+    void * const *data = (void * const *)&v->data;
+    if(UA_Variant_isScalar(v)) {
+        if(!checkTarget(c, data, 1, v->type->memSize))
+            return false;
+        if(!v->type->fixedSize && !checkMembers(c, v->data, v->type, depth + 1))
+            return false;
+    } else if(!checkArray(c, data, v->arrayLength, v->type, depth)) {
+        return false;
+    }
+    return checkArray(c, (void * const *)&v->arrayDimensions, v->arrayDimensionsSize,
+                      &UA_TYPES[UA_TYPES_UINT32], depth);
+}
+
+/* Mirrors writeMembers */
+static UA_Boolean
+checkMembers(UA_SnapshotChecker *c, const void *p, const UA_DataType *type, size_t depth) {
+    if(depth > UA_SNAPSHOT_MAXDEPTH)
+        return false;
+    if(type->fixedSize)
+        return true;
+    if(type->builtin) {
+        switch(type->typeIndex) {
+        case UA_TYPES_STRING:
+        case UA_TYPES_BYTESTRING:
+        case UA_TYPES_XMLELEMENT:
+            return checkString(c, (const UA_String*)p);
+        case UA_TYPES_NODEID: {
+            const UA_NodeId *id = (const UA_NodeId*)p;
+            switch(id->identifierType) {
+            case UA_NODEIDTYPE_NUMERIC:
+            case UA_NODEIDTYPE_GUID:
+                return true;
+            case UA_NODEIDTYPE_STRING:
+            case UA_NODEIDTYPE_BYTESTRING:
+                return checkString(c, &id->identifier.string);
+            default:
+                return false;
+            }
+        }
+        case UA_TYPES_EXPANDEDNODEID: {
+            const UA_ExpandedNodeId *id = (const UA_ExpandedNodeId*)p;
+            return checkMembers(c, &id->nodeId, &UA_TYPES[UA_TYPES_NODEID], depth) &&
+                checkString(c, &id->namespaceUri);
+        }
+        case UA_TYPES_QUALIFIEDNAME:
+            return checkString(c, &((const UA_QualifiedName*)p)->name);
+        case UA_TYPES_LOCALIZEDTEXT: {
+            const UA_LocalizedText *lt = (const UA_LocalizedText*)p;
+            return checkString(c, &lt->locale) && checkString(c, &lt->text);
+        }
+        case UA_TYPES_EXTENSIONOBJECT: {
+            const UA_ExtensionObject *eo = (const UA_ExtensionObject*)p;
+            if(eo->encoding < UA_EXTENSIONOBJECT_DECODED)
+                return checkMembers(c, &eo->content.encoded.typeId,
+                                    &UA_TYPES[UA_TYPES_NODEID], depth) &&
+                    checkString(c, &eo->content.encoded.body);
+            if(eo->encoding != UA_EXTENSIONOBJECT_DECODED ||
+               getMark(c, &eo->content.decoded.type) != UA_SNAPSHOT_MARK_TYPE)
+                return false;
+            const UA_DataType *contentType = eo->content.decoded.type;
+            void * const *data = (void * const *)&eo->content.decoded.data;
+            if(!checkTarget(c, data, 1, contentType->memSize))
+                return false;
+            return contentType->fixedSize ||
+                checkMembers(c, *data, contentType, depth + 1);
+        }
+        case UA_TYPES_DATAVALUE:
+            return checkVariant(c, &((const UA_DataValue*)p)->value, depth);
+        case UA_TYPES_VARIANT:
+            return checkVariant(c, (const UA_Variant*)p, depth);
+        case UA_TYPES_DIAGNOSTICINFO: {
+            const UA_DiagnosticInfo *di = (const UA_DiagnosticInfo*)p;
+            return !di->hasInnerDiagnosticInfo && checkString(c, &di->additionalInfo);
+        }
+        default:
+            return false;
+        }
+    }
+
+    if(type < UA_TYPES || type >= &UA_TYPES[UA_TYPES_COUNT])
+        return false;
+    uintptr_t ptr = (uintptr_t)p;
+    for(size_t i = 0; i < type->membersSize; ++i) {
+        const UA_DataTypeMember *m = &type->members[i];
+        const UA_DataType *mt = &UA_TYPES[m->memberTypeIndex];
+        ptr += m->padding;
+        if(!m->isArray) {
+            if(!checkMembers(c, (const void*)ptr, mt, depth))
+                return false;
+            ptr += mt->memSize;
+        } else {
+            size_t size = *(const size_t*)ptr;
+            ptr += sizeof(size_t);
+            if(!checkArray(c, (void * const *)ptr, size, mt, depth))
+                return false;
+            ptr += sizeof(void*);
+        }
+    }
+    return true;
+}
+
+/* Mirrors writeNode */
+static UA_Boolean
+checkNode(UA_SnapshotChecker *c, UA_Node * const *field) {
+    if(!checkTarget(c, (void * const *)field, 1, sizeof(UA_Node)))
+        return false;
+    const UA_Node *node = *field;
+    size_t size = nodeSize(node->nodeClass);
+    size_t offset = (size_t)((const UA_Byte*)node - c->data);
+    if(size == 0 || size > c->size - offset)
+        return false;
+
+    if(node->referencesIndex ||
+       !checkMembers(c, &node->nodeId, &UA_TYPES[UA_TYPES_NODEID], 0) ||
+       !checkMembers(c, &node->browseName, &UA_TYPES[UA_TYPES_QUALIFIEDNAME], 0) ||
+       !checkMembers(c, &node->displayName, &UA_TYPES[UA_TYPES_LOCALIZEDTEXT], 0) ||
+       !checkMembers(c, &node->description, &UA_TYPES[UA_TYPES_LOCALIZEDTEXT], 0) ||
+       !checkArray(c, (void * const *)&node->references, node->referencesSize,
+                   &UA_TYPES[UA_TYPES_REFERENCENODE], 0))
+        return false;
+
+    /* Callbacks and handles are not stored and must be empty */
+    switch(node->nodeClass) {
+    case UA_NODECLASS_VARIABLE:
+    case UA_NODECLASS_VARIABLETYPE: {
+        const UA_VariableNode *vn = (const UA_VariableNode*)node;
+        if(vn->valueSource != UA_VALUESOURCE_DATA ||
+           !isZero(&vn->value.data.callback, sizeof(UA_ValueCallback)))
+            return false;
+#ifdef UA_ENABLE_MULTITHREADING
+        if(vn->valueCell)
+            return false;
+#endif
+        return checkMembers(c, &vn->dataType, &UA_TYPES[UA_TYPES_NODEID], 0) &&
+            checkArray(c, (void * const *)&vn->arrayDimensions, vn->arrayDimensionsSize,
+                       &UA_TYPES[UA_TYPES_UINT32], 0) &&
+            checkMembers(c, &vn->value.data.value, &UA_TYPES[UA_TYPES_DATAVALUE], 0);
+    }
+    case UA_NODECLASS_METHOD: {
+        const UA_MethodNode *mn = (const UA_MethodNode*)node;
+        return !mn->methodHandle && !mn->attachedMethod && !mn->asyncMethod;
+    }
+    case UA_NODECLASS_OBJECT:
+        return ((const UA_ObjectNode*)node)->instanceHandle == NULL;
+    case UA_NODECLASS_OBJECTTYPE:
+        return isZero(&((const UA_ObjectTypeNode*)node)->lifecycleManagement,
+                      sizeof(UA_ObjectLifecycleManagement));
+    case UA_NODECLASS_REFERENCETYPE:
+        return checkMembers(c, &((const UA_ReferenceTypeNode*)node)->inverseName,
+                            &UA_TYPES[UA_TYPES_LOCALIZEDTEXT], 0);
+    default:
+        return true;
+    }
+}
+
+static UA_Boolean
+validTable(const UA_SnapshotHeader *header, UA_UInt64 offset, UA_UInt64 entries, size_t entrySize) {
+    if(offset % UA_SNAPSHOT_ALIGN != 0 || offset < sizeof(UA_SnapshotHeader) ||
+       offset > header->size)
+        return false;
+    return entries <= (header->size - offset) / entrySize;
+}
+
+static UA_Boolean
+inTable(size_t offset, UA_UInt64 table, UA_UInt64 entries) {
+    return offset >= table && offset - table < entries * sizeof(size_t);
+}
+
+/* Relocates the pointers at the positions in the table. The header and the
+ * relocation tables themselves are never relocated. */
+static UA_StatusCode
+relocateTable(UA_Byte *data, const UA_SnapshotHeader *header, UA_Byte *marks,
+              UA_UInt64 table, UA_UInt64 entries, UA_Byte mark) {
+    const size_t *positions = (const size_t*)&data[table];
+    for(size_t i = 0; i < entries; ++i) {
+        size_t offset = positions[i];
+        if(offset % sizeof(uintptr_t) != 0 || offset < sizeof(UA_SnapshotHeader) ||
+           offset > header->size - sizeof(uintptr_t) ||
+           inTable(offset, header->relocations, header->relocationsSize) ||
+           inTable(offset, header->typeRelocations, header->typeRelocationsSize) ||
+           marks[offset / sizeof(uintptr_t)] != 0)
+            return UA_STATUSCODE_BADDECODINGERROR;
+        uintptr_t *ptr = (uintptr_t*)&data[offset];
+        if(mark == UA_SNAPSHOT_MARK_POINTER) {
+            if(*ptr >= header->size)
+                return UA_STATUSCODE_BADDECODINGERROR;
+            *ptr += (uintptr_t)data;
+        } else {
+            if(*ptr >= UA_TYPES_COUNT)
+                return UA_STATUSCODE_BADDECODINGERROR;
+            *ptr = (uintptr_t)&UA_TYPES[*ptr];
+        }
+        marks[offset / sizeof(uintptr_t)] = mark;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+relocate(UA_Byte *data, size_t size) {
+    UA_SnapshotHeader header;
+    memcpy(&header, data, sizeof(UA_SnapshotHeader));
+    if(memcmp(header.magic, UA_SNAPSHOT_MAGIC, 8) != 0 ||
+       header.version != UA_SNAPSHOT_VERSION || header.size != size)
+        return UA_STATUSCODE_BADDECODINGERROR;
+    if(header.layout != layoutHash())
+        return UA_STATUSCODE_BADNOTSUPPORTED;
+    if(!validTable(&header, header.nodes, header.nodesSize, sizeof(UA_Node*)) ||
+       !validTable(&header, header.relocations, header.relocationsSize, sizeof(size_t)) ||
+       !validTable(&header, header.typeRelocations, header.typeRelocationsSize, sizeof(size_t)))
+        return UA_STATUSCODE_BADDECODINGERROR;
+
+    UA_SnapshotChecker c;
+    c.data = data;
+    c.size = size;
+    c.budget = size;
+    c.marks = UA_calloc(size / sizeof(uintptr_t) + 1, sizeof(UA_Byte));
+    if(!c.marks)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    UA_StatusCode retval =
+        relocateTable(data, &header, c.marks, header.relocations,
+                      header.relocationsSize, UA_SNAPSHOT_MARK_POINTER);
+    if(retval == UA_STATUSCODE_GOOD)
+        retval = relocateTable(data, &header, c.marks, header.typeRelocations,
+                               header.typeRelocationsSize, UA_SNAPSHOT_MARK_TYPE);
+
+    /* Check the nodes before they are accessed. They are found by binary
+     * search and must be ordered. */
+    UA_Node * const *nodes = (UA_Node * const *)&data[header.nodes];
+    for(size_t i = 0; i < header.nodesSize && retval == UA_STATUSCODE_GOOD; ++i) {
+        if(!checkNode(&c, &nodes[i]) ||
+           (i > 0 && UA_NodeStoreImage_order(&nodes[i-1]->nodeId, &nodes[i]->nodeId) >= 0))
+            retval = UA_STATUSCODE_BADDECODINGERROR;
+    }
+    UA_free(c.marks);
+    return retval;
+}
+
+static void
+unmapSnapshot(UA_NodeStoreSnapshot *snapshot) {
+#ifndef _WIN32
+    if(snapshot->mapped) {
+        munmap(snapshot->data, snapshot->size);
+        return;
+    }
+#endif
+    UA_free(snapshot->data);
+}
+
+/* Maps the file into memory. The pages with pointers are copied on write when
+ * they are relocated. Without mmap, the file is read into the heap. */
+static UA_StatusCode
+mapSnapshot(UA_NodeStoreSnapshot *snapshot, const char *path) {
+#ifndef _WIN32
+    int fd = open(path, O_RDONLY);
+    if(fd < 0)
+        return UA_STATUSCODE_BADNOTFOUND;
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(UA_SnapshotHeader)) {
+        close(fd);
+        return UA_STATUSCODE_BADDECODINGERROR;
+    }
+    snapshot->size = (size_t)st.st_size;
+    void *data = mmap(NULL, snapshot->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    snapshot->data = (UA_Byte*)data;
+    snapshot->mapped = true;
+    return UA_STATUSCODE_GOOD;
+#else
+    FILE *f = fopen(path, "rb");
+    if(!f)
+        return UA_STATUSCODE_BADNOTFOUND;
+    long size = -1;
+    if(fseek(f, 0, SEEK_END) == 0)
+        size = ftell(f);
+    if(size < (long)sizeof(UA_SnapshotHeader) || fseek(f, 0, SEEK_SET) != 0) {
+        fclose(f);
+        return UA_STATUSCODE_BADDECODINGERROR;
+    }
+    snapshot->size = (size_t)size;
+    snapshot->data = UA_malloc(snapshot->size);
+    if(!snapshot->data) {
+        fclose(f);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    size_t read = fread(snapshot->data, 1, snapshot->size, f);
+    fclose(f);
+    if(read != snapshot->size) {
+        UA_free(snapshot->data);
+        return UA_STATUSCODE_BADDECODINGERROR;
+    }
+    snapshot->mapped = false;
+    return UA_STATUSCODE_GOOD;
+#endif
+}
+
+UA_StatusCode
+UA_NodeStoreSnapshot_load(const char *path, UA_NodeStoreSnapshot **snapshot) {
+    UA_NodeStoreSnapshot *s = UA_malloc(sizeof(UA_NodeStoreSnapshot));
+    if(!s)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    UA_StatusCode retval = mapSnapshot(s, path);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_free(s);
+        return retval;
+    }
+    retval = relocate(s->data, s->size);
+    if(retval != UA_STATUSCODE_GOOD) {
+        unmapSnapshot(s);
+        UA_free(s);
+        return retval;
+    }
+#ifndef _WIN32
+    mprotect(s->data, s->size, PROT_READ);
+#endif
+    const UA_SnapshotHeader *header = (const UA_SnapshotHeader*)s->data;
+    s->image.nodesSize = (size_t)header->nodesSize;
+    s->image.nodes = (const UA_Node * const *)&s->data[header->nodes];
+    s->image.complete = true;
+    *snapshot = s;
+    return UA_STATUSCODE_GOOD;
+}
+
+const UA_NodeStoreImage *
+UA_NodeStoreSnapshot_getImage(const UA_NodeStoreSnapshot *snapshot) {
+    return &snapshot->image;
+}
+
+void
+UA_NodeStoreSnapshot_delete(UA_NodeStoreSnapshot *snapshot) {
+    unmapSnapshot(snapshot);
+    UA_free(snapshot);
+}
@@ -35,7 +35,7 @@ static void removeSecureChannel(UA_SecureChannelManager *cm, channel_list_entry
 #ifndef UA_ENABLE_MULTITHREADING
     UA_free(entry);
 #else
-    UA_Server_delayedFree(cm->server, entry);
+    UA_Server_delayedFree(cm->server, entry, sizeof(channel_list_entry));
 #endif
 }
 
@@ -26,9 +26,6 @@ UA_THREAD_LOCAL bool rcu_locked = false;
 UA_THREAD_LOCAL UA_Session* methodCallSession = NULL;
 #endif
 
-static const UA_NodeId nodeIdHasSubType = {
-    .namespaceIndex = 0, .identifierType = UA_NODEIDTYPE_NUMERIC,
-    .identifier.numeric = UA_NS0ID_HASSUBTYPE};
 static const UA_NodeId nodeIdHasComponent = {
     .namespaceIndex = 0, .identifierType = UA_NODEIDTYPE_NUMERIC,
     .identifier.numeric = UA_NS0ID_HASCOMPONENT};
@@ -39,12 +36,6 @@ static const UA_NodeId nodeIdOrganizes = {
     .namespaceIndex = 0, .identifierType = UA_NODEIDTYPE_NUMERIC,
     .identifier.numeric = UA_NS0ID_ORGANIZES};
 
-#ifndef UA_ENABLE_GENERATE_NAMESPACE0
-static const UA_NodeId nodeIdNonHierarchicalReferences = {
-        .namespaceIndex = 0, .identifierType = UA_NODEIDTYPE_NUMERIC,
-        .identifier.numeric = UA_NS0ID_NONHIERARCHICALREFERENCES};
-#endif
-
 /**********************/
 /* Namespace Handling */
 /**********************/
@@ -166,19 +157,6 @@ addReferenceInternal(UA_Server *server, const UA_NodeId sourceId, const UA_NodeI
     return retval;
 }
 
-static UA_AddNodesResult
-addNodeInternal(UA_Server *server, UA_Node *node, const UA_NodeId parentNodeId,
-                const UA_NodeId referenceTypeId) {
-    UA_AddNodesResult res;
-    UA_AddNodesResult_init(&res);
-    UA_RCU_LOCK();
-    res.statusCode = Service_AddNodes_existing(server, &adminSession, node, &parentNodeId,
-                                               &referenceTypeId, &UA_NODEID_NULL,
-                                               NULL, &res.addedNodeId);
-    UA_RCU_UNLOCK();
-    return res;
-}
-
 static UA_AddNodesResult
 addNodeInternalWithType(UA_Server *server, UA_Node *node, const UA_NodeId parentNodeId,
                         const UA_NodeId referenceTypeId, const UA_NodeId typeIdentifier) {
@@ -239,9 +217,22 @@ void UA_Server_delete(UA_Server *server) {
     // Delete all internal data
     UA_SecureChannelManager_deleteMembers(&server->secureChannelManager);
     UA_SessionManager_deleteMembers(&server->sessionManager);
+
+    /* Discard the reads and method calls that are still pending (if the server
+     * was not shut down). No response is sent without the sessions. */
+    UA_Server_processAsyncReads(server, 0, true);
+#ifdef UA_ENABLE_METHODCALLS
+    UA_Server_processAsyncCalls(server, 0, true);
+#endif
     UA_RCU_LOCK();
     UA_NodeStore_delete(server->nodestore);
     UA_RCU_UNLOCK();
+    UA_Server_deleteTypeClosures(server);
+    UA_Server_deleteTypeInstances(server);
+    UA_Server_deleteChildIndexes(server);
+    UA_Server_deleteBrowseCache(server);
+    if(server->snapshot)
+        UA_NodeStoreSnapshot_delete(server->snapshot);
 #ifdef UA_ENABLE_EXTERNAL_NAMESPACES
     UA_Server_deleteExternalNamespaces(server);
 #endif
@@ -428,37 +419,6 @@ static void copyNames(UA_Node *node, char *name) {
     node->description = UA_LOCALIZEDTEXT_ALLOC("en_US", name);
 }
 
-static void
-addDataTypeNode(UA_Server *server, char* name, UA_UInt32 datatypeid,
-                UA_Boolean isAbstract, UA_UInt32 parent) {
-    UA_DataTypeNode *datatype = UA_NodeStore_newDataTypeNode();
-    copyNames((UA_Node*)datatype, name);
-    datatype->nodeId.identifier.numeric = datatypeid;
-    datatype->isAbstract = isAbstract;
-    addNodeInternal(server, (UA_Node*)datatype,
-                    UA_NODEID_NUMERIC(0, parent), nodeIdHasSubType);
-}
-
-static void
-addObjectTypeNode(UA_Server *server, char* name, UA_UInt32 objecttypeid,
-                  UA_UInt32 parent, UA_UInt32 parentreference) {
-    UA_ObjectTypeNode *objecttype = UA_NodeStore_newObjectTypeNode();
-    copyNames((UA_Node*)objecttype, name);
-    objecttype->nodeId.identifier.numeric = objecttypeid;
-    addNodeInternal(server, (UA_Node*)objecttype, UA_NODEID_NUMERIC(0, parent),
-                    UA_NODEID_NUMERIC(0, parentreference));
-}
-
-static UA_VariableTypeNode*
-createVariableTypeNode(UA_Server *server, char* name, UA_UInt32 variabletypeid,
-                       UA_Boolean abstract) {
-    UA_VariableTypeNode *variabletype = UA_NodeStore_newVariableTypeNode();
-    copyNames((UA_Node*)variabletype, name);
-    variabletype->nodeId.identifier.numeric = variabletypeid;
-    variabletype->isAbstract = abstract;
-    return variabletype;
-}
-
 #if defined(UA_ENABLE_METHODCALLS) && defined(UA_ENABLE_SUBSCRIPTIONS)
 static UA_StatusCode
 GetMonitoredItems(void *handle, const UA_NodeId objectId, size_t inputSize,
@@ -491,19 +451,104 @@ GetMonitoredItems(void *handle, const UA_NodeId objectId, size_t inputSize,
 }
 #endif
 
+UA_StatusCode UA_Server_saveSnapshot(UA_Server *server, const char *path) {
+    UA_RCU_LOCK();
+    UA_StatusCode retval = UA_NodeStore_saveSnapshot(server->nodestore, path);
+    UA_RCU_UNLOCK();
+    return retval;
+}
+
+/* Callbacks and handles are not part of the snapshot */
+static UA_Boolean
+hasCallbacks(const UA_Node *node) {
+    switch(node->nodeClass) {
+    case UA_NODECLASS_VARIABLE:
+    case UA_NODECLASS_VARIABLETYPE: {
+        const UA_VariableNode *vn = (const UA_VariableNode*)node;
+        return vn->valueSource == UA_VALUESOURCE_DATASOURCE ||
+            vn->value.data.callback.onRead || vn->value.data.callback.onWrite;
+    }
+    case UA_NODECLASS_METHOD: {
+        const UA_MethodNode *mn = (const UA_MethodNode*)node;
+        return mn->attachedMethod || mn->asyncMethod || mn->methodHandle;
+    }
+    case UA_NODECLASS_OBJECT:
+        return ((const UA_ObjectNode*)node)->instanceHandle != NULL;
+    case UA_NODECLASS_OBJECTTYPE: {
+        const UA_ObjectTypeNode *otn = (const UA_ObjectTypeNode*)node;
+        return otn->lifecycleManagement.constructor || otn->lifecycleManagement.destructor;
+    }
+    default:
+        return false;
+    }
+}
+
+UA_StatusCode UA_Server_loadSnapshot(UA_Server *server, const char *path) {
+    if(server->snapshot)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    UA_NodeStoreSnapshot *snapshot;
+    UA_StatusCode retval = UA_NodeStoreSnapshot_load(path, &snapshot);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    /* Nodes in the nodestore take precedence over the linked images. Remove
+     * the live copies of the snapshot nodes (e.g. the namespace zero nodes
+     * instantiated by UA_Server_new) so that the saved state is visible.
+     * Live nodes with callbacks (e.g. the data sources of the server status)
+     * are kept, as the saved copies could not provide their values. */
+    const UA_NodeStoreImage *image = UA_NodeStoreSnapshot_getImage(snapshot);
+    UA_RCU_LOCK();
+    UA_Server_beginNodesChange(server);
+    for(size_t i = 0; i < image->nodesSize; ++i) {
+        const UA_NodeId *id = &image->nodes[i]->nodeId;
+        const UA_Node *live = UA_NodeStore_get(server->nodestore, id);
+        if(live && hasCallbacks(live))
+            continue;
+        UA_NodeStore_remove(server->nodestore, id);
+    }
+    retval = UA_NodeStore_linkImage(server->nodestore, image);
+    UA_Server_endNodesChange(server);
+    UA_RCU_UNLOCK();
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_NodeStoreSnapshot_delete(snapshot);
+        return retval;
+    }
+    server->snapshot = snapshot;
+    UA_Server_invalidateTypeClosures(server);
+    UA_Server_invalidateTypeInstances(server);
+    UA_Server_invalidateChildIndexes(server);
+    return UA_STATUSCODE_GOOD;
+}
+
 UA_Server * UA_Server_new(const UA_ServerConfig config) {
     UA_Server *server = UA_calloc(1, sizeof(UA_Server));
     if(!server)
         return NULL;
 
     server->config = config;
-    server->nodestore = UA_NodeStore_new();
+    if(config.nodestore.newNodeStore)
+        server->nodestore = UA_NodeStore_newWithInterface(&config.nodestore);
+    else
+        server->nodestore = UA_NodeStore_new();
+    server->childIndexes = UA_calloc(UA_CHILDINDEX_CACHESIZE, sizeof(UA_ChildIndex*));
+    if(config.browseCacheSize > 0) {
+        size_t size = 1;
+        while(size <= config.browseCacheSize / 2)
+            size *= 2;
+        server->browseCache = UA_calloc(size, sizeof(UA_BrowseCacheEntry*));
+        if(server->browseCache)
+            server->browseCacheSize = size;
+    }
     LIST_INIT(&server->repeatedJobs);
+    LIST_INIT(&server->asyncReads);
+    LIST_INIT(&server->asyncCalls);
 
 #ifdef UA_ENABLE_MULTITHREADING
     rcu_init();
-    cds_wfcq_init(&server->dispatchQueue_head, &server->dispatchQueue_tail);
+    for(size_t i = 0; i < UA_JOBPRIORITIESSIZE; ++i)
+        cds_wfcq_init(&server->dispatchQueue_head[i], &server->dispatchQueue_tail[i]);
     cds_lfs_init(&server->mainLoopJobs);
+    cds_wfcq_init(&server->forkQueue_head, &server->forkQueue_tail);
+    SIMPLEQ_INIT(&server->delayedJobs);
 #else
     SLIST_INIT(&server->delayedCallbacks);
 #endif
@@ -566,394 +611,17 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
 
     UA_Job cleanup = {.type = UA_JOBTYPE_METHODCALL,
                       .job.methodCall = {.method = UA_Server_cleanup, .data = NULL} };
-    UA_Server_addRepeatedJob(server, cleanup, 10000, NULL);
+    UA_Server_addRepeatedJobWithPriority(server, cleanup, 10000,
+                                         UA_JOBPRIORITY_BACKGROUND, NULL);
 
     server->startTime = UA_DateTime_now();
 
 #ifndef UA_ENABLE_GENERATE_NAMESPACE0
-
-    /*********************************/
-    /* Bootstrap reference hierarchy */
-    /*********************************/
-
-    UA_ReferenceTypeNode *references = UA_NodeStore_newReferenceTypeNode();
-    copyNames((UA_Node*)references, "References");
-    references->nodeId.identifier.numeric = UA_NS0ID_REFERENCES;
-    references->isAbstract = true;
-    references->symmetric = true;
-    references->inverseName = UA_LOCALIZEDTEXT_ALLOC("en_US", "References");
-
-    UA_ReferenceTypeNode *hassubtype = UA_NodeStore_newReferenceTypeNode();
-    copyNames((UA_Node*)hassubtype, "HasSubtype");
-    hassubtype->inverseName = UA_LOCALIZEDTEXT_ALLOC("en_US", "HasSupertype");
-    hassubtype->nodeId.identifier.numeric = UA_NS0ID_HASSUBTYPE;
-    hassubtype->isAbstract = false;
-    hassubtype->symmetric = false;
-
-    UA_RCU_LOCK();
-    UA_NodeStore_insert(server->nodestore, (UA_Node*)references);
-    UA_NodeStore_insert(server->nodestore, (UA_Node*)hassubtype);
-    UA_RCU_UNLOCK();
-
-    UA_ReferenceTypeNode *hierarchicalreferences = UA_NodeStore_newReferenceTypeNode();
-    copyNames((UA_Node*)hierarchicalreferences, "HierarchicalReferences");
-    hierarchicalreferences->nodeId.identifier.numeric = UA_NS0ID_HIERARCHICALREFERENCES;
-    hierarchicalreferences->isAbstract = true;
-    hierarchicalreferences->symmetric  = false;
-    addNodeInternal(server, (UA_Node*)hierarchicalreferences,
-                    UA_NODEID_NUMERIC(0, UA_NS0ID_REFERENCES), nodeIdHasSubType);
-
-    UA_ReferenceTypeNode *nonhierarchicalreferences = UA_NodeStore_newReferenceTypeNode();
-    copyNames((UA_Node*)nonhierarchicalreferences, "NonHierarchicalReferences");
-    nonhierarchicalreferences->nodeId.identifier.numeric = UA_NS0ID_NONHIERARCHICALREFERENCES;
-    nonhierarchicalreferences->isAbstract = true;
-    nonhierarchicalreferences->symmetric  = false;
-    addNodeInternal(server, (UA_Node*)nonhierarchicalreferences,
-                    UA_NODEID_NUMERIC(0, UA_NS0ID_REFERENCES), nodeIdHasSubType);
-
-    UA_ReferenceTypeNode *haschild = UA_NodeStore_newReferenceTypeNode();
-    copyNames((UA_Node*)haschild, "HasChild");
-    haschild->nodeId.identifier.numeric = UA_NS0ID_HASCHILD;
-    haschild->isAbstract = false;
-    haschild->symmetric  = false;
-    addNodeInternal(server, (UA_Node*)haschild,
-                    UA_NODEID_NUMERIC(0, UA_NS0ID_HIERARCHICALREFERENCES), nodeIdHasSubType);
-
-    UA_ReferenceTypeNode *organizes = UA_NodeStore_newReferenceTypeNode();
-    copyNames((UA_Node*)organizes, "Organizes");
-    organizes->inverseName = UA_LOCALIZEDTEXT_ALLOC("en_US", "OrganizedBy");
-    organizes->nodeId.identifier.numeric = UA_NS0ID_ORGANIZES;
-    organizes->isAbstract = false;
-    organizes->symmetric  = false;
-    addNodeInternal(server, (UA_Node*)organizes,
-                    UA_NODEID_NUMERIC(0, UA_NS0ID_HIERARCHICALREFERENCES), nodeIdHasSubType);
-
-    UA_ReferenceTypeNode *haseventsource = UA_NodeStore_newReferenceTypeNode();
-    copyNames((UA_Node*)haseventsource, "HasEventSource");
-    haseventsource->inverseName = UA_LOCALIZEDTEXT_ALLOC("en_US", "EventSourceOf");
-    haseventsource->nodeId.identifier.numeric = UA_NS0ID_HASEVENTSOURCE;
-    haseventsource->isAbstract = false;
-    haseventsource->symmetric  = false;
-    addNodeInternal(server, (UA_Node*)haseventsource,
-                    UA_NODEID_NUMERIC(0, UA_NS0ID_HIERARCHICALREFERENCES), nodeIdHasSubType);
-
-    UA_ReferenceTypeNode *hasmodellingrule = UA_NodeStore_newReferenceTypeNode();
-    copyNames((UA_Node*)hasmodellingrule, "HasModellingRule");
-    hasmodellingrule->inverseName = UA_LOCALIZEDTEXT_ALLOC("en_US", "ModellingRuleOf");
-    hasmodellingrule->nodeId.identifier.numeric = UA_NS0ID_HASMODELLINGRULE;
-    hasmodellingrule->isAbstract = false;
-    hasmodellingrule->symmetric  = false;
-    addNodeInternal(server, (UA_Node*)hasmodellingrule, nodeIdNonHierarchicalReferences, nodeIdHasSubType);
-
-    UA_ReferenceTypeNode *hasencoding = UA_NodeStore_newReferenceTypeNode();
-    copyNames((UA_Node*)hasencoding, "HasEncoding");
-    hasencoding->inverseName = UA_LOCALIZEDTEXT_ALLOC("en_US", "EncodingOf");
-    hasencoding->nodeId.identifier.numeric = UA_NS0ID_HASENCODING;
-    hasencoding->isAbstract = false;
-    hasencoding->symmetric  = false;
-    addNodeInternal(server, (UA_Node*)hasencoding, nodeIdNonHierarchicalReferences, nodeIdHasSubType);
-
-    UA_ReferenceTypeNode *hasdescription = UA_NodeStore_newReferenceTypeNode();
-    copyNames((UA_Node*)hasdescription, "HasDescription");
-    hasdescription->inverseName = UA_LOCALIZEDTEXT_ALLOC("en_US", "DescriptionOf");
-    hasdescription->nodeId.identifier.numeric = UA_NS0ID_HASDESCRIPTION;
-    hasdescription->isAbstract = false;
-    hasdescription->symmetric  = false;
-    addNodeInternal(server, (UA_Node*)hasdescription, nodeIdNonHierarchicalReferences, nodeIdHasSubType);
-
-    UA_ReferenceTypeNode *hastypedefinition = UA_NodeStore_newReferenceTypeNode();
-    copyNames((UA_Node*)hastypedefinition, "HasTypeDefinition");
-    hastypedefinition->inverseName = UA_LOCALIZEDTEXT_ALLOC("en_US", "TypeDefinitionOf");
-    hastypedefinition->nodeId.identifier.numeric = UA_NS0ID_HASTYPEDEFINITION;
-    hastypedefinition->isAbstract = false;
-    hastypedefinition->symmetric  = false;
-    addNodeInternal(server, (UA_Node*)hastypedefinition, nodeIdNonHierarchicalReferences, nodeIdHasSubType);
-
-    UA_ReferenceTypeNode *generatesevent = UA_NodeStore_newReferenceTypeNode();
-    copyNames((UA_Node*)generatesevent, "GeneratesEvent");
-    generatesevent->inverseName = UA_LOCALIZEDTEXT_ALLOC("en_US", "GeneratedBy");
-    generatesevent->nodeId.identifier.numeric = UA_NS0ID_GENERATESEVENT;
-    generatesevent->isAbstract = false;
-    generatesevent->symmetric  = false;
-    addNodeInternal(server, (UA_Node*)generatesevent, nodeIdNonHierarchicalReferences, nodeIdHasSubType);
-
-    UA_ReferenceTypeNode *aggregates = UA_NodeStore_newReferenceTypeNode();
-    copyNames((UA_Node*)aggregates, "Aggregates");
-    aggregates->inverseName = UA_LOCALIZEDTEXT_ALLOC("en_US", "AggregatedBy");
-    aggregates->nodeId.identifier.numeric = UA_NS0ID_AGGREGATES;
-    aggregates->isAbstract = false;
-    aggregates->symmetric  = false;
-    addNodeInternal(server, (UA_Node*)aggregates, UA_NODEID_NUMERIC(0, UA_NS0ID_HASCHILD), nodeIdHasSubType);
-
-    /* complete bootstrap of hassubtype */
-    addReferenceInternal(server, UA_NODEID_NUMERIC(0, UA_NS0ID_HASCHILD), nodeIdHasSubType,
-                         UA_EXPANDEDNODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE), true);
-
-    UA_ReferenceTypeNode *hasproperty = UA_NodeStore_newReferenceTypeNode();
-    copyNames((UA_Node*)hasproperty, "HasProperty");
-    hasproperty->inverseName = UA_LOCALIZEDTEXT_ALLOC("en_US", "PropertyOf");
-    hasproperty->nodeId.identifier.numeric = UA_NS0ID_HASPROPERTY;
-    hasproperty->isAbstract = false;
-    hasproperty->symmetric  = false;
-    addNodeInternal(server, (UA_Node*)hasproperty,
-                    UA_NODEID_NUMERIC(0, UA_NS0ID_AGGREGATES), nodeIdHasSubType);
-
-    UA_ReferenceTypeNode *hascomponent = UA_NodeStore_newReferenceTypeNode();
-    copyNames((UA_Node*)hascomponent, "HasComponent");
-    hascomponent->inverseName = UA_LOCALIZEDTEXT_ALLOC("en_US", "ComponentOf");
-    hascomponent->nodeId.identifier.numeric = UA_NS0ID_HASCOMPONENT;
-    hascomponent->isAbstract = false;
-    hascomponent->symmetric  = false;
-    addNodeInternal(server, (UA_Node*)hascomponent, UA_NODEID_NUMERIC(0, UA_NS0ID_AGGREGATES), nodeIdHasSubType);
-
-    UA_ReferenceTypeNode *hasnotifier = UA_NodeStore_newReferenceTypeNode();
-    copyNames((UA_Node*)hasnotifier, "HasNotifier");
-    hasnotifier->inverseName = UA_LOCALIZEDTEXT_ALLOC("en_US", "NotifierOf");
-    hasnotifier->nodeId.identifier.numeric = UA_NS0ID_HASNOTIFIER;
-    hasnotifier->isAbstract = false;
-    hasnotifier->symmetric  = false;
-    addNodeInternal(server, (UA_Node*)hasnotifier, UA_NODEID_NUMERIC(0, UA_NS0ID_HASEVENTSOURCE), nodeIdHasSubType);
-
-    UA_ReferenceTypeNode *hasorderedcomponent = UA_NodeStore_newReferenceTypeNode();
-    copyNames((UA_Node*)hasorderedcomponent, "HasOrderedComponent");
-    hasorderedcomponent->inverseName = UA_LOCALIZEDTEXT_ALLOC("en_US", "OrderedComponentOf");
-    hasorderedcomponent->nodeId.identifier.numeric = UA_NS0ID_HASORDEREDCOMPONENT;
-    hasorderedcomponent->isAbstract = false;
-    hasorderedcomponent->symmetric  = false;
-    addNodeInternal(server, (UA_Node*)hasorderedcomponent, UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT), nodeIdHasSubType);
-
-    UA_ReferenceTypeNode *hasmodelparent = UA_NodeStore_newReferenceTypeNode();
-    copyNames((UA_Node*)hasmodelparent, "HasModelParent");
-    hasmodelparent->inverseName = UA_LOCALIZEDTEXT_ALLOC("en_US", "ModelParentOf");
-    hasmodelparent->nodeId.identifier.numeric = UA_NS0ID_HASMODELPARENT;
-    hasmodelparent->isAbstract = false;
-    hasmodelparent->symmetric  = false;
-    addNodeInternal(server, (UA_Node*)hasmodelparent, nodeIdNonHierarchicalReferences, nodeIdHasSubType);
-
-    UA_ReferenceTypeNode *fromstate = UA_NodeStore_newReferenceTypeNode();
-    copyNames((UA_Node*)fromstate, "FromState");
-    fromstate->inverseName = UA_LOCALIZEDTEXT_ALLOC("en_US", "ToTransition");
-    fromstate->nodeId.identifier.numeric = UA_NS0ID_FROMSTATE;
-    fromstate->isAbstract = false;
-    fromstate->symmetric  = false;
-    addNodeInternal(server, (UA_Node*)fromstate, nodeIdNonHierarchicalReferences, nodeIdHasSubType);
-
-    UA_ReferenceTypeNode *tostate = UA_NodeStore_newReferenceTypeNode();
-    copyNames((UA_Node*)tostate, "ToState");
-    tostate->inverseName = UA_LOCALIZEDTEXT_ALLOC("en_US", "FromTransition");
-    tostate->nodeId.identifier.numeric = UA_NS0ID_TOSTATE;
-    tostate->isAbstract = false;
-    tostate->symmetric  = false;
-    addNodeInternal(server, (UA_Node*)tostate, nodeIdNonHierarchicalReferences, nodeIdHasSubType);
-
-    UA_ReferenceTypeNode *hascause = UA_NodeStore_newReferenceTypeNode();
-    copyNames((UA_Node*)hascause, "HasCause");
-    hascause->inverseName = UA_LOCALIZEDTEXT_ALLOC("en_US", "MayBeCausedBy");
-    hascause->nodeId.identifier.numeric = UA_NS0ID_HASCAUSE;
-    hascause->isAbstract = false;
-    hascause->symmetric  = false;
-    addNodeInternal(server, (UA_Node*)hascause, nodeIdNonHierarchicalReferences, nodeIdHasSubType);
-    
-    UA_ReferenceTypeNode *haseffect = UA_NodeStore_newReferenceTypeNode();
-    copyNames((UA_Node*)haseffect, "HasEffect");
-    haseffect->inverseName = UA_LOCALIZEDTEXT_ALLOC("en_US", "MayBeEffectedBy");
-    haseffect->nodeId.identifier.numeric = UA_NS0ID_HASEFFECT;
-    haseffect->isAbstract = false;
-    haseffect->symmetric  = false;
-    addNodeInternal(server, (UA_Node*)haseffect, nodeIdNonHierarchicalReferences, nodeIdHasSubType);
-
-    UA_ReferenceTypeNode *hashistoricalconfiguration = UA_NodeStore_newReferenceTypeNode();
-    copyNames((UA_Node*)hashistoricalconfiguration, "HasHistoricalConfiguration");
-    hashistoricalconfiguration->inverseName = UA_LOCALIZEDTEXT_ALLOC("en_US", "HistoricalConfigurationOf");
-    hashistoricalconfiguration->nodeId.identifier.numeric = UA_NS0ID_HASHISTORICALCONFIGURATION;
-    hashistoricalconfiguration->isAbstract = false;
-    hashistoricalconfiguration->symmetric  = false;
-    addNodeInternal(server, (UA_Node*)hashistoricalconfiguration, UA_NODEID_NUMERIC(0, UA_NS0ID_AGGREGATES), nodeIdHasSubType);
-
-    /**************/
-    /* Data Types */
-    /**************/
-
-    UA_DataTypeNode *basedatatype = UA_NodeStore_newDataTypeNode();
-    copyNames((UA_Node*)basedatatype, "BaseDataType");
-    basedatatype->nodeId.identifier.numeric = UA_NS0ID_BASEDATATYPE;
-    basedatatype->isAbstract = true;
-    UA_RCU_LOCK();
-    UA_NodeStore_insert(server->nodestore, (UA_Node*)basedatatype);
-    UA_RCU_UNLOCK();
-
-    addDataTypeNode(server, "Boolean", UA_NS0ID_BOOLEAN, false, UA_NS0ID_BASEDATATYPE);
-    addDataTypeNode(server, "Number", UA_NS0ID_NUMBER, true, UA_NS0ID_BASEDATATYPE);
-    addDataTypeNode(server, "Float", UA_NS0ID_FLOAT, false, UA_NS0ID_NUMBER);
-    addDataTypeNode(server, "Double", UA_NS0ID_DOUBLE, false, UA_NS0ID_NUMBER);
-    addDataTypeNode(server, "Integer", UA_NS0ID_INTEGER, true, UA_NS0ID_NUMBER);
-       addDataTypeNode(server, "SByte", UA_NS0ID_SBYTE, false, UA_NS0ID_INTEGER);
-       addDataTypeNode(server, "Int16", UA_NS0ID_INT16, false, UA_NS0ID_INTEGER);
-       addDataTypeNode(server, "Int32", UA_NS0ID_INT32, false, UA_NS0ID_INTEGER);
-       addDataTypeNode(server, "Int64", UA_NS0ID_INT64, false, UA_NS0ID_INTEGER);
-       addDataTypeNode(server, "UInteger", UA_NS0ID_UINTEGER, true, UA_NS0ID_INTEGER);
-          addDataTypeNode(server, "Byte", UA_NS0ID_BYTE, false, UA_NS0ID_UINTEGER);
-          addDataTypeNode(server, "UInt16", UA_NS0ID_UINT16, false, UA_NS0ID_UINTEGER);
-          addDataTypeNode(server, "UInt32", UA_NS0ID_UINT32, false, UA_NS0ID_UINTEGER);
-          addDataTypeNode(server, "UInt64", UA_NS0ID_UINT64, false, UA_NS0ID_UINTEGER);
-    addDataTypeNode(server, "String", UA_NS0ID_STRING, false, UA_NS0ID_BASEDATATYPE);
-    addDataTypeNode(server, "DateTime", UA_NS0ID_DATETIME, false, UA_NS0ID_BASEDATATYPE);
-    addDataTypeNode(server, "Guid", UA_NS0ID_GUID, false, UA_NS0ID_BASEDATATYPE);
-    addDataTypeNode(server, "ByteString", UA_NS0ID_BYTESTRING, false, UA_NS0ID_BASEDATATYPE);
-    addDataTypeNode(server, "XmlElement", UA_NS0ID_XMLELEMENT, false, UA_NS0ID_BASEDATATYPE);
-    addDataTypeNode(server, "NodeId", UA_NS0ID_NODEID, false, UA_NS0ID_BASEDATATYPE);
-    addDataTypeNode(server, "ExpandedNodeId", UA_NS0ID_EXPANDEDNODEID, false, UA_NS0ID_BASEDATATYPE);
-    addDataTypeNode(server, "StatusCode", UA_NS0ID_STATUSCODE, false, UA_NS0ID_BASEDATATYPE);
-    addDataTypeNode(server, "QualifiedName", UA_NS0ID_QUALIFIEDNAME, false, UA_NS0ID_BASEDATATYPE);
-    addDataTypeNode(server, "LocalizedText", UA_NS0ID_LOCALIZEDTEXT, false, UA_NS0ID_BASEDATATYPE);
-    addDataTypeNode(server, "Structure", UA_NS0ID_STRUCTURE, true, UA_NS0ID_BASEDATATYPE);
-       addDataTypeNode(server, "ServerStatusDataType", UA_NS0ID_SERVERSTATUSDATATYPE, false, UA_NS0ID_STRUCTURE);
-       addDataTypeNode(server, "BuildInfo", UA_NS0ID_BUILDINFO, false, UA_NS0ID_STRUCTURE);
-    addDataTypeNode(server, "DataValue", UA_NS0ID_DATAVALUE, false, UA_NS0ID_BASEDATATYPE);
-    addDataTypeNode(server, "DiagnosticInfo", UA_NS0ID_DIAGNOSTICINFO, false, UA_NS0ID_BASEDATATYPE);
-    addDataTypeNode(server, "Enumeration", UA_NS0ID_ENUMERATION, true, UA_NS0ID_BASEDATATYPE);
-       addDataTypeNode(server, "ServerState", UA_NS0ID_SERVERSTATE, false, UA_NS0ID_ENUMERATION);
-
-    /*****************/
-    /* VariableTypes */
-    /*****************/
-
-    UA_VariableTypeNode *basevartype =
-        createVariableTypeNode(server, "BaseVariableType", UA_NS0ID_BASEVARIABLETYPE, true);
-    basevartype->valueRank = -2;
-    basevartype->dataType = UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATATYPE);
+    /* Link the read-only image of namespace 0. The nodes are copied into the
+     * nodestore only when they are edited. */
     UA_RCU_LOCK();
-    UA_NodeStore_insert(server->nodestore, (UA_Node*)basevartype);
+    UA_NodeStore_linkImage(server->nodestore, &UA_NodeStoreImage_ns0);
     UA_RCU_UNLOCK();
-
-    UA_VariableTypeNode *basedatavartype =
-        createVariableTypeNode(server, "BaseDataVariableType", UA_NS0ID_BASEDATAVARIABLETYPE, false);
-    basedatavartype->valueRank = -2;
-    basedatavartype->dataType = UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATATYPE);
-    addNodeInternalWithType(server, (UA_Node*)basedatavartype,
-                            UA_NODEID_NUMERIC(0, UA_NS0ID_BASEVARIABLETYPE),
-                            nodeIdHasSubType, UA_NODEID_NUMERIC(0, UA_NS0ID_BASEVARIABLETYPE));
-
-    UA_VariableTypeNode *propertytype =
-        createVariableTypeNode(server, "PropertyType", UA_NS0ID_PROPERTYTYPE, false);
-    propertytype->valueRank = -2;
-    propertytype->dataType = UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATATYPE);
-    addNodeInternalWithType(server, (UA_Node*)propertytype,
-                            UA_NODEID_NUMERIC(0, UA_NS0ID_BASEVARIABLETYPE),
-                            nodeIdHasSubType, UA_NODEID_NUMERIC(0, UA_NS0ID_BASEVARIABLETYPE));
-
-    UA_VariableTypeNode *buildinfotype =
-        createVariableTypeNode(server, "BuildInfoType", UA_NS0ID_BUILDINFOTYPE, false);
-    buildinfotype->valueRank = -1;
-    buildinfotype->dataType = UA_NODEID_NUMERIC(0, UA_NS0ID_BUILDINFO);
-    addNodeInternalWithType(server, (UA_Node*)buildinfotype,
-                            UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE),
-                            nodeIdHasSubType, UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE));
-
-    UA_VariableTypeNode *serverstatustype =
-        createVariableTypeNode(server, "ServerStatusType", UA_NS0ID_SERVERSTATUSTYPE, false);
-    serverstatustype->valueRank = -1;
-    serverstatustype->dataType = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVERSTATUSDATATYPE);
-    addNodeInternalWithType(server, (UA_Node*)serverstatustype,
-                            UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE),
-                            nodeIdHasSubType, UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE));
-
-    /**********************/
-    /* Basic Object Types */
-    /**********************/
-
-    UA_ObjectTypeNode *baseobjtype = UA_NodeStore_newObjectTypeNode();
-    copyNames((UA_Node*)baseobjtype, "BaseObjectType");
-    baseobjtype->nodeId.identifier.numeric = UA_NS0ID_BASEOBJECTTYPE;
-    UA_RCU_LOCK();
-    UA_NodeStore_insert(server->nodestore, (UA_Node*)baseobjtype);
-    UA_RCU_UNLOCK();
-
-    addObjectTypeNode(server, "FolderType", UA_NS0ID_FOLDERTYPE,
-                      UA_NS0ID_BASEOBJECTTYPE, UA_NS0ID_HASSUBTYPE);
-    addObjectTypeNode(server, "ServerType", UA_NS0ID_SERVERTYPE,
-                      UA_NS0ID_BASEOBJECTTYPE, UA_NS0ID_HASSUBTYPE);
-    addObjectTypeNode(server, "ServerDiagnosticsType", UA_NS0ID_SERVERDIAGNOSTICSTYPE,
-                      UA_NS0ID_BASEOBJECTTYPE, UA_NS0ID_HASSUBTYPE);
-    addObjectTypeNode(server, "ServerCapatilitiesType", UA_NS0ID_SERVERCAPABILITIESTYPE,
-                      UA_NS0ID_BASEOBJECTTYPE, UA_NS0ID_HASSUBTYPE);
-
-    /******************/
-    /* Root and below */
-    /******************/
-
-    static const UA_NodeId nodeIdFolderType = {
-        .namespaceIndex = 0, .identifierType = UA_NODEIDTYPE_NUMERIC,
-        .identifier.numeric = UA_NS0ID_FOLDERTYPE};
-    static const UA_NodeId nodeIdHasTypeDefinition = {
-        .namespaceIndex = 0, .identifierType = UA_NODEIDTYPE_NUMERIC,
-        .identifier.numeric = UA_NS0ID_HASTYPEDEFINITION};
-
-    UA_ObjectNode *root = UA_NodeStore_newObjectNode();
-    copyNames((UA_Node*)root, "Root");
-    root->nodeId.identifier.numeric = UA_NS0ID_ROOTFOLDER;
-    UA_RCU_LOCK();
-    UA_NodeStore_insert(server->nodestore, (UA_Node*)root);
-    UA_RCU_UNLOCK();
-    addReferenceInternal(server, UA_NODEID_NUMERIC(0, UA_NS0ID_ROOTFOLDER), nodeIdHasTypeDefinition,
-                         UA_EXPANDEDNODEID_NUMERIC(0, UA_NS0ID_FOLDERTYPE), true);
-
-    UA_ObjectNode *objects = UA_NodeStore_newObjectNode();
-    copyNames((UA_Node*)objects, "Objects");
-    objects->nodeId.identifier.numeric = UA_NS0ID_OBJECTSFOLDER;
-    addNodeInternalWithType(server, (UA_Node*)objects, UA_NODEID_NUMERIC(0, UA_NS0ID_ROOTFOLDER),
-                            nodeIdOrganizes, nodeIdFolderType);
-
-    UA_ObjectNode *types = UA_NodeStore_newObjectNode();
-    copyNames((UA_Node*)types, "Types");
-    types->nodeId.identifier.numeric = UA_NS0ID_TYPESFOLDER;
-    addNodeInternalWithType(server, (UA_Node*)types, UA_NODEID_NUMERIC(0, UA_NS0ID_ROOTFOLDER),
-                            nodeIdOrganizes, nodeIdFolderType);
-
-    UA_ObjectNode *referencetypes = UA_NodeStore_newObjectNode();
-    copyNames((UA_Node*)referencetypes, "ReferenceTypes");
-    referencetypes->nodeId.identifier.numeric = UA_NS0ID_REFERENCETYPESFOLDER;
-    addNodeInternalWithType(server, (UA_Node*)referencetypes, UA_NODEID_NUMERIC(0, UA_NS0ID_TYPESFOLDER),
-                            nodeIdOrganizes, nodeIdFolderType);
-    addReferenceInternal(server, UA_NODEID_NUMERIC(0, UA_NS0ID_REFERENCETYPESFOLDER), nodeIdOrganizes,
-                         UA_EXPANDEDNODEID_NUMERIC(0, UA_NS0ID_REFERENCES), true);
-
-    UA_ObjectNode *datatypes = UA_NodeStore_newObjectNode();
-    copyNames((UA_Node*)datatypes, "DataTypes");
-    datatypes->nodeId.identifier.numeric = UA_NS0ID_DATATYPESFOLDER;
-    addNodeInternalWithType(server, (UA_Node*)datatypes, UA_NODEID_NUMERIC(0, UA_NS0ID_TYPESFOLDER),
-                            nodeIdOrganizes, nodeIdFolderType);
-    addReferenceInternal(server, UA_NODEID_NUMERIC(0, UA_NS0ID_DATATYPESFOLDER), nodeIdOrganizes,
-                         UA_EXPANDEDNODEID_NUMERIC(0, UA_NS0ID_BASEDATATYPE), true);
-
-    UA_ObjectNode *variabletypes = UA_NodeStore_newObjectNode();
-    copyNames((UA_Node*)variabletypes, "VariableTypes");
-    variabletypes->nodeId.identifier.numeric = UA_NS0ID_VARIABLETYPESFOLDER;
-    addNodeInternalWithType(server, (UA_Node*)variabletypes, UA_NODEID_NUMERIC(0, UA_NS0ID_TYPESFOLDER),
-                            nodeIdOrganizes, nodeIdFolderType);
-    addReferenceInternal(server, UA_NODEID_NUMERIC(0, UA_NS0ID_VARIABLETYPESFOLDER), nodeIdOrganizes,
-                         UA_EXPANDEDNODEID_NUMERIC(0, UA_NS0ID_BASEVARIABLETYPE), true);
-
-    UA_ObjectNode *objecttypes = UA_NodeStore_newObjectNode();
-    copyNames((UA_Node*)objecttypes, "ObjectTypes");
-    objecttypes->nodeId.identifier.numeric = UA_NS0ID_OBJECTTYPESFOLDER;
-    addNodeInternalWithType(server, (UA_Node*)objecttypes, UA_NODEID_NUMERIC(0, UA_NS0ID_TYPESFOLDER),
-                            nodeIdOrganizes, nodeIdFolderType);
-    addReferenceInternal(server, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTTYPESFOLDER), nodeIdOrganizes,
-                         UA_EXPANDEDNODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE), true);
-
-    UA_ObjectNode *eventtypes = UA_NodeStore_newObjectNode();
-    copyNames((UA_Node*)eventtypes, "EventTypes");
-    eventtypes->nodeId.identifier.numeric = UA_NS0ID_EVENTTYPESFOLDER;
-    addNodeInternalWithType(server, (UA_Node*)eventtypes, UA_NODEID_NUMERIC(0, UA_NS0ID_TYPESFOLDER),
-                            nodeIdOrganizes, nodeIdFolderType);
-
-    UA_ObjectNode *views = UA_NodeStore_newObjectNode();
-    copyNames((UA_Node*)views, "Views");
-    views->nodeId.identifier.numeric = UA_NS0ID_VIEWSFOLDER;
-    addNodeInternalWithType(server, (UA_Node*)views, UA_NODEID_NUMERIC(0, UA_NS0ID_ROOTFOLDER),
-                            nodeIdOrganizes, nodeIdFolderType);
-
 #else
     /* load the generated namespace externally */
     ua_namespaceinit_generated(server);
@@ -964,7 +632,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     /*********************/
     
     /* Create our own server object */ 
-    UA_ObjectNode *servernode = UA_NodeStore_newObjectNode();
+    UA_ObjectNode *servernode = UA_NodeStore_newObjectNode(server->nodestore);
     copyNames((UA_Node*)servernode, "Server");
     servernode->nodeId.identifier.numeric = UA_NS0ID_SERVER;
     addNodeInternalWithType(server, (UA_Node*)servernode, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
@@ -976,7 +644,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     UA_NodeId serverNodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER);
     deleteInstanceChildren(server, &serverNodeId);
     
-    UA_VariableNode *namespaceArray = UA_NodeStore_newVariableNode();
+    UA_VariableNode *namespaceArray = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)namespaceArray, "NamespaceArray");
     namespaceArray->nodeId.identifier.numeric = UA_NS0ID_SERVER_NAMESPACEARRAY;
     namespaceArray->valueSource = UA_VALUESOURCE_DATASOURCE;
@@ -988,7 +656,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     addNodeInternalWithType(server, (UA_Node*)namespaceArray, UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER),
                             nodeIdHasProperty, UA_NODEID_NUMERIC(0, UA_NS0ID_PROPERTYTYPE));
 
-    UA_VariableNode *serverArray = UA_NodeStore_newVariableNode();
+    UA_VariableNode *serverArray = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)serverArray, "ServerArray");
     serverArray->nodeId.identifier.numeric = UA_NS0ID_SERVER_SERVERARRAY;
     UA_Variant_setArrayCopy(&serverArray->value.data.value.value,
@@ -1000,7 +668,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     addNodeInternalWithType(server, (UA_Node*)serverArray, UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER),
                             nodeIdHasProperty, UA_NODEID_NUMERIC(0, UA_NS0ID_PROPERTYTYPE));
 
-    UA_ObjectNode *servercapablities = UA_NodeStore_newObjectNode();
+    UA_ObjectNode *servercapablities = UA_NodeStore_newObjectNode(server->nodestore);
     copyNames((UA_Node*)servercapablities, "ServerCapabilities");
     servercapablities->nodeId.identifier.numeric = UA_NS0ID_SERVER_SERVERCAPABILITIES;
     addNodeInternalWithType(server, (UA_Node*)servercapablities, UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER),
@@ -1009,7 +677,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     UA_NodeId ServerCapabilitiesNodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERCAPABILITIES);
     deleteInstanceChildren(server, &ServerCapabilitiesNodeId);
     
-    UA_VariableNode *localeIdArray = UA_NodeStore_newVariableNode();
+    UA_VariableNode *localeIdArray = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)localeIdArray, "LocaleIdArray");
     localeIdArray->nodeId.identifier.numeric = UA_NS0ID_SERVER_SERVERCAPABILITIES_LOCALEIDARRAY;
     UA_String enLocale = UA_STRING("en");
@@ -1022,7 +690,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERCAPABILITIES),
                             nodeIdHasProperty, UA_NODEID_NUMERIC(0, UA_NS0ID_PROPERTYTYPE));
 
-    UA_VariableNode *maxBrowseContinuationPoints = UA_NodeStore_newVariableNode();
+    UA_VariableNode *maxBrowseContinuationPoints = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)maxBrowseContinuationPoints, "MaxBrowseContinuationPoints");
     maxBrowseContinuationPoints->nodeId.identifier.numeric =
         UA_NS0ID_SERVER_SERVERCAPABILITIES_MAXBROWSECONTINUATIONPOINTS;
@@ -1050,7 +718,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     ADDPROFILEARRAY("http://opcfoundation.org/UA-Profile/Server/EmbeddedDataChangeSubscription");
 #endif
 
-    UA_VariableNode *serverProfileArray = UA_NodeStore_newVariableNode();
+    UA_VariableNode *serverProfileArray = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)serverProfileArray, "ServerProfileArray");
     serverProfileArray->nodeId.identifier.numeric = UA_NS0ID_SERVER_SERVERCAPABILITIES_SERVERPROFILEARRAY;
     UA_Variant_setArray(&serverProfileArray->value.data.value.value,
@@ -1065,7 +733,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERCAPABILITIES),
                             nodeIdHasProperty, UA_NODEID_NUMERIC(0, UA_NS0ID_PROPERTYTYPE));
 
-    UA_VariableNode *softwareCertificates = UA_NodeStore_newVariableNode();
+    UA_VariableNode *softwareCertificates = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)softwareCertificates, "SoftwareCertificates");
     softwareCertificates->nodeId.identifier.numeric = UA_NS0ID_SERVER_SERVERCAPABILITIES_SOFTWARECERTIFICATES;
     softwareCertificates->dataType = UA_TYPES[UA_TYPES_SIGNEDSOFTWARECERTIFICATE].typeId;
@@ -1073,17 +741,18 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERCAPABILITIES),
                             nodeIdHasProperty, UA_NODEID_NUMERIC(0, UA_NS0ID_PROPERTYTYPE));
 
-    UA_VariableNode *maxQueryContinuationPoints = UA_NodeStore_newVariableNode();
+    UA_VariableNode *maxQueryContinuationPoints = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)maxQueryContinuationPoints, "MaxQueryContinuationPoints");
     maxQueryContinuationPoints->nodeId.identifier.numeric = UA_NS0ID_SERVER_SERVERCAPABILITIES_MAXQUERYCONTINUATIONPOINTS;
-    UA_Variant_setScalar(&maxQueryContinuationPoints->value.data.value.value,
-                         UA_UInt16_new(), &UA_TYPES[UA_TYPES_UINT16]);
+    UA_Variant_setScalarCopy(&maxQueryContinuationPoints->value.data.value.value,
+                             &server->config.maxQueryContinuationPoints,
+                             &UA_TYPES[UA_TYPES_UINT16]);
     maxQueryContinuationPoints->value.data.value.hasValue = true;
     addNodeInternalWithType(server, (UA_Node*)maxQueryContinuationPoints,
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERCAPABILITIES),
                             nodeIdHasProperty, UA_NODEID_NUMERIC(0, UA_NS0ID_PROPERTYTYPE));
 
-    UA_VariableNode *maxHistoryContinuationPoints = UA_NodeStore_newVariableNode();
+    UA_VariableNode *maxHistoryContinuationPoints = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)maxHistoryContinuationPoints, "MaxHistoryContinuationPoints");
     maxHistoryContinuationPoints->nodeId.identifier.numeric = UA_NS0ID_SERVER_SERVERCAPABILITIES_MAXHISTORYCONTINUATIONPOINTS;
     UA_Variant_setScalar(&maxHistoryContinuationPoints->value.data.value.value,
@@ -1093,7 +762,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERCAPABILITIES),
                             nodeIdHasProperty, UA_NODEID_NUMERIC(0, UA_NS0ID_PROPERTYTYPE));
 
-    UA_VariableNode *minSupportedSampleRate = UA_NodeStore_newVariableNode();
+    UA_VariableNode *minSupportedSampleRate = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)minSupportedSampleRate, "MinSupportedSampleRate");
     minSupportedSampleRate->nodeId.identifier.numeric = UA_NS0ID_SERVER_SERVERCAPABILITIES_MINSUPPORTEDSAMPLERATE;
     UA_Variant_setScalar(&minSupportedSampleRate->value.data.value.value,
@@ -1103,21 +772,21 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERCAPABILITIES),
                             nodeIdHasProperty, UA_NODEID_NUMERIC(0, UA_NS0ID_PROPERTYTYPE));
 
-    UA_ObjectNode *modellingRules = UA_NodeStore_newObjectNode();
+    UA_ObjectNode *modellingRules = UA_NodeStore_newObjectNode(server->nodestore);
     copyNames((UA_Node*)modellingRules, "ModellingRules");
     modellingRules->nodeId.identifier.numeric = UA_NS0ID_SERVER_SERVERCAPABILITIES_MODELLINGRULES;
     addNodeInternalWithType(server, (UA_Node*)modellingRules,
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERCAPABILITIES), nodeIdHasProperty,
                             UA_NODEID_NUMERIC(0, UA_NS0ID_FOLDERTYPE));
 
-    UA_ObjectNode *aggregateFunctions = UA_NodeStore_newObjectNode();
+    UA_ObjectNode *aggregateFunctions = UA_NodeStore_newObjectNode(server->nodestore);
     copyNames((UA_Node*)aggregateFunctions, "AggregateFunctions");
     aggregateFunctions->nodeId.identifier.numeric = UA_NS0ID_SERVER_SERVERCAPABILITIES_AGGREGATEFUNCTIONS;
     addNodeInternalWithType(server, (UA_Node*)aggregateFunctions,
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERCAPABILITIES),
                             nodeIdHasProperty, UA_NODEID_NUMERIC(0, UA_NS0ID_FOLDERTYPE));
 
-    UA_ObjectNode *serverdiagnostics = UA_NodeStore_newObjectNode();
+    UA_ObjectNode *serverdiagnostics = UA_NodeStore_newObjectNode(server->nodestore);
     copyNames((UA_Node*)serverdiagnostics, "ServerDiagnostics");
     serverdiagnostics->nodeId.identifier.numeric = UA_NS0ID_SERVER_SERVERDIAGNOSTICS;
     addNodeInternalWithType(server, (UA_Node*)serverdiagnostics,
@@ -1126,7 +795,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     UA_NodeId ServerDiagnosticsNodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERDIAGNOSTICS);
     deleteInstanceChildren(server, &ServerDiagnosticsNodeId);
     
-    UA_VariableNode *enabledFlag = UA_NodeStore_newVariableNode();
+    UA_VariableNode *enabledFlag = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)enabledFlag, "EnabledFlag");
     enabledFlag->nodeId.identifier.numeric = UA_NS0ID_SERVER_SERVERDIAGNOSTICS_ENABLEDFLAG;
     UA_Variant_setScalar(&enabledFlag->value.data.value.value, UA_Boolean_new(),
@@ -1138,7 +807,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERDIAGNOSTICS),
                             nodeIdHasProperty, UA_NODEID_NUMERIC(0, UA_NS0ID_PROPERTYTYPE));
 
-    UA_VariableNode *serverstatus = UA_NodeStore_newVariableNode();
+    UA_VariableNode *serverstatus = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)serverstatus, "ServerStatus");
     serverstatus->nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS);
     serverstatus->valueSource = UA_VALUESOURCE_DATASOURCE;
@@ -1147,7 +816,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     addNodeInternalWithType(server, (UA_Node*)serverstatus, UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER),
                             nodeIdHasComponent, UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE));
 
-    UA_VariableNode *starttime = UA_NodeStore_newVariableNode();
+    UA_VariableNode *starttime = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)starttime, "StartTime");
     starttime->nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_STARTTIME);
     UA_Variant_setScalarCopy(&starttime->value.data.value.value,
@@ -1157,7 +826,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS),
                             nodeIdHasComponent, UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE));
 
-    UA_VariableNode *currenttime = UA_NodeStore_newVariableNode();
+    UA_VariableNode *currenttime = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)currenttime, "CurrentTime");
     currenttime->nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_CURRENTTIME);
     currenttime->valueSource = UA_VALUESOURCE_DATASOURCE;
@@ -1167,7 +836,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS),
                             nodeIdHasComponent, UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE));
 
-    UA_VariableNode *state = UA_NodeStore_newVariableNode();
+    UA_VariableNode *state = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)state, "State");
     state->nodeId.identifier.numeric = UA_NS0ID_SERVER_SERVERSTATUS_STATE;
     UA_Variant_setScalar(&state->value.data.value.value, UA_ServerState_new(),
@@ -1177,7 +846,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     addNodeInternalWithType(server, (UA_Node*)state, UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS),
                             nodeIdHasComponent, UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE));
 
-    UA_VariableNode *buildinfo = UA_NodeStore_newVariableNode();
+    UA_VariableNode *buildinfo = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)buildinfo, "BuildInfo");
     buildinfo->nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_BUILDINFO);
     UA_Variant_setScalarCopy(&buildinfo->value.data.value.value,
@@ -1187,7 +856,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS),
                             nodeIdHasComponent, UA_NODEID_NUMERIC(0, UA_NS0ID_BUILDINFOTYPE));
 
-    UA_VariableNode *producturi = UA_NodeStore_newVariableNode();
+    UA_VariableNode *producturi = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)producturi, "ProductUri");
     producturi->nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_BUILDINFO_PRODUCTURI);
     UA_Variant_setScalarCopy(&producturi->value.data.value.value, &server->config.buildInfo.productUri,
@@ -1197,7 +866,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_BUILDINFO),
                             nodeIdHasComponent, UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE));
 
-    UA_VariableNode *manufacturername = UA_NodeStore_newVariableNode();
+    UA_VariableNode *manufacturername = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)manufacturername, "ManufacturerName");
     manufacturername->nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_BUILDINFO_MANUFACTURERNAME);
     UA_Variant_setScalarCopy(&manufacturername->value.data.value.value,
@@ -1208,7 +877,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_BUILDINFO),
                             nodeIdHasComponent, UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE));
 
-    UA_VariableNode *productname = UA_NodeStore_newVariableNode();
+    UA_VariableNode *productname = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)productname, "ProductName");
     productname->nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_BUILDINFO_PRODUCTNAME);
     UA_Variant_setScalarCopy(&productname->value.data.value.value, &server->config.buildInfo.productName,
@@ -1218,7 +887,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_BUILDINFO),
                             nodeIdHasComponent, UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE));
 
-    UA_VariableNode *softwareversion = UA_NodeStore_newVariableNode();
+    UA_VariableNode *softwareversion = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)softwareversion, "SoftwareVersion");
     softwareversion->nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_BUILDINFO_SOFTWAREVERSION);
     UA_Variant_setScalarCopy(&softwareversion->value.data.value.value,
@@ -1228,7 +897,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_BUILDINFO),
                             nodeIdHasComponent, UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE));
 
-    UA_VariableNode *buildnumber = UA_NodeStore_newVariableNode();
+    UA_VariableNode *buildnumber = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)buildnumber, "BuildNumber");
     buildnumber->nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_BUILDINFO_BUILDNUMBER);
     UA_Variant_setScalarCopy(&buildnumber->value.data.value.value, &server->config.buildInfo.buildNumber,
@@ -1238,7 +907,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_BUILDINFO),
                             nodeIdHasComponent, UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE));
 
-    UA_VariableNode *builddate = UA_NodeStore_newVariableNode();
+    UA_VariableNode *builddate = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)builddate, "BuildDate");
     builddate->nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_BUILDINFO_BUILDDATE);
     UA_Variant_setScalarCopy(&builddate->value.data.value.value, &server->config.buildInfo.buildDate,
@@ -1248,7 +917,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_BUILDINFO),
                             nodeIdHasComponent, UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE));
 
-    UA_VariableNode *secondstillshutdown = UA_NodeStore_newVariableNode();
+    UA_VariableNode *secondstillshutdown = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)secondstillshutdown, "SecondsTillShutdown");
     secondstillshutdown->nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_SECONDSTILLSHUTDOWN);
     UA_Variant_setScalar(&secondstillshutdown->value.data.value.value, UA_UInt32_new(),
@@ -1258,7 +927,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS),
                             nodeIdHasComponent, UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE));
 
-    UA_VariableNode *shutdownreason = UA_NodeStore_newVariableNode();
+    UA_VariableNode *shutdownreason = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)shutdownreason, "ShutdownReason");
     shutdownreason->nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_SHUTDOWNREASON);
     UA_Variant_setScalar(&shutdownreason->value.data.value.value, UA_LocalizedText_new(),
@@ -1268,7 +937,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS),
                             nodeIdHasComponent, UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE));
 
-    UA_VariableNode *servicelevel = UA_NodeStore_newVariableNode();
+    UA_VariableNode *servicelevel = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)servicelevel, "ServiceLevel");
     servicelevel->nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVICELEVEL);
     servicelevel->valueSource = UA_VALUESOURCE_DATASOURCE;
@@ -1278,7 +947,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER), nodeIdHasComponent,
                             UA_NODEID_NUMERIC(0, UA_NS0ID_PROPERTYTYPE));
 
-    UA_VariableNode *auditing = UA_NodeStore_newVariableNode();
+    UA_VariableNode *auditing = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)auditing, "Auditing");
     auditing->nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_AUDITING);
     auditing->valueSource = UA_VALUESOURCE_DATASOURCE;
@@ -1287,7 +956,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER), nodeIdHasComponent,
                             UA_NODEID_NUMERIC(0, UA_NS0ID_PROPERTYTYPE));
 
-    UA_ObjectNode *vendorServerInfo = UA_NodeStore_newObjectNode();
+    UA_ObjectNode *vendorServerInfo = UA_NodeStore_newObjectNode(server->nodestore);
     copyNames((UA_Node*)vendorServerInfo, "VendorServerInfo");
     vendorServerInfo->nodeId.identifier.numeric = UA_NS0ID_SERVER_VENDORSERVERINFO;
     addNodeInternalWithType(server, (UA_Node*)vendorServerInfo,
@@ -1299,7 +968,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     */
 
 
-    UA_ObjectNode *serverRedundancy = UA_NodeStore_newObjectNode();
+    UA_ObjectNode *serverRedundancy = UA_NodeStore_newObjectNode(server->nodestore);
     copyNames((UA_Node*)serverRedundancy, "ServerRedundancy");
     serverRedundancy->nodeId.identifier.numeric = UA_NS0ID_SERVER_SERVERREDUNDANCY;
     addNodeInternalWithType(server, (UA_Node*)serverRedundancy,
@@ -1310,7 +979,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
                          nodeIdHasTypeDefinition, UA_EXPANDEDNODEID_NUMERIC(0, UA_NS0ID_SERVERREDUNDANCYTYPE), true);
     */
 
-    UA_VariableNode *redundancySupport = UA_NodeStore_newVariableNode();
+    UA_VariableNode *redundancySupport = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)redundancySupport, "RedundancySupport");
     redundancySupport->nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERREDUNDANCY_REDUNDANCYSUPPORT);
     redundancySupport->valueRank = -1;
@@ -69,7 +69,6 @@ getServicePointers(UA_UInt32 requestTypeId, const UA_DataType **requestType,
         *responseType = &UA_TYPES[UA_TYPES_CLOSESESSIONRESPONSE];
         break;
     case UA_NS0ID_READREQUEST_ENCODING_DEFAULTBINARY:
-        *service = (UA_Service)Service_Read;
         *requestType = &UA_TYPES[UA_TYPES_READREQUEST];
         *responseType = &UA_TYPES[UA_TYPES_READRESPONSE];
         break;
@@ -98,6 +97,16 @@ getServicePointers(UA_UInt32 requestTypeId, const UA_DataType **requestType,
         *requestType = &UA_TYPES[UA_TYPES_UNREGISTERNODESREQUEST];
         *responseType = &UA_TYPES[UA_TYPES_UNREGISTERNODESRESPONSE];
         break;
+    case UA_NS0ID_QUERYFIRSTREQUEST_ENCODING_DEFAULTBINARY:
+        *service = (UA_Service)Service_QueryFirst;
+        *requestType = &UA_TYPES[UA_TYPES_QUERYFIRSTREQUEST];
+        *responseType = &UA_TYPES[UA_TYPES_QUERYFIRSTRESPONSE];
+        break;
+    case UA_NS0ID_QUERYNEXTREQUEST_ENCODING_DEFAULTBINARY:
+        *service = (UA_Service)Service_QueryNext;
+        *requestType = &UA_TYPES[UA_TYPES_QUERYNEXTREQUEST];
+        *responseType = &UA_TYPES[UA_TYPES_QUERYNEXTRESPONSE];
+        break;
     case UA_NS0ID_TRANSLATEBROWSEPATHSTONODEIDSREQUEST_ENCODING_DEFAULTBINARY:
         *service = (UA_Service)Service_TranslateBrowsePathsToNodeIds;
         *requestType = &UA_TYPES[UA_TYPES_TRANSLATEBROWSEPATHSTONODEIDSREQUEST];
@@ -158,7 +167,6 @@ getServicePointers(UA_UInt32 requestTypeId, const UA_DataType **requestType,
 
 #ifdef UA_ENABLE_METHODCALLS
     case UA_NS0ID_CALLREQUEST_ENCODING_DEFAULTBINARY:
-        *service = (UA_Service)Service_Call;
         *requestType = &UA_TYPES[UA_TYPES_CALLREQUEST];
         *responseType = &UA_TYPES[UA_TYPES_CALLRESPONSE];
         break;
@@ -442,6 +450,9 @@ processMSG(UA_Server *server, UA_SecureChannel *channel,
             return;
         }
         UA_Session_init(&anonymousSession);
+        anonymousSession.availableContinuationPoints = server->config.maxContinuationPoints;
+        anonymousSession.availableQueryContinuationPoints =
+            server->config.maxQueryContinuationPoints;
         anonymousSession.sessionId = UA_NODEID_GUID(0, UA_GUID_NULL);
         anonymousSession.channel = channel;
         session = &anonymousSession;
@@ -482,8 +493,25 @@ processMSG(UA_Server *server, UA_SecureChannel *channel,
     }
 #endif
 
+    /* The read request may be answered asynchronously */
+    if(requestType == &UA_TYPES[UA_TYPES_READREQUEST]) {
+        Service_ReadAsync(server, session, request, requestId);
+        UA_deleteMembers(request, requestType);
+        return;
+    }
+
+#ifdef UA_ENABLE_METHODCALLS
+    /* The call request may be answered asynchronously */
+    if(requestType == &UA_TYPES[UA_TYPES_CALLREQUEST]) {
+        Service_Call(server, session, request, requestId);
+        UA_deleteMembers(request, requestType);
+        return;
+    }
+#endif
+
     /* Call the service */
-    UA_assert(service); /* For all services besides publish, the service pointer is non-NULL*/
+    UA_assert(service); /* For all services besides publish, read and call,
+                           the service pointer is non-NULL*/
     service(server, session, request, response);
 
  send_response:
@@ -60,22 +60,128 @@ typedef struct UA_ExternalNamespace {
 } UA_ExternalNamespace;
 #endif
 
+/* Counters for the processed jobs of a priority class. Every instance is
+ * written from a single thread only. */
+typedef struct {
+    UA_UInt64 processed;
+    UA_DateTime waitTime; /* Sum over all processed jobs */
+    UA_DateTime maxWaitTime;
+} UA_JobCounters;
+
+/* Counters for the delayed jobs that free memory once no concurrent thread can
+ * access it anymore. Written from the main loop only. */
+typedef struct {
+    size_t pendingJobs;
+    size_t pendingBytes;
+    UA_UInt64 reclaimedJobs;
+    UA_UInt64 reclaimedBytes;
+    UA_DateTime maxLatency;
+} UA_ReclamationCounters;
+
 #ifdef UA_ENABLE_MULTITHREADING
+/* Allocated by the worker thread itself, after it was pinned to its CPU set */
 typedef struct {
     UA_Server *server;
-    pthread_t thr;
     UA_UInt32 counter;
     volatile UA_Boolean running;
-    char padding[64 - sizeof(void*) - sizeof(pthread_t) -
-                 sizeof(UA_UInt32) - sizeof(UA_Boolean)]; // separate cache lines
+    volatile UA_Boolean idle; /* waits for jobs and holds no references */
+    UA_JobCounters jobCounters[UA_JOBPRIORITIESSIZE];
+    UA_ThreadPlacement placement;
+    char padding[128 - sizeof(void*) - sizeof(UA_UInt32) - (2 * sizeof(UA_Boolean)) -
+                 (UA_JOBPRIORITIESSIZE * sizeof(UA_JobCounters)) -
+                 sizeof(UA_ThreadPlacement)]; // separate cache lines
 } UA_Worker;
 #endif
 
+/* The transitive subtypes of every ReferenceType (below References) and
+ * DataType (below BaseDataType). The types are ordered by their NodeId. Every
+ * type has a bitset with one bit per type. The closures are built when they
+ * are first used and rebuilt after the HasSubtype references changed. */
+typedef enum {
+    UA_TYPECLOSURE_REFERENCETYPES = 0,
+    UA_TYPECLOSURE_DATATYPES = 1
+} UA_TypeClosureKind;
+#define UA_TYPECLOSURESSIZE 2
+
+typedef struct {
+#ifdef UA_ENABLE_MULTITHREADING
+    struct rcu_head rcu_head;
+#endif
+    UA_UInt32 version;
+    size_t typesSize;
+    UA_NodeId *types;
+    size_t setSize; /* Number of words in a bitset */
+    UA_UInt64 *subtypes; /* The bitset of type i begins at i * setSize */
+} UA_TypeClosure;
+
+/* The children of a node indexed by their BrowseName (defined in
+ * ua_services_view.c). The server caches the indexes of recently used nodes in
+ * a direct-mapped table. */
+struct UA_ChildIndex;
+typedef struct UA_ChildIndex UA_ChildIndex;
+#define UA_CHILDINDEX_CACHESIZE 1024 /* power of two */
+
+/* Complete BrowseResults (returned without a continuation point) are cached
+ * in a direct-mapped table if it is enabled in the configuration (defined in
+ * ua_services_view.c). An entry is valid as long as the version of the browsed
+ * node and the browseCacheVersion of the server are unchanged. */
+struct UA_BrowseCacheEntry;
+typedef struct UA_BrowseCacheEntry UA_BrowseCacheEntry;
+
+/* RegisterNodes returns numeric alias NodeIds in a reserved namespace. The
+ * identifier is the position in the table of registered nodes of the session.
+ * The table holds the resolved nodes (pointers) as long as no node was
+ * replaced or removed in the nodestore since. Otherwise, the nodes are
+ * resolved again on the next access. The table is replaced (and freed after
+ * the rcu grace period) when nodes are (un)registered or resolved again.
+ *
+ * Only the node is cached, not a pre-parsed read plan. The services still
+ * dispatch on the AttributeId and parse the IndexRange of every request item.
+ * These steps depend on the request, not on the alias, and are cheap compared
+ * to the hashing of the NodeId and the nodestore lookup that are skipped. */
+#define UA_REGISTEREDNODES_NAMESPACE UA_UINT16_MAX
+
+typedef struct {
+    UA_NodeId nodeId; /* Null for unused entries */
+    const UA_Node *node;
+} UA_RegisteredNode;
+
+struct UA_RegisteredNodes {
+#ifdef UA_ENABLE_MULTITHREADING
+    struct rcu_head rcu_head;
+#endif
+    UA_Boolean resolved;
+    UA_UInt32 nodesVersion; /* The nodes were resolved at this version */
+    size_t entriesSize;
+    UA_RegisteredNode entries[];
+};
+
+/* The instances of ObjectTypes and VariableTypes (the targets of the
+ * HasTypeDefinition references) for the Query services. The entries are sorted
+ * by the type and then by the instance. The index is built when it is first
+ * used and rebuilt after a HasTypeDefinition reference was added or removed. */
+typedef struct {
+    UA_NodeId typeDefinition;
+    UA_NodeId instance;
+} UA_TypeInstance;
+
+typedef struct {
+#ifdef UA_ENABLE_MULTITHREADING
+    struct rcu_head rcu_head;
+#endif
+    UA_UInt32 version;
+    size_t instancesSize;
+    UA_TypeInstance *instances;
+} UA_TypeInstanceIndex;
+
 #if defined(UA_ENABLE_METHODCALLS) && defined(UA_ENABLE_SUBSCRIPTIONS)
 /* Internally used context to a session 'context' of the current mehtod call */
 extern UA_THREAD_LOCAL UA_Session* methodCallSession;
 #endif
 
+typedef struct UA_AsyncReadRequest UA_AsyncReadRequest;
+typedef struct UA_AsyncCallRequest UA_AsyncCallRequest;
+
 struct UA_Server {
     /* Meta */
     UA_DateTime startTime;
@@ -88,6 +194,20 @@ struct UA_Server {
 
     /* Address Space */
     UA_NodeStore *nodestore;
+    UA_NodeStoreSnapshot *snapshot; /* Linked into the nodestore (or NULL) */
+    UA_TypeClosure *typeClosures[UA_TYPECLOSURESSIZE];
+    UA_UInt32 typeClosuresVersion; /* Increased when a HasSubtype reference changes */
+    UA_TypeInstanceIndex *typeInstances;
+    UA_UInt32 typeInstancesVersion; /* Increased when instances are added or removed */
+    UA_ChildIndex **childIndexes; /* UA_CHILDINDEX_CACHESIZE entries */
+    UA_UInt32 browseNamesVersion; /* Increased when a node is renamed or removed */
+    UA_BrowseCacheEntry **browseCache; /* browseCacheSize entries (or NULL) */
+    size_t browseCacheSize; /* power of two */
+    UA_UInt32 browseCacheVersion; /* Increased when cached results may be outdated */
+    UA_UInt32 browseCacheHits;
+    UA_UInt32 browseCacheMisses;
+    UA_UInt32 nodesVersion; /* Increased when a node is replaced or removed */
+    UA_UInt32 nodesChanging; /* Number of replacements/removals in progress */
 
     size_t namespacesSize;
     UA_String *namespaces;
@@ -97,21 +217,42 @@ struct UA_Server {
     UA_ExternalNamespace *externalNamespaces;
 #endif
 
+    /* Reads with pending asynchronous DataSources */
+    LIST_HEAD(AsyncReadsList, UA_AsyncReadRequest) asyncReads;
+
+    /* Calls with pending asynchronous methods */
+    LIST_HEAD(AsyncCallsList, UA_AsyncCallRequest) asyncCalls;
+
     /* Jobs with a repetition interval */
     LIST_HEAD(RepeatedJobsList, RepeatedJob) repeatedJobs;
 
+    /* Jobs processed in the main loop */
+    UA_JobCounters jobCounters[UA_JOBPRIORITIESSIZE];
+    UA_ReclamationCounters reclamationCounters;
+
+    /* Placement of the main loop thread */
+    UA_ThreadPlacement placement;
+
 #ifndef UA_ENABLE_MULTITHREADING
     SLIST_HEAD(DelayedJobsList, UA_DelayedJob) delayedCallbacks;
 #else
-    /* Dispatch queue head for the worker threads (the tail should not be in the same cache line) */
-    struct cds_wfcq_head dispatchQueue_head;
-    UA_Worker *workers; /* there are nThread workers in a running server */
+    /* Dispatch queue heads for the worker threads, one per priority class (the
+     * tails should not be in the same cache line) */
+    struct cds_wfcq_head dispatchQueue_head[UA_JOBPRIORITIESSIZE];
+    UA_UInt64 dispatchedJobs[UA_JOBPRIORITIESSIZE]; /* written from the main loop only */
+    UA_Worker **workers; /* there are nThread workers in a running server */
+    pthread_t *workerThreads;
+    size_t workersStarted; /* protected by the dispatchQueue_mutex */
     struct cds_lfs_stack mainLoopJobs; /* Work that shall be executed only in the main loop and not
                                           by worker threads */
-    struct DelayedJobs *delayedJobs;
+    struct cds_wfcq_head forkQueue_head; /* Helpers for the ranges of large
+                                            requests. Taken before all jobs. */
+    struct cds_wfcq_tail forkQueue_tail;
+    SIMPLEQ_HEAD(DelayedJobsQueue, DelayedJobs) delayedJobs; /* oldest batch first */
+    struct DelayedJobs *delayedJobsOpen; /* batch that is not yet sealed */
     pthread_cond_t dispatchQueue_condition; /* so the workers don't spin if the queue is empty */
     pthread_mutex_t dispatchQueue_mutex; /* mutex for access to condition variable */
-    struct cds_wfcq_tail dispatchQueue_tail; /* Dispatch queue tail for the worker threads */
+    struct cds_wfcq_tail dispatchQueue_tail[UA_JOBPRIORITIESSIZE]; /* Dispatch queue tails */
 #endif
 
     /* Config is the last element so that MSVC allows the usernamePasswordLogins
@@ -126,6 +267,163 @@ struct UA_Server {
 void UA_Node_deleteMembersAnyNodeClass(UA_Node *node);
 UA_StatusCode UA_Node_copyAnyNodeClass(const UA_Node *src, UA_Node *dst);
 
+/* Adds a reference to the node. Nodes with many references get an index. Then
+ * the reference is inserted next to the references with the same type and
+ * direction. */
+UA_StatusCode
+UA_Node_addReference(UA_Node *node, const UA_NodeId *referenceTypeId,
+                     UA_Boolean isInverse, const UA_ExpandedNodeId *targetId);
+
+/* Returns UA_STATUSCODE_UNCERTAINREFERENCENOTDELETED if there is no matching
+ * reference */
+UA_StatusCode
+UA_Node_deleteReference(UA_Node *node, const UA_NodeId *referenceTypeId,
+                        UA_Boolean isInverse, const UA_NodeId *targetId);
+
+/* Returns the position after the last reference that has the same type and
+ * direction as the reference at the given position. Loops over the references
+ * use this to skip the references of a type that is not relevant. Without an
+ * index, this is position + 1. */
+size_t UA_Node_referenceGroupEnd(const UA_Node *node, size_t position);
+
+/* Returns the value of a variable (or variabletype) with
+ * UA_VALUESOURCE_DATA. The value remains valid until the rcu lock is
+ * released. */
+const UA_DataValue * UA_VariableNode_getValue(const UA_VariableNode *node);
+
+#ifdef UA_ENABLE_MULTITHREADING
+/* A value cell points to the current version of the value. Writers build a
+ * new version and swap the pointer. Old versions are freed after the rcu grace
+ * period. While the constraints on the value (DataType, ValueRank,
+ * ArrayDimensions) are replaced, the current version is locked. Writers wait
+ * until it is unlocked and then recheck the constraints in the nodestore. */
+typedef struct UA_ValueCellVersion {
+    struct rcu_head rcu_head;
+    UA_DataValue value;
+    volatile UA_Boolean locked;
+} UA_ValueCellVersion;
+
+typedef struct UA_ValueCell {
+    UA_ValueCellVersion *version;
+} UA_ValueCell;
+
+UA_ValueCellVersion * UA_ValueCellVersion_new(void);
+
+/* Frees the version immediately. Only for versions that were never visible to
+ * readers. */
+void UA_ValueCellVersion_delete(UA_ValueCellVersion *version);
+
+/* Frees the version after the rcu grace period */
+void UA_ValueCellVersion_retire(UA_ValueCellVersion *version);
+
+/* Moves the value of the node into a new cell. Called when the node is inserted
+ * into the nodestore. */
+UA_StatusCode UA_VariableNode_createValueCell(UA_VariableNode *node);
+
+/* Frees the cell and its current version. The caller ensures that no readers
+ * remain. */
+void UA_ValueCell_delete(UA_ValueCell *cell);
+
+/* Swaps in a locked version with the current value. Returns NULL if out of
+ * memory. The lock is held only while the node is replaced, without calling
+ * user code in between. */
+UA_ValueCellVersion * UA_ValueCell_lock(UA_ValueCell *cell);
+
+void UA_ValueCell_unlock(UA_ValueCellVersion *locked);
+
+/* Waits for a locked version to be unlocked. Call in a loop that rereads the
+ * current version. Spins first, then yields the processor. The spin count
+ * starts at zero. */
+void UA_ValueCell_wait(size_t *spins);
+
+/* Compares DataType, ValueRank and ArrayDimensions. VariableTypeNodes can be
+ * passed as well. */
+UA_Boolean
+UA_VariableNode_sameConstraints(const UA_VariableNode *n1, const UA_VariableNode *n2);
+#endif
+
+/******************/
+/* Interned Names */
+/******************/
+
+/* The strings in the names of stored nodes (BrowseName, DisplayName and
+ * Description) are shared between the nodes with the same text. The interned
+ * buffers are immutable and reference counted. */
+struct UA_StringTable;
+typedef struct UA_StringTable UA_StringTable;
+
+UA_StringTable * UA_StringTable_new(void);
+
+/* All strings must be released before */
+void UA_StringTable_delete(UA_StringTable *st);
+
+/* Replaces the buffer of the string with the shared buffer for the same
+ * content. If that fails, the string keeps its own buffer. */
+void UA_StringTable_intern(UA_StringTable *st, UA_String *s);
+
+/* Releases the shared buffer or frees the own buffer of the string. The string
+ * is empty afterwards. */
+void UA_StringTable_release(UA_StringTable *st, UA_String *s);
+
+void UA_Node_internNames(UA_StringTable *st, UA_Node *node);
+void UA_Node_releaseNames(UA_StringTable *st, UA_Node *node);
+
+/*******************/
+/* Nodestore Images */
+/*******************/
+
+/* The images linked into a nodestore (with a flag for each node that was
+ * removed). Used by the nodestore implementations. The flags are set
+ * atomically, so that concurrent removals and copy-on-write replacements of an
+ * image node agree on the outcome. */
+typedef struct {
+    size_t imagesSize;
+    const UA_NodeStoreImage **images;
+    volatile UA_UInt32 **removed;
+} UA_NodeStoreImages;
+
+void UA_NodeStoreImages_init(UA_NodeStoreImages *images);
+void UA_NodeStoreImages_deleteMembers(UA_NodeStoreImages *images);
+UA_StatusCode UA_NodeStoreImages_link(UA_NodeStoreImages *images, const UA_NodeStoreImage *image);
+
+/* Returns the node from the last image that contains the NodeId. Or NULL if
+ * the node was removed from there. */
+const UA_Node *
+UA_NodeStoreImages_find(const UA_NodeStoreImages *images, const UA_NodeId *nodeid);
+
+/* Hides the node in all images. Returns whether a node was visible. Of
+ * concurrent removals, only one sees the node as visible. */
+UA_Boolean UA_NodeStoreImages_remove(UA_NodeStoreImages *images, const UA_NodeId *nodeid);
+
+/* Is the node (pointer) from one of the images? */
+UA_Boolean UA_NodeStoreImages_contains(const UA_NodeStoreImages *images, const UA_Node *node);
+
+/* Nodes are replaced or removed from the nodestore (and images linked) only
+ * between these calls. Pointers to nodes that are kept beyond a read-side
+ * critical section are valid as long as the nodesVersion is unchanged. They
+ * must be taken while no change is in progress and the version did not change
+ * until they were all taken. */
+static UA_INLINE void
+UA_Server_beginNodesChange(UA_Server *server) {
+    UA_atomic_add(&server->nodesChanging, 1);
+    UA_atomic_add(&server->nodesVersion, 1);
+}
+
+static UA_INLINE void
+UA_Server_endNodesChange(UA_Server *server) {
+    UA_atomic_add(&server->nodesChanging, (UA_UInt32)-1);
+}
+
+/* Returns the node. Alias NodeIds registered by the session are resolved
+ * without a nodestore lookup (if the table of the session is up to date). */
+const UA_Node *
+UA_Server_getSessionNode(UA_Server *server, UA_Session *session, const UA_NodeId *nodeId);
+
+/* Returns the registered NodeId for an alias of the session. Other NodeIds are
+ * returned as they are. */
+const UA_NodeId *
+UA_Session_resolveNodeId(UA_Session *session, const UA_NodeId *nodeId);
+
 typedef UA_StatusCode (*UA_EditNodeCallback)(UA_Server*, UA_Session*, UA_Node*, const void*);
 
 /* Calls callback on the node. In the multithreaded case, the node is copied before and replaced in
@@ -136,10 +434,47 @@ UA_StatusCode UA_Server_editNode(UA_Server *server, UA_Session *session, const U
 void UA_Server_processBinaryMessage(UA_Server *server, UA_Connection *connection,
                                     const UA_ByteString *message);
 
+#ifdef UA_ENABLE_MULTITHREADING
+/* Execute the job in the next main loop iteration. Can be called from any
+ * thread. */
+UA_StatusCode UA_Server_addMainLoopJob(UA_Server *server, const UA_Job *job);
+#endif
+
+/* Calls the callback for the items [0, itemsSize) of a service request. With
+ * multithreading, requests with at least parallelItemsThreshold items are
+ * split into ranges. The ranges are processed by the calling thread and the
+ * idle workers in parallel (fork-join). The function returns when all items
+ * are done. Call from within a read-side critical section (rcu). The callback
+ * must only write to the results of its own item. */
+typedef void (*UA_ServiceItemCallback)(UA_Server *server, void *context, size_t item);
+void UA_Server_processItems(UA_Server *server, size_t itemsSize,
+                            UA_ServiceItemCallback callback, void *context);
+
+/* Sends the responses of asynchronous reads that have completed or timed out.
+ * Returns the time (in ms) until the next pending read times out. With force,
+ * all pending reads time out. Reads of sessions that were closed are discarded
+ * right away. Call only from the main loop. */
+UA_UInt16 UA_Server_processAsyncReads(UA_Server *server, UA_DateTime now,
+                                      UA_Boolean force);
+
+#ifdef UA_ENABLE_METHODCALLS
+/* The same for asynchronous method calls */
+UA_UInt16 UA_Server_processAsyncCalls(UA_Server *server, UA_DateTime now,
+                                      UA_Boolean force);
+#endif
+
 UA_StatusCode UA_Server_delayedCallback(UA_Server *server, UA_ServerCallback callback, void *data);
-UA_StatusCode UA_Server_delayedFree(UA_Server *server, void *data);
+/* Frees the memory when no concurrent thread can access it anymore. The size
+ * (in bytes) is only used for the reclamation statistics. */
+UA_StatusCode UA_Server_delayedFree(UA_Server *server, void *data, size_t size);
 void UA_Server_deleteAllRepeatedJobs(UA_Server *server);
 
+/* Same as UA_Server_addRepeatedJob, but with the priority class of the job
+ * dispatch given explicitly */
+UA_StatusCode
+UA_Server_addRepeatedJobWithPriority(UA_Server *server, UA_Job job, UA_UInt32 interval,
+                                     UA_JobPriority priority, UA_Guid *jobId);
+
 /* Add an existing node. The node is assumed to be "finished", i.e. no
  * instantiation from inheritance is necessary. Instantiationcallback and
  * addedNodeId may be NULL. */
@@ -177,15 +512,61 @@ UA_StatusCode
 getTypeHierarchy(UA_NodeStore *ns, const UA_Node *rootRef, UA_Boolean inverse,
                  UA_NodeId **typeHierarchy, size_t *typeHierarchySize);
 
-/* Recursively searches "upwards" in the tree following specific reference types */
-UA_Boolean
-isNodeInTree(UA_NodeStore *ns, const UA_NodeId *leafNode,
-             const UA_NodeId *nodeToFind, const UA_NodeId *referenceTypeIds,
-             size_t referenceTypeIdsSize);
-
 const UA_Node *
 getNodeType(UA_Server *server, const UA_Node *node);
 
+/* Returns the current closure (or NULL if out of memory). It remains valid
+ * until the rcu lock is released. */
+const UA_TypeClosure *
+UA_Server_getTypeClosure(UA_Server *server, UA_TypeClosureKind kind);
+
+/* Returns the position of the type. Or typesSize if the type is unknown. */
+size_t UA_TypeClosure_find(const UA_TypeClosure *tc, const UA_NodeId *type);
+
+/* Is the type at position type a subtype of (or equal to) the supertype? */
+static UA_INLINE UA_Boolean
+UA_TypeClosure_isSubtype(const UA_TypeClosure *tc, size_t type, size_t supertype) {
+    const UA_UInt64 *set = &tc->subtypes[supertype * tc->setSize];
+    return (set[type / 64] >> (type % 64)) & 1;
+}
+
+/* Is the type a subtype of (or equal to) the supertype? Both are looked up in
+ * the closure of the kind. No nodes are accessed. */
+UA_Boolean
+UA_Server_isSubtype(UA_Server *server, UA_TypeClosureKind kind,
+                    const UA_NodeId *type, const UA_NodeId *supertype);
+
+/* Called after a HasSubtype reference was added or removed */
+void UA_Server_invalidateTypeClosures(UA_Server *server);
+
+void UA_Server_deleteTypeClosures(UA_Server *server);
+
+/* Called after the BrowseName of a node was changed or a node was removed.
+ * Then the cached child indexes of all nodes (and the browse cache) are
+ * outdated. */
+void UA_Server_invalidateChildIndexes(UA_Server *server);
+
+void UA_Server_deleteChildIndexes(UA_Server *server);
+
+/* Called after the attributes of nodes that are returned for the targets of
+ * references (BrowseName, DisplayName, TypeDefinition) changed, a node was
+ * removed or the hierarchy of the ReferenceTypes changed. Changes of the
+ * references of a node are detected from its version. */
+void UA_Server_invalidateBrowseCache(UA_Server *server);
+
+void UA_Server_deleteBrowseCache(UA_Server *server);
+
+/* Returns the current index of the type instances (or NULL if out of memory).
+ * It remains valid until the rcu lock is released. Defined in
+ * ua_services_query.c. */
+const UA_TypeInstanceIndex *
+UA_Server_getTypeInstanceIndex(UA_Server *server);
+
+/* Called after a HasTypeDefinition reference was added or removed */
+void UA_Server_invalidateTypeInstances(UA_Server *server);
+
+void UA_Server_deleteTypeInstances(UA_Server *server);
+
 /***************************************/
 /* Check Information Model Consistency */
 /***************************************/
@@ -246,12 +627,18 @@ Service_TranslateBrowsePathsToNodeIds_single(UA_Server *server, UA_Session *sess
                                              const UA_BrowsePath *path,
                                              UA_BrowsePathResult *result);
 
+/* The token is passed to asynchronous DataSource reads. If the token is NULL,
+ * DataSources are read synchronously. */
 void Service_Read_single(UA_Server *server, UA_Session *session,
                          UA_TimestampsToReturn timestamps,
-                         const UA_ReadValueId *id, UA_DataValue *v);
+                         const UA_ReadValueId *id, UA_DataValue *v,
+                         UA_ReadToken *token);
 
+/* The token is passed to asynchronous method callbacks. If the token is NULL,
+ * methods with an asynchronous callback cannot be called. */
 void Service_Call_single(UA_Server *server, UA_Session *session,
                          const UA_CallMethodRequest *request,
-                         UA_CallMethodResult *result);
+                         UA_CallMethodResult *result,
+                         UA_MethodCallToken *token);
 
 #endif /* UA_SERVER_INTERNAL_H_ */
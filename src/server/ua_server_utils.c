@@ -107,8 +107,10 @@ getTypeHierarchy(UA_NodeStore *ns, const UA_Node *rootRef, UA_Boolean inverse,
         for(size_t i = 0; i < node->referencesSize; ++i) {
             /* is the reference relevant? */
             if(node->references[i].isInverse != inverse ||
-               !UA_NodeId_equal(&hasSubtypeNodeId, &node->references[i].referenceTypeId))
+               !UA_NodeId_equal(&hasSubtypeNodeId, &node->references[i].referenceTypeId)) {
+                i = UA_Node_referenceGroupEnd(node, i) - 1;
                 continue;
+            }
 
             /* is the target already considered? (multi-inheritance) */
             UA_Boolean duplicate = false;
@@ -159,30 +161,265 @@ getTypeHierarchy(UA_NodeStore *ns, const UA_Node *rootRef, UA_Boolean inverse,
     return UA_STATUSCODE_GOOD;
 }
 
+/*****************/
+/* Type Closures */
+/*****************/
+
+static int
+compareTypeNodes(const void *a, const void *b) {
+    const UA_Node *n1 = *(const UA_Node * const *)a;
+    const UA_Node *n2 = *(const UA_Node * const *)b;
+    return UA_NodeStoreImage_order(&n1->nodeId, &n2->nodeId);
+}
+
+/* Inserts the node into the sorted array of visited nodes. Returns false if
+ * the node was visited before. */
+static UA_Boolean
+visitTypeNode(const UA_Node **visited, size_t *visitedSize, const UA_Node *node) {
+    size_t low = 0;
+    size_t high = *visitedSize;
+    while(low < high) {
+        size_t mid = low + (high - low) / 2;
+        if(visited[mid] == node)
+            return false;
+        if((uintptr_t)visited[mid] < (uintptr_t)node)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    memmove((void*)&visited[low + 1], (void*)&visited[low],
+            sizeof(UA_Node*) * (*visitedSize - low));
+    visited[low] = node;
+    ++*visitedSize;
+    return true;
+}
+
+static void
+deleteTypeClosure(UA_TypeClosure *tc) {
+    UA_Array_delete(tc->types, tc->typesSize, &UA_TYPES[UA_TYPES_NODEID]);
+    UA_free(tc->subtypes);
+    UA_free(tc);
+}
+
+#ifdef UA_ENABLE_MULTITHREADING
+static void
+deleteTypeClosureRcu(struct rcu_head *head) {
+    deleteTypeClosure(container_of(head, UA_TypeClosure, rcu_head));
+}
+#endif
+
+/* Collects the types below the root (breadth-first). The nodes are returned
+ * ordered by their NodeId. */
+static UA_StatusCode
+collectTypeNodes(UA_NodeStore *ns, const UA_NodeId *rootId, UA_NodeClass nodeClass,
+                 const UA_Node ***nodes, size_t *nodesSize) {
+    *nodes = NULL;
+    *nodesSize = 0;
+    const UA_Node *root = UA_NodeStore_get(ns, rootId);
+    if(!root || root->nodeClass != nodeClass)
+        return UA_STATUSCODE_GOOD;
+
+    size_t capacity = 64;
+    const UA_Node **queue = UA_malloc(sizeof(UA_Node*) * capacity);
+    const UA_Node **visited = UA_malloc(sizeof(UA_Node*) * capacity);
+    if(!queue || !visited) {
+        UA_free((void*)queue);
+        UA_free((void*)visited);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    size_t queueSize = 1;
+    size_t visitedSize = 1;
+    queue[0] = root;
+    visited[0] = root;
+
+    const UA_NodeId hasSubtype = UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE);
+    for(size_t i = 0; i < queueSize; ++i) {
+        const UA_Node *node = queue[i];
+        for(size_t j = 0; j < node->referencesSize; ++j) {
+            const UA_ReferenceNode *ref = &node->references[j];
+            if(ref->isInverse || !UA_NodeId_equal(&ref->referenceTypeId, &hasSubtype)) {
+                j = UA_Node_referenceGroupEnd(node, j) - 1;
+                continue;
+            }
+            const UA_Node *subtype = UA_NodeStore_get(ns, &ref->targetId.nodeId);
+            if(!subtype || subtype->nodeClass != nodeClass)
+                continue;
+            if(queueSize == capacity) {
+                const UA_Node **newQueue =
+                    UA_realloc((void*)queue, sizeof(UA_Node*) * capacity * 2);
+                if(newQueue)
+                    queue = newQueue;
+                const UA_Node **newVisited =
+                    UA_realloc((void*)visited, sizeof(UA_Node*) * capacity * 2);
+                if(newVisited)
+                    visited = newVisited;
+                if(!newQueue || !newVisited) {
+                    UA_free((void*)queue);
+                    UA_free((void*)visited);
+                    return UA_STATUSCODE_BADOUTOFMEMORY;
+                }
+                capacity *= 2;
+            }
+            if(visitTypeNode(visited, &visitedSize, subtype))
+                queue[queueSize++] = subtype;
+        }
+    }
+    UA_free((void*)visited);
+
+    qsort((void*)queue, queueSize, sizeof(UA_Node*), compareTypeNodes);
+    *nodes = queue;
+    *nodesSize = queueSize;
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_TypeClosure *
+buildTypeClosure(UA_Server *server, UA_TypeClosureKind kind, UA_UInt32 version) {
+    UA_NodeId rootId = UA_NODEID_NUMERIC(0, UA_NS0ID_REFERENCES);
+    UA_NodeClass nodeClass = UA_NODECLASS_REFERENCETYPE;
+    if(kind == UA_TYPECLOSURE_DATATYPES) {
+        rootId = UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATATYPE);
+        nodeClass = UA_NODECLASS_DATATYPE;
+    }
+
+    UA_TypeClosure *tc = UA_calloc(1, sizeof(UA_TypeClosure));
+    if(!tc)
+        return NULL;
+    tc->version = version;
+    const UA_Node **nodes;
+    size_t nodesSize;
+    if(collectTypeNodes(server->nodestore, &rootId, nodeClass,
+                        &nodes, &nodesSize) != UA_STATUSCODE_GOOD) {
+        UA_free(tc);
+        return NULL;
+    }
+    if(nodesSize == 0)
+        return tc;
+
+    /* Copy the NodeIds */
+    size_t *stack = UA_malloc(sizeof(size_t) * nodesSize);
+    tc->types = UA_Array_new(nodesSize, &UA_TYPES[UA_TYPES_NODEID]);
+    tc->setSize = (nodesSize + 63) / 64;
+    tc->subtypes = UA_calloc(nodesSize * tc->setSize, sizeof(UA_UInt64));
+    if(!stack || !tc->types || !tc->subtypes) {
+        UA_free(stack);
+        UA_free((void*)nodes);
+        deleteTypeClosure(tc);
+        return NULL;
+    }
+    tc->typesSize = nodesSize;
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    for(size_t i = 0; i < nodesSize; ++i)
+        retval |= UA_NodeId_copy(&nodes[i]->nodeId, &tc->types[i]);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_free(stack);
+        UA_free((void*)nodes);
+        deleteTypeClosure(tc);
+        return NULL;
+    }
+
+    /* Set the bits of all (transitive) subtypes. Every type is a subtype of
+     * itself. */
+    const UA_NodeId hasSubtype = UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE);
+    for(size_t i = 0; i < nodesSize; ++i) {
+        UA_UInt64 *set = &tc->subtypes[i * tc->setSize];
+        set[i / 64] |= (UA_UInt64)1 << (i % 64);
+        size_t stackSize = 1;
+        stack[0] = i;
+        while(stackSize > 0) {
+            const UA_Node *node = nodes[stack[--stackSize]];
+            for(size_t j = 0; j < node->referencesSize; ++j) {
+                const UA_ReferenceNode *ref = &node->references[j];
+                if(ref->isInverse || !UA_NodeId_equal(&ref->referenceTypeId, &hasSubtype)) {
+                    j = UA_Node_referenceGroupEnd(node, j) - 1;
+                    continue;
+                }
+                size_t sub = UA_TypeClosure_find(tc, &ref->targetId.nodeId);
+                if(sub == nodesSize || UA_TypeClosure_isSubtype(tc, sub, i))
+                    continue;
+                set[sub / 64] |= (UA_UInt64)1 << (sub % 64);
+                stack[stackSize++] = sub;
+            }
+        }
+    }
+    UA_free(stack);
+    UA_free((void*)nodes);
+    return tc;
+}
+
+const UA_TypeClosure *
+UA_Server_getTypeClosure(UA_Server *server, UA_TypeClosureKind kind) {
+    UA_UInt32 version = server->typeClosuresVersion;
+#ifdef UA_ENABLE_MULTITHREADING
+    UA_TypeClosure *tc = rcu_dereference(server->typeClosures[kind]);
+#else
+    UA_TypeClosure *tc = server->typeClosures[kind];
+#endif
+    if(tc && tc->version == version)
+        return tc;
+
+    UA_TypeClosure *newTc = buildTypeClosure(server, kind, version);
+    if(!newTc)
+        return NULL;
+#ifdef UA_ENABLE_MULTITHREADING
+    UA_TypeClosure *seen = rcu_cmpxchg_pointer(&server->typeClosures[kind], tc, newTc);
+    if(seen != tc) {
+        /* Another thread was faster */
+        deleteTypeClosure(newTc);
+        return seen;
+    }
+    if(tc)
+        call_rcu(&tc->rcu_head, deleteTypeClosureRcu);
+#else
+    if(tc)
+        deleteTypeClosure(tc);
+    server->typeClosures[kind] = newTc;
+#endif
+    return newTc;
+}
+
+size_t
+UA_TypeClosure_find(const UA_TypeClosure *tc, const UA_NodeId *type) {
+    size_t low = 0;
+    size_t high = tc->typesSize;
+    while(low < high) {
+        size_t mid = low + (high - low) / 2;
+        int order = UA_NodeStoreImage_order(&tc->types[mid], type);
+        if(order == 0)
+            return mid;
+        if(order < 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return tc->typesSize;
+}
+
 UA_Boolean
-isNodeInTree(UA_NodeStore *ns, const UA_NodeId *leafNode, const UA_NodeId *nodeToFind,
-             const UA_NodeId *referenceTypeIds, size_t referenceTypeIdsSize) {
-    if(UA_NodeId_equal(leafNode, nodeToFind))
+UA_Server_isSubtype(UA_Server *server, UA_TypeClosureKind kind,
+                    const UA_NodeId *type, const UA_NodeId *supertype) {
+    if(UA_NodeId_equal(type, supertype))
         return true;
-
-    const UA_Node *node = UA_NodeStore_get(ns,leafNode);
-    if(!node)
+    const UA_TypeClosure *tc = UA_Server_getTypeClosure(server, kind);
+    if(!tc)
+        return false;
+    size_t t = UA_TypeClosure_find(tc, type);
+    size_t s = UA_TypeClosure_find(tc, supertype);
+    if(t == tc->typesSize || s == tc->typesSize)
         return false;
+    return UA_TypeClosure_isSubtype(tc, t, s);
+}
 
-    /* Search upwards in the tree */
-    for(size_t i = 0; i < node->referencesSize; ++i) {
-        if(!node->references[i].isInverse)
-            continue;
+void UA_Server_invalidateTypeClosures(UA_Server *server) {
+    UA_atomic_add(&server->typeClosuresVersion, 1);
+    UA_Server_invalidateBrowseCache(server);
+}
 
-        /* Recurse only for valid reference types */
-        for(size_t j = 0; j < referenceTypeIdsSize; ++j) {
-            if(UA_NodeId_equal(&node->references[i].referenceTypeId, &referenceTypeIds[j]) &&
-               isNodeInTree(ns, &node->references[i].targetId.nodeId, nodeToFind,
-                            referenceTypeIds, referenceTypeIdsSize))
-                return true;
-        }
+void UA_Server_deleteTypeClosures(UA_Server *server) {
+    for(size_t i = 0; i < UA_TYPECLOSURESSIZE; ++i) {
+        if(server->typeClosures[i])
+            deleteTypeClosure(server->typeClosures[i]);
+        server->typeClosures[i] = NULL;
     }
-    return false;
 }
 
 const UA_Node *
@@ -206,7 +443,7 @@ getNodeType(UA_Server *server, const UA_Node *node) {
 
     /* stop at the first matching candidate */
     UA_NodeId *parentId = NULL;
-    for(size_t i = 0; i < node->referencesSize; ++i) {
+    for(size_t i = 0; i < node->referencesSize; i = UA_Node_referenceGroupEnd(node, i)) {
         if(node->references[i].isInverse == inverse &&
            UA_NodeId_equal(&node->references[i].referenceTypeId, &parentRef)) {
             parentId = &node->references[i].targetId.nodeId;
@@ -239,7 +476,7 @@ UA_Boolean
 UA_Node_hasSubTypeOrInstances(const UA_Node *node) {
     const UA_NodeId hasSubType = UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE);
     const UA_NodeId hasTypeDefinition = UA_NODEID_NUMERIC(0, UA_NS0ID_HASTYPEDEFINITION);
-    for(size_t i = 0; i < node->referencesSize; ++i) {
+    for(size_t i = 0; i < node->referencesSize; i = UA_Node_referenceGroupEnd(node, i)) {
         if(node->references[i].isInverse == false &&
            UA_NodeId_equal(&node->references[i].referenceTypeId, &hasSubType))
             return true;
@@ -250,8 +487,45 @@ UA_Node_hasSubTypeOrInstances(const UA_Node *node) {
     return false;
 }
 
+#ifdef UA_ENABLE_MULTITHREADING
+/* Value writes are checked against the constraints of the node version they
+ * have seen. When the constraints change, the value cell is locked until the
+ * node is replaced and the current value is checked against the new
+ * constraints. Writers wait for the lock and recheck. */
+static UA_StatusCode
+lockValueConstraints(UA_Server *server, const UA_Node *copy,
+                     UA_ValueCellVersion **locked) {
+    if(copy->nodeClass != UA_NODECLASS_VARIABLE &&
+       copy->nodeClass != UA_NODECLASS_VARIABLETYPE)
+        return UA_STATUSCODE_GOOD;
+    const UA_VariableNode *vn = (const UA_VariableNode*)copy;
+    if(!vn->valueCell)
+        return UA_STATUSCODE_GOOD;
+    const UA_VariableNode *stored = (const UA_VariableNode*)
+        UA_NodeStore_get(server->nodestore, &copy->nodeId);
+    if(!stored || UA_VariableNode_sameConstraints(vn, stored))
+        return UA_STATUSCODE_GOOD;
+    UA_ValueCellVersion *version = UA_ValueCell_lock(vn->valueCell);
+    if(!version)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    if(version->value.hasValue) {
+        UA_StatusCode retval =
+            typeCheckValue(server, &vn->dataType, vn->valueRank,
+                           vn->arrayDimensionsSize, vn->arrayDimensions,
+                           &version->value.value, NULL, NULL);
+        if(retval != UA_STATUSCODE_GOOD) {
+            UA_ValueCell_unlock(version);
+            return retval;
+        }
+    }
+    *locked = version;
+    return UA_STATUSCODE_GOOD;
+}
+#endif
+
 /* For mulithreading: make a copy of the node, edit and replace.
- * For singletrheading: edit the original */
+ * For singletrheading: edit the original. Nodes from a read-only image are
+ * always copied. */
 UA_StatusCode
 UA_Server_editNode(UA_Server *server, UA_Session *session,
                    const UA_NodeId *nodeId, UA_EditNodeCallback callback,
@@ -260,21 +534,233 @@ UA_Server_editNode(UA_Server *server, UA_Session *session,
     const UA_Node *node = UA_NodeStore_get(server->nodestore, nodeId);
     if(!node)
         return UA_STATUSCODE_BADNODEIDUNKNOWN;
-    UA_Node *editNode = (UA_Node*)(uintptr_t)node; // dirty cast
-    return callback(server, session, editNode, data);
+    if(!UA_NodeStore_isImmutable(server->nodestore, node)) {
+        UA_Node *editNode = (UA_Node*)(uintptr_t)node; // dirty cast
+        ++editNode->version;
+        return callback(server, session, editNode, data);
+    }
+    UA_Node *copy = UA_NodeStore_getCopy(server->nodestore, nodeId);
+    if(!copy)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    ++copy->version;
+    UA_StatusCode retval = callback(server, session, copy, data);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_NodeStore_deleteNode(server->nodestore, copy);
+        return retval;
+    }
+    UA_Server_beginNodesChange(server);
+    retval = UA_NodeStore_replace(server->nodestore, copy);
+    UA_Server_endNodesChange(server);
+    return retval;
 #else
     UA_StatusCode retval;
     do {
         UA_Node *copy = UA_NodeStore_getCopy(server->nodestore, nodeId);
         if(!copy)
             return UA_STATUSCODE_BADOUTOFMEMORY;
+        ++copy->version;
         retval = callback(server, session, copy, data);
+        UA_ValueCellVersion *locked = NULL;
+        if(retval == UA_STATUSCODE_GOOD)
+            retval = lockValueConstraints(server, copy, &locked);
         if(retval != UA_STATUSCODE_GOOD) {
-            UA_NodeStore_deleteNode(copy);
+            UA_NodeStore_deleteNode(server->nodestore, copy);
             return retval;
         }
+        UA_Server_beginNodesChange(server);
         retval = UA_NodeStore_replace(server->nodestore, copy);
+        UA_Server_endNodesChange(server);
+        if(locked)
+            UA_ValueCell_unlock(locked);
     } while(retval != UA_STATUSCODE_GOOD);
     return UA_STATUSCODE_GOOD;
 #endif
 }
+
+/***********************/
+/* Nodestore Interface */
+/***********************/
+
+UA_NodeStore *
+UA_NodeStore_new(void) {
+    return UA_NodeStore_newWithInterface(&UA_NodeStoreInterface_default);
+}
+
+UA_NodeStore *
+UA_NodeStore_newWithInterface(const UA_NodeStoreInterface *interface) {
+    UA_NodeStore *ns = UA_malloc(sizeof(UA_NodeStore));
+    if(!ns)
+        return NULL;
+    ns->interface = *interface;
+    ns->handle = interface->newNodeStore();
+    if(!ns->handle) {
+        UA_free(ns);
+        return NULL;
+    }
+    return ns;
+}
+
+void
+UA_NodeStore_delete(UA_NodeStore *ns) {
+    ns->interface.deleteNodeStore(ns->handle);
+    UA_free(ns);
+}
+
+UA_StatusCode
+UA_NodeStore_linkImage(UA_NodeStore *ns, const UA_NodeStoreImage *image) {
+    if(ns->interface.linkImage)
+        return ns->interface.linkImage(ns->handle, image);
+
+    /* Copy the nodes into the nodestore */
+    for(size_t i = 0; i < image->nodesSize; ++i) {
+        const UA_Node *node = image->nodes[i];
+        UA_Node *copy = UA_NodeStore_newNode(ns, node->nodeClass);
+        if(!copy)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        UA_StatusCode retval = UA_Node_copyAnyNodeClass(node, copy);
+        if(retval != UA_STATUSCODE_GOOD) {
+            UA_NodeStore_deleteNode(ns, copy);
+            return retval;
+        }
+        retval = UA_NodeStore_insert(ns, copy);
+        if(retval != UA_STATUSCODE_GOOD && retval != UA_STATUSCODE_BADNODEIDEXISTS)
+            return retval;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+/*******************/
+/* Nodestore Image */
+/*******************/
+
+int
+UA_NodeStoreImage_order(const UA_NodeId *n1, const UA_NodeId *n2) {
+    if(n1->namespaceIndex != n2->namespaceIndex)
+        return (n1->namespaceIndex < n2->namespaceIndex) ? -1 : 1;
+    if(n1->identifierType != n2->identifierType)
+        return (n1->identifierType < n2->identifierType) ? -1 : 1;
+    switch(n1->identifierType) {
+    case UA_NODEIDTYPE_NUMERIC:
+        if(n1->identifier.numeric == n2->identifier.numeric)
+            return 0;
+        return (n1->identifier.numeric < n2->identifier.numeric) ? -1 : 1;
+    case UA_NODEIDTYPE_GUID:
+        return memcmp(&n1->identifier.guid, &n2->identifier.guid, sizeof(UA_Guid));
+    default: {
+        const UA_String *s1 = &n1->identifier.string;
+        const UA_String *s2 = &n2->identifier.string;
+        if(s1->length != s2->length)
+            return (s1->length < s2->length) ? -1 : 1;
+        if(s1->length == 0)
+            return 0;
+        return memcmp(s1->data, s2->data, s1->length);
+    }
+    }
+}
+
+const UA_Node *
+UA_NodeStoreImage_find(const UA_NodeStoreImage *image, const UA_NodeId *nodeid,
+                       size_t *index) {
+    size_t low = 0;
+    size_t high = image->nodesSize;
+    while(low < high) {
+        size_t mid = low + ((high - low) / 2);
+        const UA_Node *node = image->nodes[mid];
+        int order = UA_NodeStoreImage_order(&node->nodeId, nodeid);
+        if(order == 0) {
+            if(index)
+                *index = mid;
+            return node;
+        }
+        if(order < 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return NULL;
+}
+
+void
+UA_NodeStoreImages_init(UA_NodeStoreImages *images) {
+    images->imagesSize = 0;
+    images->images = NULL;
+    images->removed = NULL;
+}
+
+void
+UA_NodeStoreImages_deleteMembers(UA_NodeStoreImages *images) {
+    for(size_t i = 0; i < images->imagesSize; ++i)
+        UA_free((void*)(uintptr_t)images->removed[i]);
+    UA_free(images->removed);
+    UA_free(images->images);
+    UA_NodeStoreImages_init(images);
+}
+
+UA_StatusCode
+UA_NodeStoreImages_link(UA_NodeStoreImages *images, const UA_NodeStoreImage *image) {
+    size_t size = images->imagesSize;
+    const UA_NodeStoreImage **nimages =
+        UA_realloc(images->images, sizeof(UA_NodeStoreImage*) * (size + 1));
+    if(!nimages)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    images->images = nimages;
+    volatile UA_UInt32 **nremoved =
+        UA_realloc(images->removed, sizeof(UA_UInt32*) * (size + 1));
+    if(!nremoved)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    images->removed = nremoved;
+    nremoved[size] = UA_calloc(image->nodesSize, sizeof(UA_UInt32));
+    if(!nremoved[size] && image->nodesSize > 0)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    nimages[size] = image;
+    images->imagesSize = size + 1;
+
+    /* Hide the nodes of the earlier images that are not in the complete image */
+    if(!image->complete)
+        return UA_STATUSCODE_GOOD;
+    for(size_t i = 0; i < size; ++i) {
+        for(size_t j = 0; j < nimages[i]->nodesSize; ++j) {
+            if(!UA_NodeStoreImage_find(image, &nimages[i]->nodes[j]->nodeId, NULL))
+                images->removed[i][j] = 1;
+        }
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+const UA_Node *
+UA_NodeStoreImages_find(const UA_NodeStoreImages *images, const UA_NodeId *nodeid) {
+    for(size_t i = images->imagesSize; i > 0; --i) {
+        size_t index;
+        const UA_Node *node = UA_NodeStoreImage_find(images->images[i-1], nodeid, &index);
+        if(node)
+            return images->removed[i-1][index] ? NULL : node;
+    }
+    return NULL;
+}
+
+UA_Boolean
+UA_NodeStoreImages_remove(UA_NodeStoreImages *images, const UA_NodeId *nodeid) {
+    /* The node is visible in the last image that contains the NodeId. Setting
+     * the flag there decides which of concurrent removals hides the node. */
+    UA_Boolean found = false;
+    UA_Boolean visible = false;
+    for(size_t i = images->imagesSize; i > 0; --i) {
+        size_t index;
+        if(!UA_NodeStoreImage_find(images->images[i-1], nodeid, &index))
+            continue;
+        UA_UInt32 old = UA_atomic_cmpxchg32(&images->removed[i-1][index], 0, 1);
+        if(!found)
+            visible = (old == 0);
+        found = true;
+    }
+    return visible;
+}
+
+UA_Boolean
+UA_NodeStoreImages_contains(const UA_NodeStoreImages *images, const UA_Node *node) {
+    for(size_t i = 0; i < images->imagesSize; ++i) {
+        if(UA_NodeStoreImage_find(images->images[i], &node->nodeId, NULL) == node)
+            return true;
+    }
+    return false;
+}
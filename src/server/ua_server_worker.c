@@ -17,19 +17,35 @@
  * iteration. This is used e.g. to trigger adding and removing repeated jobs without blocking the
  * mainloop.
  *
- * 4. Delayed jobs are executed once in a worker thread. But only when all normal jobs that were
+ * 4. Delayed jobs are executed once in the main loop. But only when all normal jobs that were
  * dispatched earlier have been executed. This is achieved by a counter in the worker threads. We
- * compute from the counter if all previous jobs have finished. The delay can be very long, since we
- * try to not interfere too much with normal execution. A use case is to eventually free obsolete
- * structures that _could_ still be accessed from concurrent threads.
+ * compute from the counter if all previous jobs have finished. The check is done in every mainloop
+ * iteration, so the delay is bounded by the runtime of the jobs that were dispatched before. A
+ * configurable budget limits the number of delayed jobs processed per iteration. A use case is to
+ * eventually free obsolete structures that _could_ still be accessed from concurrent threads.
  *
  * - Remove the entry from the list
  * - mark it as "dead" with an atomic operation
  * - add a delayed job that frees the memory when all concurrent operations have completed
  *
- * This approach to concurrently accessible memory is known as epoch based reclamation [1]. According to
- * [2], it performs competitively well on many-core systems. Our version of EBR does however not require
- * a global epoch. Instead, every worker thread has its own epoch counter that we observe for changes.
+ * This approach to concurrently accessible memory is a variant of epoch based reclamation [1] known
+ * as quiescent state based reclamation (QSBR). According to [2], it performs competitively well on
+ * many-core systems. Our version does not require a global epoch. Every worker thread has its own
+ * counter that is increased after every job. A worker is quiescent once its counter has moved or when
+ * it waits idle for new jobs.
+ *
+ * Jobs that are dispatched to the worker threads are sorted into queues per
+ * priority class. Workers always take the next job from the highest-priority
+ * queue that is not empty. So bulk service requests do not delay sampling and
+ * publishing. The priority class of a job is taken from the server config.
+ * Internal housekeeping jobs (e.g. the cleanup of timed-out sessions) run in
+ * the background class.
+ *
+ * Service requests with many items (e.g. a Read of many nodes) are split into
+ * ranges of items. The thread that processes the request enqueues helpers for
+ * the idle workers and then takes ranges itself until none is left
+ * (fork-join). Workers take the helpers before all other jobs. So the request
+ * that is already in progress is finished first.
  *
  * [1] Fraser, K. 2003. Practical lock freedom. Ph.D. thesis. Computer Laboratory, University of Cambridge.
  * [2] Hart, T. E., McKenney, P. E., Brown, A. D., & Walpole, J. (2007). Performance of memory reclamation
@@ -40,7 +56,26 @@
  *     memory models." ACM SIGPLAN Notices. Vol. 48. No. 8. ACM, 2013.
  */
 
-#define MAXTIMEOUT 50 // max timeout in millisec until the next main loop iteration
+#define MAXTIMEOUT 50 // max timeout in millisec if the networklayer cannot be woken up
+
+/* Called from the thread that owns the counters */
+static void
+countJob(UA_JobCounters *counters, UA_DateTime waitTime) {
+    if(waitTime < 0)
+        waitTime = 0;
+    ++counters->processed;
+    counters->waitTime += waitTime;
+    if(waitTime > counters->maxWaitTime)
+        counters->maxWaitTime = waitTime;
+}
+
+static void
+sumJobCounters(UA_JobCounters *sum, const UA_JobCounters *counters) {
+    sum->processed += counters->processed;
+    sum->waitTime += counters->waitTime;
+    if(counters->maxWaitTime > sum->maxWaitTime)
+        sum->maxWaitTime = counters->maxWaitTime;
+}
 
 static void
 processJob(UA_Server *server, UA_Job *job) {
@@ -88,12 +123,152 @@ struct MainLoopJob {
 
 struct DispatchJob {
     struct cds_wfcq_node node; // node for the queue
+    UA_DateTime due; // monotonic time when the job was due for dispatch
+    UA_JobPriority priority;
     UA_Job job;
 };
 
+/* Take the next job from the highest-priority queue that is not empty */
+static struct DispatchJob *
+dequeueJob(UA_Server *server) {
+    for(size_t i = 0; i < UA_JOBPRIORITIESSIZE; ++i) {
+        if(cds_wfcq_empty(&server->dispatchQueue_head[i], &server->dispatchQueue_tail[i]))
+            continue;
+        struct DispatchJob *dj = (struct DispatchJob*)
+            cds_wfcq_dequeue_blocking(&server->dispatchQueue_head[i],
+                                      &server->dispatchQueue_tail[i]);
+        if(dj)
+            return dj;
+    }
+    return NULL;
+}
+
+/* Range processing for large service requests. The ranges are claimed with an
+ * atomic counter. The caller waits until all ranges are done. But not until
+ * all helpers were dequeued, as the workers may be busy with other jobs. So
+ * the structure is freed with the last reference. */
+struct ForkJoin;
+
+struct ForkHelper {
+    struct cds_wfcq_node node; // node for the queue
+    struct ForkJoin *fj;
+};
+
+struct ForkJoin {
+    UA_Server *server;
+    UA_ServiceItemCallback callback;
+    void *context;
+    size_t itemsSize;
+    size_t rangeSize;
+    UA_UInt32 rangesSize;
+    UA_UInt32 nextRange;
+    UA_UInt32 doneRanges;
+    UA_UInt32 refs;
+    UA_Boolean done; /* protected by the mutex */
+    pthread_mutex_t mutex;
+    pthread_cond_t condition;
+    struct ForkHelper helpers[];
+};
+
+static void
+releaseForkJoin(struct ForkJoin *fj) {
+    if(UA_atomic_add(&fj->refs, (UA_UInt32)-1) != 0)
+        return;
+    pthread_mutex_destroy(&fj->mutex);
+    pthread_cond_destroy(&fj->condition);
+    UA_free(fj);
+}
+
+/* Process ranges until none is left. The callback and context are not
+ * accessed once all ranges are claimed. */
+static void
+processRanges(struct ForkJoin *fj) {
+    while(true) {
+        UA_UInt32 range = UA_atomic_add(&fj->nextRange, 1) - 1;
+        if(range >= fj->rangesSize)
+            return;
+        size_t begin = range * fj->rangeSize;
+        size_t end = begin + fj->rangeSize;
+        if(end > fj->itemsSize)
+            end = fj->itemsSize;
+        for(size_t i = begin; i < end; ++i)
+            fj->callback(fj->server, fj->context, i);
+        if(UA_atomic_add(&fj->doneRanges, 1) == fj->rangesSize) {
+            pthread_mutex_lock(&fj->mutex);
+            fj->done = true;
+            pthread_cond_signal(&fj->condition);
+            pthread_mutex_unlock(&fj->mutex);
+        }
+    }
+}
+
+static struct ForkHelper *
+dequeueForkHelper(UA_Server *server) {
+    if(cds_wfcq_empty(&server->forkQueue_head, &server->forkQueue_tail))
+        return NULL;
+    return (struct ForkHelper*)
+        cds_wfcq_dequeue_blocking(&server->forkQueue_head, &server->forkQueue_tail);
+}
+
+static void
+processForkHelper(struct ForkHelper *helper) {
+    struct ForkJoin *fj = helper->fj;
+    UA_RCU_LOCK();
+    processRanges(fj);
+    UA_RCU_UNLOCK();
+    releaseForkJoin(fj);
+}
+
+struct WorkerStartup {
+    UA_Server *server;
+    size_t index;
+};
+
+/* Pin the thread before the worker structure is allocated. With the
+ * first-touch policy of the OS, the memory is then placed on the NUMA node of
+ * the worker. */
+static UA_Worker *
+newWorker(UA_Server *server, size_t index) {
+    UA_Boolean pinned = false;
+    if(server->config.workerCpuSetsSize > 0) {
+        const UA_CpuSet *cpuSet =
+            &server->config.workerCpuSets[index % server->config.workerCpuSetsSize];
+        if(UA_Thread_setAffinity(cpuSet) == UA_STATUSCODE_GOOD)
+            pinned = true;
+        else
+            UA_LOG_WARNING(server->config.logger, UA_LOGCATEGORY_SERVER,
+                           "Could not pin worker %u to its CPU set", (unsigned)index);
+    }
+
+    UA_Worker *worker = UA_malloc(sizeof(UA_Worker));
+    if(!worker)
+        return NULL;
+    memset(worker, 0, sizeof(UA_Worker));
+    worker->server = server;
+    worker->running = true;
+    UA_Thread_getPlacement(&worker->placement);
+    worker->placement.pinned = pinned;
+    UA_LOG_DEBUG(server->config.logger, UA_LOGCATEGORY_SERVER,
+                 "Worker %u runs on CPU %i (NUMA node %i)", (unsigned)index,
+                 worker->placement.cpu, worker->placement.numaNode);
+    return worker;
+}
+
 static void *
-workerLoop(UA_Worker *worker) {
-    UA_Server *server = worker->server;
+workerLoop(struct WorkerStartup *startup) {
+    UA_Server *server = startup->server;
+    UA_Worker *worker = newWorker(server, startup->index);
+
+    /* Announce the worker to the main loop. The startup structure is freed
+     * from there. */
+    pthread_mutex_lock(&server->dispatchQueue_mutex);
+    server->workers[startup->index] = worker;
+    ++server->workersStarted;
+    pthread_cond_broadcast(&server->dispatchQueue_condition);
+    pthread_mutex_unlock(&server->dispatchQueue_mutex);
+    if(!worker)
+        return NULL;
+
     UA_UInt32 *counter = &worker->counter;
     volatile UA_Boolean *running = &worker->running;
 
@@ -102,15 +277,21 @@ workerLoop(UA_Worker *worker) {
     rcu_register_thread();
 
     while(*running) {
-        struct DispatchJob *dj = (struct DispatchJob*)
-            cds_wfcq_dequeue_blocking(&server->dispatchQueue_head, &server->dispatchQueue_tail);
-        if(dj) {
+        struct ForkHelper *helper = dequeueForkHelper(server);
+        struct DispatchJob *dj = NULL;
+        if(helper) {
+            processForkHelper(helper);
+        } else if((dj = dequeueJob(server))) {
+            countJob(&worker->jobCounters[dj->priority],
+                     UA_DateTime_nowMonotonic() - dj->due);
             processJob(server, &dj->job);
             UA_free(dj);
         } else {
             /* nothing to do. sleep until a job is dispatched (and wakes up all worker threads) */
             pthread_mutex_lock(&server->dispatchQueue_mutex);
+            worker->idle = true;
             pthread_cond_wait(&server->dispatchQueue_condition, &server->dispatchQueue_mutex);
+            worker->idle = false;
             pthread_mutex_unlock(&server->dispatchQueue_mutex);
         }
         UA_atomic_add(counter, 1);
@@ -123,26 +304,119 @@ workerLoop(UA_Worker *worker) {
     return NULL;
 }
 
+/* Call only from the main loop */
 static void
-dispatchJob(UA_Server *server, const UA_Job *job) {
+dispatchJob(UA_Server *server, const UA_Job *job, UA_JobPriority priority, UA_DateTime due) {
     struct DispatchJob *dj = UA_malloc(sizeof(struct DispatchJob));
+    if(!dj) {
+        UA_LOG_ERROR(server->config.logger, UA_LOGCATEGORY_SERVER,
+                     "Not enough memory to dispatch a job");
+        return;
+    }
     dj->job = *job;
+    dj->due = due;
+    dj->priority = priority;
     cds_wfcq_node_init(&dj->node);
-    cds_wfcq_enqueue(&server->dispatchQueue_head, &server->dispatchQueue_tail, &dj->node);
+    cds_wfcq_enqueue(&server->dispatchQueue_head[priority],
+                     &server->dispatchQueue_tail[priority], &dj->node);
+    ++server->dispatchedJobs[priority];
 }
 
 static void
 emptyDispatchQueue(UA_Server *server) {
-    while(!cds_wfcq_empty(&server->dispatchQueue_head, &server->dispatchQueue_tail)) {
-        struct DispatchJob *dj = (struct DispatchJob*)
-            cds_wfcq_dequeue_blocking(&server->dispatchQueue_head, &server->dispatchQueue_tail);
+    /* Helpers that were not dequeued before the workers stopped */
+    struct ForkHelper *helper;
+    while((helper = dequeueForkHelper(server)))
+        processForkHelper(helper);
+
+    struct DispatchJob *dj;
+    while((dj = dequeueJob(server))) {
+        countJob(&server->jobCounters[dj->priority],
+                 UA_DateTime_nowMonotonic() - dj->due);
         processJob(server, &dj->job);
         UA_free(dj);
     }
 }
 
+/* Wakes up the main loop so that the job is executed without waiting for the
+ * next network event */
+UA_StatusCode
+UA_Server_addMainLoopJob(UA_Server *server, const UA_Job *job) {
+    struct MainLoopJob *mlw = UA_malloc(sizeof(struct MainLoopJob));
+    if(!mlw)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    mlw->job = *job;
+    cds_lfs_push(&server->mainLoopJobs, &mlw->node);
+    UA_Server_wakeup(server);
+    return UA_STATUSCODE_GOOD;
+}
+
 #endif
 
+/*****************************/
+/* Intra-request Parallelism */
+/*****************************/
+
+#define MINRANGESIZE 32 /* Minimum number of items in a range */
+#define RANGESPERTHREAD 4 /* Smaller ranges balance the load between threads */
+
+void
+UA_Server_processItems(UA_Server *server, size_t itemsSize,
+                       UA_ServiceItemCallback callback, void *context) {
+#ifdef UA_ENABLE_MULTITHREADING
+    /* Fork only with running workers and enough items for the ranges */
+    UA_UInt32 threshold = server->config.parallelItemsThreshold;
+    size_t rangesSize = itemsSize / MINRANGESIZE;
+    size_t maxRangesSize = ((size_t)server->config.nThreads + 1) * RANGESPERTHREAD;
+    if(rangesSize > maxRangesSize)
+        rangesSize = maxRangesSize;
+    if(!server->workers || threshold == 0 || itemsSize < threshold || rangesSize < 2)
+        goto serial;
+    size_t helpersSize = server->config.nThreads;
+    if(helpersSize > rangesSize - 1)
+        helpersSize = rangesSize - 1;
+
+    struct ForkJoin *fj =
+        UA_malloc(sizeof(struct ForkJoin) + (helpersSize * sizeof(struct ForkHelper)));
+    if(!fj)
+        goto serial;
+    fj->server = server;
+    fj->callback = callback;
+    fj->context = context;
+    fj->itemsSize = itemsSize;
+    fj->rangeSize = (itemsSize + rangesSize - 1) / rangesSize;
+    fj->rangesSize = (UA_UInt32)((itemsSize + fj->rangeSize - 1) / fj->rangeSize);
+    fj->nextRange = 0;
+    fj->doneRanges = 0;
+    fj->refs = (UA_UInt32)helpersSize + 1;
+    fj->done = false;
+    pthread_mutex_init(&fj->mutex, NULL);
+    pthread_cond_init(&fj->condition, NULL);
+
+    /* Fork */
+    for(size_t i = 0; i < helpersSize; ++i) {
+        fj->helpers[i].fj = fj;
+        cds_wfcq_node_init(&fj->helpers[i].node);
+        cds_wfcq_enqueue(&server->forkQueue_head, &server->forkQueue_tail,
+                         &fj->helpers[i].node);
+    }
+    pthread_cond_broadcast(&server->dispatchQueue_condition);
+
+    /* Join */
+    processRanges(fj);
+    pthread_mutex_lock(&fj->mutex);
+    while(!fj->done)
+        pthread_cond_wait(&fj->condition, &fj->mutex);
+    pthread_mutex_unlock(&fj->mutex);
+    releaseForkJoin(fj);
+    return;
+
+ serial:
+#endif
+    for(size_t i = 0; i < itemsSize; ++i)
+        callback(server, context, i);
+}
+
 /*****************/
 /* Repeated Jobs */
 /*****************/
@@ -153,6 +427,7 @@ struct RepeatedJob {
     UA_DateTime nextTime;          /* The next time when the jobs are to be executed */
     UA_UInt64 interval;            /* Interval in 100ns resolution */
     UA_Guid id;                    /* Id of the repeated job */
+    UA_JobPriority priority;       /* Priority class for the dispatch */
     UA_Job job;                    /* The job description itself */
 };
 
@@ -190,6 +465,17 @@ addRepeatedJob(UA_Server *server, struct RepeatedJob * UA_RESTRICT rj) {
 UA_StatusCode
 UA_Server_addRepeatedJob(UA_Server *server, UA_Job job,
                          UA_UInt32 interval, UA_Guid *jobId) {
+    return UA_Server_addRepeatedJobWithPriority(server, job, interval,
+                                                server->config.repeatedJobPriority,
+                                                jobId);
+}
+
+UA_StatusCode
+UA_Server_addRepeatedJobWithPriority(UA_Server *server, UA_Job job, UA_UInt32 interval,
+                                     UA_JobPriority priority, UA_Guid *jobId) {
+    if(priority >= UA_JOBPRIORITIESSIZE)
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+
     /* the interval needs to be at least 5ms */
     if(interval < 5)
         return UA_STATUSCODE_BADINTERNALERROR;
@@ -204,19 +490,18 @@ UA_Server_addRepeatedJob(UA_Server *server, UA_Job job,
      * rj->nextTime = UA_DateTime_nowMonotonic() + interval_dt; */
     rj->interval = interval_dt;
     rj->id = UA_Guid_random();
+    rj->priority = priority;
     rj->job = job;
 
 #ifdef UA_ENABLE_MULTITHREADING
     /* Call addRepeatedJob from the main loop */
-    struct MainLoopJob *mlw = UA_malloc(sizeof(struct MainLoopJob));
-    if(!mlw) {
+    UA_Job mlj = (UA_Job) {
+        .type = UA_JOBTYPE_METHODCALL,
+        .job.methodCall = {.data = rj, .method = (void (*)(UA_Server*, void*))addRepeatedJob}};
+    if(UA_Server_addMainLoopJob(server, &mlj) != UA_STATUSCODE_GOOD) {
         UA_free(rj);
         return UA_STATUSCODE_BADOUTOFMEMORY;
     }
-    mlw->job = (UA_Job) {
-        .type = UA_JOBTYPE_METHODCALL,
-        .job.methodCall = {.data = rj, .method = (void (*)(UA_Server*, void*))addRepeatedJob}};
-    cds_lfs_push(&server->mainLoopJobs, &mlw->node);
 #else
     /* Add directly */
     addRepeatedJob(server, rj);
@@ -227,9 +512,8 @@ UA_Server_addRepeatedJob(UA_Server *server, UA_Job job,
 }
 
 /* - Dispatches all repeated jobs that have timed out
- * - Reinserts dispatched job at their new position in the sorted list
- * - Returns the next datetime when a repeated job is scheduled */
-static UA_DateTime
+ * - Reinserts dispatched job at their new position in the sorted list */
+static void
 processRepeatedJobs(UA_Server *server, UA_DateTime current, UA_Boolean *dispatched) {
     /* Find the last job that is executed in this iteration */
     struct RepeatedJob *lastNow = NULL, *tmp;
@@ -253,10 +537,12 @@ processRepeatedJobs(UA_Server *server, UA_DateTime current, UA_Boolean *dispatch
 
         /* Dispatch/process job */
 #ifdef UA_ENABLE_MULTITHREADING
-        dispatchJob(server, &rj->job);
+        dispatchJob(server, &rj->job, rj->priority, rj->nextTime);
         *dispatched = true;
 #else
         struct RepeatedJob **previousNext = rj->next.le_prev;
+        countJob(&server->jobCounters[rj->priority],
+                 UA_DateTime_nowMonotonic() - rj->nextTime);
         processJob(server, &rj->job);
         /* See if the current job was deleted during processJob. That means the
          * le_next field of the previous repeated job (could also be the list
@@ -305,13 +591,21 @@ processRepeatedJobs(UA_Server *server, UA_DateTime current, UA_Boolean *dispatch
         /* Update last_dispatched and loop */
         last_dispatched = rj;
     }
+}
 
-    /* Check if the next repeated job is sooner than the usual timeout */
+/* Returns the time until the next repeated job is due (in millisec).
+ * UA_UINT16_MAX denotes that no repeated job is scheduled. */
+static UA_UInt16
+nextRepeatedJobTimeout(UA_Server *server, UA_DateTime now) {
     struct RepeatedJob *first = LIST_FIRST(&server->repeatedJobs);
-    UA_DateTime next = current + (MAXTIMEOUT * UA_MSEC_TO_DATETIME);
-    if(first && first->nextTime < next)
-        next = first->nextTime;
-    return next;
+    if(!first)
+        return UA_UINT16_MAX;
+    if(first->nextTime <= now)
+        return 0;
+    UA_DateTime timeout = (first->nextTime - now) / UA_MSEC_TO_DATETIME;
+    if(timeout >= UA_UINT16_MAX)
+        return UA_UINT16_MAX - 1;
+    return (UA_UInt16)timeout;
 }
 
 /* Call this function only from the main loop! */
@@ -337,11 +631,13 @@ UA_StatusCode UA_Server_removeRepeatedJob(UA_Server *server, UA_Guid jobId) {
         return UA_STATUSCODE_BADOUTOFMEMORY;
     *idptr = jobId;
     // dispatch to the mainloopjobs stack
-    struct MainLoopJob *mlw = UA_malloc(sizeof(struct MainLoopJob));
-    mlw->job = (UA_Job) {
+    UA_Job mlj = (UA_Job) {
         .type = UA_JOBTYPE_METHODCALL,
         .job.methodCall = {.data = idptr, .method = (void (*)(UA_Server*, void*))removeRepeatedJob}};
-    cds_lfs_push(&server->mainLoopJobs, &mlw->node);
+    if(UA_Server_addMainLoopJob(server, &mlj) != UA_STATUSCODE_GOOD) {
+        UA_free(idptr);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
 #else
     removeRepeatedJob(server, &jobId);
 #endif
@@ -360,10 +656,25 @@ void UA_Server_deleteAllRepeatedJobs(UA_Server *server) {
 /* Delayed Jobs */
 /****************/
 
+/* Called from the main loop when a delayed job has been processed */
+static void
+countReclaimed(UA_Server *server, size_t size, UA_DateTime added) {
+    UA_ReclamationCounters *rc = &server->reclamationCounters;
+    --rc->pendingJobs;
+    rc->pendingBytes -= size;
+    ++rc->reclaimedJobs;
+    rc->reclaimedBytes += size;
+    UA_DateTime latency = UA_DateTime_nowMonotonic() - added;
+    if(latency > rc->maxLatency)
+        rc->maxLatency = latency;
+}
+
 #ifndef UA_ENABLE_MULTITHREADING
 
 typedef struct UA_DelayedJob {
     SLIST_ENTRY(UA_DelayedJob) next;
+    UA_DateTime added;
+    size_t size;
     UA_Job job;
 } UA_DelayedJob;
 
@@ -372,10 +683,13 @@ UA_Server_delayedCallback(UA_Server *server, UA_ServerCallback callback, void *d
     UA_DelayedJob *dj = UA_malloc(sizeof(UA_DelayedJob));
     if(!dj)
         return UA_STATUSCODE_BADOUTOFMEMORY;
+    dj->added = UA_DateTime_nowMonotonic();
+    dj->size = 0;
     dj->job.type = UA_JOBTYPE_METHODCALL;
     dj->job.job.methodCall.data = data;
     dj->job.job.methodCall.method = callback;
     SLIST_INSERT_HEAD(&server->delayedCallbacks, dj, next);
+    ++server->reclamationCounters.pendingJobs;
     return UA_STATUSCODE_GOOD;
 }
 
@@ -384,58 +698,75 @@ processDelayedCallbacks(UA_Server *server) {
     UA_DelayedJob *dj, *dj_tmp;
     SLIST_FOREACH_SAFE(dj, &server->delayedCallbacks, next, dj_tmp) {
         SLIST_REMOVE(&server->delayedCallbacks, dj, UA_DelayedJob, next);
+        countJob(&server->jobCounters[UA_JOBPRIORITY_BACKGROUND], 0);
         processJob(server, &dj->job);
+        countReclaimed(server, dj->size, dj->added);
         UA_free(dj);
     }
 }
 
 #else
 
-#define DELAYEDJOBSSIZE 100 // Collect delayed jobs until we have DELAYEDWORKSIZE items
+/* Delayed jobs are collected in batches. A batch is sealed in the main loop
+ * iteration after the jobs were added. Then, the number of jobs dispatched so
+ * far is noted for every priority class. Once the workers have dequeued that
+ * many jobs, the jobs that could still hold references are either in
+ * processing or done. We take a snapshot of the worker counters and wait until
+ * every worker has moved on or waits idle for new jobs (quiescent state). Then
+ * the delayed jobs of the batch are processed in the main loop. */
+
+#define DELAYEDJOBSSIZE 100 // Max. number of delayed jobs in a batch
+
+typedef struct {
+    UA_Job job;
+    size_t size; /* Memory freed by the job (for the statistics) */
+} UA_DelayedJob;
 
 struct DelayedJobs {
-    struct DelayedJobs *next;
-    UA_UInt32 *workerCounters; // initially NULL until the counter are set
-    UA_UInt32 jobsCount; // the size of the array is DELAYEDJOBSSIZE, the count may be less
-    UA_Job jobs[DELAYEDJOBSSIZE]; // when it runs full, a new delayedJobs entry is created
+    SIMPLEQ_ENTRY(DelayedJobs) next;
+    UA_DateTime added; /* When the first job was added */
+    UA_UInt64 dispatched[UA_JOBPRIORITIESSIZE]; /* Dispatch counts when sealed */
+    UA_UInt32 *workerCounters; /* NULL until all earlier jobs were dequeued */
+    size_t jobsCount;
+    size_t jobsProcessed; /* The budget may stop processing within a batch */
+    UA_DelayedJob jobs[DELAYEDJOBSSIZE];
 };
 
-/* Dispatched as an ordinary job when the DelayedJobs list is full */
-static void getCounters(UA_Server *server, struct DelayedJobs *delayed) {
-    UA_UInt32 *counters = UA_malloc(server->config.nThreads * sizeof(UA_UInt32));
-    for(UA_UInt16 i = 0; i < server->config.nThreads; ++i)
-        counters[i] = server->workers[i].counter;
-    delayed->workerCounters = counters;
+/* Note the current dispatch counts for the open batch. Jobs added from now on
+ * go into a new batch. */
+static void
+sealDelayedJobs(UA_Server *server) {
+    struct DelayedJobs *dj = server->delayedJobsOpen;
+    if(!dj)
+        return;
+    memcpy(dj->dispatched, server->dispatchedJobs, sizeof(dj->dispatched));
+    server->delayedJobsOpen = NULL;
 }
 
-/* Call from the main thread only. This is the only function that modifies */
-/* server->delayedWork. processDelayedWorkQueue modifies the "next" (after the */
-/* head). */
-static void addDelayedJob(UA_Server *server, UA_Job *job) {
-    struct DelayedJobs *dj = server->delayedJobs;
+/* Call from the main loop only */
+static void
+addDelayedJob(UA_Server *server, const UA_Job *job, size_t size) {
+    struct DelayedJobs *dj = server->delayedJobsOpen;
     if(!dj || dj->jobsCount >= DELAYEDJOBSSIZE) {
-        /* create a new DelayedJobs and add it to the linked list */
+        sealDelayedJobs(server);
         dj = UA_malloc(sizeof(struct DelayedJobs));
         if(!dj) {
             UA_LOG_ERROR(server->config.logger, UA_LOGCATEGORY_SERVER,
                          "Not enough memory to add a delayed job");
             return;
         }
-        dj->jobsCount = 0;
+        dj->added = UA_DateTime_nowMonotonic();
         dj->workerCounters = NULL;
-        dj->next = server->delayedJobs;
-        server->delayedJobs = dj;
-
-        /* dispatch a method that sets the counter for the full list that comes afterwards */
-        if(dj->next) {
-            UA_Job setCounter = (UA_Job){
-                .type = UA_JOBTYPE_METHODCALL, .job.methodCall =
-                {.method = (void (*)(UA_Server*, void*))getCounters, .data = dj->next}};
-            dispatchJob(server, &setCounter);
-        }
+        dj->jobsCount = 0;
+        dj->jobsProcessed = 0;
+        SIMPLEQ_INSERT_TAIL(&server->delayedJobs, dj, next);
+        server->delayedJobsOpen = dj;
     }
-    dj->jobs[dj->jobsCount] = *job;
+    dj->jobs[dj->jobsCount].job = *job;
+    dj->jobs[dj->jobsCount].size = size;
     ++dj->jobsCount;
+    ++server->reclamationCounters.pendingJobs;
+    server->reclamationCounters.pendingBytes += size;
 }
 
 static void
@@ -443,68 +774,105 @@ delayed_free(UA_Server *server, void *data) {
     UA_free(data);
 }
 
-UA_StatusCode UA_Server_delayedFree(UA_Server *server, void *data) {
-    return UA_Server_delayedCallback(server, delayed_free, data);
+static void
+addDelayedJobAsync(UA_Server *server, UA_DelayedJob *dj) {
+    addDelayedJob(server, &dj->job, dj->size);
+    UA_free(dj);
 }
 
-static void
-addDelayedJobAsync(UA_Server *server, UA_Job *job) {
-    addDelayedJob(server, job);
-    UA_free(job);
+static UA_StatusCode
+addDelayedCallback(UA_Server *server, UA_ServerCallback callback,
+                   void *data, size_t size) {
+    UA_DelayedJob *dj = UA_malloc(sizeof(UA_DelayedJob));
+    if(!dj)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    dj->job.type = UA_JOBTYPE_METHODCALL;
+    dj->job.job.methodCall.data = data;
+    dj->job.job.methodCall.method = callback;
+    dj->size = size;
+    UA_Job mlj = (UA_Job) {.type = UA_JOBTYPE_METHODCALL, .job.methodCall =
+                           {.data = dj, .method = (UA_ServerCallback)addDelayedJobAsync}};
+    if(UA_Server_addMainLoopJob(server, &mlj) != UA_STATUSCODE_GOOD) {
+        UA_free(dj);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_Server_delayedFree(UA_Server *server, void *data, size_t size) {
+    return addDelayedCallback(server, delayed_free, data, size);
 }
 
 UA_StatusCode
 UA_Server_delayedCallback(UA_Server *server, UA_ServerCallback callback, void *data) {
-    UA_Job *j = UA_malloc(sizeof(UA_Job));
-    if(!j)
-        return UA_STATUSCODE_BADOUTOFMEMORY;
-    j->type = UA_JOBTYPE_METHODCALL;
-    j->job.methodCall.data = data;
-    j->job.methodCall.method = callback;
-    struct MainLoopJob *mlw = UA_malloc(sizeof(struct MainLoopJob));
-    mlw->job = (UA_Job) {.type = UA_JOBTYPE_METHODCALL, .job.methodCall =
-                         {.data = j, .method = (UA_ServerCallback)addDelayedJobAsync}};
-    cds_lfs_push(&server->mainLoopJobs, &mlw->node);
-    return UA_STATUSCODE_GOOD;
+    return addDelayedCallback(server, callback, data, 0);
 }
 
-/* Find out which delayed jobs can be executed now */
-static void
-dispatchDelayedJobs(UA_Server *server, void *_) {
-    /* start at the second */
-    struct DelayedJobs *dw = server->delayedJobs, *beforedw = dw;
-    if(dw)
-        dw = dw->next;
-
-    /* find the first delayedwork where the counters have been set and have moved */
-    while(dw) {
-        if(!dw->workerCounters) {
-            beforedw = dw;
-            dw = dw->next;
-            continue;
-        }
-        UA_Boolean allMoved = true;
-        for(size_t i = 0; i < server->config.nThreads; ++i) {
-            if(dw->workerCounters[i] == server->workers[i].counter) {
-                allMoved = false;
-                break;
-            }
+/* The number of jobs that were taken from the dispatch queue */
+static UA_UInt64
+dequeuedJobs(UA_Server *server, size_t priority) {
+    UA_UInt64 dequeued = server->jobCounters[priority].processed;
+    for(size_t i = 0; i < server->config.nThreads; ++i)
+        dequeued += server->workers[i]->jobCounters[priority].processed;
+    return dequeued;
+}
+
+static UA_Boolean
+delayedJobsReady(UA_Server *server, struct DelayedJobs *dj) {
+    if(!server->workers)
+        return true;
+
+    if(!dj->workerCounters) {
+        /* Wait until the jobs dispatched before the batch was sealed have been
+         * taken by a worker */
+        for(size_t i = 0; i < UA_JOBPRIORITIESSIZE; ++i) {
+            if(dequeuedJobs(server, i) < dj->dispatched[i])
+                return false;
         }
-        if(allMoved)
-            break;
-        beforedw = dw;
-        dw = dw->next;
+        UA_UInt32 *counters = UA_malloc(server->config.nThreads * sizeof(UA_UInt32));
+        if(!counters)
+            return false;
+        for(size_t i = 0; i < server->config.nThreads; ++i)
+            counters[i] = server->workers[i]->counter;
+        dj->workerCounters = counters;
+    }
+
+    /* Every worker has finished the job it processed during the snapshot */
+    for(size_t i = 0; i < server->config.nThreads; ++i) {
+        if(dj->workerCounters[i] == server->workers[i]->counter &&
+           !server->workers[i]->idle)
+            return false;
     }
+    return true;
+}
 
-    /* process and free all delayed jobs from here on */
-    while(dw) {
-        for(size_t i = 0; i < dw->jobsCount; ++i)
-            processJob(server, &dw->jobs[i]);
-        struct DelayedJobs *next = UA_atomic_xchg((void**)&beforedw->next, NULL);
-        UA_free(dw->workerCounters);
-        UA_free(dw);
-        dw = next;
+/* Process the delayed jobs that no longer conflict with concurrent workers.
+ * With force, all delayed jobs are processed (after the workers have shut
+ * down). Returns true if jobs are ready but were held back by the budget. */
+static UA_Boolean
+processDelayedJobs(UA_Server *server, UA_Boolean force) {
+    sealDelayedJobs(server);
+    struct DelayedJobs *dj;
+    size_t budget = server->config.reclamationBudget;
+    size_t processed = 0;
+    while((dj = SIMPLEQ_FIRST(&server->delayedJobs))) {
+        if(!force && !delayedJobsReady(server, dj))
+            return false;
+        while(dj->jobsProcessed < dj->jobsCount) {
+            if(!force && budget > 0 && processed >= budget)
+                return true;
+            UA_DelayedJob *j = &dj->jobs[dj->jobsProcessed];
+            ++dj->jobsProcessed;
+            ++processed;
+            processJob(server, &j->job);
+            countReclaimed(server, j->size, dj->added);
+        }
+        SIMPLEQ_REMOVE_HEAD(&server->delayedJobs, next);
+        UA_free(dj->workerCounters);
+        UA_free(dj);
     }
+    return false;
 }
 
 #endif
@@ -530,28 +898,101 @@ static void processMainLoopJobs(UA_Server *server) {
 }
 #endif
 
-UA_StatusCode UA_Server_run_startup(UA_Server *server) {
 #ifdef UA_ENABLE_MULTITHREADING
-    /* Spin up the worker threads */
+/* Stops the worker threads that have been started. Keeps the job statistics of
+ * the workers. */
+static void
+stopWorkers(UA_Server *server) {
+    for(size_t i = 0; i < server->workersStarted; ++i) {
+        if(server->workers[i])
+            server->workers[i]->running = false;
+    }
+    pthread_cond_broadcast(&server->dispatchQueue_condition);
+    for(size_t i = 0; i < server->workersStarted; ++i)
+        pthread_join(server->workerThreads[i], NULL);
+    for(size_t i = 0; i < server->workersStarted; ++i) {
+        UA_Worker *worker = server->workers[i];
+        if(!worker)
+            continue;
+        for(size_t j = 0; j < UA_JOBPRIORITIESSIZE; ++j)
+            sumJobCounters(&server->jobCounters[j], &worker->jobCounters[j]);
+        UA_free(worker);
+    }
+    UA_free(server->workers);
+    UA_free(server->workerThreads);
+    server->workers = NULL;
+    server->workerThreads = NULL;
+    server->workersStarted = 0;
+}
+
+static UA_StatusCode
+startWorkers(UA_Server *server) {
     UA_LOG_INFO(server->config.logger, UA_LOGCATEGORY_SERVER,
                 "Spinning up %u worker thread(s)", server->config.nThreads);
     pthread_cond_init(&server->dispatchQueue_condition, 0);
     pthread_mutex_init(&server->dispatchQueue_mutex, 0);
-    server->workers = UA_malloc(server->config.nThreads * sizeof(UA_Worker));
-    if(!server->workers)
+    size_t nThreads = server->config.nThreads;
+    server->workers = UA_calloc(nThreads, sizeof(UA_Worker*));
+    server->workerThreads = UA_malloc(nThreads * sizeof(pthread_t));
+    struct WorkerStartup *startups = UA_malloc(nThreads * sizeof(struct WorkerStartup));
+    if(!server->workers || !server->workerThreads || !startups) {
+        UA_free(server->workers);
+        UA_free(server->workerThreads);
+        UA_free(startups);
+        server->workers = NULL;
+        server->workerThreads = NULL;
         return UA_STATUSCODE_BADOUTOFMEMORY;
-    for(size_t i = 0; i < server->config.nThreads; ++i) {
-        UA_Worker *worker = &server->workers[i];
-        worker->server = server;
-        worker->counter = 0;
-        worker->running = true;
-        pthread_create(&worker->thr, NULL, (void* (*)(void*))workerLoop, worker);
     }
 
-    /* Try to execute delayed callbacks every 10 sec */
-    UA_Job processDelayed = {.type = UA_JOBTYPE_METHODCALL,
-                             .job.methodCall = {.method = dispatchDelayedJobs, .data = NULL} };
-    UA_Server_addRepeatedJob(server, processDelayed, 10000, NULL);
+    /* The workers allocate their own structures. Wait until all are ready. */
+    server->workersStarted = 0;
+    size_t created = 0;
+    for(; created < nThreads; ++created) {
+        startups[created].server = server;
+        startups[created].index = created;
+        if(pthread_create(&server->workerThreads[created], NULL,
+                          (void* (*)(void*))workerLoop, &startups[created]) != 0)
+            break;
+    }
+    pthread_mutex_lock(&server->dispatchQueue_mutex);
+    while(server->workersStarted < created)
+        pthread_cond_wait(&server->dispatchQueue_condition, &server->dispatchQueue_mutex);
+    pthread_mutex_unlock(&server->dispatchQueue_mutex);
+    UA_free(startups);
+
+    UA_Boolean complete = (created == nThreads);
+    for(size_t i = 0; i < created; ++i) {
+        if(!server->workers[i])
+            complete = false;
+    }
+    if(!complete) {
+        UA_LOG_ERROR(server->config.logger, UA_LOGCATEGORY_SERVER,
+                     "Could not start the worker threads");
+        stopWorkers(server);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+#endif
+
+UA_StatusCode UA_Server_run_startup(UA_Server *server) {
+    /* Pin the main loop thread */
+    UA_Boolean pinned = false;
+    if(server->config.networkCpuSet.cpusSize > 0) {
+        if(UA_Thread_setAffinity(&server->config.networkCpuSet) == UA_STATUSCODE_GOOD)
+            pinned = true;
+        else
+            UA_LOG_WARNING(server->config.logger, UA_LOGCATEGORY_SERVER,
+                           "Could not pin the main loop to its CPU set");
+    }
+    UA_Thread_getPlacement(&server->placement);
+    server->placement.pinned = pinned;
+
+#ifdef UA_ENABLE_MULTITHREADING
+    /* Spin up the worker threads */
+    UA_StatusCode retval = startWorkers(server);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
 #endif
 
     /* Start the networklayers */
@@ -591,19 +1032,74 @@ completeMessages(UA_Server *server, UA_Job *job) {
         job->type = UA_JOBTYPE_NOTHING;
 }
 
+void UA_Server_wakeup(UA_Server *server) {
+    /* Only the last networklayer waits on the timeout */
+    if(server->config.networkLayersSize == 0)
+        return;
+    UA_ServerNetworkLayer *nl =
+        &server->config.networkLayers[server->config.networkLayersSize-1];
+    if(nl->wakeup)
+        nl->wakeup(nl);
+}
+
+/* Without a wakeup from the networklayer, jobs added from other threads are
+ * only seen when the main loop polls in short intervals */
+static UA_Boolean
+canWakeup(UA_Server *server) {
+    if(server->config.networkLayersSize == 0)
+        return false;
+    return server->config.networkLayers[server->config.networkLayersSize-1].wakeup != NULL;
+}
+
+/* Answers reads and method calls that have completed or timed out. Returns the
+ * time (in ms) until the next deadline. */
+static UA_UInt16
+processAsyncRequests(UA_Server *server, UA_DateTime now, UA_Boolean force) {
+    UA_UInt16 timeout = UA_Server_processAsyncReads(server, now, force);
+#ifdef UA_ENABLE_METHODCALLS
+    UA_UInt16 callTimeout = UA_Server_processAsyncCalls(server, now, force);
+    if(callTimeout < timeout)
+        timeout = callTimeout;
+#endif
+    return timeout;
+}
+
 UA_UInt16 UA_Server_run_iterate(UA_Server *server, UA_Boolean waitInternal) {
 #ifdef UA_ENABLE_MULTITHREADING
     /* Run work assigned for the main thread */
     processMainLoopJobs(server);
+
+    /* Free memory that is no longer accessed by the workers */
+    UA_Boolean delayedReady = processDelayedJobs(server, false);
 #endif
     /* Process repeated work */
     UA_DateTime now = UA_DateTime_nowMonotonic();
     UA_Boolean dispatched = false; /* to wake up worker threads */
-    UA_DateTime nextRepeated = processRepeatedJobs(server, now, &dispatched);
+    processRepeatedJobs(server, now, &dispatched);
+
+    /* Answer reads and method calls that have completed or timed out */
+    UA_UInt16 asyncTimeout = processAsyncRequests(server, now, false);
 
     UA_UInt16 timeout = 0;
-    if(waitInternal)
-        timeout = (UA_UInt16)((nextRepeated - now) / UA_MSEC_TO_DATETIME);
+    if(waitInternal) {
+        timeout = nextRepeatedJobTimeout(server, now);
+        if(asyncTimeout < timeout)
+            timeout = asyncTimeout;
+#ifdef UA_ENABLE_MULTITHREADING
+        /* The workers do not wake up the main loop when they become
+         * quiescent. Poll for the pending delayed jobs. */
+        if(delayedReady)
+            timeout = 0;
+        else if(timeout > MAXTIMEOUT && !SIMPLEQ_EMPTY(&server->delayedJobs))
+            timeout = MAXTIMEOUT;
+#endif
+        if(timeout > MAXTIMEOUT && !canWakeup(server))
+            timeout = MAXTIMEOUT;
+    }
+
+    UA_JobPriority messagePriority = server->config.messageJobPriority;
+    if(messagePriority >= UA_JOBPRIORITIESSIZE)
+        messagePriority = UA_JOBPRIORITY_NORMAL;
 
     /* Get work from the networklayer */
     for(size_t i = 0; i < server->config.networkLayersSize; ++i) {
@@ -620,7 +1116,7 @@ UA_UInt16 UA_Server_run_iterate(UA_Server *server, UA_Boolean waitInternal) {
 #ifdef UA_ENABLE_MULTITHREADING
             /* Filter out delayed work */
             if(jobs[k].type == UA_JOBTYPE_METHODCALL_DELAYED) {
-                addDelayedJob(server, &jobs[k]);
+                addDelayedJob(server, &jobs[k], 0);
                 jobs[k].type = UA_JOBTYPE_NOTHING;
                 continue;
             }
@@ -631,11 +1127,14 @@ UA_UInt16 UA_Server_run_iterate(UA_Server *server, UA_Boolean waitInternal) {
         }
 
         /* Dispatch/process jobs */
+        UA_DateTime received = UA_DateTime_nowMonotonic();
         for(size_t j = 0; j < jobsSize; ++j) {
 #ifdef UA_ENABLE_MULTITHREADING
-            dispatchJob(server, &jobs[j]);
+            dispatchJob(server, &jobs[j], messagePriority, received);
             dispatched = true;
 #else
+            countJob(&server->jobCounters[messagePriority],
+                     UA_DateTime_nowMonotonic() - received);
             processJob(server, &jobs[j]);
 #endif
         }
@@ -653,10 +1152,19 @@ UA_UInt16 UA_Server_run_iterate(UA_Server *server, UA_Boolean waitInternal) {
     processDelayedCallbacks(server);
 #endif
 
+    /* Jobs processed in this iteration might have added repeated jobs or
+     * completed reads and method calls */
     now = UA_DateTime_nowMonotonic();
-    timeout = 0;
-    if(nextRepeated > now)
-        timeout = (UA_UInt16)((nextRepeated - now) / UA_MSEC_TO_DATETIME);
+    timeout = nextRepeatedJobTimeout(server, now);
+    asyncTimeout = processAsyncRequests(server, now, false);
+    if(asyncTimeout < timeout)
+        timeout = asyncTimeout;
+    if(timeout > MAXTIMEOUT)
+        timeout = MAXTIMEOUT;
+#ifdef UA_ENABLE_MULTITHREADING
+    if(delayedReady)
+        timeout = 0;
+#endif
     return timeout;
 }
 
@@ -676,26 +1184,79 @@ UA_StatusCode UA_Server_run_shutdown(UA_Server *server) {
         UA_LOG_INFO(server->config.logger, UA_LOGCATEGORY_SERVER,
                     "Shutting down %u worker thread(s)", server->config.nThreads);
         /* Wait for all worker threads to finish */
-        for(size_t i = 0; i < server->config.nThreads; ++i)
-            server->workers[i].running = false;
-        pthread_cond_broadcast(&server->dispatchQueue_condition);
-        for(size_t i = 0; i < server->config.nThreads; ++i)
-            pthread_join(server->workers[i].thr, NULL);
-        /* Free the worker structures */
-        UA_free(server->workers);
-        server->workers = NULL;
+        stopWorkers(server);
     }
 
     /* Manually finish the work still enqueued */
     emptyDispatchQueue(server);
+    processMainLoopJobs(server);
+    processAsyncRequests(server, 0, true);
+    processDelayedJobs(server, true);
     UA_ASSERT_RCU_UNLOCKED();
     rcu_barrier(); // wait for all scheduled call_rcu work to complete
 #else
+    processAsyncRequests(server, 0, true);
     processDelayedCallbacks(server);
 #endif
     return UA_STATUSCODE_GOOD;
 }
 
+UA_StatusCode
+UA_Server_getJobStatistics(UA_Server *server, UA_JobPriority priority,
+                           UA_JobStatistics *stats) {
+    if(priority >= UA_JOBPRIORITIESSIZE)
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+
+    /* Sum up the counters of the main loop and all workers */
+    UA_JobCounters sum = server->jobCounters[priority];
+#ifdef UA_ENABLE_MULTITHREADING
+    if(server->workers) {
+        for(size_t i = 0; i < server->config.nThreads; ++i)
+            sumJobCounters(&sum, &server->workers[i]->jobCounters[priority]);
+    }
+#endif
+
+    stats->queueDepth = 0;
+    stats->processedJobs = sum.processed;
+    stats->meanWaitTime = 0.0;
+#ifdef UA_ENABLE_MULTITHREADING
+    if(server->dispatchedJobs[priority] > sum.processed)
+        stats->queueDepth = (size_t)(server->dispatchedJobs[priority] - sum.processed);
+#endif
+    if(sum.processed > 0)
+        stats->meanWaitTime = ((UA_Double)sum.waitTime / (UA_Double)sum.processed) /
+            (UA_Double)UA_MSEC_TO_DATETIME;
+    stats->maxWaitTime = (UA_Double)sum.maxWaitTime / (UA_Double)UA_MSEC_TO_DATETIME;
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_Server_getThreadPlacement(UA_Server *server, size_t thread,
+                             UA_ThreadPlacement *placement) {
+    if(thread == 0) {
+        *placement = server->placement;
+        return UA_STATUSCODE_GOOD;
+    }
+#ifdef UA_ENABLE_MULTITHREADING
+    if(server->workers && thread <= server->config.nThreads) {
+        *placement = server->workers[thread-1]->placement;
+        return UA_STATUSCODE_GOOD;
+    }
+#endif
+    return UA_STATUSCODE_BADINVALIDARGUMENT;
+}
+
+void
+UA_Server_getReclamationStatistics(UA_Server *server,
+                                   UA_ReclamationStatistics *stats) {
+    const UA_ReclamationCounters *rc = &server->reclamationCounters;
+    stats->pendingJobs = rc->pendingJobs;
+    stats->pendingBytes = rc->pendingBytes;
+    stats->reclaimedJobs = rc->reclaimedJobs;
+    stats->reclaimedBytes = rc->reclaimedBytes;
+    stats->maxLatency = (UA_Double)rc->maxLatency / (UA_Double)UA_MSEC_TO_DATETIME;
+}
+
 UA_StatusCode UA_Server_run(UA_Server *server, volatile UA_Boolean *running) {
     UA_StatusCode retval = UA_Server_run_startup(server);
     if(retval != UA_STATUSCODE_GOOD)
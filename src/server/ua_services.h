@@ -178,8 +178,22 @@ void Service_UnregisterNodes(UA_Server *server, UA_Session *session,
  * data maintained by a Server without any knowledge of the logical schema used
  * for internal storage of the data. Knowledge of the AddressSpace is
  * sufficient. */
-/* Not Implemented: Service_QueryFirst */
-/* Not Impelemented: Service_QueryNext */
+/* This Service is used to issue a Query request to the Server. The instances
+ * of the requested types (and their subtypes) are looked up in an index of the
+ * HasTypeDefinition references and filtered. The supported filter operators
+ * are Equals, IsNull, GreaterThan, LessThan, GreaterThanOrEqual,
+ * LessThanOrEqual, Not, Between, InList, And, Or and OfType. The remaining
+ * candidates are kept in a continuation point if more than the maximum number
+ * of data sets match. Only the default view is supported. */
+void Service_QueryFirst(UA_Server *server, UA_Session *session,
+                        const UA_QueryFirstRequest *request,
+                        UA_QueryFirstResponse *response);
+
+/* This Service is used to request the next set of QueryFirst or QueryNext
+ * response information that is too large to be sent in a single response. */
+void Service_QueryNext(UA_Server *server, UA_Session *session,
+                       const UA_QueryNextRequest *request,
+                       UA_QueryNextResponse *response);
 
 /**
  * Attribute Service Set
@@ -194,6 +208,13 @@ void Service_Read(UA_Server *server, UA_Session *session,
                   const UA_ReadRequest *request,
                   UA_ReadResponse *response);
 
+/* Same as Service_Read. But DataSources with an asynchronous read callback can
+ * complete later. Then the response is sent once all reads have completed or
+ * the request has timed out. Note that the service signature is an exception
+ * and does not contain a pointer to a ReadResponse. */
+void Service_ReadAsync(UA_Server *server, UA_Session *session,
+                       const UA_ReadRequest *request, UA_UInt32 requestId);
+
 /* Used to write one or more Attributes of one or more Nodes. For constructed
  * Attribute values whose elements are indexed, such as an array, this Service
  * allows Clients to write the entire set of indexed values as a composite, to
@@ -216,10 +237,13 @@ void Service_Write(UA_Server *server, UA_Session *session,
 /* Used to call (invoke) a list of Methods. Each method call is invoked within
  * the context of an existing Session. If the Session is terminated, the results
  * of the method's execution cannot be returned to the Client and are
- * discarded. */
+ * discarded.
+ *
+ * Note that the service signature is an exception and does not contain a
+ * pointer to a CallResponse. Methods with an asynchronous callback can
+ * complete later. The response is sent once all methods have completed. */
 void Service_Call(UA_Server *server, UA_Session *session,
-                  const UA_CallRequest *request,
-                  UA_CallResponse *response);
+                  const UA_CallRequest *request, UA_UInt32 requestId);
 
 /**
  * MonitoredItem Service Set
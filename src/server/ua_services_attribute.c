@@ -8,6 +8,32 @@
 #include "ua_types_encoding_binary.h"
 #endif
 
+/* A ReadRequest with pending asynchronous reads from DataSources. The response
+ * is sent when the counter of pending reads drops to zero or the deadline has
+ * passed. The counter is increased by one while the request is processed in
+ * Service_ReadAsync. The request is freed when the last reference is released.
+ * References are held by the service (and later the list of pending reads in
+ * the server) and by every token that was not completed yet. */
+struct UA_AsyncReadRequest {
+    LIST_ENTRY(UA_AsyncReadRequest) pointers; /* only accessed from the main loop */
+    UA_UInt32 pending;
+    UA_UInt32 refs;
+    UA_DateTime deadline; /* monotonic */
+    UA_UInt32 requestId;
+    UA_NodeId sessionToken;
+    UA_TimestampsToReturn timestamps;
+    UA_ReadResponse response;
+    UA_ReadToken *tokens;
+};
+
+/* The token is claimed either by the completion or by the timeout. Tokens of
+ * reads that are not deferred are always claimed. */
+struct UA_ReadToken {
+    UA_AsyncReadRequest *read;
+    UA_DataValue *result;
+    UA_UInt32 claimed;
+};
+
 /* Force cast from const data for zero-copy reading. The storage type is set to
    nodelete. So the value is not deleted. Use with care! */
 static void
@@ -165,8 +191,8 @@ typeCheckValue(UA_Server *server, const UA_NodeId *targetDataTypeId,
         goto check_array;
 
     /* Has the value a subtype of the required type? */
-    const UA_NodeId subtypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE);
-    if(isNodeInTree(server->nodestore, &value->type->typeId, targetDataTypeId, &subtypeId, 1))
+    if(UA_Server_isSubtype(server, UA_TYPECLOSURE_DATATYPES,
+                           &value->type->typeId, targetDataTypeId))
         goto check_array;
 
     /* Try to convert to a matching value if this is wanted */
@@ -371,9 +397,8 @@ writeDataTypeAttribute(UA_Server *server, UA_VariableNode *node,
         return UA_STATUSCODE_BADINTERNALERROR;
 
     /* Does the new type match the constraints of the variabletype? */
-    UA_NodeId subtypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE);
-    if(!isNodeInTree(server->nodestore, dataType,
-                     constraintDataType, &subtypeId, 1))
+    if(!UA_Server_isSubtype(server, UA_TYPECLOSURE_DATATYPES,
+                            dataType, constraintDataType))
         return UA_STATUSCODE_BADTYPEMISMATCH;
 
     /* Check if the current value would match the new type */
@@ -414,17 +439,18 @@ readValueAttributeFromNode(UA_Server *server, const UA_VariableNode *vn, UA_Data
                            UA_NumericRange *rangeptr) {
     if(vn->value.data.callback.onRead) {
         UA_RCU_UNLOCK();
-        vn->value.data.callback.onRead(vn->value.data.callback.handle,
-                                       vn->nodeId, &vn->value.data.value.value, rangeptr);
+        vn->value.data.callback.onRead(vn->value.data.callback.handle, vn->nodeId,
+                                       &UA_VariableNode_getValue(vn)->value, rangeptr);
         UA_RCU_LOCK();
 #ifdef UA_ENABLE_MULTITHREADING
         /* Reopen the node to see the changes (multithreading only) */
         vn = (const UA_VariableNode*)UA_NodeStore_get(server->nodestore, &vn->nodeId);
 #endif
     }
+    const UA_DataValue *value = UA_VariableNode_getValue(vn);
     if(rangeptr)
-        return UA_Variant_copyRange(&vn->value.data.value.value, &v->value, *rangeptr);
-    *v = vn->value.data.value;
+        return UA_Variant_copyRange(&value->value, &v->value, *rangeptr);
+    *v = *value;
     v->value.storageType = UA_VARIANT_DATA_NODELETE;
     return UA_STATUSCODE_GOOD;
 }
@@ -432,16 +458,32 @@ readValueAttributeFromNode(UA_Server *server, const UA_VariableNode *vn, UA_Data
 static UA_StatusCode
 readValueAttributeFromDataSource(const UA_VariableNode *vn, UA_DataValue *v,
                                  UA_TimestampsToReturn timestamps,
-                                 UA_NumericRange *rangeptr) {
+                                 UA_NumericRange *rangeptr, UA_ReadToken *token) {
     if(!vn->value.dataSource.read)
         return UA_STATUSCODE_BADINTERNALERROR;
     UA_Boolean sourceTimeStamp = (timestamps == UA_TIMESTAMPSTORETURN_SOURCE ||
                                   timestamps == UA_TIMESTAMPSTORETURN_BOTH);
 
     UA_RCU_UNLOCK();
-    UA_StatusCode retval =
-        vn->value.dataSource.read(vn->value.dataSource.handle, vn->nodeId,
-                                  sourceTimeStamp, rangeptr, v);
+    UA_StatusCode retval;
+    if(token && vn->value.dataSource.readAsync) {
+        /* Count as pending before the callback. The read might be completed
+         * before the callback returns. */
+        UA_AsyncReadRequest *ar = token->read;
+        token->claimed = 0;
+        UA_atomic_add(&ar->pending, 1);
+        UA_atomic_add(&ar->refs, 1);
+        retval = vn->value.dataSource.readAsync(vn->value.dataSource.handle, vn->nodeId,
+                                                sourceTimeStamp, rangeptr, v, token);
+        if(retval != UA_STATUSCODE_GOODCOMPLETESASYNCHRONOUSLY) {
+            token->claimed = 1;
+            UA_atomic_add(&ar->pending, (UA_UInt32)-1);
+            UA_atomic_add(&ar->refs, (UA_UInt32)-1);
+        }
+    } else {
+        retval = vn->value.dataSource.read(vn->value.dataSource.handle, vn->nodeId,
+                                           sourceTimeStamp, rangeptr, v);
+    }
     UA_RCU_LOCK();
     return retval;
 }
@@ -449,7 +491,7 @@ readValueAttributeFromDataSource(const UA_VariableNode *vn, UA_DataValue *v,
 static UA_StatusCode
 readValueAttributeComplete(UA_Server *server, const UA_VariableNode *vn,
                            UA_TimestampsToReturn timestamps, const UA_String *indexRange,
-                           UA_DataValue *v) {
+                           UA_DataValue *v, UA_ReadToken *token) {
     /* Compute the index range */
     UA_NumericRange range;
     UA_NumericRange *rangeptr = NULL;
@@ -465,7 +507,7 @@ readValueAttributeComplete(UA_Server *server, const UA_VariableNode *vn,
     if(vn->valueSource == UA_VALUESOURCE_DATA)
         retval = readValueAttributeFromNode(server, vn, v, rangeptr);
     else
-        retval = readValueAttributeFromDataSource(vn, v, timestamps, rangeptr);
+        retval = readValueAttributeFromDataSource(vn, v, timestamps, rangeptr, token);
 
     /* Clean up */
     if(rangeptr)
@@ -475,26 +517,25 @@ readValueAttributeComplete(UA_Server *server, const UA_VariableNode *vn,
 
 UA_StatusCode
 readValueAttribute(UA_Server *server, const UA_VariableNode *vn, UA_DataValue *v) {
-    return readValueAttributeComplete(server, vn, UA_TIMESTAMPSTORETURN_NEITHER, NULL, v);
+    return readValueAttributeComplete(server, vn, UA_TIMESTAMPSTORETURN_NEITHER, NULL, v, NULL);
 }
 
 static UA_StatusCode
-writeValueAttributeWithoutRange(UA_VariableNode *node, const UA_DataValue *value) {
-    UA_DataValue old_value = node->value.data.value; /* keep the pointers for restoring */
-    UA_StatusCode retval = UA_DataValue_copy(value, &node->value.data.value);
+writeValueAttributeWithoutRange(UA_DataValue *target, const UA_DataValue *value) {
+    UA_DataValue old_value = *target; /* keep the pointers for restoring */
+    UA_StatusCode retval = UA_DataValue_copy(value, target);
     if(retval == UA_STATUSCODE_GOOD)
         UA_DataValue_deleteMembers(&old_value);
     else
-        node->value.data.value = old_value;
+        *target = old_value;
     return retval;
 }
 
 static UA_StatusCode
-writeValueAttributeWithRange(UA_VariableNode *node, const UA_DataValue *value,
+writeValueAttributeWithRange(UA_DataValue *target, const UA_DataValue *value,
                              const UA_NumericRange *rangeptr) {
     /* Value on both sides? */
-    if(value->status != node->value.data.value.status ||
-       !value->hasValue || !node->value.data.value.hasValue)
+    if(value->status != target->status || !value->hasValue || !target->hasValue)
         return UA_STATUSCODE_BADINDEXRANGEINVALID;
 
     /* Make scalar a one-entry array for range matching */
@@ -507,21 +548,86 @@ writeValueAttributeWithRange(UA_VariableNode *node, const UA_DataValue *value,
     }
 
     /* Write the value */
-    UA_StatusCode retval = UA_Variant_setRangeCopy(&node->value.data.value.value,
-                                                   v->data, v->arrayLength, *rangeptr);
+    UA_StatusCode retval = UA_Variant_setRangeCopy(&target->value, v->data,
+                                                   v->arrayLength, *rangeptr);
     if(retval != UA_STATUSCODE_GOOD)
         return retval;
 
     /* Write the status and timestamps */
-    node->value.data.value.hasStatus = value->hasStatus;
-    node->value.data.value.status = value->status;
-    node->value.data.value.hasSourceTimestamp = value->hasSourceTimestamp;
-    node->value.data.value.sourceTimestamp = value->sourceTimestamp;
-    node->value.data.value.hasSourcePicoseconds = value->hasSourcePicoseconds;
-    node->value.data.value.sourcePicoseconds = value->sourcePicoseconds;
+    target->hasStatus = value->hasStatus;
+    target->status = value->status;
+    target->hasSourceTimestamp = value->hasSourceTimestamp;
+    target->sourceTimestamp = value->sourceTimestamp;
+    target->hasSourcePicoseconds = value->hasSourcePicoseconds;
+    target->sourcePicoseconds = value->sourcePicoseconds;
     return UA_STATUSCODE_GOOD;
 }
 
+#ifdef UA_ENABLE_MULTITHREADING
+/* Build the new value in a fresh version and swap it into the cell. Writes
+ * with a range start from the current version. The swap is retried if another
+ * writer swapped the version in between. The value was checked against the
+ * constraints of the node. If they were changed in the meantime (the cell is
+ * locked during the change), BADNODEIDUNKNOWN tells the caller to get the
+ * current node and check again. */
+static UA_StatusCode
+writeValueCell(UA_Server *server, const UA_VariableNode *node,
+               const UA_DataValue *value, const UA_NumericRange *rangeptr) {
+    UA_ValueCell *cell = node->valueCell;
+    UA_ValueCellVersion *version = NULL;
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    size_t spins = 0;
+    while(true) {
+        UA_ValueCellVersion *old = rcu_dereference(cell->version);
+        if(old->locked) {
+            UA_ValueCell_wait(&spins);
+            continue;
+        }
+        UA_atomic_sync(); /* Read the node after the cell */
+        const UA_Node *stored = UA_NodeStore_get(server->nodestore, &node->nodeId);
+        if(!stored || (stored != (const UA_Node*)node &&
+                       !UA_VariableNode_sameConstraints(node, (const UA_VariableNode*)stored))) {
+            retval = UA_STATUSCODE_BADNODEIDUNKNOWN;
+            break;
+        }
+        if(!version) {
+            version = UA_ValueCellVersion_new();
+            if(!version)
+                return UA_STATUSCODE_BADOUTOFMEMORY;
+            if(!rangeptr)
+                retval = UA_DataValue_copy(value, &version->value);
+        }
+        if(rangeptr) {
+            UA_DataValue_deleteMembers(&version->value);
+            retval = UA_DataValue_copy(&old->value, &version->value);
+            if(retval == UA_STATUSCODE_GOOD)
+                retval = writeValueAttributeWithRange(&version->value, value, rangeptr);
+        }
+        if(retval != UA_STATUSCODE_GOOD)
+            break;
+        if(rcu_cmpxchg_pointer(&cell->version, old, version) == old) {
+            UA_ValueCellVersion_retire(old);
+            return UA_STATUSCODE_GOOD;
+        }
+    }
+    if(version)
+        UA_ValueCellVersion_delete(version);
+    return retval;
+}
+#endif
+
+static UA_StatusCode
+writeValueAttributeData(UA_Server *server, UA_VariableNode *node,
+                        const UA_DataValue *value, const UA_NumericRange *rangeptr) {
+#ifdef UA_ENABLE_MULTITHREADING
+    if(node->valueCell)
+        return writeValueCell(server, node, value, rangeptr);
+#endif
+    if(!rangeptr)
+        return writeValueAttributeWithoutRange(&node->value.data.value, value);
+    return writeValueAttributeWithRange(&node->value.data.value, value, rangeptr);
+}
+
 UA_StatusCode
 writeValueAttribute(UA_Server *server, UA_VariableNode *node,
                     const UA_DataValue *value, const UA_String *indexRange) {
@@ -558,10 +664,7 @@ writeValueAttribute(UA_Server *server, UA_VariableNode *node,
 
     /* Ok, do it */
     if(node->valueSource == UA_VALUESOURCE_DATA) {
-        if(!rangeptr)
-            retval = writeValueAttributeWithoutRange(node, &editableValue);
-        else
-            retval = writeValueAttributeWithRange(node, &editableValue, rangeptr);
+        retval = writeValueAttributeData(server, node, &editableValue, rangeptr);
 
         /* Callback after writing */
         if(retval == UA_STATUSCODE_GOOD && node->value.data.callback.onWrite) {
@@ -576,7 +679,8 @@ writeValueAttribute(UA_Server *server, UA_VariableNode *node,
             UA_RCU_UNLOCK();
             writtenNode->value.data.callback.onWrite(writtenNode->value.data.callback.handle,
                                                      writtenNode->nodeId,
-                                                     &writtenNode->value.data.value.value, rangeptr);
+                                                     &UA_VariableNode_getValue(writtenNode)->value,
+                                                     rangeptr);
             UA_RCU_LOCK();
         }
     } else {
@@ -658,9 +762,43 @@ static const UA_String binEncoding = {sizeof("DefaultBinary")-1, (UA_Byte*)"Defa
         break;                                                  \
     }
 
+/* Sets the status or the timestamps of a value that was read */
+static void
+finishRead(UA_DataValue *v, UA_StatusCode retval,
+           UA_TimestampsToReturn timestamps, UA_UInt32 attributeId) {
+    /* Return error code when reading has failed */
+    if(retval != UA_STATUSCODE_GOOD) {
+        v->hasStatus = true;
+        v->status = retval;
+        return;
+    }
+
+    v->hasValue = true;
+
+    /* Create server timestamp */
+    if(timestamps == UA_TIMESTAMPSTORETURN_SERVER ||
+       timestamps == UA_TIMESTAMPSTORETURN_BOTH) {
+        v->serverTimestamp = UA_DateTime_now();
+        v->hasServerTimestamp = true;
+    }
+
+    /* Handle source time stamp */
+    if(attributeId == UA_ATTRIBUTEID_VALUE) {
+        if (timestamps == UA_TIMESTAMPSTORETURN_SERVER ||
+            timestamps == UA_TIMESTAMPSTORETURN_NEITHER) {
+            v->hasSourceTimestamp = false;
+            v->hasSourcePicoseconds = false;
+        } else if(!v->hasSourceTimestamp) {
+            v->sourceTimestamp = UA_DateTime_now();
+            v->hasSourceTimestamp = true;
+        }
+    }
+}
+
 void Service_Read_single(UA_Server *server, UA_Session *session,
                          const UA_TimestampsToReturn timestamps,
-                         const UA_ReadValueId *id, UA_DataValue *v) {
+                         const UA_ReadValueId *id, UA_DataValue *v,
+                         UA_ReadToken *token) {
     UA_LOG_DEBUG_SESSION(server->config.logger, session,
                          "Read the attribute %i", id->attributeId);
 
@@ -680,7 +818,7 @@ void Service_Read_single(UA_Server *server, UA_Session *session,
     }
 
     /* Get the node */
-    const UA_Node *node = UA_NodeStore_get(server->nodestore, &id->nodeId);
+    const UA_Node *node = UA_Server_getSessionNode(server, session, &id->nodeId);
     if(!node) {
         v->hasStatus = true;
         v->status = UA_STATUSCODE_BADNODEIDUNKNOWN;
@@ -737,7 +875,7 @@ void Service_Read_single(UA_Server *server, UA_Session *session,
     case UA_ATTRIBUTEID_VALUE:
         CHECK_NODECLASS(UA_NODECLASS_VARIABLE | UA_NODECLASS_VARIABLETYPE);
         retval = readValueAttributeComplete(server, (const UA_VariableNode*)node,
-                                            timestamps, &id->indexRange, v);
+                                            timestamps, &id->indexRange, v, token);
         break;
     case UA_ATTRIBUTEID_DATATYPE:
         CHECK_NODECLASS(UA_NODECLASS_VARIABLE | UA_NODECLASS_VARIABLETYPE);
@@ -787,38 +925,39 @@ void Service_Read_single(UA_Server *server, UA_Session *session,
         retval = UA_STATUSCODE_BADATTRIBUTEIDINVALID;
     }
 
-    /* Return error code when reading has failed */
-    if(retval != UA_STATUSCODE_GOOD) {
-        v->hasStatus = true;
-        v->status = retval;
+    /* The value is set when the read is completed. Don't touch it anymore. */
+    if(token && retval == UA_STATUSCODE_GOODCOMPLETESASYNCHRONOUSLY)
         return;
-    }
 
-    v->hasValue = true;
+    finishRead(v, retval, timestamps, id->attributeId);
+}
 
-    /* Create server timestamp */
-    if(timestamps == UA_TIMESTAMPSTORETURN_SERVER ||
-       timestamps == UA_TIMESTAMPSTORETURN_BOTH) {
-        v->serverTimestamp = UA_DateTime_now();
-        v->hasServerTimestamp = true;
-    }
+typedef struct {
+    UA_Session *session;
+    const UA_ReadRequest *request;
+    UA_ReadResponse *response;
+    UA_AsyncReadRequest *ar;
+#ifdef UA_ENABLE_EXTERNAL_NAMESPACES
+    const UA_Boolean *isExternal;
+#endif
+} ReadNodesContext;
 
-    /* Handle source time stamp */
-    if(id->attributeId == UA_ATTRIBUTEID_VALUE) {
-        if (timestamps == UA_TIMESTAMPSTORETURN_SERVER ||
-            timestamps == UA_TIMESTAMPSTORETURN_NEITHER) {
-            v->hasSourceTimestamp = false;
-            v->hasSourcePicoseconds = false;
-        } else if(!v->hasSourceTimestamp) {
-            v->sourceTimestamp = UA_DateTime_now();
-            v->hasSourceTimestamp = true;
-        }
-    }
+static void
+readNode(UA_Server *server, void *context, size_t i) {
+    ReadNodesContext *rc = (ReadNodesContext*)context;
+#ifdef UA_ENABLE_EXTERNAL_NAMESPACES
+    if(rc->isExternal[i])
+        return;
+#endif
+    Service_Read_single(server, rc->session, rc->request->timestampsToReturn,
+                        &rc->request->nodesToRead[i], &rc->response->results[i],
+                        rc->ar ? &rc->ar->tokens[i] : NULL);
 }
 
-void Service_Read(UA_Server *server, UA_Session *session,
-                  const UA_ReadRequest *request, UA_ReadResponse *response) {
-    UA_LOG_DEBUG_SESSION(server->config.logger, session, "Processing ReadRequest");
+/* If the request context is given, DataSources can be read asynchronously */
+static void
+readNodes(UA_Server *server, UA_Session *session, const UA_ReadRequest *request,
+          UA_ReadResponse *response, UA_AsyncReadRequest *ar) {
     if(request->nodesToReadSize <= 0) {
         response->responseHeader.serviceResult = UA_STATUSCODE_BADNOTHINGTODO;
         return;
@@ -838,6 +977,19 @@ void Service_Read(UA_Server *server, UA_Session *session,
     }
     response->resultsSize = size;
 
+    if(ar) {
+        ar->tokens = UA_malloc(size * sizeof(UA_ReadToken));
+        if(!ar->tokens) {
+            response->responseHeader.serviceResult = UA_STATUSCODE_BADOUTOFMEMORY;
+            return;
+        }
+        for(size_t i = 0; i < size; ++i) {
+            ar->tokens[i].read = ar;
+            ar->tokens[i].result = &response->results[i];
+            ar->tokens[i].claimed = 1;
+        }
+    }
+
     if(request->maxAge < 0) {
         response->responseHeader.serviceResult = UA_STATUSCODE_BADMAXAGEINVALID;
         return;
@@ -865,13 +1017,15 @@ void Service_Read(UA_Server *server, UA_Session *session,
     }
 #endif
 
-    for(size_t i = 0;i < size;++i) {
+    ReadNodesContext rc;
+    rc.session = session;
+    rc.request = request;
+    rc.response = response;
+    rc.ar = ar;
 #ifdef UA_ENABLE_EXTERNAL_NAMESPACES
-        if(!isExternal[i])
+    rc.isExternal = isExternal;
 #endif
-            Service_Read_single(server, session, request->timestampsToReturn,
-                                &request->nodesToRead[i], &response->results[i]);
-    }
+    UA_Server_processItems(server, size, readNode, &rc);
 
 #ifdef UA_ENABLE_NONSTANDARD_STATELESS
     /* Add an expiry header for caching */
@@ -915,6 +1069,155 @@ void Service_Read(UA_Server *server, UA_Session *session,
 #endif
 }
 
+void Service_Read(UA_Server *server, UA_Session *session,
+                  const UA_ReadRequest *request, UA_ReadResponse *response) {
+    UA_LOG_DEBUG_SESSION(server->config.logger, session, "Processing ReadRequest");
+    readNodes(server, session, request, response, NULL);
+}
+
+static void
+releaseAsyncReadRequest(UA_AsyncReadRequest *ar) {
+    if(UA_atomic_add(&ar->refs, (UA_UInt32)-1) != 0)
+        return;
+    UA_ReadResponse_deleteMembers(&ar->response);
+    UA_NodeId_deleteMembers(&ar->sessionToken);
+    UA_free(ar->tokens);
+    UA_free(ar);
+}
+
+/* Sends the response if the session is still alive. Otherwise, the results
+ * are discarded. The session is looked up if it is not given. */
+static void
+sendReadResponse(UA_Server *server, UA_Session *session, UA_AsyncReadRequest *ar) {
+    if(!session)
+        session = UA_SessionManager_getSession(&server->sessionManager, &ar->sessionToken);
+    if(!session || !session->channel)
+        return;
+    ar->response.responseHeader.timestamp = UA_DateTime_now();
+    UA_SecureChannel_sendBinaryMessage(session->channel, ar->requestId, &ar->response,
+                                       &UA_TYPES[UA_TYPES_READRESPONSE]);
+}
+
+/* Claims the tokens of all reads that are still pending */
+static void
+timeoutReads(UA_AsyncReadRequest *ar) {
+    for(size_t i = 0; i < ar->response.resultsSize; ++i) {
+        UA_ReadToken *token = &ar->tokens[i];
+        if(UA_atomic_add(&token->claimed, 1) != 1)
+            continue;
+        token->result->hasStatus = true;
+        token->result->status = UA_STATUSCODE_BADTIMEOUT;
+        UA_atomic_add(&ar->pending, (UA_UInt32)-1);
+    }
+}
+
+static void
+addAsyncReadRequest(UA_Server *server, void *ar) {
+    LIST_INSERT_HEAD(&server->asyncReads, (UA_AsyncReadRequest*)ar, pointers);
+}
+
+void Service_ReadAsync(UA_Server *server, UA_Session *session,
+                       const UA_ReadRequest *request, UA_UInt32 requestId) {
+    UA_LOG_DEBUG_SESSION(server->config.logger, session, "Processing ReadRequest");
+    UA_AsyncReadRequest *ar = UA_malloc(sizeof(UA_AsyncReadRequest));
+    if(!ar) {
+        UA_ReadResponse response;
+        UA_ReadResponse_init(&response);
+        response.responseHeader.requestHandle = request->requestHeader.requestHandle;
+        response.responseHeader.timestamp = UA_DateTime_now();
+        response.responseHeader.serviceResult = UA_STATUSCODE_BADOUTOFMEMORY;
+        UA_SecureChannel_sendBinaryMessage(session->channel, requestId, &response,
+                                           &UA_TYPES[UA_TYPES_READRESPONSE]);
+        return;
+    }
+    ar->pending = 1;
+    ar->refs = 1;
+    ar->requestId = requestId;
+    ar->timestamps = request->timestampsToReturn;
+    ar->tokens = NULL;
+    UA_UInt32 timeout = server->config.asyncReadTimeout;
+    if(request->requestHeader.timeoutHint > 0 && request->requestHeader.timeoutHint < timeout)
+        timeout = request->requestHeader.timeoutHint;
+    ar->deadline = UA_DateTime_nowMonotonic() + (UA_DateTime)timeout * UA_MSEC_TO_DATETIME;
+    UA_NodeId_copy(&session->authenticationToken, &ar->sessionToken);
+    UA_ReadResponse_init(&ar->response);
+    ar->response.responseHeader.requestHandle = request->requestHeader.requestHandle;
+
+    readNodes(server, session, request, &ar->response, ar);
+
+    /* Send the response right away if no read is pending */
+    if(UA_atomic_add(&ar->pending, (UA_UInt32)-1) == 0) {
+        sendReadResponse(server, session, ar);
+        releaseAsyncReadRequest(ar);
+        return;
+    }
+
+    /* Wait for the completions in the main loop. The list of pending reads
+     * takes over the reference of the service. */
+#ifdef UA_ENABLE_MULTITHREADING
+    UA_Job job = (UA_Job) {
+        .type = UA_JOBTYPE_METHODCALL,
+        .job.methodCall = {.data = ar, .method = addAsyncReadRequest}};
+    if(UA_Server_addMainLoopJob(server, &job) != UA_STATUSCODE_GOOD) {
+        timeoutReads(ar);
+        if(UA_atomic_add(&ar->pending, 0) == 0)
+            sendReadResponse(server, session, ar);
+        releaseAsyncReadRequest(ar);
+    }
+#else
+    addAsyncReadRequest(server, ar);
+#endif
+}
+
+UA_StatusCode
+UA_Server_completeRead(UA_Server *server, UA_ReadToken *token,
+                       const UA_DataValue *value) {
+    UA_AsyncReadRequest *ar = token->read;
+    UA_StatusCode retval = UA_STATUSCODE_BADTIMEOUT;
+    if(UA_atomic_add(&token->claimed, 1) == 1) {
+        UA_DataValue *v = token->result;
+        retval = UA_DataValue_copy(value, v);
+        finishRead(v, retval, ar->timestamps, UA_ATTRIBUTEID_VALUE);
+        /* The last completion wakes up the main loop to send the response */
+        if(UA_atomic_add(&ar->pending, (UA_UInt32)-1) == 0)
+            UA_Server_wakeup(server);
+    }
+    releaseAsyncReadRequest(ar);
+    return retval;
+}
+
+UA_UInt16
+UA_Server_processAsyncReads(UA_Server *server, UA_DateTime now, UA_Boolean force) {
+    UA_DateTime next = UA_INT64_MAX;
+    UA_AsyncReadRequest *ar, *ar_tmp;
+    LIST_FOREACH_SAFE(ar, &server->asyncReads, pointers, ar_tmp) {
+        /* The results are discarded if the session was closed in between */
+        UA_Session *session =
+            UA_SessionManager_getSession(&server->sessionManager, &ar->sessionToken);
+        if(force || !session || ar->deadline <= now)
+            timeoutReads(ar);
+        if(UA_atomic_add(&ar->pending, 0) == 0) {
+            if(session)
+                sendReadResponse(server, session, ar);
+        } else if(!force) {
+            if(ar->deadline < next)
+                next = ar->deadline;
+            continue;
+        }
+        LIST_REMOVE(ar, pointers);
+        releaseAsyncReadRequest(ar);
+    }
+
+    if(next == UA_INT64_MAX)
+        return UA_UINT16_MAX;
+    if(next <= now)
+        return 0;
+    UA_DateTime timeout = (next - now) / UA_MSEC_TO_DATETIME;
+    if(timeout >= UA_UINT16_MAX)
+        return UA_UINT16_MAX - 1;
+    return (UA_UInt16)timeout;
+}
+
 /* Exposes the Read service to local users */
 UA_DataValue
 UA_Server_read(UA_Server *server, const UA_ReadValueId *item,
@@ -922,7 +1225,7 @@ UA_Server_read(UA_Server *server, const UA_ReadValueId *item,
     UA_DataValue dv;
     UA_DataValue_init(&dv);
     UA_RCU_LOCK();
-    Service_Read_single(server, &adminSession, timestamps, item, &dv);
+    Service_Read_single(server, &adminSession, timestamps, item, &dv, NULL);
     UA_RCU_UNLOCK();
     return dv;
 }
@@ -1016,17 +1319,19 @@ CopyAttributeIntoNode(UA_Server *server, UA_Session *session,
         break;
     case UA_ATTRIBUTEID_BROWSENAME:
         CHECK_DATATYPE_SCALAR(QUALIFIEDNAME);
-        UA_QualifiedName_deleteMembers(&node->browseName);
+        UA_NodeStore_releaseString(server->nodestore, &node->browseName.name);
         UA_QualifiedName_copy(value, &node->browseName);
         break;
     case UA_ATTRIBUTEID_DISPLAYNAME:
         CHECK_DATATYPE_SCALAR(LOCALIZEDTEXT);
-        UA_LocalizedText_deleteMembers(&node->displayName);
+        UA_NodeStore_releaseString(server->nodestore, &node->displayName.locale);
+        UA_NodeStore_releaseString(server->nodestore, &node->displayName.text);
         UA_LocalizedText_copy(value, &node->displayName);
         break;
     case UA_ATTRIBUTEID_DESCRIPTION:
         CHECK_DATATYPE_SCALAR(LOCALIZEDTEXT);
-        UA_LocalizedText_deleteMembers(&node->description);
+        UA_NodeStore_releaseString(server->nodestore, &node->description.locale);
+        UA_NodeStore_releaseString(server->nodestore, &node->description.text);
         UA_LocalizedText_copy(value, &node->description);
         break;
     case UA_ATTRIBUTEID_WRITEMASK:
@@ -1125,6 +1430,69 @@ CopyAttributeIntoNode(UA_Server *server, UA_Session *session,
     return retval;
 }
 
+/* Writes a single attribute. With multithreading, the value of a variable is
+ * swapped in its value cell. The node is not copied and value writes do not
+ * conflict with concurrent edits of other attributes or the references. If
+ * the DataType, ValueRank or ArrayDimensions were changed concurrently, the
+ * value is checked again against the current node. */
+static UA_StatusCode
+writeAttribute(UA_Server *server, UA_Session *session, const UA_WriteValue *wvalue) {
+#ifdef UA_ENABLE_MULTITHREADING
+    while(wvalue->attributeId == UA_ATTRIBUTEID_VALUE) {
+        const UA_Node *node = UA_Server_getSessionNode(server, session, &wvalue->nodeId);
+        if(!node)
+            return UA_STATUSCODE_BADNODEIDUNKNOWN;
+        if(node->nodeClass != UA_NODECLASS_VARIABLE &&
+           node->nodeClass != UA_NODECLASS_VARIABLETYPE)
+            break;
+        /* Only the value cell is written. The node remains unchanged. */
+        UA_VariableNode *vn = (UA_VariableNode*)(uintptr_t)node;
+        if(vn->valueSource != UA_VALUESOURCE_DATA || !vn->valueCell)
+            break;
+        UA_StatusCode retval = writeValueAttribute(server, vn, &wvalue->value,
+                                                   &wvalue->indexRange);
+        if(retval == UA_STATUSCODE_BADNODEIDUNKNOWN)
+            continue; /* The node was replaced or removed */
+        if(retval != UA_STATUSCODE_GOOD)
+            UA_LOG_INFO_SESSION(server->config.logger, session,
+                                "WriteRequest returned status code %s",
+                                UA_StatusCode_name(retval));
+        return retval;
+    }
+#endif
+    UA_StatusCode retval = UA_Server_editNode(server, session,
+                                              UA_Session_resolveNodeId(session, &wvalue->nodeId),
+                                              (UA_EditNodeCallback)CopyAttributeIntoNode,
+                                              wvalue);
+    if(retval == UA_STATUSCODE_GOOD && wvalue->attributeId == UA_ATTRIBUTEID_BROWSENAME)
+        UA_Server_invalidateChildIndexes(server);
+    else if(retval == UA_STATUSCODE_GOOD && wvalue->attributeId == UA_ATTRIBUTEID_DISPLAYNAME)
+        UA_Server_invalidateBrowseCache(server);
+    return retval;
+}
+
+typedef struct {
+    UA_Session *session;
+    const UA_WriteRequest *request;
+    UA_WriteResponse *response;
+#ifdef UA_ENABLE_EXTERNAL_NAMESPACES
+    const UA_Boolean *isExternal;
+#endif
+} WriteNodesContext;
+
+/* If the items of a request are processed in parallel, several writes to the
+ * same node are applied in any order */
+static void
+writeNodeItem(UA_Server *server, void *context, size_t i) {
+    WriteNodesContext *wc = (WriteNodesContext*)context;
+#ifdef UA_ENABLE_EXTERNAL_NAMESPACES
+    if(wc->isExternal[i])
+        return;
+#endif
+    wc->response->results[i] =
+        writeAttribute(server, wc->session, &wc->request->nodesToWrite[i]);
+}
+
 void
 Service_Write(UA_Server *server, UA_Session *session,
               const UA_WriteRequest *request, UA_WriteResponse *response) {
@@ -1141,13 +1509,11 @@ Service_Write(UA_Server *server, UA_Session *session,
     }
     response->resultsSize = request->nodesToWriteSize;
 
-#ifndef UA_ENABLE_EXTERNAL_NAMESPACES
-    for(size_t i = 0;i < request->nodesToWriteSize;++i) {
-        response->results[i] = UA_Server_editNode(server, session, &request->nodesToWrite[i].nodeId,
-                                                  (UA_EditNodeCallback)CopyAttributeIntoNode,
-                                                  &request->nodesToWrite[i]);
-    }
-#else
+    WriteNodesContext wc;
+    wc.session = session;
+    wc.request = request;
+    wc.response = response;
+#ifdef UA_ENABLE_EXTERNAL_NAMESPACES
     UA_Boolean isExternal[request->nodesToWriteSize];
     UA_UInt32 indices[request->nodesToWriteSize];
     memset(isExternal, false, sizeof(UA_Boolean)*request->nodesToWriteSize);
@@ -1167,22 +1533,15 @@ Service_Write(UA_Server *server, UA_Session *session,
         ens->writeNodes(ens->ensHandle, &request->requestHeader, request->nodesToWrite,
                         indices, indexSize, response->results, response->diagnosticInfos);
     }
-    for(size_t i = 0;i < request->nodesToWriteSize;++i) {
-        if(isExternal[i])
-            continue;
-        response->results[i] = UA_Server_editNode(server, session, &request->nodesToWrite[i].nodeId,
-                                                  (UA_EditNodeCallback)CopyAttributeIntoNode,
-                                                  &request->nodesToWrite[i]);
-    }
+    wc.isExternal = isExternal;
 #endif
+    UA_Server_processItems(server, request->nodesToWriteSize, writeNodeItem, &wc);
 }
 
 UA_StatusCode
 UA_Server_write(UA_Server *server, const UA_WriteValue *value) {
     UA_RCU_LOCK();
-    UA_StatusCode retval =
-        UA_Server_editNode(server, &adminSession, &value->nodeId,
-                           (UA_EditNodeCallback)CopyAttributeIntoNode, value);
+    UA_StatusCode retval = writeAttribute(server, &adminSession, value);
     UA_RCU_UNLOCK();
     return retval;
 }
@@ -7,22 +7,49 @@
 
 #ifdef UA_ENABLE_METHODCALLS /* conditional compilation */
 
+/* A CallRequest with pending asynchronous method calls. The response is sent
+ * when the counter of pending calls drops to zero or the deadline has passed.
+ * The counter is increased by one while the request is processed in
+ * Service_Call. The request is freed when the last reference is released.
+ * References are held by the service (and later the list of pending calls in
+ * the server) and by every token that was not completed yet. */
+struct UA_AsyncCallRequest {
+    LIST_ENTRY(UA_AsyncCallRequest) pointers; /* only accessed from the main loop */
+    UA_UInt32 pending;
+    UA_UInt32 refs;
+    UA_DateTime deadline; /* monotonic */
+    UA_UInt32 requestId;
+    UA_NodeId sessionToken;
+    UA_CallResponse response;
+    UA_MethodCallToken *tokens;
+};
+
+/* The token is claimed either by the completion or by the timeout. Tokens of
+ * calls that are not deferred are always claimed. */
+struct UA_MethodCallToken {
+    UA_AsyncCallRequest *call;
+    UA_CallMethodResult *result;
+    UA_UInt32 claimed;
+};
+
 static const UA_VariableNode *
 getArgumentsVariableNode(UA_Server *server, const UA_MethodNode *ofMethod,
                          UA_String withBrowseName) {
     UA_NodeId hasProperty = UA_NODEID_NUMERIC(0, UA_NS0ID_HASPROPERTY);
     for(size_t i = 0; i < ofMethod->referencesSize; ++i) {
-        if(ofMethod->references[i].isInverse == false &&
-            UA_NodeId_equal(&hasProperty, &ofMethod->references[i].referenceTypeId)) {
-            const UA_Node *refTarget =
-                UA_NodeStore_get(server->nodestore, &ofMethod->references[i].targetId.nodeId);
-            if(!refTarget)
-                continue;
-            if(refTarget->nodeClass == UA_NODECLASS_VARIABLE &&
-                refTarget->browseName.namespaceIndex == 0 &&
-                UA_String_equal(&withBrowseName, &refTarget->browseName.name)) {
-                return (const UA_VariableNode*) refTarget;
-            }
+        if(ofMethod->references[i].isInverse != false ||
+           !UA_NodeId_equal(&hasProperty, &ofMethod->references[i].referenceTypeId)) {
+            i = UA_Node_referenceGroupEnd((const UA_Node*)ofMethod, i) - 1;
+            continue;
+        }
+        const UA_Node *refTarget =
+            UA_NodeStore_get(server->nodestore, &ofMethod->references[i].targetId.nodeId);
+        if(!refTarget)
+            continue;
+        if(refTarget->nodeClass == UA_NODECLASS_VARIABLE &&
+           refTarget->browseName.namespaceIndex == 0 &&
+           UA_String_equal(&withBrowseName, &refTarget->browseName.name)) {
+            return (const UA_VariableNode*) refTarget;
         }
     }
     return NULL;
@@ -31,13 +58,14 @@ getArgumentsVariableNode(UA_Server *server, const UA_MethodNode *ofMethod,
 static UA_StatusCode
 argumentsConformsToDefinition(UA_Server *server, const UA_VariableNode *argRequirements,
                               size_t argsSize, UA_Variant *args) {
-    if(argRequirements->value.data.value.value.type != &UA_TYPES[UA_TYPES_ARGUMENT])
-        return UA_STATUSCODE_BADINTERNALERROR;
-    UA_Argument *argReqs = (UA_Argument*)argRequirements->value.data.value.value.data;
-    size_t argReqsSize = argRequirements->value.data.value.value.arrayLength;
     if(argRequirements->valueSource != UA_VALUESOURCE_DATA)
         return UA_STATUSCODE_BADINTERNALERROR;
-    if(UA_Variant_isScalar(&argRequirements->value.data.value.value))
+    const UA_Variant *argValue = &UA_VariableNode_getValue(argRequirements)->value;
+    if(argValue->type != &UA_TYPES[UA_TYPES_ARGUMENT])
+        return UA_STATUSCODE_BADINTERNALERROR;
+    UA_Argument *argReqs = (UA_Argument*)argValue->data;
+    size_t argReqsSize = argValue->arrayLength;
+    if(UA_Variant_isScalar(argValue))
         argReqsSize = 1;
     if(argReqsSize > argsSize)
         return UA_STATUSCODE_BADARGUMENTSMISSING;
@@ -55,10 +83,11 @@ argumentsConformsToDefinition(UA_Server *server, const UA_VariableNode *argRequi
 void
 Service_Call_single(UA_Server *server, UA_Session *session,
                     const UA_CallMethodRequest *request,
-                    UA_CallMethodResult *result) {
+                    UA_CallMethodResult *result,
+                    UA_MethodCallToken *token) {
     /* Get/verify the method node */
     const UA_MethodNode *methodCalled =
-        (const UA_MethodNode*)UA_NodeStore_get(server->nodestore, &request->methodId);
+        (const UA_MethodNode*)UA_Server_getSessionNode(server, session, &request->methodId);
     if(!methodCalled) {
         result->statusCode = UA_STATUSCODE_BADMETHODINVALID;
         return;
@@ -67,14 +96,15 @@ Service_Call_single(UA_Server *server, UA_Session *session,
         result->statusCode = UA_STATUSCODE_BADNODECLASSINVALID;
         return;
     }
-    if(!methodCalled->executable || !methodCalled->userExecutable || !methodCalled->attachedMethod) {
+    if(!methodCalled->executable || !methodCalled->userExecutable ||
+       (!methodCalled->attachedMethod && !methodCalled->asyncMethod)) {
         result->statusCode = UA_STATUSCODE_BADNOTWRITABLE; // There is no NOTEXECUTABLE?
         return;
     }
 
     /* Get/verify the object node */
     const UA_ObjectNode *withObject =
-        (const UA_ObjectNode*)UA_NodeStore_get(server->nodestore, &request->objectId);
+        (const UA_ObjectNode*)UA_Server_getSessionNode(server, session, &request->objectId);
     if(!withObject) {
         result->statusCode = UA_STATUSCODE_BADNODEIDINVALID;
         return;
@@ -90,12 +120,12 @@ Service_Call_single(UA_Server *server, UA_Session *session,
      * a hasComponent (or subtype) reference */
     UA_Boolean found = false;
     UA_NodeId hasComponentNodeId = UA_NODEID_NUMERIC(0,UA_NS0ID_HASCOMPONENT);
-    UA_NodeId hasSubTypeNodeId = UA_NODEID_NUMERIC(0,UA_NS0ID_HASSUBTYPE);
     for(size_t i = 0; i < methodCalled->referencesSize; ++i) {
         if(methodCalled->references[i].isInverse &&
            UA_NodeId_equal(&methodCalled->references[i].targetId.nodeId, &withObject->nodeId)) {
-            found = isNodeInTree(server->nodestore, &methodCalled->references[i].referenceTypeId,
-                                 &hasComponentNodeId, &hasSubTypeNodeId, 1);
+            found = UA_Server_isSubtype(server, UA_TYPECLOSURE_REFERENCETYPES,
+                                        &methodCalled->references[i].referenceTypeId,
+                                        &hasComponentNodeId);
             if(found)
                 break;
         }
@@ -127,22 +157,49 @@ Service_Call_single(UA_Server *server, UA_Session *session,
     const UA_VariableNode *outputArguments =
         getArgumentsVariableNode(server, methodCalled, UA_STRING("OutputArguments"));
     if(outputArguments) {
-        result->outputArguments = UA_Array_new(outputArguments->value.data.value.value.arrayLength,
-                                               &UA_TYPES[UA_TYPES_VARIANT]);
+        size_t outputSize = UA_VariableNode_getValue(outputArguments)->value.arrayLength;
+        result->outputArguments = UA_Array_new(outputSize, &UA_TYPES[UA_TYPES_VARIANT]);
         if(!result->outputArguments) {
             result->statusCode = UA_STATUSCODE_BADOUTOFMEMORY;
             return;
         }
-        result->outputArgumentsSize = outputArguments->value.data.value.value.arrayLength;
+        result->outputArgumentsSize = outputSize;
     }
 
     /* Call the method */
 #if defined(UA_ENABLE_METHODCALLS) && defined(UA_ENABLE_SUBSCRIPTIONS)
     methodCallSession = session;
 #endif
-    result->statusCode = methodCalled->attachedMethod(methodCalled->methodHandle, withObject->nodeId,
-                                                      request->inputArgumentsSize, request->inputArguments,
-                                                      result->outputArgumentsSize, result->outputArguments);
+    if(methodCalled->asyncMethod) {
+        if(!token) {
+            result->statusCode = UA_STATUSCODE_BADNOTSUPPORTED;
+        } else {
+            /* Count as pending before the callback. The call might be completed
+             * from another thread before the callback returns. */
+            UA_AsyncCallRequest *call = token->call;
+            token->claimed = 0;
+            UA_atomic_add(&call->pending, 1);
+            UA_atomic_add(&call->refs, 1);
+            UA_StatusCode retval =
+                methodCalled->asyncMethod(methodCalled->methodHandle, withObject->nodeId,
+                                          request->inputArgumentsSize, request->inputArguments,
+                                          result->outputArgumentsSize, result->outputArguments,
+                                          token);
+            /* Completed right away. Unless the token was already completed
+             * with UA_Server_completeMethodCall, which has set the result. */
+            if(retval != UA_STATUSCODE_GOODCOMPLETESASYNCHRONOUSLY &&
+               UA_atomic_add(&token->claimed, 1) == 1) {
+                result->statusCode = retval;
+                UA_atomic_add(&call->pending, (UA_UInt32)-1);
+                UA_atomic_add(&call->refs, (UA_UInt32)-1);
+            }
+        }
+    } else {
+        result->statusCode =
+            methodCalled->attachedMethod(methodCalled->methodHandle, withObject->nodeId,
+                                         request->inputArgumentsSize, request->inputArguments,
+                                         result->outputArgumentsSize, result->outputArguments);
+    }
 #if defined(UA_ENABLE_METHODCALLS) && defined(UA_ENABLE_SUBSCRIPTIONS)
     methodCallSession = NULL;
 #endif
@@ -150,22 +207,116 @@ Service_Call_single(UA_Server *server, UA_Session *session,
     /* TODO: Verify Output matches the argument definition */
 }
 
+static void
+releaseAsyncCallRequest(UA_AsyncCallRequest *call) {
+    if(UA_atomic_add(&call->refs, (UA_UInt32)-1) != 0)
+        return;
+    UA_CallResponse_deleteMembers(&call->response);
+    UA_NodeId_deleteMembers(&call->sessionToken);
+    UA_free(call->tokens);
+    UA_free(call);
+}
+
+/* Sends the response if the session is still alive. Otherwise, the results
+ * are discarded. The session is looked up if it is not given. */
+static void
+sendCallResponse(UA_Server *server, UA_Session *session, UA_AsyncCallRequest *call) {
+    if(!session)
+        session = UA_SessionManager_getSession(&server->sessionManager, &call->sessionToken);
+    if(!session || !session->channel)
+        return;
+    call->response.responseHeader.timestamp = UA_DateTime_now();
+    UA_SecureChannel_sendBinaryMessage(session->channel, call->requestId, &call->response,
+                                       &UA_TYPES[UA_TYPES_CALLRESPONSE]);
+}
+
+/* Claims the tokens of all method calls that are still pending */
+static void
+timeoutCalls(UA_AsyncCallRequest *call) {
+    for(size_t i = 0; i < call->response.resultsSize; ++i) {
+        UA_MethodCallToken *token = &call->tokens[i];
+        if(UA_atomic_add(&token->claimed, 1) != 1)
+            continue;
+        token->result->statusCode = UA_STATUSCODE_BADTIMEOUT;
+        UA_atomic_add(&call->pending, (UA_UInt32)-1);
+    }
+}
+
+static void
+addAsyncCallRequest(UA_Server *server, void *call) {
+    LIST_INSERT_HEAD(&server->asyncCalls, (UA_AsyncCallRequest*)call, pointers);
+}
+
+typedef struct {
+    UA_Session *session;
+    const UA_CallRequest *request;
+    UA_AsyncCallRequest *call;
+#ifdef UA_ENABLE_EXTERNAL_NAMESPACES
+    const UA_Boolean *isExternal;
+#endif
+} CallMethodsContext;
+
+static void
+callMethod(UA_Server *server, void *context, size_t i) {
+    CallMethodsContext *cc = (CallMethodsContext*)context;
+#ifdef UA_ENABLE_EXTERNAL_NAMESPACES
+    if(cc->isExternal[i])
+        return;
+#endif
+    UA_AsyncCallRequest *call = cc->call;
+    Service_Call_single(server, cc->session, &cc->request->methodsToCall[i],
+                        &call->response.results[i], &call->tokens[i]);
+}
+
 void Service_Call(UA_Server *server, UA_Session *session,
-                  const UA_CallRequest *request,
-                  UA_CallResponse *response) {
+                  const UA_CallRequest *request, UA_UInt32 requestId) {
     UA_LOG_DEBUG_SESSION(server->config.logger, session, "Processing CallRequest");
+    UA_AsyncCallRequest *call = UA_malloc(sizeof(UA_AsyncCallRequest));
+    if(!call) {
+        UA_CallResponse response;
+        UA_CallResponse_init(&response);
+        response.responseHeader.requestHandle = request->requestHeader.requestHandle;
+        response.responseHeader.timestamp = UA_DateTime_now();
+        response.responseHeader.serviceResult = UA_STATUSCODE_BADOUTOFMEMORY;
+        UA_SecureChannel_sendBinaryMessage(session->channel, requestId, &response,
+                                           &UA_TYPES[UA_TYPES_CALLRESPONSE]);
+        return;
+    }
+    call->pending = 1;
+    call->refs = 1;
+    call->requestId = requestId;
+    call->tokens = NULL;
+    UA_UInt32 timeout = server->config.asyncCallTimeout;
+    if(request->requestHeader.timeoutHint > 0 && request->requestHeader.timeoutHint < timeout)
+        timeout = request->requestHeader.timeoutHint;
+    call->deadline = UA_DateTime_nowMonotonic() + (UA_DateTime)timeout * UA_MSEC_TO_DATETIME;
+    UA_NodeId_copy(&session->authenticationToken, &call->sessionToken);
+    UA_CallResponse_init(&call->response);
+    UA_CallResponse *response = &call->response;
+    response->responseHeader.requestHandle = request->requestHeader.requestHandle;
+
     if(request->methodsToCallSize <= 0) {
         response->responseHeader.serviceResult = UA_STATUSCODE_BADNOTHINGTODO;
-        return;
+        goto finish;
     }
 
     response->results = UA_Array_new(request->methodsToCallSize, &UA_TYPES[UA_TYPES_CALLMETHODRESULT]);
-    if(!response->results) {
+    call->tokens = UA_malloc(request->methodsToCallSize * sizeof(UA_MethodCallToken));
+    if(!response->results || !call->tokens) {
         response->responseHeader.serviceResult = UA_STATUSCODE_BADOUTOFMEMORY;
-        return;
+        goto finish;
     }
     response->resultsSize = request->methodsToCallSize;
+    for(size_t i = 0; i < response->resultsSize; ++i) {
+        call->tokens[i].call = call;
+        call->tokens[i].result = &response->results[i];
+        call->tokens[i].claimed = 1;
+    }
 
+    CallMethodsContext cc;
+    cc.session = session;
+    cc.request = request;
+    cc.call = call;
 #ifdef UA_ENABLE_EXTERNAL_NAMESPACES
     UA_Boolean isExternal[request->methodsToCallSize];
     UA_UInt32 indices[request->methodsToCallSize];
@@ -185,14 +336,92 @@ void Service_Call(UA_Server *server, UA_Session *session,
         ens->call(ens->ensHandle, &request->requestHeader, request->methodsToCall,
                        indices, (UA_UInt32)indexSize, response->results);
     }
+    cc.isExternal = isExternal;
 #endif
-    
-    for(size_t i = 0; i < request->methodsToCallSize;++i){
-#ifdef UA_ENABLE_EXTERNAL_NAMESPACES
-        if(!isExternal[i])
-#endif    
-            Service_Call_single(server, session, &request->methodsToCall[i], &response->results[i]);
+    UA_Server_processItems(server, request->methodsToCallSize, callMethod, &cc);
+
+ finish:
+    /* Send the response right away if no method call is pending */
+    if(UA_atomic_add(&call->pending, (UA_UInt32)-1) == 0) {
+        sendCallResponse(server, session, call);
+        releaseAsyncCallRequest(call);
+        return;
+    }
+
+    /* Wait for the completions in the main loop. The list of pending calls
+     * takes over the reference of the service. */
+#ifdef UA_ENABLE_MULTITHREADING
+    UA_Job job = (UA_Job) {
+        .type = UA_JOBTYPE_METHODCALL,
+        .job.methodCall = {.data = call, .method = addAsyncCallRequest}};
+    if(UA_Server_addMainLoopJob(server, &job) != UA_STATUSCODE_GOOD) {
+        timeoutCalls(call);
+        if(UA_atomic_add(&call->pending, 0) == 0)
+            sendCallResponse(server, session, call);
+        releaseAsyncCallRequest(call);
+    }
+#else
+    addAsyncCallRequest(server, call);
+#endif
+}
+
+UA_StatusCode
+UA_Server_completeMethodCall(UA_Server *server, UA_MethodCallToken *token,
+                             UA_StatusCode result, size_t outputSize,
+                             const UA_Variant *output) {
+    UA_AsyncCallRequest *call = token->call;
+    UA_StatusCode retval = UA_STATUSCODE_BADTIMEOUT;
+    if(UA_atomic_add(&token->claimed, 1) == 1) {
+        UA_CallMethodResult *r = token->result;
+        retval = UA_STATUSCODE_GOOD;
+        r->statusCode = result;
+        if(outputSize != r->outputArgumentsSize) {
+            r->statusCode = UA_STATUSCODE_BADINTERNALERROR;
+            retval = UA_STATUSCODE_BADINVALIDARGUMENT;
+        } else {
+            for(size_t i = 0; i < outputSize; ++i) {
+                UA_Variant_deleteMembers(&r->outputArguments[i]);
+                r->statusCode |= UA_Variant_copy(&output[i], &r->outputArguments[i]);
+            }
+        }
+        /* The last completion wakes up the main loop to send the response */
+        if(UA_atomic_add(&call->pending, (UA_UInt32)-1) == 0)
+            UA_Server_wakeup(server);
     }
+    releaseAsyncCallRequest(call);
+    return retval;
+}
+
+UA_UInt16
+UA_Server_processAsyncCalls(UA_Server *server, UA_DateTime now, UA_Boolean force) {
+    UA_DateTime next = UA_INT64_MAX;
+    UA_AsyncCallRequest *call, *call_tmp;
+    LIST_FOREACH_SAFE(call, &server->asyncCalls, pointers, call_tmp) {
+        /* The results are discarded if the session was closed in between */
+        UA_Session *session =
+            UA_SessionManager_getSession(&server->sessionManager, &call->sessionToken);
+        if(force || !session || call->deadline <= now)
+            timeoutCalls(call);
+        if(UA_atomic_add(&call->pending, 0) == 0) {
+            if(session)
+                sendCallResponse(server, session, call);
+        } else if(!force) {
+            if(call->deadline < next)
+                next = call->deadline;
+            continue;
+        }
+        LIST_REMOVE(call, pointers);
+        releaseAsyncCallRequest(call);
+    }
+
+    if(next == UA_INT64_MAX)
+        return UA_UINT16_MAX;
+    if(next <= now)
+        return 0;
+    UA_DateTime timeout = (next - now) / UA_MSEC_TO_DATETIME;
+    if(timeout >= UA_UINT16_MAX)
+        return UA_UINT16_MAX - 1;
+    return (UA_UInt16)timeout;
 }
 
 #endif /* UA_ENABLE_METHODCALLS */
@@ -13,16 +13,8 @@
  * referenced with an allowed (hierarchical) reference type. For "type" nodes,
  * only hasSubType references are allowed. */
 static UA_StatusCode
-checkParentReference(UA_Server *server, UA_Session *session, UA_NodeClass nodeClass,
-                     const UA_NodeId *parentNodeId, const UA_NodeId *referenceTypeId) {
-    /* See if the parent exists */
-    const UA_Node *parent = UA_NodeStore_get(server->nodestore, parentNodeId);
-    if(!parent) {
-        UA_LOG_INFO_SESSION(server->config.logger, session,
-                            "AddNodes: Parent node not found");
-        return UA_STATUSCODE_BADPARENTNODEIDINVALID;
-    }
-
+checkReferenceToParent(UA_Server *server, UA_Session *session, UA_NodeClass nodeClass,
+                       const UA_Node *parent, const UA_NodeId *referenceTypeId) {
     /* Check the referencetype exists */
     const UA_ReferenceTypeNode *referenceType =
         (const UA_ReferenceTypeNode*)UA_NodeStore_get(server->nodestore, referenceTypeId);
@@ -72,8 +64,8 @@ checkParentReference(UA_Server *server, UA_Session *session, UA_NodeClass nodeCl
     /* Test if the referencetype is hierarchical */
     const UA_NodeId hierarchicalReference =
         UA_NODEID_NUMERIC(0, UA_NS0ID_HIERARCHICALREFERENCES);
-    if(!isNodeInTree(server->nodestore, referenceTypeId,
-                     &hierarchicalReference, &subtypeId, 1)) {
+    if(!UA_Server_isSubtype(server, UA_TYPECLOSURE_REFERENCETYPES,
+                            referenceTypeId, &hierarchicalReference)) {
         UA_LOG_INFO_SESSION(server->config.logger, session,
                             "AddNodes: Reference type is not hierarchical");
         return UA_STATUSCODE_BADREFERENCETYPEIDINVALID;
@@ -82,6 +74,39 @@ checkParentReference(UA_Server *server, UA_Session *session, UA_NodeClass nodeCl
     return UA_STATUSCODE_GOOD;
 }
 
+static UA_StatusCode
+checkParentReference(UA_Server *server, UA_Session *session, UA_NodeClass nodeClass,
+                     const UA_NodeId *parentNodeId, const UA_NodeId *referenceTypeId) {
+    /* See if the parent exists */
+    const UA_Node *parent = UA_NodeStore_get(server->nodestore, parentNodeId);
+    if(!parent) {
+        UA_LOG_INFO_SESSION(server->config.logger, session,
+                            "AddNodes: Parent node not found");
+        return UA_STATUSCODE_BADPARENTNODEIDINVALID;
+    }
+    return checkReferenceToParent(server, session, nodeClass, parent, referenceTypeId);
+}
+
+/* Returns the type node if it can be instantiated for the nodeclass */
+static const UA_Node *
+getInstantiableType(UA_Server *server, UA_NodeClass nodeClass, const UA_NodeId *typeId) {
+    const UA_Node *typenode = UA_NodeStore_get(server->nodestore, typeId);
+    if(!typenode)
+        return NULL;
+    if(nodeClass == UA_NODECLASS_VARIABLE) {
+        if(typenode->nodeClass != UA_NODECLASS_VARIABLETYPE ||
+           ((const UA_VariableTypeNode*)typenode)->isAbstract)
+            return NULL;
+    } else if(nodeClass == UA_NODECLASS_OBJECT) {
+        if(typenode->nodeClass != UA_NODECLASS_OBJECTTYPE ||
+           ((const UA_ObjectTypeNode*)typenode)->isAbstract)
+            return NULL;
+    } else {
+        return NULL;
+    }
+    return typenode;
+}
+
 /************/
 /* Add Node */
 /************/
@@ -241,20 +266,9 @@ instantiateNode(UA_Server *server, UA_Session *session, const UA_NodeId *nodeId,
                 UA_NodeClass nodeClass, const UA_NodeId *typeId,
                 UA_InstantiationCallback *instantiationCallback) {
     /* see if the type node is correct */
-    const UA_Node *typenode = UA_NodeStore_get(server->nodestore, typeId);
+    const UA_Node *typenode = getInstantiableType(server, nodeClass, typeId);
     if(!typenode)
         return UA_STATUSCODE_BADTYPEDEFINITIONINVALID;
-    if(nodeClass == UA_NODECLASS_VARIABLE) {
-        if(typenode->nodeClass != UA_NODECLASS_VARIABLETYPE ||
-           ((const UA_VariableTypeNode*)typenode)->isAbstract)
-            return UA_STATUSCODE_BADTYPEDEFINITIONINVALID;
-    } else if(nodeClass == UA_NODECLASS_OBJECT) {
-        if(typenode->nodeClass != UA_NODECLASS_OBJECTTYPE ||
-           ((const UA_ObjectTypeNode*)typenode)->isAbstract)
-            return UA_STATUSCODE_BADTYPEDEFINITIONINVALID;
-    } else {
-        return UA_STATUSCODE_BADTYPEDEFINITIONINVALID;
-    }
 
     /* Get the hierarchy of the type and all its supertypes */
     UA_NodeId *hierarchy = NULL;
@@ -421,7 +435,7 @@ Service_AddNodes_existing(UA_Server *server, UA_Session *session, UA_Node *node,
     /* Check the namespaceindex */
     if(node->nodeId.namespaceIndex >= server->namespacesSize) {
         UA_LOG_INFO_SESSION(server->config.logger, session, "AddNodes: Namespace invalid");
-        UA_NodeStore_deleteNode(node);
+        UA_NodeStore_deleteNode(server->nodestore, node);
         return UA_STATUSCODE_BADNODEIDINVALID;
     }
 
@@ -432,7 +446,7 @@ Service_AddNodes_existing(UA_Server *server, UA_Session *session, UA_Node *node,
         UA_LOG_INFO_SESSION(server->config.logger, session,
                             "AddNodes: Checking the reference to the parent returned"
                             "error code %s", UA_StatusCode_name(retval));
-        UA_NodeStore_deleteNode(node);
+        UA_NodeStore_deleteNode(server->nodestore, node);
         return retval;
     }
 
@@ -674,7 +688,7 @@ createNodeFromAttributes(UA_Server *server, const UA_AddNodesItem *item, UA_Node
 
     /* Create the node */
     // todo: error case where the nodeclass is faulty
-    void *node = UA_NodeStore_newNode(item->nodeClass);
+    void *node = UA_NodeStore_newNode(server->nodestore, item->nodeClass);
     if(!node)
         return UA_STATUSCODE_BADOUTOFMEMORY;
 
@@ -719,7 +733,7 @@ createNodeFromAttributes(UA_Server *server, const UA_AddNodesItem *item, UA_Node
     if(retval == UA_STATUSCODE_GOOD)
         *newNode = node;
     else
-        UA_NodeStore_deleteNode(node);
+        UA_NodeStore_deleteNode(server->nodestore, node);
     return retval;
 }
 
@@ -849,7 +863,7 @@ UA_Server_addDataSourceVariableNode(UA_Server *server, const UA_NodeId requested
                                     const UA_VariableAttributes attr, const UA_DataSource dataSource,
                                     UA_NodeId *outNewNodeId) {
     /* Create the new node */
-    UA_VariableNode *node = UA_NodeStore_newVariableNode();
+    UA_VariableNode *node = UA_NodeStore_newVariableNode(server->nodestore);
     if(!node)
         return UA_STATUSCODE_BADOUTOFMEMORY;
 
@@ -866,7 +880,7 @@ UA_Server_addDataSourceVariableNode(UA_Server *server, const UA_NodeId requested
     editAttr.value = value.value;
 
     if(retval != UA_STATUSCODE_GOOD) {
-        UA_NodeStore_deleteNode((UA_Node*)node);
+        UA_NodeStore_deleteNode(server->nodestore, (UA_Node*)node);
         return retval;
     }
 
@@ -885,7 +899,7 @@ UA_Server_addDataSourceVariableNode(UA_Server *server, const UA_NodeId requested
     node->value.dataSource = dataSource;
     UA_DataValue_deleteMembers(&value);
     if(retval != UA_STATUSCODE_GOOD) {
-        UA_NodeStore_deleteNode((UA_Node*)node);
+        UA_NodeStore_deleteNode(server->nodestore, (UA_Node*)node);
         UA_RCU_UNLOCK();
         return retval;
     }
@@ -909,7 +923,7 @@ UA_Server_addMethodNode(UA_Server *server, const UA_NodeId requestedNewNodeId,
                         size_t inputArgumentsSize, const UA_Argument* inputArguments,
                         size_t outputArgumentsSize, const UA_Argument* outputArguments,
                         UA_NodeId *outNewNodeId) {
-    UA_MethodNode *node = UA_NodeStore_newMethodNode();
+    UA_MethodNode *node = UA_NodeStore_newMethodNode(server->nodestore);
     if(!node)
         return UA_STATUSCODE_BADOUTOFMEMORY;
 
@@ -937,7 +951,7 @@ UA_Server_addMethodNode(UA_Server *server, const UA_NodeId requestedNewNodeId,
     const UA_NodeId propertytype = UA_NODEID_NUMERIC(0, UA_NS0ID_PROPERTYTYPE);
 
     if(inputArgumentsSize > 0) {
-        UA_VariableNode *inputArgumentsVariableNode = UA_NodeStore_newVariableNode();
+        UA_VariableNode *inputArgumentsVariableNode = UA_NodeStore_newVariableNode(server->nodestore);
         inputArgumentsVariableNode->nodeId.namespaceIndex = newMethodId.namespaceIndex;
         inputArgumentsVariableNode->browseName = UA_QUALIFIEDNAME_ALLOC(0, "InputArguments");
         inputArgumentsVariableNode->displayName = UA_LOCALIZEDTEXT_ALLOC("en_US", "InputArguments");
@@ -969,7 +983,7 @@ UA_Server_addMethodNode(UA_Server *server, const UA_NodeId requestedNewNodeId,
 
     if(outputArgumentsSize > 0) {
         /* create OutputArguments */
-        UA_VariableNode *outputArgumentsVariableNode  = UA_NodeStore_newVariableNode();
+        UA_VariableNode *outputArgumentsVariableNode  = UA_NodeStore_newVariableNode(server->nodestore);
         outputArgumentsVariableNode->nodeId.namespaceIndex = newMethodId.namespaceIndex;
         outputArgumentsVariableNode->browseName  = UA_QUALIFIEDNAME_ALLOC(0, "OutputArguments");
         outputArgumentsVariableNode->displayName = UA_LOCALIZEDTEXT_ALLOC("en_US", "OutputArguments");
@@ -1014,26 +1028,13 @@ deleteOneWayReference(UA_Server *server, UA_Session *session, UA_Node *node,
 static UA_StatusCode
 addOneWayReference(UA_Server *server, UA_Session *session,
                    UA_Node *node, const UA_AddReferencesItem *item) {
-    size_t i = node->referencesSize;
-    size_t refssize = (i+1) | 3; // so the realloc is not necessary every time
-    UA_ReferenceNode *new_refs = UA_realloc(node->references, sizeof(UA_ReferenceNode) * refssize);
-    if(!new_refs)
-        return UA_STATUSCODE_BADOUTOFMEMORY;
-    node->references = new_refs;
-    UA_ReferenceNode_init(&new_refs[i]);
-    UA_StatusCode retval = UA_NodeId_copy(&item->referenceTypeId, &new_refs[i].referenceTypeId);
-    retval |= UA_ExpandedNodeId_copy(&item->targetNodeId, &new_refs[i].targetId);
-    new_refs[i].isInverse = !item->isForward;
-    if(retval == UA_STATUSCODE_GOOD)
-        node->referencesSize = i+1;
-    else
-        UA_ReferenceNode_deleteMembers(&new_refs[i]);
-    return retval;
+    return UA_Node_addReference(node, &item->referenceTypeId, !item->isForward,
+                                &item->targetNodeId);
 }
 
-UA_StatusCode
-Service_AddReferences_single(UA_Server *server, UA_Session *session,
-                             const UA_AddReferencesItem *item) {
+static UA_StatusCode
+addReferences_single(UA_Server *server, UA_Session *session,
+                     const UA_AddReferencesItem *item) {
     /* Currently no expandednodeids are allowed */
     if(item->targetServerUri.length > 0)
         return UA_STATUSCODE_BADNOTIMPLEMENTED;
@@ -1107,6 +1108,19 @@ Service_AddReferences_single(UA_Server *server, UA_Session *session,
     return retval;
 }
 
+UA_StatusCode
+Service_AddReferences_single(UA_Server *server, UA_Session *session,
+                             const UA_AddReferencesItem *item) {
+    UA_StatusCode retval = addReferences_single(server, session, item);
+    const UA_NodeId hasSubtype = UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE);
+    const UA_NodeId hasTypeDefinition = UA_NODEID_NUMERIC(0, UA_NS0ID_HASTYPEDEFINITION);
+    if(UA_NodeId_equal(&item->referenceTypeId, &hasSubtype))
+        UA_Server_invalidateTypeClosures(server);
+    else if(UA_NodeId_equal(&item->referenceTypeId, &hasTypeDefinition))
+        UA_Server_invalidateTypeInstances(server);
+    return retval;
+}
+
 void Service_AddReferences(UA_Server *server, UA_Session *session,
                            const UA_AddReferencesRequest *request,
                            UA_AddReferencesResponse *response) {
@@ -1218,7 +1232,16 @@ Service_DeleteNodes_single(UA_Server *server, UA_Session *session,
     if(deleteReferences)
         removeReferences(server, session, node);
 
-    return UA_NodeStore_remove(server->nodestore, nodeId);
+    UA_NodeClass nodeClass = node->nodeClass;
+    UA_Server_beginNodesChange(server);
+    UA_StatusCode retval = UA_NodeStore_remove(server->nodestore, nodeId);
+    UA_Server_endNodesChange(server);
+    if(nodeClass == UA_NODECLASS_REFERENCETYPE || nodeClass == UA_NODECLASS_DATATYPE)
+        UA_Server_invalidateTypeClosures(server);
+    if(nodeClass == UA_NODECLASS_OBJECT || nodeClass == UA_NODECLASS_VARIABLE)
+        UA_Server_invalidateTypeInstances(server);
+    UA_Server_invalidateChildIndexes(server);
+    return retval;
 }
 
 void Service_DeleteNodes(UA_Server *server, UA_Session *session,
@@ -1263,30 +1286,8 @@ UA_Server_deleteNode(UA_Server *server, const UA_NodeId nodeId,
 static UA_StatusCode
 deleteOneWayReference(UA_Server *server, UA_Session *session, UA_Node *node,
                       const UA_DeleteReferencesItem *item) {
-    UA_Boolean edited = false;
-    for(size_t i = node->referencesSize; i > 0; --i) {
-        UA_ReferenceNode *ref = &node->references[i-1];
-        if(!UA_NodeId_equal(&item->targetNodeId.nodeId, &ref->targetId.nodeId))
-            continue;
-        if(!UA_NodeId_equal(&item->referenceTypeId, &ref->referenceTypeId))
-            continue;
-        if(item->isForward == ref->isInverse)
-            continue;
-        UA_ReferenceNode_deleteMembers(ref);
-        /* move the last entry to override the current position */
-        node->references[i-1] = node->references[node->referencesSize-1];
-        --node->referencesSize;
-        edited = true;
-        break;
-    }
-    if(!edited)
-        return UA_STATUSCODE_UNCERTAINREFERENCENOTDELETED;
-    /* we removed the last reference */
-    if(node->referencesSize == 0 && node->references) {
-        UA_free(node->references);
-        node->references = NULL;
-    }
-    return UA_STATUSCODE_GOOD;;
+    return UA_Node_deleteReference(node, &item->referenceTypeId, !item->isForward,
+                                   &item->targetNodeId.nodeId);
 }
 
 UA_StatusCode
@@ -1294,18 +1295,24 @@ Service_DeleteReferences_single(UA_Server *server, UA_Session *session,
                                 const UA_DeleteReferencesItem *item) {
     UA_StatusCode retval = UA_Server_editNode(server, session, &item->sourceNodeId,
                                               (UA_EditNodeCallback)deleteOneWayReference, item);
-    if(retval != UA_STATUSCODE_GOOD)
-        return retval;
-    if(!item->deleteBidirectional || item->targetNodeId.serverIndex != 0)
-        return retval;
-    UA_DeleteReferencesItem secondItem;
-    UA_DeleteReferencesItem_init(&secondItem);
-    secondItem.isForward = !item->isForward;
-    secondItem.sourceNodeId = item->targetNodeId.nodeId;
-    secondItem.targetNodeId.nodeId = item->sourceNodeId;
-    secondItem.referenceTypeId = item->referenceTypeId;
-    return UA_Server_editNode(server, session, &secondItem.sourceNodeId,
-                              (UA_EditNodeCallback)deleteOneWayReference, &secondItem);
+    if(retval == UA_STATUSCODE_GOOD && item->deleteBidirectional &&
+       item->targetNodeId.serverIndex == 0) {
+        UA_DeleteReferencesItem secondItem;
+        UA_DeleteReferencesItem_init(&secondItem);
+        secondItem.isForward = !item->isForward;
+        secondItem.sourceNodeId = item->targetNodeId.nodeId;
+        secondItem.targetNodeId.nodeId = item->sourceNodeId;
+        secondItem.referenceTypeId = item->referenceTypeId;
+        retval = UA_Server_editNode(server, session, &secondItem.sourceNodeId,
+                                    (UA_EditNodeCallback)deleteOneWayReference, &secondItem);
+    }
+    const UA_NodeId hasSubtype = UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE);
+    const UA_NodeId hasTypeDefinition = UA_NODEID_NUMERIC(0, UA_NS0ID_HASTYPEDEFINITION);
+    if(UA_NodeId_equal(&item->referenceTypeId, &hasSubtype))
+        UA_Server_invalidateTypeClosures(server);
+    else if(UA_NodeId_equal(&item->referenceTypeId, &hasTypeDefinition))
+        UA_Server_invalidateTypeInstances(server);
+    return retval;
 }
 
 void
@@ -1428,6 +1435,7 @@ UA_Server_setObjectTypeNode_lifecycleManagement(UA_Server *server, UA_NodeId nod
 
 struct addMethodCallback {
     UA_MethodCallback callback;
+    UA_AsyncMethodCallback asyncCallback;
     void *handle;
 };
 
@@ -1439,6 +1447,7 @@ editMethodCallback(UA_Server *server, UA_Session* session,
     const struct addMethodCallback *newCallback = handle;
     UA_MethodNode *mnode = (UA_MethodNode*) node;
     mnode->attachedMethod = newCallback->callback;
+    mnode->asyncMethod    = newCallback->asyncCallback;
     mnode->methodHandle   = newCallback->handle;
     return UA_STATUSCODE_GOOD;
 }
@@ -1446,7 +1455,18 @@ editMethodCallback(UA_Server *server, UA_Session* session,
 UA_StatusCode UA_EXPORT
 UA_Server_setMethodNode_callback(UA_Server *server, const UA_NodeId methodNodeId,
                                  UA_MethodCallback method, void *handle) {
-    struct addMethodCallback cb = { method, handle };
+    struct addMethodCallback cb = { method, NULL, handle };
+    UA_RCU_LOCK();
+    UA_StatusCode retval = UA_Server_editNode(server, &adminSession,
+                                              &methodNodeId, editMethodCallback, &cb);
+    UA_RCU_UNLOCK();
+    return retval;
+}
+
+UA_StatusCode UA_EXPORT
+UA_Server_setMethodNode_asyncCallback(UA_Server *server, const UA_NodeId methodNodeId,
+                                      UA_AsyncMethodCallback method, void *handle) {
+    struct addMethodCallback cb = { NULL, method, handle };
     UA_RCU_LOCK();
     UA_StatusCode retval = UA_Server_editNode(server, &adminSession,
                                               &methodNodeId, editMethodCallback, &cb);
@@ -1455,3 +1475,451 @@ UA_Server_setMethodNode_callback(UA_Server *server, const UA_NodeId methodNodeId
 }
 
 #endif
+
+/****************/
+/* Bulk Loading */
+/****************/
+
+/* Objects and variables of the batch are held back from the nodestore until
+ * their references are added. All other nodes (types) are inserted right away,
+ * so that the following nodes of the batch can be checked against them. */
+typedef struct {
+    const UA_AddNodesItem *item;
+    UA_Node *node; /* held back. NULL when inserted or failed. */
+    const UA_Node *type; /* the type of held objects and variables */
+    UA_StatusCode result;
+} UA_BulkNode;
+
+/* A reference to add to a node that is already in the nodestore */
+typedef struct {
+    const UA_Node *source;
+    const UA_NodeId *referenceTypeId;
+    const UA_NodeId *targetId;
+    const UA_StatusCode *targetResult; /* NULL if the target was not in the batch */
+    UA_Boolean isInverse;
+    size_t order; /* keep the batch order of the references in the node */
+} UA_BulkReference;
+
+/* Consecutive nodes of a batch mostly share the parent and the type. So the
+ * last lookups are remembered. */
+#define UA_BULKLOAD_RECENT 4
+
+typedef struct {
+    const UA_NodeId *nodeId;
+    const UA_Node *node;
+    UA_BulkNode *bulkNode;
+} UA_BulkLookup;
+
+typedef struct {
+    UA_Server *server;
+    UA_BulkNode *nodes;
+    UA_BulkNode **held; /* sorted by the NodeId */
+    size_t heldSize;
+    UA_BulkLookup recent[UA_BULKLOAD_RECENT];
+    size_t recentNext;
+    UA_BulkReference *refs;
+    size_t refsSize;
+    size_t refsCapacity;
+} UA_BulkLoad;
+
+static int
+compareBulkNodes(const void *a, const void *b) {
+    const UA_BulkNode *n1 = *(UA_BulkNode * const *)a;
+    const UA_BulkNode *n2 = *(UA_BulkNode * const *)b;
+    int order = UA_NodeStoreImage_order(&n1->item->requestedNewNodeId.nodeId,
+                                        &n2->item->requestedNewNodeId.nodeId);
+    if(order != 0)
+        return order;
+    return (n1 < n2) ? -1 : 1; /* the first in the batch comes first */
+}
+
+static int
+compareBulkReferences(const void *a, const void *b) {
+    const UA_BulkReference *r1 = (const UA_BulkReference*)a;
+    const UA_BulkReference *r2 = (const UA_BulkReference*)b;
+    if(r1->source != r2->source)
+        return ((uintptr_t)r1->source < (uintptr_t)r2->source) ? -1 : 1;
+    return (r1->order < r2->order) ? -1 : 1;
+}
+
+/* Finds a node of the batch or the nodestore. Failed nodes are not found. */
+static const UA_Node *
+findBulkNode(UA_BulkLoad *bl, const UA_NodeId *nodeId, UA_BulkNode **bulkNode) {
+    for(size_t i = 0; i < UA_BULKLOAD_RECENT; ++i) {
+        UA_BulkLookup *lookup = &bl->recent[i];
+        if(lookup->nodeId && UA_NodeId_equal(lookup->nodeId, nodeId)) {
+            *bulkNode = lookup->bulkNode;
+            return lookup->node;
+        }
+    }
+    UA_BulkLookup *lookup = &bl->recent[bl->recentNext];
+    bl->recentNext = (bl->recentNext + 1) % UA_BULKLOAD_RECENT;
+    lookup->nodeId = nodeId;
+    lookup->bulkNode = NULL;
+    lookup->node = NULL;
+    *bulkNode = NULL;
+
+    size_t low = 0;
+    size_t high = bl->heldSize;
+    while(low < high) {
+        size_t mid = low + ((high - low) / 2);
+        if(UA_NodeStoreImage_order(&bl->held[mid]->item->requestedNewNodeId.nodeId,
+                                   nodeId) < 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    if(low < bl->heldSize &&
+       UA_NodeId_equal(&bl->held[low]->item->requestedNewNodeId.nodeId, nodeId)) {
+        lookup->bulkNode = bl->held[low];
+        lookup->node = bl->held[low]->node;
+    } else {
+        lookup->node = UA_NodeStore_get(bl->server->nodestore, nodeId);
+    }
+    *bulkNode = lookup->bulkNode;
+    return lookup->node;
+}
+
+static void
+forgetBulkLookups(UA_BulkLoad *bl) {
+    memset(bl->recent, 0, sizeof(bl->recent));
+}
+
+static void
+failBulkNode(UA_BulkLoad *bl, UA_BulkNode *bn, UA_StatusCode result) {
+    forgetBulkLookups(bl);
+    bn->result = result;
+    if(bn->node) {
+        UA_NodeStore_deleteNode(bl->server->nodestore, bn->node);
+        bn->node = NULL;
+    } else {
+        UA_Server_beginNodesChange(bl->server);
+        UA_NodeStore_remove(bl->server->nodestore, &bn->item->requestedNewNodeId.nodeId);
+        UA_Server_endNodesChange(bl->server);
+    }
+}
+
+/* Adds the reference right away if the source is held back. Otherwise, the
+ * reference is collected to be added with the others of the same source. */
+static UA_StatusCode
+addBulkReference(UA_BulkLoad *bl, const UA_NodeId *sourceId, const UA_NodeId *referenceTypeId,
+                 UA_Boolean isInverse, const UA_NodeId *targetId) {
+    UA_BulkNode *source;
+    const UA_Node *node = findBulkNode(bl, sourceId, &source);
+    if(!node)
+        return UA_STATUSCODE_BADNODEIDUNKNOWN;
+    if(source) {
+        UA_ExpandedNodeId target;
+        UA_ExpandedNodeId_init(&target);
+        target.nodeId = *targetId;
+        return UA_Node_addReference(source->node, referenceTypeId, isInverse, &target);
+    }
+
+    if(bl->refsSize == bl->refsCapacity) {
+        size_t ncapacity = (bl->refsCapacity > 0) ? bl->refsCapacity * 2 : 1024;
+        UA_BulkReference *nrefs = UA_realloc(bl->refs, sizeof(UA_BulkReference) * ncapacity);
+        if(!nrefs)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        bl->refs = nrefs;
+        bl->refsCapacity = ncapacity;
+    }
+    UA_BulkNode *target;
+    findBulkNode(bl, targetId, &target);
+    UA_BulkReference *ref = &bl->refs[bl->refsSize];
+    ref->source = node;
+    ref->referenceTypeId = referenceTypeId;
+    ref->targetId = targetId;
+    ref->targetResult = target ? &target->result : NULL;
+    ref->isInverse = isInverse;
+    ref->order = bl->refsSize;
+    ++bl->refsSize;
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+addBulkReferencePair(UA_BulkLoad *bl, const UA_NodeId *sourceId,
+                     const UA_NodeId *referenceTypeId, UA_Boolean isForward,
+                     const UA_NodeId *targetId) {
+    UA_StatusCode retval = addBulkReference(bl, sourceId, referenceTypeId, !isForward, targetId);
+    if(retval == UA_STATUSCODE_GOOD)
+        retval = addBulkReference(bl, targetId, referenceTypeId, isForward, sourceId);
+    return retval;
+}
+
+/* Drops the collected references of a node that is removed again */
+static void
+dropBulkReferences(UA_BulkLoad *bl, const UA_Node *source) {
+    size_t kept = 0;
+    for(size_t i = 0; i < bl->refsSize; ++i) {
+        if(bl->refs[i].source != source)
+            bl->refs[kept++] = bl->refs[i];
+    }
+    bl->refsSize = kept;
+}
+
+/* The collected references of one source node */
+typedef struct {
+    const UA_BulkReference *refs;
+    size_t refsSize;
+} UA_BulkReferenceGroup;
+
+static UA_StatusCode
+addBulkReferenceGroup(UA_Server *server, UA_Session *session,
+                      UA_Node *node, const UA_BulkReferenceGroup *group) {
+    UA_ExpandedNodeId target;
+    UA_ExpandedNodeId_init(&target);
+    for(size_t i = 0; i < group->refsSize; ++i) {
+        const UA_BulkReference *ref = &group->refs[i];
+        if(ref->targetResult && *ref->targetResult != UA_STATUSCODE_GOOD)
+            continue;
+        target.nodeId = *ref->targetId;
+        UA_StatusCode retval = UA_Node_addReference(node, ref->referenceTypeId,
+                                                    ref->isInverse, &target);
+        if(retval != UA_STATUSCODE_GOOD)
+            return retval;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Run the checks of AddNodes for the entire batch. Nodes below a failed
+ * parent fail as well. So repeat until no more nodes fail. */
+static void
+validateBulkNodes(UA_BulkLoad *bl, size_t nodesSize) {
+    UA_Server *server = bl->server;
+    const UA_NodeId basedatavariabletype = UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE);
+    const UA_NodeId baseobjecttype = UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE);
+    UA_Boolean failed;
+    do {
+        failed = false;
+        for(size_t i = 0; i < nodesSize; ++i) {
+            UA_BulkNode *bn = &bl->nodes[i];
+            if(bn->result != UA_STATUSCODE_GOOD)
+                continue;
+            const UA_AddNodesItem *item = bn->item;
+            UA_BulkNode *parentBulkNode;
+            const UA_Node *parent =
+                findBulkNode(bl, &item->parentNodeId.nodeId, &parentBulkNode);
+            if(!parent) {
+                failBulkNode(bl, bn, UA_STATUSCODE_BADPARENTNODEIDINVALID);
+                failed = true;
+                continue;
+            }
+            UA_StatusCode retval =
+                checkReferenceToParent(server, &adminSession, item->nodeClass,
+                                       parent, &item->referenceTypeId);
+            if(retval != UA_STATUSCODE_GOOD) {
+                failBulkNode(bl, bn, retval);
+                failed = true;
+                continue;
+            }
+            /* The type is looked up again in every pass. It may have failed
+             * (and was removed) since the last pass. */
+            if(!bn->node)
+                continue;
+            const UA_NodeId *typeId = &item->typeDefinition.nodeId;
+            if(UA_NodeId_isNull(typeId))
+                typeId = (item->nodeClass == UA_NODECLASS_VARIABLE) ?
+                    &basedatavariabletype : &baseobjecttype;
+            bn->type = getInstantiableType(server, item->nodeClass, typeId);
+            if(!bn->type) {
+                failBulkNode(bl, bn, UA_STATUSCODE_BADTYPEDEFINITIONINVALID);
+                failed = true;
+            }
+        }
+    } while(failed);
+}
+
+static UA_StatusCode
+validateBulkReference(UA_BulkLoad *bl, const UA_AddReferencesItem *item) {
+    if(item->targetServerUri.length > 0)
+        return UA_STATUSCODE_BADNOTIMPLEMENTED;
+    UA_BulkNode *bn;
+    if(!findBulkNode(bl, &item->sourceNodeId, &bn))
+        return UA_STATUSCODE_BADSOURCENODEIDINVALID;
+    if(!findBulkNode(bl, &item->targetNodeId.nodeId, &bn))
+        return UA_STATUSCODE_BADTARGETNODEIDINVALID;
+    const UA_Node *refType = findBulkNode(bl, &item->referenceTypeId, &bn);
+    if(!refType || refType->nodeClass != UA_NODECLASS_REFERENCETYPE)
+        return UA_STATUSCODE_BADREFERENCETYPEIDINVALID;
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+addNodesBulk(UA_BulkLoad *bl, size_t nodesSize, const UA_AddNodesItem *nodes,
+             size_t referencesSize, const UA_AddReferencesItem *references,
+             UA_StatusCode *referenceResults) {
+    UA_Server *server = bl->server;
+
+    /* Create the nodes. Types are inserted right away. */
+    for(size_t i = 0; i < nodesSize; ++i) {
+        UA_BulkNode *bn = &bl->nodes[i];
+        const UA_AddNodesItem *item = &nodes[i];
+        bn->item = item;
+        const UA_NodeId *nodeId = &item->requestedNewNodeId.nodeId;
+        if(UA_NodeId_isNull(nodeId) || nodeId->namespaceIndex >= server->namespacesSize) {
+            bn->result = UA_STATUSCODE_BADNODEIDINVALID;
+            continue;
+        }
+        UA_Node *node = NULL;
+        bn->result = createNodeFromAttributes(server, item, &node);
+        if(bn->result != UA_STATUSCODE_GOOD)
+            continue;
+        if(node->nodeClass == UA_NODECLASS_OBJECT || node->nodeClass == UA_NODECLASS_VARIABLE) {
+            bn->node = node;
+            bl->held[bl->heldSize++] = bn;
+        } else {
+            bn->result = UA_NodeStore_insert(server->nodestore, node);
+        }
+    }
+
+    /* Sort the held nodes for the lookup. Reject duplicate NodeIds. */
+    qsort(bl->held, bl->heldSize, sizeof(UA_BulkNode*), compareBulkNodes);
+    for(size_t i = 0; i < bl->heldSize; ++i) {
+        UA_BulkNode *bn = bl->held[i];
+        const UA_NodeId *nodeId = &bn->item->requestedNewNodeId.nodeId;
+        if((i > 0 && UA_NodeId_equal(&bl->held[i-1]->item->requestedNewNodeId.nodeId, nodeId)) ||
+           UA_NodeStore_get(server->nodestore, nodeId))
+            failBulkNode(bl, bn, UA_STATUSCODE_BADNODEIDEXISTS);
+    }
+
+    validateBulkNodes(bl, nodesSize);
+    for(size_t i = 0; i < referencesSize; ++i)
+        referenceResults[i] = validateBulkReference(bl, &references[i]);
+
+    /* Link the references. The references of held nodes are added directly. */
+    const UA_NodeId hasTypeDefinition = UA_NODEID_NUMERIC(0, UA_NS0ID_HASTYPEDEFINITION);
+    for(size_t i = 0; i < nodesSize; ++i) {
+        UA_BulkNode *bn = &bl->nodes[i];
+        if(bn->result != UA_STATUSCODE_GOOD)
+            continue;
+        const UA_AddNodesItem *item = bn->item;
+        UA_StatusCode retval =
+            addBulkReferencePair(bl, &item->requestedNewNodeId.nodeId, &item->referenceTypeId,
+                                 false, &item->parentNodeId.nodeId);
+        if(bn->type) {
+            retval |= addBulkReferencePair(bl, &item->requestedNewNodeId.nodeId,
+                                           &hasTypeDefinition, true, &bn->type->nodeId);
+            if(bn->type->nodeClass == UA_NODECLASS_OBJECTTYPE) {
+                const UA_ObjectLifecycleManagement *olm =
+                    &((const UA_ObjectTypeNode*)bn->type)->lifecycleManagement;
+                if(olm->constructor)
+                    ((UA_ObjectNode*)bn->node)->instanceHandle = olm->constructor(bn->node->nodeId);
+            }
+        }
+        if(retval != UA_STATUSCODE_GOOD) {
+            if(!bn->node)
+                dropBulkReferences(bl, UA_NodeStore_get(server->nodestore,
+                                                        &item->requestedNewNodeId.nodeId));
+            failBulkNode(bl, bn, retval);
+        }
+    }
+    for(size_t i = 0; i < referencesSize; ++i) {
+        if(referenceResults[i] != UA_STATUSCODE_GOOD)
+            continue;
+        const UA_AddReferencesItem *item = &references[i];
+        referenceResults[i] =
+            addBulkReferencePair(bl, &item->sourceNodeId, &item->referenceTypeId,
+                                 item->isForward, &item->targetNodeId.nodeId);
+    }
+
+    /* Insert the held nodes */
+    UA_Node **insert = (UA_Node**)bl->held; /* reuse the memory */
+    size_t insertSize = 0;
+    for(size_t i = 0; i < nodesSize; ++i) {
+        if(bl->nodes[i].node)
+            insert[insertSize++] = bl->nodes[i].node;
+    }
+    UA_StatusCode retval = UA_NodeStore_reserve(server->nodestore, insertSize, insert);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    bl->heldSize = 0; /* all nodes are found in the nodestore from here on */
+    forgetBulkLookups(bl);
+    for(size_t i = 0; i < nodesSize; ++i) {
+        UA_BulkNode *bn = &bl->nodes[i];
+        if(!bn->node)
+            continue;
+        bn->result = UA_NodeStore_insert(server->nodestore, bn->node);
+        bn->node = NULL;
+    }
+
+    /* Add the collected references with one edit per source node. The nodes
+     * are inserted. So continue with the other sources if one fails. */
+    qsort(bl->refs, bl->refsSize, sizeof(UA_BulkReference), compareBulkReferences);
+    for(size_t i = 0; i < bl->refsSize;) {
+        UA_BulkReferenceGroup group;
+        group.refs = &bl->refs[i];
+        group.refsSize = 1;
+        while(i + group.refsSize < bl->refsSize &&
+              bl->refs[i + group.refsSize].source == group.refs->source)
+            ++group.refsSize;
+        UA_StatusCode res =
+            UA_Server_editNode(server, &adminSession, &group.refs->source->nodeId,
+                               (UA_EditNodeCallback)addBulkReferenceGroup, &group);
+        if(retval == UA_STATUSCODE_GOOD)
+            retval = res;
+        i += group.refsSize;
+    }
+    return retval;
+}
+
+UA_StatusCode
+UA_Server_addNodesBulk(UA_Server *server, size_t nodesSize, const UA_AddNodesItem *nodes,
+                       size_t referencesSize, const UA_AddReferencesItem *references,
+                       UA_StatusCode *nodeResults, UA_StatusCode *referenceResults) {
+    UA_BulkLoad bl;
+    memset(&bl, 0, sizeof(UA_BulkLoad));
+    bl.server = server;
+    bl.nodes = UA_calloc(nodesSize + 1, sizeof(UA_BulkNode));
+    bl.held = UA_malloc(sizeof(UA_BulkNode*) * (nodesSize + 1));
+    UA_StatusCode *refResults = referenceResults;
+    if(!referenceResults)
+        refResults = UA_malloc(sizeof(UA_StatusCode) * (referencesSize + 1));
+    if(!bl.nodes || !bl.held || !refResults) {
+        UA_free(bl.nodes);
+        UA_free(bl.held);
+        if(!referenceResults)
+            UA_free(refResults);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+
+    UA_RCU_LOCK();
+    UA_StatusCode retval = addNodesBulk(&bl, nodesSize, nodes, referencesSize,
+                                        references, refResults);
+    /* Nodes that are still held were not inserted */
+    for(size_t i = 0; i < nodesSize; ++i) {
+        if(!bl.nodes[i].node)
+            continue;
+        UA_NodeStore_deleteNode(server->nodestore, bl.nodes[i].node);
+        if(bl.nodes[i].result == UA_STATUSCODE_GOOD)
+            bl.nodes[i].result = (retval != UA_STATUSCODE_GOOD) ?
+                retval : UA_STATUSCODE_BADINTERNALERROR;
+    }
+    UA_RCU_UNLOCK();
+    UA_Server_invalidateTypeClosures(server);
+    UA_Server_invalidateTypeInstances(server);
+
+    /* Report the first failed node or reference */
+    size_t failedNodes = 0;
+    for(size_t i = 0; i < nodesSize; ++i) {
+        if(nodeResults)
+            nodeResults[i] = bl.nodes[i].result;
+        if(bl.nodes[i].result == UA_STATUSCODE_GOOD)
+            continue;
+        if(retval == UA_STATUSCODE_GOOD)
+            retval = bl.nodes[i].result;
+        ++failedNodes;
+    }
+    for(size_t i = 0; i < referencesSize && retval == UA_STATUSCODE_GOOD; ++i)
+        retval = refResults[i];
+    if(failedNodes > 0)
+        UA_LOG_INFO(server->config.logger, UA_LOGCATEGORY_SERVER,
+                    "Bulk loading: %lu of %lu nodes could not be added",
+                    (unsigned long)failedNodes, (unsigned long)nodesSize);
+
+    UA_free(bl.nodes);
+    UA_free(bl.held);
+    UA_free(bl.refs);
+    if(!referenceResults)
+        UA_free(refResults);
+    return retval;
+}
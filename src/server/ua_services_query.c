@@ -0,0 +1,1012 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+*  License, v. 2.0. If a copy of the MPL was not distributed with this
+*  file, You can obtain one at http://mozilla.org/MPL/2.0/.*/
+
+#include "ua_server_internal.h"
+#include "ua_services.h"
+
+/* Limits the walk up the type hierarchy (protects against HasSubtype cycles) */
+#define QUERY_MAXTYPEDEPTH 32
+
+/***********************/
+/* Type Instance Index */
+/***********************/
+
+typedef struct {
+    size_t instancesSize;
+    size_t capacity;
+    UA_TypeInstance *instances;
+    UA_StatusCode retval;
+} CollectInstancesContext;
+
+static void
+collectTypeInstances(void *visitorContext, const UA_Node *node) {
+    CollectInstancesContext *ctx = (CollectInstancesContext*)visitorContext;
+    if(ctx->retval != UA_STATUSCODE_GOOD ||
+       (node->nodeClass != UA_NODECLASS_OBJECT && node->nodeClass != UA_NODECLASS_VARIABLE))
+        return;
+    const UA_NodeId hasTypeDefinition = UA_NODEID_NUMERIC(0, UA_NS0ID_HASTYPEDEFINITION);
+    for(size_t i = 0; i < node->referencesSize; ++i) {
+        const UA_ReferenceNode *ref = &node->references[i];
+        if(ref->isInverse || !UA_NodeId_equal(&ref->referenceTypeId, &hasTypeDefinition)) {
+            i = UA_Node_referenceGroupEnd(node, i) - 1;
+            continue;
+        }
+        if(ctx->instancesSize == ctx->capacity) {
+            size_t capacity = ctx->capacity > 0 ? ctx->capacity * 2 : 1024;
+            UA_TypeInstance *instances =
+                UA_realloc(ctx->instances, sizeof(UA_TypeInstance) * capacity);
+            if(!instances) {
+                ctx->retval = UA_STATUSCODE_BADOUTOFMEMORY;
+                return;
+            }
+            ctx->instances = instances;
+            ctx->capacity = capacity;
+        }
+        UA_TypeInstance *ti = &ctx->instances[ctx->instancesSize];
+        UA_NodeId_init(&ti->instance);
+        ctx->retval = UA_NodeId_copy(&ref->targetId.nodeId, &ti->typeDefinition);
+        ctx->retval |= UA_NodeId_copy(&node->nodeId, &ti->instance);
+        if(ctx->retval != UA_STATUSCODE_GOOD) {
+            UA_NodeId_deleteMembers(&ti->typeDefinition);
+            UA_NodeId_deleteMembers(&ti->instance);
+            return;
+        }
+        ++ctx->instancesSize;
+    }
+}
+
+static int
+compareTypeInstances(const void *a, const void *b) {
+    const UA_TypeInstance *ta = (const UA_TypeInstance*)a;
+    const UA_TypeInstance *tb = (const UA_TypeInstance*)b;
+    int order = UA_NodeStoreImage_order(&ta->typeDefinition, &tb->typeDefinition);
+    if(order != 0)
+        return order;
+    return UA_NodeStoreImage_order(&ta->instance, &tb->instance);
+}
+
+static void
+deleteTypeInstanceIndex(UA_TypeInstanceIndex *tii) {
+    for(size_t i = 0; i < tii->instancesSize; ++i) {
+        UA_NodeId_deleteMembers(&tii->instances[i].typeDefinition);
+        UA_NodeId_deleteMembers(&tii->instances[i].instance);
+    }
+    UA_free(tii->instances);
+    UA_free(tii);
+}
+
+#ifdef UA_ENABLE_MULTITHREADING
+static void
+deleteTypeInstanceIndexRcu(struct rcu_head *head) {
+    deleteTypeInstanceIndex(container_of(head, UA_TypeInstanceIndex, rcu_head));
+}
+#endif
+
+static UA_TypeInstanceIndex *
+buildTypeInstanceIndex(UA_Server *server, UA_UInt32 version) {
+    UA_TypeInstanceIndex *tii = UA_calloc(1, sizeof(UA_TypeInstanceIndex));
+    if(!tii)
+        return NULL;
+    tii->version = version;
+    CollectInstancesContext ctx;
+    memset(&ctx, 0, sizeof(CollectInstancesContext));
+    UA_NodeStore_iterate(server->nodestore, &ctx, collectTypeInstances);
+    tii->instances = ctx.instances;
+    tii->instancesSize = ctx.instancesSize;
+    if(ctx.retval != UA_STATUSCODE_GOOD) {
+        deleteTypeInstanceIndex(tii);
+        return NULL;
+    }
+    qsort(tii->instances, tii->instancesSize, sizeof(UA_TypeInstance), compareTypeInstances);
+    return tii;
+}
+
+const UA_TypeInstanceIndex *
+UA_Server_getTypeInstanceIndex(UA_Server *server) {
+    UA_UInt32 version = server->typeInstancesVersion;
+#ifdef UA_ENABLE_MULTITHREADING
+    UA_TypeInstanceIndex *tii = rcu_dereference(server->typeInstances);
+#else
+    UA_TypeInstanceIndex *tii = server->typeInstances;
+#endif
+    if(tii && tii->version == version)
+        return tii;
+
+    UA_TypeInstanceIndex *newTii = buildTypeInstanceIndex(server, version);
+    if(!newTii)
+        return NULL;
+#ifdef UA_ENABLE_MULTITHREADING
+    UA_TypeInstanceIndex *seen = rcu_cmpxchg_pointer(&server->typeInstances, tii, newTii);
+    if(seen != tii) {
+        /* Another thread was faster */
+        deleteTypeInstanceIndex(newTii);
+        return seen;
+    }
+    if(tii)
+        call_rcu(&tii->rcu_head, deleteTypeInstanceIndexRcu);
+#else
+    if(tii)
+        deleteTypeInstanceIndex(tii);
+    server->typeInstances = newTii;
+#endif
+    return newTii;
+}
+
+void UA_Server_invalidateTypeInstances(UA_Server *server) {
+    UA_atomic_add(&server->typeInstancesVersion, 1);
+    UA_Server_invalidateBrowseCache(server);
+}
+
+void UA_Server_deleteTypeInstances(UA_Server *server) {
+    if(server->typeInstances)
+        deleteTypeInstanceIndex(server->typeInstances);
+    server->typeInstances = NULL;
+}
+
+/* Returns the number of instances of the type and the position of the first */
+static size_t
+findTypeInstances(const UA_TypeInstanceIndex *tii, const UA_NodeId *type, size_t *first) {
+    size_t low = 0;
+    size_t high = tii->instancesSize;
+    while(low < high) {
+        size_t mid = low + (high - low) / 2;
+        if(UA_NodeStoreImage_order(&tii->instances[mid].typeDefinition, type) < 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    size_t end = low;
+    while(end < tii->instancesSize &&
+          UA_NodeId_equal(&tii->instances[end].typeDefinition, type))
+        ++end;
+    *first = low;
+    return end - low;
+}
+
+/******************/
+/* Content Filter */
+/******************/
+
+static UA_StatusCode
+checkOperandsCount(UA_FilterOperator op, size_t operandsSize) {
+    size_t expected;
+    switch(op) {
+    case UA_FILTEROPERATOR_ISNULL:
+    case UA_FILTEROPERATOR_NOT:
+    case UA_FILTEROPERATOR_OFTYPE:
+        expected = 1;
+        break;
+    case UA_FILTEROPERATOR_EQUALS:
+    case UA_FILTEROPERATOR_GREATERTHAN:
+    case UA_FILTEROPERATOR_LESSTHAN:
+    case UA_FILTEROPERATOR_GREATERTHANOREQUAL:
+    case UA_FILTEROPERATOR_LESSTHANOREQUAL:
+    case UA_FILTEROPERATOR_AND:
+    case UA_FILTEROPERATOR_OR:
+        expected = 2;
+        break;
+    case UA_FILTEROPERATOR_BETWEEN:
+        expected = 3;
+        break;
+    case UA_FILTEROPERATOR_INLIST:
+        if(operandsSize < 2)
+            return UA_STATUSCODE_BADFILTEROPERANDCOUNTMISMATCH;
+        return UA_STATUSCODE_GOOD;
+    case UA_FILTEROPERATOR_LIKE:
+    case UA_FILTEROPERATOR_CAST:
+    case UA_FILTEROPERATOR_INVIEW:
+    case UA_FILTEROPERATOR_RELATEDTO:
+    case UA_FILTEROPERATOR_BITWISEAND:
+    case UA_FILTEROPERATOR_BITWISEOR:
+        return UA_STATUSCODE_BADFILTEROPERATORUNSUPPORTED;
+    default:
+        return UA_STATUSCODE_BADFILTEROPERATORINVALID;
+    }
+    if(operandsSize != expected)
+        return UA_STATUSCODE_BADFILTEROPERANDCOUNTMISMATCH;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Elements may only refer to later elements. So they are evaluated from the
+ * last to the first. */
+static UA_StatusCode
+checkOperand(const UA_ContentFilter *filter, size_t index, const UA_ExtensionObject *operand) {
+    if(operand->encoding < UA_EXTENSIONOBJECT_DECODED)
+        return UA_STATUSCODE_BADFILTEROPERANDINVALID;
+    const UA_DataType *type = operand->content.decoded.type;
+    const void *data = operand->content.decoded.data;
+    if(filter->elements[index].filterOperator == UA_FILTEROPERATOR_OFTYPE) {
+        if(type != &UA_TYPES[UA_TYPES_LITERALOPERAND] ||
+           !UA_Variant_isScalar(&((const UA_LiteralOperand*)data)->value) ||
+           ((const UA_LiteralOperand*)data)->value.type != &UA_TYPES[UA_TYPES_NODEID])
+            return UA_STATUSCODE_BADFILTEROPERANDINVALID;
+        return UA_STATUSCODE_GOOD;
+    }
+    if(type == &UA_TYPES[UA_TYPES_ELEMENTOPERAND]) {
+        UA_UInt32 element = ((const UA_ElementOperand*)data)->index;
+        if(element <= index || element >= filter->elementsSize)
+            return UA_STATUSCODE_BADFILTEROPERANDINVALID;
+        return UA_STATUSCODE_GOOD;
+    }
+    if(type == &UA_TYPES[UA_TYPES_LITERALOPERAND] ||
+       type == &UA_TYPES[UA_TYPES_ATTRIBUTEOPERAND] ||
+       type == &UA_TYPES[UA_TYPES_SIMPLEATTRIBUTEOPERAND])
+        return UA_STATUSCODE_GOOD;
+    return UA_STATUSCODE_BADFILTEROPERANDINVALID;
+}
+
+/* The element results are only returned if the filter is invalid */
+static UA_StatusCode
+checkContentFilter(const UA_ContentFilter *filter, UA_ContentFilterResult *result) {
+    if(filter->elementsSize == 0)
+        return UA_STATUSCODE_GOOD;
+    result->elementResults = UA_Array_new(filter->elementsSize,
+                                          &UA_TYPES[UA_TYPES_CONTENTFILTERELEMENTRESULT]);
+    if(!result->elementResults)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    result->elementResultsSize = filter->elementsSize;
+
+    UA_Boolean valid = true;
+    for(size_t i = 0; i < filter->elementsSize; ++i) {
+        const UA_ContentFilterElement *elm = &filter->elements[i];
+        UA_ContentFilterElementResult *er = &result->elementResults[i];
+        er->statusCode = checkOperandsCount(elm->filterOperator, elm->filterOperandsSize);
+        if(er->statusCode != UA_STATUSCODE_GOOD) {
+            valid = false;
+            continue;
+        }
+        er->operandStatusCodes = UA_Array_new(elm->filterOperandsSize,
+                                              &UA_TYPES[UA_TYPES_STATUSCODE]);
+        if(!er->operandStatusCodes) {
+            UA_ContentFilterResult_deleteMembers(result);
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        }
+        er->operandStatusCodesSize = elm->filterOperandsSize;
+        for(size_t j = 0; j < elm->filterOperandsSize; ++j) {
+            er->operandStatusCodes[j] = checkOperand(filter, i, &elm->filterOperands[j]);
+            if(er->operandStatusCodes[j] != UA_STATUSCODE_GOOD) {
+                er->statusCode = UA_STATUSCODE_BADFILTEROPERANDINVALID;
+                valid = false;
+            }
+        }
+    }
+
+    if(!valid)
+        return UA_STATUSCODE_BADCONTENTFILTERINVALID;
+    UA_ContentFilterResult_deleteMembers(result);
+    UA_ContentFilterResult_init(result);
+    return UA_STATUSCODE_GOOD;
+}
+
+/* The candidate that is filtered */
+typedef struct {
+    UA_Server *server;
+    UA_Session *session;
+    const UA_ContentFilter *filter;
+    const UA_Node *node;
+    const UA_NodeId *typeDefinition;
+    UA_Boolean *results; /* Of the elements, evaluated from the last to the first */
+} QueryContext;
+
+/* Walks up the HasSubtype references. Only the first supertype is followed. */
+static UA_Boolean
+isTypeOrSubtype(UA_Server *server, const UA_NodeId *type, const UA_NodeId *supertype) {
+    const UA_NodeId hasSubtype = UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE);
+    for(size_t depth = 0; depth < QUERY_MAXTYPEDEPTH; ++depth) {
+        if(UA_NodeId_equal(type, supertype))
+            return true;
+        const UA_Node *node = UA_NodeStore_get(server->nodestore, type);
+        if(!node)
+            return false;
+        const UA_NodeId *parent = NULL;
+        for(size_t i = 0; i < node->referencesSize; ++i) {
+            if(node->references[i].isInverse &&
+               UA_NodeId_equal(&node->references[i].referenceTypeId, &hasSubtype)) {
+                parent = &node->references[i].targetId.nodeId;
+                break;
+            }
+        }
+        if(!parent)
+            return false;
+        type = parent;
+    }
+    return false;
+}
+
+/* Returns the first target of a matching reference with the BrowseName. A null
+ * ReferenceTypeId matches all references. */
+static const UA_Node *
+findTarget(UA_Server *server, const UA_Node *node, const UA_NodeId *referenceTypeId,
+           UA_Boolean includeSubtypes, UA_Boolean isInverse, const UA_QualifiedName *name) {
+    for(size_t i = 0; i < node->referencesSize; ++i) {
+        const UA_ReferenceNode *ref = &node->references[i];
+        if(ref->isInverse != isInverse)
+            continue;
+        if(!UA_NodeId_isNull(referenceTypeId) &&
+           !UA_NodeId_equal(&ref->referenceTypeId, referenceTypeId) &&
+           (!includeSubtypes ||
+            !UA_Server_isSubtype(server, UA_TYPECLOSURE_REFERENCETYPES,
+                                 &ref->referenceTypeId, referenceTypeId))) {
+            i = UA_Node_referenceGroupEnd(node, i) - 1;
+            continue;
+        }
+        const UA_Node *target = UA_NodeStore_get(server->nodestore, &ref->targetId.nodeId);
+        if(target && target->browseName.namespaceIndex == name->namespaceIndex &&
+           UA_String_equal(&target->browseName.name, &name->name))
+            return target;
+    }
+    return NULL;
+}
+
+static const UA_Node *
+followRelativePath(UA_Server *server, const UA_Node *node, const UA_RelativePath *path) {
+    for(size_t i = 0; i < path->elementsSize && node; ++i) {
+        const UA_RelativePathElement *elm = &path->elements[i];
+        node = findTarget(server, node, &elm->referenceTypeId, elm->includeSubtypes,
+                          elm->isInverse, &elm->targetName);
+    }
+    return node;
+}
+
+/* Follows forward hierarchical references */
+static const UA_Node *
+followBrowsePath(UA_Server *server, const UA_Node *node, size_t browsePathSize,
+                 const UA_QualifiedName *browsePath) {
+    const UA_NodeId hierarchical = UA_NODEID_NUMERIC(0, UA_NS0ID_HIERARCHICALREFERENCES);
+    for(size_t i = 0; i < browsePathSize && node; ++i)
+        node = findTarget(server, node, &hierarchical, true, false, &browsePath[i]);
+    return node;
+}
+
+/* Moves the value of the attribute into the variant. Returns the status of the
+ * read. */
+static UA_StatusCode
+readQueryAttribute(QueryContext *ctx, const UA_Node *node, UA_UInt32 attributeId,
+                   const UA_String *indexRange, UA_Variant *value) {
+    UA_ReadValueId rvi;
+    UA_ReadValueId_init(&rvi);
+    rvi.nodeId = node->nodeId;
+    rvi.attributeId = attributeId;
+    rvi.indexRange = *indexRange;
+    UA_DataValue dv;
+    UA_DataValue_init(&dv);
+    Service_Read_single(ctx->server, ctx->session, UA_TIMESTAMPSTORETURN_NEITHER,
+                        &rvi, &dv, NULL);
+    UA_StatusCode retval = dv.hasStatus ? dv.status : UA_STATUSCODE_GOOD;
+    if(retval == UA_STATUSCODE_GOOD && dv.hasValue) {
+        *value = dv.value;
+        UA_Variant_init(&dv.value);
+    }
+    UA_DataValue_deleteMembers(&dv);
+    return retval;
+}
+
+/* The value of the operand. Operands that do not apply to the candidate are
+ * null. The variant needs to be deleted afterwards. */
+static void
+resolveOperand(QueryContext *ctx, const UA_ExtensionObject *operand, UA_Variant *value) {
+    UA_Variant_init(value);
+    const UA_DataType *type = operand->content.decoded.type;
+    const void *data = operand->content.decoded.data;
+    if(type == &UA_TYPES[UA_TYPES_LITERALOPERAND]) {
+        *value = ((const UA_LiteralOperand*)data)->value;
+        value->storageType = UA_VARIANT_DATA_NODELETE;
+        return;
+    }
+
+    /* Elements refer only to later elements that are already evaluated */
+    if(type == &UA_TYPES[UA_TYPES_ELEMENTOPERAND]) {
+        UA_Variant_setScalar(value, &ctx->results[((const UA_ElementOperand*)data)->index],
+                             &UA_TYPES[UA_TYPES_BOOLEAN]);
+        value->storageType = UA_VARIANT_DATA_NODELETE;
+        return;
+    }
+
+    const UA_NodeId *typeDefinition;
+    const UA_Node *node;
+    UA_UInt32 attributeId;
+    const UA_String *indexRange;
+    if(type == &UA_TYPES[UA_TYPES_SIMPLEATTRIBUTEOPERAND]) {
+        const UA_SimpleAttributeOperand *sao = (const UA_SimpleAttributeOperand*)data;
+        typeDefinition = &sao->typeDefinitionId;
+        node = followBrowsePath(ctx->server, ctx->node, sao->browsePathSize, sao->browsePath);
+        attributeId = sao->attributeId;
+        indexRange = &sao->indexRange;
+    } else {
+        const UA_AttributeOperand *ao = (const UA_AttributeOperand*)data;
+        typeDefinition = &ao->nodeId;
+        node = followRelativePath(ctx->server, ctx->node, &ao->browsePath);
+        attributeId = ao->attributeId;
+        indexRange = &ao->indexRange;
+    }
+    if(!node || (!UA_NodeId_isNull(typeDefinition) &&
+                 !isTypeOrSubtype(ctx->server, ctx->typeDefinition, typeDefinition)))
+        return;
+    readQueryAttribute(ctx, node, attributeId, indexRange, value);
+}
+
+/* The type is from UA_TYPES */
+static UA_Boolean
+isStandardType(const UA_DataType *type) {
+    return type->typeIndex < UA_TYPES_COUNT && type == &UA_TYPES[type->typeIndex];
+}
+
+/* Boolean to Double are the first types in UA_TYPES */
+static UA_Boolean
+isNumericType(const UA_DataType *type) {
+    return isStandardType(type) &&
+        (type->typeIndex <= UA_TYPES_DOUBLE ||
+         type->typeIndex == UA_TYPES_DATETIME || type->typeIndex == UA_TYPES_STATUSCODE);
+}
+
+static UA_Double
+numericToDouble(const UA_Variant *v) {
+    switch(v->type->typeIndex) {
+    case UA_TYPES_BOOLEAN: return *(const UA_Boolean*)v->data ? 1.0 : 0.0;
+    case UA_TYPES_SBYTE: return *(const UA_SByte*)v->data;
+    case UA_TYPES_BYTE: return *(const UA_Byte*)v->data;
+    case UA_TYPES_INT16: return *(const UA_Int16*)v->data;
+    case UA_TYPES_UINT16: return *(const UA_UInt16*)v->data;
+    case UA_TYPES_INT32: return *(const UA_Int32*)v->data;
+    case UA_TYPES_UINT32: return *(const UA_UInt32*)v->data;
+    case UA_TYPES_INT64: return (UA_Double)*(const UA_Int64*)v->data;
+    case UA_TYPES_UINT64: return (UA_Double)*(const UA_UInt64*)v->data;
+    case UA_TYPES_FLOAT: return *(const UA_Float*)v->data;
+    case UA_TYPES_DOUBLE: return *(const UA_Double*)v->data;
+    case UA_TYPES_DATETIME: return (UA_Double)*(const UA_DateTime*)v->data;
+    case UA_TYPES_STATUSCODE: return *(const UA_StatusCode*)v->data;
+    default: return 0.0;
+    }
+}
+
+static int
+compareStrings(const UA_String *s1, const UA_String *s2) {
+    size_t length = s1->length < s2->length ? s1->length : s2->length;
+    int order = length > 0 ? memcmp(s1->data, s2->data, length) : 0;
+    if(order != 0)
+        return order;
+    if(s1->length == s2->length)
+        return 0;
+    return s1->length < s2->length ? -1 : 1;
+}
+
+/* Scalars of the same type (or numbers) are compared. Returns false if the
+ * values cannot be compared. Integers of the same type are compared exactly,
+ * mixed numbers as double. */
+static UA_Boolean
+compareValues(const UA_Variant *v1, const UA_Variant *v2, int *order) {
+    if(!UA_Variant_isScalar(v1) || !UA_Variant_isScalar(v2))
+        return false;
+    const UA_DataType *type = v1->type;
+    if(isNumericType(type) && isNumericType(v2->type)) {
+        if(type == v2->type && type->typeIndex == UA_TYPES_INT64) {
+            UA_Int64 i1 = *(const UA_Int64*)v1->data, i2 = *(const UA_Int64*)v2->data;
+            *order = (i1 > i2) - (i1 < i2);
+            return true;
+        }
+        if(type == v2->type && type->typeIndex == UA_TYPES_UINT64) {
+            UA_UInt64 u1 = *(const UA_UInt64*)v1->data, u2 = *(const UA_UInt64*)v2->data;
+            *order = (u1 > u2) - (u1 < u2);
+            return true;
+        }
+        UA_Double d1 = numericToDouble(v1), d2 = numericToDouble(v2);
+        if(d1 != d1 || d2 != d2)
+            return false; /* NaN */
+        *order = (d1 > d2) - (d1 < d2);
+        return true;
+    }
+    if(type != v2->type || !isStandardType(type))
+        return false;
+    switch(type->typeIndex) {
+    case UA_TYPES_STRING:
+    case UA_TYPES_BYTESTRING:
+    case UA_TYPES_XMLELEMENT:
+        *order = compareStrings((const UA_String*)v1->data, (const UA_String*)v2->data);
+        return true;
+    case UA_TYPES_LOCALIZEDTEXT:
+        *order = compareStrings(&((const UA_LocalizedText*)v1->data)->text,
+                                &((const UA_LocalizedText*)v2->data)->text);
+        return true;
+    case UA_TYPES_QUALIFIEDNAME: {
+        const UA_QualifiedName *q1 = (const UA_QualifiedName*)v1->data;
+        const UA_QualifiedName *q2 = (const UA_QualifiedName*)v2->data;
+        *order = (q1->namespaceIndex > q2->namespaceIndex) -
+            (q1->namespaceIndex < q2->namespaceIndex);
+        if(*order == 0)
+            *order = compareStrings(&q1->name, &q2->name);
+        return true;
+    }
+    case UA_TYPES_NODEID:
+        *order = UA_NodeStoreImage_order((const UA_NodeId*)v1->data,
+                                         (const UA_NodeId*)v2->data);
+        return true;
+    case UA_TYPES_GUID:
+        *order = memcmp(v1->data, v2->data, sizeof(UA_Guid));
+        return true;
+    default:
+        return false;
+    }
+}
+
+static UA_Boolean
+operandIsTrue(QueryContext *ctx, const UA_ExtensionObject *operand) {
+    UA_Variant value;
+    resolveOperand(ctx, operand, &value);
+    UA_Boolean result = UA_Variant_isScalar(&value) &&
+        value.type == &UA_TYPES[UA_TYPES_BOOLEAN] && *(UA_Boolean*)value.data;
+    UA_Variant_deleteMembers(&value);
+    return result;
+}
+
+/* Compares the first operand with the operand at the position */
+static UA_Boolean
+compareOperands(QueryContext *ctx, const UA_ContentFilterElement *elm,
+                 const UA_Variant *first, size_t operand, int *order) {
+    UA_Variant value;
+    resolveOperand(ctx, &elm->filterOperands[operand], &value);
+    UA_Boolean comparable = compareValues(first, &value, order);
+    UA_Variant_deleteMembers(&value);
+    return comparable;
+}
+
+static UA_Boolean
+evaluateElement(QueryContext *ctx, size_t index) {
+    const UA_ContentFilterElement *elm = &ctx->filter->elements[index];
+    const UA_ExtensionObject *operands = elm->filterOperands;
+    switch(elm->filterOperator) {
+    case UA_FILTEROPERATOR_AND:
+        return operandIsTrue(ctx, &operands[0]) && operandIsTrue(ctx, &operands[1]);
+    case UA_FILTEROPERATOR_OR:
+        return operandIsTrue(ctx, &operands[0]) || operandIsTrue(ctx, &operands[1]);
+    case UA_FILTEROPERATOR_NOT:
+        return !operandIsTrue(ctx, &operands[0]);
+    case UA_FILTEROPERATOR_OFTYPE: {
+        const UA_LiteralOperand *lo = (const UA_LiteralOperand*)operands[0].content.decoded.data;
+        return isTypeOrSubtype(ctx->server, ctx->typeDefinition, (const UA_NodeId*)lo->value.data);
+    }
+    default:
+        break;
+    }
+
+    UA_Variant first;
+    resolveOperand(ctx, &operands[0], &first);
+    UA_Boolean result = false;
+    int order = 0;
+    switch(elm->filterOperator) {
+    case UA_FILTEROPERATOR_ISNULL:
+        result = UA_Variant_isEmpty(&first);
+        break;
+    case UA_FILTEROPERATOR_EQUALS:
+        result = compareOperands(ctx, elm, &first, 1, &order) && order == 0;
+        break;
+    case UA_FILTEROPERATOR_GREATERTHAN:
+        result = compareOperands(ctx, elm, &first, 1, &order) && order > 0;
+        break;
+    case UA_FILTEROPERATOR_LESSTHAN:
+        result = compareOperands(ctx, elm, &first, 1, &order) && order < 0;
+        break;
+    case UA_FILTEROPERATOR_GREATERTHANOREQUAL:
+        result = compareOperands(ctx, elm, &first, 1, &order) && order >= 0;
+        break;
+    case UA_FILTEROPERATOR_LESSTHANOREQUAL:
+        result = compareOperands(ctx, elm, &first, 1, &order) && order <= 0;
+        break;
+    case UA_FILTEROPERATOR_BETWEEN:
+        result = compareOperands(ctx, elm, &first, 1, &order) && order >= 0 &&
+            compareOperands(ctx, elm, &first, 2, &order) && order <= 0;
+        break;
+    case UA_FILTEROPERATOR_INLIST:
+        for(size_t i = 1; i < elm->filterOperandsSize && !result; ++i)
+            result = compareOperands(ctx, elm, &first, i, &order) && order == 0;
+        break;
+    default:
+        break;
+    }
+    UA_Variant_deleteMembers(&first);
+    return result;
+}
+
+/* Every element is evaluated once. Elements that are the operand of several
+ * other elements are not evaluated again. */
+static UA_Boolean
+evaluateFilter(QueryContext *ctx) {
+    for(size_t i = ctx->filter->elementsSize; i > 0; --i)
+        ctx->results[i - 1] = evaluateElement(ctx, i - 1);
+    return ctx->results[0];
+}
+
+/*******************/
+/* Query Data Sets */
+/*******************/
+
+typedef struct {
+    size_t nodeType; /* Position in the NodeTypes of the request */
+    UA_NodeId typeDefinition;
+    UA_NodeId instance;
+} QueryCandidate;
+
+struct UA_QueryContinuationPoint {
+    LIST_ENTRY(UA_QueryContinuationPoint) pointers;
+    UA_ByteString identifier;
+    size_t nodeTypesSize;
+    UA_NodeTypeDescription *nodeTypes;
+    UA_ContentFilter filter;
+    UA_UInt32 maxDataSets;
+    size_t candidatesSize;
+    QueryCandidate *candidates;
+    size_t position; /* The next candidate to be filtered */
+};
+
+static void
+deleteQueryCandidates(QueryCandidate *candidates, size_t candidatesSize) {
+    for(size_t i = 0; i < candidatesSize; ++i) {
+        UA_NodeId_deleteMembers(&candidates[i].typeDefinition);
+        UA_NodeId_deleteMembers(&candidates[i].instance);
+    }
+    UA_free(candidates);
+}
+
+static void
+deleteQueryCp(UA_QueryContinuationPoint *cp) {
+    UA_ByteString_deleteMembers(&cp->identifier);
+    UA_Array_delete(cp->nodeTypes, cp->nodeTypesSize, &UA_TYPES[UA_TYPES_NODETYPEDESCRIPTION]);
+    UA_ContentFilter_deleteMembers(&cp->filter);
+    deleteQueryCandidates(cp->candidates, cp->candidatesSize);
+    UA_free(cp);
+}
+
+static void
+removeQueryCp(UA_Session *session, UA_QueryContinuationPoint *cp) {
+    LIST_REMOVE(cp, pointers);
+    deleteQueryCp(cp);
+    ++session->availableQueryContinuationPoints;
+}
+
+void
+UA_Session_deleteQueryContinuationPoints(UA_Session *session) {
+    UA_QueryContinuationPoint *cp, *temp;
+    LIST_FOREACH_SAFE(cp, &session->queryContinuationPoints, pointers, temp)
+        removeQueryCp(session, cp);
+}
+
+/* Checks the NodeType and returns the type with all subtypes */
+static UA_StatusCode
+getQueryTypes(UA_Server *server, const UA_NodeTypeDescription *nodeType,
+              UA_ParsingResult *parsingResult, UA_NodeId **types, size_t *typesSize) {
+    const UA_ExpandedNodeId *typeId = &nodeType->typeDefinitionNode;
+    const UA_Node *typeNode = NULL;
+    if(typeId->serverIndex == 0 && typeId->namespaceUri.length == 0)
+        typeNode = UA_NodeStore_get(server->nodestore, &typeId->nodeId);
+    if(!typeNode || (typeNode->nodeClass != UA_NODECLASS_OBJECTTYPE &&
+                     typeNode->nodeClass != UA_NODECLASS_VARIABLETYPE)) {
+        parsingResult->statusCode = UA_STATUSCODE_BADTYPEDEFINITIONINVALID;
+        return parsingResult->statusCode;
+    }
+
+    for(size_t i = 0; i < nodeType->dataToReturnSize; ++i) {
+        UA_UInt32 attributeId = nodeType->dataToReturn[i].attributeId;
+        if(attributeId >= UA_ATTRIBUTEID_NODEID && attributeId <= UA_ATTRIBUTEID_USEREXECUTABLE)
+            continue;
+        if(!parsingResult->dataStatusCodes) {
+            parsingResult->dataStatusCodes =
+                UA_Array_new(nodeType->dataToReturnSize, &UA_TYPES[UA_TYPES_STATUSCODE]);
+            if(!parsingResult->dataStatusCodes)
+                return UA_STATUSCODE_BADOUTOFMEMORY;
+            parsingResult->dataStatusCodesSize = nodeType->dataToReturnSize;
+        }
+        parsingResult->dataStatusCodes[i] = UA_STATUSCODE_BADATTRIBUTEIDINVALID;
+        parsingResult->statusCode = UA_STATUSCODE_BADINVALIDARGUMENT;
+    }
+    if(parsingResult->statusCode != UA_STATUSCODE_GOOD)
+        return parsingResult->statusCode;
+
+    if(!nodeType->includeSubTypes) {
+        *types = UA_NodeId_new();
+        if(!*types)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        *typesSize = 1;
+        return UA_NodeId_copy(&typeNode->nodeId, *types);
+    }
+    return getTypeHierarchy(server->nodestore, typeNode, false, types, typesSize);
+}
+
+/* Appends the instances of the types from the index */
+static UA_StatusCode
+appendQueryCandidates(const UA_TypeInstanceIndex *tii, size_t nodeType,
+                      const UA_NodeId *types, size_t typesSize,
+                      QueryCandidate **candidates, size_t *candidatesSize, size_t *capacity) {
+    for(size_t i = 0; i < typesSize; ++i) {
+        size_t first;
+        size_t count = findTypeInstances(tii, &types[i], &first);
+        if(count == 0)
+            continue;
+        if(*candidatesSize + count > *capacity) {
+            size_t newCapacity = (*capacity > 0) ? *capacity : 64;
+            while(newCapacity < *candidatesSize + count)
+                newCapacity *= 2;
+            QueryCandidate *newCandidates =
+                UA_realloc(*candidates, sizeof(QueryCandidate) * newCapacity);
+            if(!newCandidates)
+                return UA_STATUSCODE_BADOUTOFMEMORY;
+            *candidates = newCandidates;
+            *capacity = newCapacity;
+        }
+        for(size_t j = first; j < first + count; ++j) {
+            QueryCandidate *c = &(*candidates)[*candidatesSize];
+            c->nodeType = nodeType;
+            UA_NodeId_init(&c->instance);
+            UA_StatusCode retval =
+                UA_NodeId_copy(&tii->instances[j].typeDefinition, &c->typeDefinition);
+            retval |= UA_NodeId_copy(&tii->instances[j].instance, &c->instance);
+            if(retval != UA_STATUSCODE_GOOD) {
+                UA_NodeId_deleteMembers(&c->typeDefinition);
+                UA_NodeId_deleteMembers(&c->instance);
+                return retval;
+            }
+            ++*candidatesSize;
+        }
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Looks up the instances of the NodeTypes. If a NodeType is invalid, the
+ * parsing results are returned. */
+static UA_StatusCode
+collectQueryCandidates(UA_Server *server, const UA_QueryFirstRequest *request,
+                       UA_QueryFirstResponse *response,
+                       QueryCandidate **candidates, size_t *candidatesSize) {
+    const UA_TypeInstanceIndex *tii = UA_Server_getTypeInstanceIndex(server);
+    UA_ParsingResult *parsingResults =
+        UA_Array_new(request->nodeTypesSize, &UA_TYPES[UA_TYPES_PARSINGRESULT]);
+    if(!tii || !parsingResults) {
+        UA_free(parsingResults);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+
+    size_t capacity = 0;
+    UA_Boolean invalid = false;
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    for(size_t i = 0; i < request->nodeTypesSize && retval == UA_STATUSCODE_GOOD; ++i) {
+        UA_NodeId *types = NULL;
+        size_t typesSize = 0;
+        retval = getQueryTypes(server, &request->nodeTypes[i], &parsingResults[i],
+                               &types, &typesSize);
+        if(parsingResults[i].statusCode != UA_STATUSCODE_GOOD) {
+            invalid = true;
+            retval = UA_STATUSCODE_GOOD;
+            continue;
+        }
+        if(retval == UA_STATUSCODE_GOOD && !invalid)
+            retval = appendQueryCandidates(tii, i, types, typesSize,
+                                           candidates, candidatesSize, &capacity);
+        UA_Array_delete(types, typesSize, &UA_TYPES[UA_TYPES_NODEID]);
+    }
+
+    if(retval == UA_STATUSCODE_GOOD && !invalid) {
+        UA_Array_delete(parsingResults, request->nodeTypesSize,
+                        &UA_TYPES[UA_TYPES_PARSINGRESULT]);
+        return UA_STATUSCODE_GOOD;
+    }
+    deleteQueryCandidates(*candidates, *candidatesSize);
+    *candidates = NULL;
+    *candidatesSize = 0;
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_Array_delete(parsingResults, request->nodeTypesSize,
+                        &UA_TYPES[UA_TYPES_PARSINGRESULT]);
+        return retval;
+    }
+    response->parsingResults = parsingResults;
+    response->parsingResultsSize = request->nodeTypesSize;
+    return UA_STATUSCODE_BADINVALIDARGUMENT;
+}
+
+/* Values that are not found are null. Bad values are replaced by the
+ * StatusCode. */
+static UA_StatusCode
+writeQueryDataSet(QueryContext *ctx, const UA_NodeTypeDescription *nodeType,
+                  UA_QueryDataSet *dataSet) {
+    UA_StatusCode retval = UA_NodeId_copy(&ctx->node->nodeId, &dataSet->nodeId.nodeId);
+    retval |= UA_NodeId_copy(ctx->typeDefinition, &dataSet->typeDefinitionNode.nodeId);
+    if(retval != UA_STATUSCODE_GOOD || nodeType->dataToReturnSize == 0)
+        return retval;
+    dataSet->values = UA_Array_new(nodeType->dataToReturnSize, &UA_TYPES[UA_TYPES_VARIANT]);
+    if(!dataSet->values)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    dataSet->valuesSize = nodeType->dataToReturnSize;
+    for(size_t i = 0; i < nodeType->dataToReturnSize; ++i) {
+        const UA_QueryDataDescription *dd = &nodeType->dataToReturn[i];
+        const UA_Node *node = followRelativePath(ctx->server, ctx->node, &dd->relativePath);
+        if(!node)
+            continue;
+        UA_StatusCode res = readQueryAttribute(ctx, node, dd->attributeId,
+                                               &dd->indexRange, &dataSet->values[i]);
+        if(res != UA_STATUSCODE_GOOD)
+            retval |= UA_Variant_setScalarCopy(&dataSet->values[i], &res,
+                                               &UA_TYPES[UA_TYPES_STATUSCODE]);
+    }
+    return retval;
+}
+
+/* Filters the candidates from the position until the maximum number of data
+ * sets is reached. The position is moved behind the last filtered candidate.
+ * Candidates that were removed from the nodestore in the meantime are
+ * skipped. */
+static UA_StatusCode
+queryCandidates(UA_Server *server, UA_Session *session,
+                const UA_NodeTypeDescription *nodeTypes, const UA_ContentFilter *filter,
+                const QueryCandidate *candidates, size_t candidatesSize, size_t *position,
+                UA_UInt32 maxDataSets, UA_QueryDataSet **dataSets, size_t *dataSetsSize) {
+    size_t capacity = candidatesSize - *position;
+    if(maxDataSets > 0 && capacity > maxDataSets)
+        capacity = maxDataSets;
+    if(capacity == 0)
+        return UA_STATUSCODE_GOOD;
+    UA_QueryDataSet *sets = UA_Array_new(capacity, &UA_TYPES[UA_TYPES_QUERYDATASET]);
+    if(!sets)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+
+    QueryContext ctx;
+    ctx.server = server;
+    ctx.session = session;
+    ctx.filter = filter;
+    ctx.results = NULL;
+    if(filter->elementsSize > 0) {
+        ctx.results = UA_malloc(sizeof(UA_Boolean) * filter->elementsSize);
+        if(!ctx.results) {
+            UA_free(sets);
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        }
+    }
+    size_t found = 0;
+    size_t i = *position;
+    for(; i < candidatesSize && found < capacity; ++i) {
+        ctx.node = UA_NodeStore_get(server->nodestore, &candidates[i].instance);
+        if(!ctx.node)
+            continue;
+        ctx.typeDefinition = &candidates[i].typeDefinition;
+        if(filter->elementsSize > 0 && !evaluateFilter(&ctx))
+            continue;
+        UA_StatusCode retval =
+            writeQueryDataSet(&ctx, &nodeTypes[candidates[i].nodeType], &sets[found]);
+        ++found;
+        if(retval != UA_STATUSCODE_GOOD) {
+            UA_free(ctx.results);
+            UA_Array_delete(sets, found, &UA_TYPES[UA_TYPES_QUERYDATASET]);
+            return retval;
+        }
+    }
+    UA_free(ctx.results);
+    *position = i;
+    if(found == 0) {
+        UA_free(sets);
+        return UA_STATUSCODE_GOOD;
+    }
+    *dataSets = sets;
+    *dataSetsSize = found;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Takes ownership of the candidates if successful */
+static UA_StatusCode
+addQueryCp(UA_Session *session, const UA_QueryFirstRequest *request,
+           QueryCandidate *candidates, size_t candidatesSize, size_t position,
+           UA_UInt32 maxDataSets, UA_ByteString *identifier) {
+    if(session->availableQueryContinuationPoints == 0)
+        return UA_STATUSCODE_BADNOCONTINUATIONPOINTS;
+    UA_QueryContinuationPoint *cp = UA_calloc(1, sizeof(UA_QueryContinuationPoint));
+    if(!cp)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    UA_Guid *ident = UA_Guid_new();
+    if(!ident) {
+        UA_free(cp);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    *ident = UA_Guid_random();
+    cp->identifier.data = (UA_Byte*)ident;
+    cp->identifier.length = sizeof(UA_Guid);
+    UA_StatusCode retval =
+        UA_Array_copy(request->nodeTypes, request->nodeTypesSize, (void**)&cp->nodeTypes,
+                      &UA_TYPES[UA_TYPES_NODETYPEDESCRIPTION]);
+    if(retval == UA_STATUSCODE_GOOD)
+        cp->nodeTypesSize = request->nodeTypesSize;
+    retval |= UA_ContentFilter_copy(&request->filter, &cp->filter);
+    retval |= UA_ByteString_copy(&cp->identifier, identifier);
+    if(retval != UA_STATUSCODE_GOOD) {
+        deleteQueryCp(cp);
+        return retval;
+    }
+    cp->maxDataSets = maxDataSets;
+    cp->candidates = candidates;
+    cp->candidatesSize = candidatesSize;
+    cp->position = position;
+    LIST_INSERT_HEAD(&session->queryContinuationPoints, cp, pointers);
+    --session->availableQueryContinuationPoints;
+    return UA_STATUSCODE_GOOD;
+}
+
+void Service_QueryFirst(UA_Server *server, UA_Session *session,
+                        const UA_QueryFirstRequest *request,
+                        UA_QueryFirstResponse *response) {
+    UA_LOG_DEBUG_SESSION(server->config.logger, session, "Processing QueryFirstRequest");
+    if(request->nodeTypesSize == 0) {
+        response->responseHeader.serviceResult = UA_STATUSCODE_BADNOTHINGTODO;
+        return;
+    }
+    if(!UA_NodeId_isNull(&request->view.viewId)) {
+        response->responseHeader.serviceResult = UA_STATUSCODE_BADVIEWIDUNKNOWN;
+        return;
+    }
+    UA_StatusCode retval = checkContentFilter(&request->filter, &response->filterResult);
+    if(retval != UA_STATUSCODE_GOOD) {
+        response->responseHeader.serviceResult = retval;
+        return;
+    }
+
+    QueryCandidate *candidates = NULL;
+    size_t candidatesSize = 0;
+    retval = collectQueryCandidates(server, request, response, &candidates, &candidatesSize);
+    if(retval != UA_STATUSCODE_GOOD) {
+        response->responseHeader.serviceResult = retval;
+        return;
+    }
+
+    UA_UInt32 maxDataSets = server->config.maxQueryDataSets;
+    if(request->maxDataSetsToReturn > 0 &&
+       (maxDataSets == 0 || request->maxDataSetsToReturn < maxDataSets))
+        maxDataSets = request->maxDataSetsToReturn;
+    size_t position = 0;
+    retval = queryCandidates(server, session, request->nodeTypes, &request->filter,
+                             candidates, candidatesSize, &position, maxDataSets,
+                             &response->queryDataSets, &response->queryDataSetsSize);
+    if(retval == UA_STATUSCODE_GOOD && position < candidatesSize) {
+        /* Keep the remaining candidates for QueryNext */
+        retval = addQueryCp(session, request, candidates, candidatesSize, position,
+                            maxDataSets, &response->continuationPoint);
+        if(retval == UA_STATUSCODE_GOOD)
+            return;
+    }
+    deleteQueryCandidates(candidates, candidatesSize);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_Array_delete(response->queryDataSets, response->queryDataSetsSize,
+                        &UA_TYPES[UA_TYPES_QUERYDATASET]);
+        response->queryDataSets = NULL;
+        response->queryDataSetsSize = 0;
+        response->responseHeader.serviceResult = retval;
+    }
+}
+
+void Service_QueryNext(UA_Server *server, UA_Session *session,
+                       const UA_QueryNextRequest *request,
+                       UA_QueryNextResponse *response) {
+    UA_LOG_DEBUG_SESSION(server->config.logger, session, "Processing QueryNextRequest");
+    UA_QueryContinuationPoint *cp;
+    LIST_FOREACH(cp, &session->queryContinuationPoints, pointers) {
+        if(UA_ByteString_equal(&cp->identifier, &request->continuationPoint))
+            break;
+    }
+    if(!cp) {
+        response->responseHeader.serviceResult = UA_STATUSCODE_BADCONTINUATIONPOINTINVALID;
+        return;
+    }
+    if(request->releaseContinuationPoint) {
+        removeQueryCp(session, cp);
+        return;
+    }
+
+    UA_StatusCode retval =
+        queryCandidates(server, session, cp->nodeTypes, &cp->filter, cp->candidates,
+                        cp->candidatesSize, &cp->position, cp->maxDataSets,
+                        &response->queryDataSets, &response->queryDataSetsSize);
+    if(retval != UA_STATUSCODE_GOOD) {
+        response->responseHeader.serviceResult = retval;
+        return;
+    }
+    if(cp->position == cp->candidatesSize) {
+        removeQueryCp(session, cp);
+        return;
+    }
+    retval = UA_ByteString_copy(&cp->identifier, &response->revisedContinuationPoint);
+    if(retval != UA_STATUSCODE_GOOD)
+        response->responseHeader.serviceResult = retval;
+}
@@ -204,7 +204,7 @@ Service_CreateMonitoredItems_single(UA_Server *server, UA_Session *session,
      * be repaired inside the data source. */
     UA_DataValue v;
     UA_DataValue_init(&v);
-    Service_Read_single(server, session, timestampsToReturn, &request->itemToMonitor, &v);
+    Service_Read_single(server, session, timestampsToReturn, &request->itemToMonitor, &v, NULL);
     if(v.hasStatus && (v.status >> 30) > 1 &&
        v.status != UA_STATUSCODE_BADRESOURCEUNAVAILABLE &&
        v.status != UA_STATUSCODE_BADCOMMUNICATIONERROR &&
@@ -5,29 +5,41 @@
 #include "ua_server_internal.h"
 #include "ua_services.h"
 
+/* The fields of a ReferenceDescription that are taken from the target node.
+ * The other fields are known from the reference alone. */
+#define UA_BROWSERESULTMASK_TARGETATTRIBUTES                            \
+    (UA_BROWSERESULTMASK_NODECLASS | UA_BROWSERESULTMASK_BROWSENAME |   \
+     UA_BROWSERESULTMASK_DISPLAYNAME | UA_BROWSERESULTMASK_TYPEDEFINITION)
+
+/* Fills only the fields selected by the mask. The target node is NULL if no
+ * field of the target is selected. */
 static UA_StatusCode
-fillReferenceDescription(UA_NodeStore *ns, const UA_Node *curr, UA_ReferenceNode *ref,
+fillReferenceDescription(const UA_Node *curr, const UA_ReferenceNode *ref,
                          UA_UInt32 mask, UA_ReferenceDescription *descr) {
     UA_ReferenceDescription_init(descr);
-    UA_StatusCode retval = UA_NodeId_copy(&curr->nodeId, &descr->nodeId.nodeId);
+    UA_StatusCode retval = UA_ExpandedNodeId_copy(&ref->targetId, &descr->nodeId);
     if(mask & UA_BROWSERESULTMASK_REFERENCETYPEID)
         retval |= UA_NodeId_copy(&ref->referenceTypeId, &descr->referenceTypeId);
     if(mask & UA_BROWSERESULTMASK_ISFORWARD)
         descr->isForward = !ref->isInverse;
+    if(!curr)
+        return retval;
     if(mask & UA_BROWSERESULTMASK_NODECLASS)
-        retval |= UA_NodeClass_copy(&curr->nodeClass, &descr->nodeClass);
+        descr->nodeClass = curr->nodeClass;
     if(mask & UA_BROWSERESULTMASK_BROWSENAME)
         retval |= UA_QualifiedName_copy(&curr->browseName, &descr->browseName);
     if(mask & UA_BROWSERESULTMASK_DISPLAYNAME)
         retval |= UA_LocalizedText_copy(&curr->displayName, &descr->displayName);
-    if(mask & UA_BROWSERESULTMASK_TYPEDEFINITION){
-        if(curr->nodeClass == UA_NODECLASS_OBJECT || curr->nodeClass == UA_NODECLASS_VARIABLE) {
-            for(size_t i = 0; i < curr->referencesSize; ++i) {
-                UA_ReferenceNode *refnode = &curr->references[i];
-                if(refnode->referenceTypeId.identifier.numeric == UA_NS0ID_HASTYPEDEFINITION) {
-                    retval |= UA_ExpandedNodeId_copy(&refnode->targetId, &descr->typeDefinition);
-                    break;
-                }
+    if((mask & UA_BROWSERESULTMASK_TYPEDEFINITION) &&
+       (curr->nodeClass == UA_NODECLASS_OBJECT || curr->nodeClass == UA_NODECLASS_VARIABLE)) {
+        for(size_t i = 0; i < curr->referencesSize; i = UA_Node_referenceGroupEnd(curr, i)) {
+            const UA_NodeId *refType = &curr->references[i].referenceTypeId;
+            if(refType->namespaceIndex == 0 &&
+               refType->identifierType == UA_NODEIDTYPE_NUMERIC &&
+               refType->identifier.numeric == UA_NS0ID_HASTYPEDEFINITION) {
+                retval |= UA_ExpandedNodeId_copy(&curr->references[i].targetId,
+                                                 &descr->typeDefinition);
+                break;
             }
         }
     }
@@ -36,7 +48,8 @@ fillReferenceDescription(UA_NodeStore *ns, const UA_Node *curr, UA_ReferenceNode
 
 #ifdef UA_ENABLE_EXTERNAL_NAMESPACES
 static const UA_Node *
-returnRelevantNodeExternal(UA_ExternalNodeStore *ens, const UA_BrowseDescription *descr,
+returnRelevantNodeExternal(UA_Server *server, UA_ExternalNodeStore *ens,
+                           const UA_BrowseDescription *descr,
                            const UA_ReferenceNode *reference) {
     /* prepare a read request in the external nodestore */
     UA_ReadValueId *readValueIds = UA_Array_new(5,&UA_TYPES[UA_TYPES_READVALUEID]);
@@ -57,11 +70,14 @@ returnRelevantNodeExternal(UA_ExternalNodeStore *ens, const UA_BrowseDescription
     ens->readNodes(ens->ensHandle, NULL, readValueIds, indices,
                    indicesSize, readNodesResults, false, diagnosticInfos);
 
-    /* create and fill a dummy nodeStructure */
-    UA_Node *node = (UA_Node*) UA_NodeStore_newObjectNode();
-    UA_NodeId_copy(&(reference->targetId.nodeId), &(node->nodeId));
+    /* create and fill a dummy nodeStructure of the nodeclass */
+    UA_NodeClass nodeClass = UA_NODECLASS_OBJECT;
     if(readNodesResults[0].status == UA_STATUSCODE_GOOD)
-        UA_NodeClass_copy((UA_NodeClass*)readNodesResults[0].value.data, &(node->nodeClass));
+        nodeClass = *(UA_NodeClass*)readNodesResults[0].value.data;
+    UA_Node *node = UA_NodeStore_newNode(server->nodestore, nodeClass);
+    if(!node)
+        node = (UA_Node*) UA_NodeStore_newObjectNode(server->nodestore);
+    UA_NodeId_copy(&(reference->targetId.nodeId), &(node->nodeId));
     if(readNodesResults[1].status == UA_STATUSCODE_GOOD)
         UA_QualifiedName_copy((UA_QualifiedName*)readNodesResults[1].value.data, &(node->browseName));
     if(readNodesResults[2].status == UA_STATUSCODE_GOOD)
@@ -81,37 +97,41 @@ returnRelevantNodeExternal(UA_ExternalNodeStore *ens, const UA_BrowseDescription
     UA_Array_delete(readNodesResults,5, &UA_TYPES[UA_TYPES_DATAVALUE]);
     UA_Array_delete(diagnosticInfos,5, &UA_TYPES[UA_TYPES_DIAGNOSTICINFO]);
     if(node && descr->nodeClassMask != 0 && (node->nodeClass & descr->nodeClassMask) == 0) {
-        UA_NodeStore_deleteNode(node);
+        UA_NodeStore_deleteNode(server->nodestore, node);
         return NULL;
     }
     return node;
 }
 #endif
 
-/* Tests if the node is relevant to the browse request and shall be returned. If
-   so, it is retrieved from the Nodestore. If not, null is returned. */
-static const UA_Node *
-returnRelevantNode(UA_Server *server, const UA_BrowseDescription *descr, UA_Boolean return_all,
-                   const UA_ReferenceNode *reference, const UA_NodeId *relevant, size_t relevant_count,
-                   UA_Boolean *isExternal) {
+/* Tests if the reference has the direction and type of the browse request */
+static UA_Boolean
+isRelevantReference(const UA_BrowseDescription *descr, UA_Boolean return_all,
+                    const UA_ReferenceNode *reference, const UA_TypeClosure *refTypes,
+                    size_t rootRef) {
     /* reference in the right direction? */
     if(reference->isInverse && descr->browseDirection == UA_BROWSEDIRECTION_FORWARD)
-        return NULL;
+        return false;
     if(!reference->isInverse && descr->browseDirection == UA_BROWSEDIRECTION_INVERSE)
-        return NULL;
+        return false;
 
     /* is the reference part of the hierarchy of references we look for? */
-    if(!return_all) {
-        UA_Boolean is_relevant = false;
-        for(size_t i = 0; i < relevant_count; ++i) {
-            if(UA_NodeId_equal(&reference->referenceTypeId, &relevant[i])) {
-                is_relevant = true;
-                break;
-            }
-        }
-        if(!is_relevant)
-            return NULL;
-    }
+    if(return_all)
+        return true;
+    if(!refTypes)
+        return UA_NodeId_equal(&reference->referenceTypeId, &descr->referenceTypeId);
+    size_t refType = UA_TypeClosure_find(refTypes, &reference->referenceTypeId);
+    return refType < refTypes->typesSize &&
+        UA_TypeClosure_isSubtype(refTypes, refType, rootRef);
+}
+
+/* Returns the target node of a relevant reference if it shall be returned. If
+   so, it is retrieved from the Nodestore. If not, null is returned. Missing
+   is set if the target is not in the Nodestore. */
+static const UA_Node *
+returnRelevantNode(UA_Server *server, const UA_BrowseDescription *descr,
+                   const UA_ReferenceNode *reference, UA_Boolean *isExternal,
+                   UA_Boolean *missing) {
 
 #ifdef UA_ENABLE_EXTERNAL_NAMESPACES
     /* return the node from an external namespace*/
@@ -119,13 +139,15 @@ returnRelevantNode(UA_Server *server, const UA_BrowseDescription *descr, UA_Bool
         if(reference->targetId.nodeId.namespaceIndex != server->externalNamespaces[nsIndex].index)
             continue;
         *isExternal = true;
-        return returnRelevantNodeExternal(&server->externalNamespaces[nsIndex].externalNodeStore,
+        return returnRelevantNodeExternal(server, &server->externalNamespaces[nsIndex].externalNodeStore,
                                           descr, reference);
     }
 #endif
 
     /* return from the internal nodestore */
     const UA_Node *node = UA_NodeStore_get(server->nodestore, &reference->targetId.nodeId);
+    if(!node)
+        *missing = true;
     if(node && descr->nodeClassMask != 0 && (node->nodeClass & descr->nodeClassMask) == 0)
         return NULL;
     *isExternal = false;
@@ -140,6 +162,136 @@ static void removeCp(struct ContinuationPointEntry *cp, UA_Session* session) {
     ++session->availableContinuationPoints;
 }
 
+/****************/
+/* Browse Cache */
+/****************/
+
+/* The key is the BrowseDescription with the NodeId of the browsed node (not an
+ * alias of the session) */
+struct UA_BrowseCacheEntry {
+#ifdef UA_ENABLE_MULTITHREADING
+    struct rcu_head rcu_head;
+#endif
+    UA_BrowseDescription key;
+    UA_UInt32 nodeVersion;
+    UA_UInt32 cacheVersion;
+    UA_BrowseResult result;
+};
+
+static void
+deleteBrowseCacheEntry(UA_BrowseCacheEntry *entry) {
+    UA_BrowseDescription_deleteMembers(&entry->key);
+    UA_BrowseResult_deleteMembers(&entry->result);
+    UA_free(entry);
+}
+
+#ifdef UA_ENABLE_MULTITHREADING
+static void
+deleteBrowseCacheEntryRcu(struct rcu_head *head) {
+    deleteBrowseCacheEntry(container_of(head, UA_BrowseCacheEntry, rcu_head));
+}
+#endif
+
+static UA_BrowseCacheEntry **
+browseCacheSlot(UA_Server *server, const UA_Node *node, const UA_BrowseDescription *descr) {
+    UA_UInt32 h = UA_NodeId_hash(&node->nodeId);
+    h = (h * 31) + UA_NodeId_hash(&descr->referenceTypeId);
+    h = (h * 31) + (UA_UInt32)descr->browseDirection;
+    h = (h * 31) + descr->includeSubtypes;
+    h = (h * 31) + descr->nodeClassMask;
+    h = (h * 31) + descr->resultMask;
+    return &server->browseCache[h & (server->browseCacheSize - 1)];
+}
+
+static UA_Boolean
+browseCacheEntryMatches(const UA_BrowseCacheEntry *entry, const UA_Node *node,
+                        const UA_BrowseDescription *descr) {
+    const UA_BrowseDescription *key = &entry->key;
+    return key->browseDirection == descr->browseDirection &&
+        key->includeSubtypes == descr->includeSubtypes &&
+        key->nodeClassMask == descr->nodeClassMask &&
+        key->resultMask == descr->resultMask &&
+        UA_NodeId_equal(&key->nodeId, &node->nodeId) &&
+        UA_NodeId_equal(&key->referenceTypeId, &descr->referenceTypeId);
+}
+
+/* Copies the cached result if it is up to date. Results with maxrefs or more
+ * references are computed again to return a continuation point. */
+static UA_Boolean
+getCachedBrowseResult(UA_Server *server, const UA_Node *node,
+                      const UA_BrowseDescription *descr, UA_UInt32 maxrefs,
+                      UA_UInt32 cacheVersion, UA_BrowseResult *result) {
+    UA_BrowseCacheEntry **slot = browseCacheSlot(server, node, descr);
+#ifdef UA_ENABLE_MULTITHREADING
+    const UA_BrowseCacheEntry *entry = rcu_dereference(*slot);
+#else
+    const UA_BrowseCacheEntry *entry = *slot;
+#endif
+    if(!entry || entry->nodeVersion != node->version ||
+       entry->cacheVersion != cacheVersion ||
+       (maxrefs != 0 && entry->result.referencesSize >= maxrefs) ||
+       !browseCacheEntryMatches(entry, node, descr) ||
+       UA_BrowseResult_copy(&entry->result, result) != UA_STATUSCODE_GOOD) {
+        UA_atomic_add(&server->browseCacheMisses, 1);
+        return false;
+    }
+    UA_atomic_add(&server->browseCacheHits, 1);
+    return true;
+}
+
+/* The result was computed from the node version and the cache version */
+static void
+storeBrowseResult(UA_Server *server, const UA_Node *node, const UA_BrowseDescription *descr,
+                  UA_UInt32 cacheVersion, const UA_BrowseResult *result) {
+    UA_BrowseCacheEntry *newEntry = UA_malloc(sizeof(UA_BrowseCacheEntry));
+    if(!newEntry)
+        return;
+    newEntry->nodeVersion = node->version;
+    newEntry->cacheVersion = cacheVersion;
+    UA_StatusCode retval = UA_BrowseDescription_copy(descr, &newEntry->key);
+    UA_NodeId_deleteMembers(&newEntry->key.nodeId);
+    retval |= UA_NodeId_copy(&node->nodeId, &newEntry->key.nodeId);
+    retval |= UA_BrowseResult_copy(result, &newEntry->result);
+    if(retval != UA_STATUSCODE_GOOD) {
+        deleteBrowseCacheEntry(newEntry);
+        return;
+    }
+
+    UA_BrowseCacheEntry **slot = browseCacheSlot(server, node, descr);
+#ifdef UA_ENABLE_MULTITHREADING
+    UA_BrowseCacheEntry *entry = rcu_xchg_pointer(slot, newEntry);
+    if(entry)
+        call_rcu(&entry->rcu_head, deleteBrowseCacheEntryRcu);
+#else
+    if(*slot)
+        deleteBrowseCacheEntry(*slot);
+    *slot = newEntry;
+#endif
+}
+
+void UA_Server_invalidateBrowseCache(UA_Server *server) {
+    UA_atomic_add(&server->browseCacheVersion, 1);
+}
+
+void UA_Server_deleteBrowseCache(UA_Server *server) {
+    if(!server->browseCache)
+        return;
+    for(size_t i = 0; i < server->browseCacheSize; ++i) {
+        if(server->browseCache[i])
+            deleteBrowseCacheEntry(server->browseCache[i]);
+    }
+    UA_free(server->browseCache);
+    server->browseCache = NULL;
+    server->browseCacheSize = 0;
+}
+
+void
+UA_Server_getBrowseCacheStatistics(UA_Server *server, UA_BrowseCacheStatistics *stats) {
+    stats->size = server->browseCacheSize;
+    stats->hits = server->browseCacheHits;
+    stats->misses = server->browseCacheMisses;
+}
+
 /* Results for a single browsedescription. This is the inner loop for both
  * Browse and BrowseNext
  *
@@ -172,52 +324,77 @@ Service_Browse_single(UA_Server *server, UA_Session *session,
         result->statusCode = UA_STATUSCODE_BADBROWSEDIRECTIONINVALID;
         return;
     }
+
+    /* results without a continuation point are cached. The cache version is
+     * read before anything the result is computed from. So changes in between
+     * invalidate the stored result. */
+    UA_Boolean cacheable = !cp && server->browseCache;
+    UA_UInt32 cacheVersion = 0;
+    if(cacheable)
+        cacheVersion = UA_atomic_add(&server->browseCacheVersion, 0);
     
-    /* get the references that match the browsedescription */
-    size_t relevant_refs_size = 0;
-    UA_NodeId *relevant_refs = NULL;
+    /* get the references that match the browsedescription. With subtypes, a
+     * reference matches if its type is set in the bitset of the requested
+     * type. */
+    const UA_TypeClosure *refTypes = NULL;
+    size_t rootRef = 0;
     UA_Boolean all_refs = UA_NodeId_isNull(&descr->referenceTypeId);
     if(!all_refs) {
-        const UA_Node *rootRef = UA_NodeStore_get(server->nodestore, &descr->referenceTypeId);
-        if(!rootRef || rootRef->nodeClass != UA_NODECLASS_REFERENCETYPE) {
+        const UA_Node *rootRefNode = UA_NodeStore_get(server->nodestore, &descr->referenceTypeId);
+        if(!rootRefNode || rootRefNode->nodeClass != UA_NODECLASS_REFERENCETYPE) {
             result->statusCode = UA_STATUSCODE_BADREFERENCETYPEIDINVALID;
             return;
         }
         if(descr->includeSubtypes) {
-            result->statusCode = getTypeHierarchy(server->nodestore, rootRef, false,
-                                                  &relevant_refs, &relevant_refs_size);
-            if(result->statusCode != UA_STATUSCODE_GOOD)
+            refTypes = UA_Server_getTypeClosure(server, UA_TYPECLOSURE_REFERENCETYPES);
+            if(!refTypes) {
+                result->statusCode = UA_STATUSCODE_BADOUTOFMEMORY;
                 return;
-        } else {
-            relevant_refs = (UA_NodeId*)(uintptr_t)&descr->referenceTypeId;
-            relevant_refs_size = 1;
+            }
+            /* Reference types outside the hierarchy match only themselves */
+            rootRef = UA_TypeClosure_find(refTypes, &descr->referenceTypeId);
+            if(rootRef == refTypes->typesSize)
+                refTypes = NULL;
         }
     }
 
     /* get the node */
-    const UA_Node *node = UA_NodeStore_get(server->nodestore, &descr->nodeId);
+    const UA_Node *node = UA_Server_getSessionNode(server, session, &descr->nodeId);
     if(!node) {
         result->statusCode = UA_STATUSCODE_BADNODEIDUNKNOWN;
-        if(!all_refs && descr->includeSubtypes)
-            UA_Array_delete(relevant_refs, relevant_refs_size, &UA_TYPES[UA_TYPES_NODEID]);
         return;
     }
 
     /* if the node has no references, just return */
     if(node->referencesSize == 0) {
         result->referencesSize = 0;
-        if(!all_refs && descr->includeSubtypes)
-            UA_Array_delete(relevant_refs, relevant_refs_size, &UA_TYPES[UA_TYPES_NODEID]);
         return;
     }
 
+    if(cacheable &&
+       getCachedBrowseResult(server, node, descr, maxrefs, cacheVersion, result))
+        return;
+
+    /* resume at the stored position if the node was not edited in between.
+     * Otherwise, skip the references that were already returned. */
+    if(cp && cp->nodeVersion == node->version && cp->position <= node->referencesSize) {
+        referencesIndex = cp->position;
+        continuationIndex = 0;
+    }
+
     /* how many references can we return at most? */
     size_t real_maxrefs = maxrefs;
     if(real_maxrefs == 0)
         real_maxrefs = node->referencesSize;
     else if(real_maxrefs > node->referencesSize)
         real_maxrefs = node->referencesSize;
-    result->references = UA_Array_new(real_maxrefs, &UA_TYPES[UA_TYPES_REFERENCEDESCRIPTION]);
+
+    /* the result array grows when needed. Nodes can have many references of
+     * which only a few match. */
+    size_t result_size = 16;
+    if(result_size > real_maxrefs)
+        result_size = real_maxrefs;
+    result->references = UA_Array_new(result_size, &UA_TYPES[UA_TYPES_REFERENCEDESCRIPTION]);
     if(!result->references) {
         result->statusCode = UA_STATUSCODE_BADOUTOFMEMORY;
         goto cleanup;
@@ -226,20 +403,47 @@ Service_Browse_single(UA_Server *server, UA_Session *session,
     /* loop over the node's references */
     size_t skipped = 0;
     UA_Boolean isExternal = false;
+    UA_Boolean lookupTarget = descr->nodeClassMask != 0 ||
+        (descr->resultMask & UA_BROWSERESULTMASK_TARGETATTRIBUTES) != 0;
     UA_StatusCode retval = UA_STATUSCODE_GOOD;
     for(; referencesIndex < node->referencesSize && referencesCount < real_maxrefs; ++referencesIndex) {
-        isExternal = false;
-        const UA_Node *current =
-            returnRelevantNode(server, descr, all_refs, &node->references[referencesIndex],
-                               relevant_refs, relevant_refs_size, &isExternal);
-        if(!current)
+        if(!isRelevantReference(descr, all_refs, &node->references[referencesIndex],
+                                refTypes, rootRef)) {
+            /* skip the references with the same type and direction */
+            referencesIndex = UA_Node_referenceGroupEnd(node, referencesIndex) - 1;
             continue;
+        }
+        /* the target is only looked up if its attributes are needed */
+        const UA_Node *current = NULL;
+        if(lookupTarget) {
+            isExternal = false;
+            UA_Boolean missing = false;
+            current = returnRelevantNode(server, descr, &node->references[referencesIndex],
+                                         &isExternal, &missing);
+            /* the result changes when the target is added */
+            if(isExternal || missing)
+                cacheable = false;
+            if(!current)
+                continue;
+        }
 
         if(skipped < continuationIndex) {
             ++skipped;
         } else {
-            retval |= fillReferenceDescription(server->nodestore, current,
-                                               &node->references[referencesIndex],
+            if(referencesCount == result_size) {
+                size_t new_size = result_size * 2;
+                if(new_size > real_maxrefs)
+                    new_size = real_maxrefs;
+                UA_ReferenceDescription *new_refs =
+                    UA_realloc(result->references, sizeof(UA_ReferenceDescription) * new_size);
+                if(!new_refs) {
+                    retval |= UA_STATUSCODE_BADOUTOFMEMORY;
+                    break;
+                }
+                result->references = new_refs;
+                result_size = new_size;
+            }
+            retval |= fillReferenceDescription(current, &node->references[referencesIndex],
                                                descr->resultMask,
                                                &result->references[referencesCount]);
             ++referencesCount;
@@ -262,8 +466,6 @@ Service_Browse_single(UA_Server *server, UA_Session *session,
     }
 
  cleanup:
-    if(!all_refs && descr->includeSubtypes)
-        UA_Array_delete(relevant_refs, relevant_refs_size, &UA_TYPES[UA_TYPES_NODEID]);
     if(result->statusCode != UA_STATUSCODE_GOOD)
         return;
 
@@ -275,6 +477,8 @@ Service_Browse_single(UA_Server *server, UA_Session *session,
         } else {
             /* update the cp and return the cp identifier */
             cp->continuationIndex += (UA_UInt32)referencesCount;
+            cp->position = referencesIndex;
+            cp->nodeVersion = node->version;
             UA_ByteString_copy(&cp->identifier, &result->continuationPoint);
         }
     } else if(maxrefs != 0 && referencesCount >= maxrefs) {
@@ -287,6 +491,8 @@ Service_Browse_single(UA_Server *server, UA_Session *session,
         UA_BrowseDescription_copy(descr, &cp->browseDescription);
         cp->maxReferences = maxrefs;
         cp->continuationIndex = (UA_UInt32)referencesCount;
+        cp->position = referencesIndex;
+        cp->nodeVersion = node->version;
         UA_Guid *ident = UA_Guid_new();
         *ident = UA_Guid_random();
         cp->identifier.data = (UA_Byte*)ident;
@@ -296,7 +502,32 @@ Service_Browse_single(UA_Server *server, UA_Session *session,
         /* store the cp */
         LIST_INSERT_HEAD(&session->continuationPoints, cp, pointers);
         --session->availableContinuationPoints;
+        return;
     }
+
+    if(cacheable)
+        storeBrowseResult(server, node, descr, cacheVersion, result);
+}
+
+typedef struct {
+    UA_Session *session;
+    const UA_BrowseRequest *request;
+    UA_BrowseResponse *response;
+#ifdef UA_ENABLE_EXTERNAL_NAMESPACES
+    const UA_Boolean *isExternal;
+#endif
+} BrowseNodesContext;
+
+static void
+browseNode(UA_Server *server, void *context, size_t i) {
+    BrowseNodesContext *bc = (BrowseNodesContext*)context;
+#ifdef UA_ENABLE_EXTERNAL_NAMESPACES
+    if(bc->isExternal[i])
+        return;
+#endif
+    Service_Browse_single(server, bc->session, NULL, &bc->request->nodesToBrowse[i],
+                          bc->request->requestedMaxReferencesPerNode,
+                          &bc->response->results[i]);
 }
 
 void Service_Browse(UA_Server *server, UA_Session *session, const UA_BrowseRequest *request,
@@ -320,6 +551,10 @@ void Service_Browse(UA_Server *server, UA_Session *session, const UA_BrowseReque
     }
     response->resultsSize = size;
 
+    BrowseNodesContext bc;
+    bc.session = session;
+    bc.request = request;
+    bc.response = response;
 #ifdef UA_ENABLE_EXTERNAL_NAMESPACES
 #ifdef NO_ALLOCA
     UA_Boolean isExternal[size];
@@ -345,15 +580,17 @@ void Service_Browse(UA_Server *server, UA_Session *session, const UA_BrowseReque
                          (UA_UInt32)indexSize, request->requestedMaxReferencesPerNode,
                          response->results, response->diagnosticInfos);
     }
+    bc.isExternal = isExternal;
 #endif
 
-    for(size_t i = 0; i < size; ++i) {
-#ifdef UA_ENABLE_EXTERNAL_NAMESPACES
-        if(!isExternal[i])
-#endif
-            Service_Browse_single(server, session, NULL, &request->nodesToBrowse[i],
-                                  request->requestedMaxReferencesPerNode, &response->results[i]);
+    /* Continuation points are added to the session. So the nodes are browsed
+     * in parallel only if the number of references is not limited. */
+    if(request->requestedMaxReferencesPerNode == 0) {
+        UA_Server_processItems(server, size, browseNode, &bc);
+        return;
     }
+    for(size_t i = 0; i < size; ++i)
+        browseNode(server, &bc, i);
 }
 
 UA_BrowseResult
@@ -415,6 +652,175 @@ UA_Server_browseNext(UA_Server *server, UA_Boolean releaseContinuationPoint,
     return result;
 }
 
+/***************/
+/* Child Index */
+/***************/
+
+/* Nodes with fewer references are searched without an index */
+#define UA_CHILDINDEX_MINREFS 32
+
+/* Browse path elements with more candidates are resolved without the index */
+#define UA_CHILDINDEX_MAXCANDIDATES 16
+
+/* The slots of the hash-map (with linear probing) contain the hash of the
+ * BrowseName of the target and the position+1 of the reference. Zero marks an
+ * empty slot. */
+typedef struct {
+    UA_UInt32 hash;
+    UA_UInt32 position;
+} UA_ChildIndexSlot;
+
+struct UA_ChildIndex {
+#ifdef UA_ENABLE_MULTITHREADING
+    struct rcu_head rcu_head;
+#endif
+    UA_NodeId nodeId;
+    UA_UInt32 nodeVersion;
+    UA_UInt32 browseNamesVersion;
+    size_t slotsSize; /* power of two */
+    UA_ChildIndexSlot *slots;
+};
+
+/* FNV-1a */
+static UA_UInt32
+browseNameHash(const UA_QualifiedName *name) {
+    UA_UInt32 h = 2166136261u;
+    h ^= name->namespaceIndex;
+    h *= 16777619u;
+    for(size_t i = 0; i < name->name.length; ++i) {
+        h ^= name->name.data[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void
+deleteChildIndex(UA_ChildIndex *ci) {
+    UA_NodeId_deleteMembers(&ci->nodeId);
+    UA_free(ci->slots);
+    UA_free(ci);
+}
+
+#ifdef UA_ENABLE_MULTITHREADING
+static void
+deleteChildIndexRcu(struct rcu_head *head) {
+    deleteChildIndex(container_of(head, UA_ChildIndex, rcu_head));
+}
+#endif
+
+static UA_ChildIndex *
+buildChildIndex(UA_Server *server, const UA_Node *node, UA_UInt32 browseNamesVersion) {
+    UA_ChildIndex *ci = UA_calloc(1, sizeof(UA_ChildIndex));
+    if(!ci)
+        return NULL;
+    ci->slotsSize = 64;
+    while(ci->slotsSize < node->referencesSize * 2)
+        ci->slotsSize *= 2;
+    ci->slots = UA_calloc(ci->slotsSize, sizeof(UA_ChildIndexSlot));
+    if(!ci->slots || UA_NodeId_copy(&node->nodeId, &ci->nodeId) != UA_STATUSCODE_GOOD) {
+        UA_free(ci->slots);
+        UA_free(ci);
+        return NULL;
+    }
+    ci->nodeVersion = node->version;
+    ci->browseNamesVersion = browseNamesVersion;
+
+    size_t mask = ci->slotsSize - 1;
+    for(size_t i = 0; i < node->referencesSize; ++i) {
+        const UA_Node *target =
+            UA_NodeStore_get(server->nodestore, &node->references[i].targetId.nodeId);
+        if(!target)
+            continue;
+        UA_UInt32 hash = browseNameHash(&target->browseName);
+        size_t slot = hash & mask;
+        while(ci->slots[slot].position != 0)
+            slot = (slot + 1) & mask;
+        ci->slots[slot].hash = hash;
+        ci->slots[slot].position = (UA_UInt32)i + 1;
+    }
+    return ci;
+}
+
+/* Returns the cached index of the node. A missing or outdated index is built
+ * and replaces the entry in its cache slot. */
+static const UA_ChildIndex *
+getChildIndex(UA_Server *server, const UA_Node *node) {
+    if(!server->childIndexes || node->referencesSize >= UA_UINT32_MAX)
+        return NULL;
+    UA_UInt32 browseNamesVersion = server->browseNamesVersion;
+    UA_ChildIndex **entry =
+        &server->childIndexes[UA_NodeId_hash(&node->nodeId) & (UA_CHILDINDEX_CACHESIZE - 1)];
+#ifdef UA_ENABLE_MULTITHREADING
+    UA_ChildIndex *ci = rcu_dereference(*entry);
+#else
+    UA_ChildIndex *ci = *entry;
+#endif
+    if(ci && ci->nodeVersion == node->version &&
+       ci->browseNamesVersion == browseNamesVersion &&
+       UA_NodeId_equal(&ci->nodeId, &node->nodeId))
+        return ci;
+
+    UA_ChildIndex *newCi = buildChildIndex(server, node, browseNamesVersion);
+    if(!newCi)
+        return NULL;
+#ifdef UA_ENABLE_MULTITHREADING
+    ci = rcu_xchg_pointer(entry, newCi);
+    if(ci)
+        call_rcu(&ci->rcu_head, deleteChildIndexRcu);
+#else
+    if(ci)
+        deleteChildIndex(ci);
+    *entry = newCi;
+#endif
+    return newCi;
+}
+
+/* Finds the positions of the references to targets that may have the
+ * BrowseName (the hash matches). Returns false if the node is searched without
+ * the index. */
+static UA_Boolean
+findChildCandidates(UA_Server *server, const UA_Node *node, const UA_QualifiedName *name,
+                    size_t *candidates, size_t *candidatesSize) {
+    if(node->referencesSize < UA_CHILDINDEX_MINREFS)
+        return false;
+    const UA_ChildIndex *ci = getChildIndex(server, node);
+    if(!ci)
+        return false;
+    UA_UInt32 hash = browseNameHash(name);
+    size_t mask = ci->slotsSize - 1;
+    size_t found = 0;
+    for(size_t slot = hash & mask; ci->slots[slot].position != 0; slot = (slot + 1) & mask) {
+        if(ci->slots[slot].hash != hash)
+            continue;
+        if(found == UA_CHILDINDEX_MAXCANDIDATES)
+            return false;
+        /* Keep the order of the references */
+        size_t position = ci->slots[slot].position - 1;
+        size_t j = found++;
+        for(; j > 0 && candidates[j - 1] > position; --j)
+            candidates[j] = candidates[j - 1];
+        candidates[j] = position;
+    }
+    *candidatesSize = found;
+    return true;
+}
+
+void UA_Server_invalidateChildIndexes(UA_Server *server) {
+    UA_atomic_add(&server->browseNamesVersion, 1);
+    UA_Server_invalidateBrowseCache(server);
+}
+
+void UA_Server_deleteChildIndexes(UA_Server *server) {
+    if(!server->childIndexes)
+        return;
+    for(size_t i = 0; i < UA_CHILDINDEX_CACHESIZE; ++i) {
+        if(server->childIndexes[i])
+            deleteChildIndex(server->childIndexes[i]);
+    }
+    UA_free(server->childIndexes);
+    server->childIndexes = NULL;
+}
+
 /***********************/
 /* TranslateBrowsePath */
 /***********************/
@@ -425,31 +831,54 @@ walkBrowsePath(UA_Server *server, UA_Session *session, const UA_Node *node, cons
                size_t *target_count) {
     const UA_RelativePathElement *elem = &path->elements[pathindex];
     UA_StatusCode retval = UA_STATUSCODE_GOOD;
-    UA_NodeId *reftypes = NULL;
-    size_t reftypes_count = 1; // all_refs or no subtypes => 1
+    const UA_TypeClosure *refTypes = NULL;
+    size_t rootRef = 0;
     UA_Boolean all_refs = false;
     if(UA_NodeId_isNull(&elem->referenceTypeId)) {
         all_refs = true;
-    } else if(!elem->includeSubtypes) {
-        reftypes = (UA_NodeId*)(uintptr_t)&elem->referenceTypeId; // ptr magic due to const cast
-    } else {
-        const UA_Node *rootRef = UA_NodeStore_get(server->nodestore, &elem->referenceTypeId);
-        if(!rootRef || rootRef->nodeClass != UA_NODECLASS_REFERENCETYPE)
+    } else if(elem->includeSubtypes) {
+        const UA_Node *rootRefNode = UA_NodeStore_get(server->nodestore, &elem->referenceTypeId);
+        if(!rootRefNode || rootRefNode->nodeClass != UA_NODECLASS_REFERENCETYPE)
             return UA_STATUSCODE_BADREFERENCETYPEIDINVALID;
-        retval = getTypeHierarchy(server->nodestore, rootRef, false, &reftypes, &reftypes_count);
-        if(retval != UA_STATUSCODE_GOOD)
-            return retval;
+        refTypes = UA_Server_getTypeClosure(server, UA_TYPECLOSURE_REFERENCETYPES);
+        if(!refTypes)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        rootRef = UA_TypeClosure_find(refTypes, &elem->referenceTypeId);
+        if(rootRef == refTypes->typesSize)
+            refTypes = NULL;
     }
 
-    for(size_t i = 0; i < node->referencesSize && retval == UA_STATUSCODE_GOOD; ++i) {
+    /* Only the references to candidates with a matching BrowseName are
+     * considered if the node has a child index */
+    size_t candidates[UA_CHILDINDEX_MAXCANDIDATES];
+    size_t candidatesSize = 0;
+    UA_Boolean indexed = findChildCandidates(server, node, &elem->targetName,
+                                             candidates, &candidatesSize);
+    size_t end = node->referencesSize;
+    if(indexed)
+        end = candidatesSize;
+
+    for(size_t k = 0; k < end && retval == UA_STATUSCODE_GOOD; ++k) {
+        size_t i = k;
+        if(indexed)
+            i = candidates[k];
         UA_Boolean match = all_refs;
-        for(size_t j = 0; j < reftypes_count && !match; ++j) {
-            if(node->references[i].isInverse == elem->isInverse &&
-               UA_NodeId_equal(&node->references[i].referenceTypeId, &reftypes[j]))
-                match = true;
+        if(!match && node->references[i].isInverse == elem->isInverse) {
+            if(!refTypes) {
+                match = UA_NodeId_equal(&node->references[i].referenceTypeId,
+                                        &elem->referenceTypeId);
+            } else {
+                size_t refType = UA_TypeClosure_find(refTypes,
+                                                     &node->references[i].referenceTypeId);
+                match = refType < refTypes->typesSize &&
+                    UA_TypeClosure_isSubtype(refTypes, refType, rootRef);
+            }
         }
-        if(!match)
+        if(!match) {
+            if(!indexed)
+                k = UA_Node_referenceGroupEnd(node, i) - 1;
             continue;
+        }
 
         // get the node, todo: expandednodeid
         const UA_Node *next = UA_NodeStore_get(server->nodestore, &node->references[i].targetId.nodeId);
@@ -489,8 +918,6 @@ walkBrowsePath(UA_Server *server, UA_Session *session, const UA_Node *node, cons
         }
     }
 
-    if(!all_refs && elem->includeSubtypes)
-        UA_Array_delete(reftypes, reftypes_count, &UA_TYPES[UA_TYPES_NODEID]);
     return retval;
 }
 
@@ -601,27 +1028,276 @@ void Service_TranslateBrowsePathsToNodeIds(UA_Server *server, UA_Session *sessio
     }
 }
 
+/********************/
+/* Registered Nodes */
+/********************/
+
+static void
+deleteRegisteredNodes(UA_RegisteredNodes *rn) {
+    for(size_t i = 0; i < rn->entriesSize; ++i)
+        UA_NodeId_deleteMembers(&rn->entries[i].nodeId);
+    UA_free(rn);
+}
+
+#ifdef UA_ENABLE_MULTITHREADING
+static void
+deleteRegisteredNodesRcu(struct rcu_head *head) {
+    deleteRegisteredNodes(container_of(head, UA_RegisteredNodes, rcu_head));
+}
+#endif
+
+void
+UA_Session_deleteRegisteredNodes(UA_Session *session) {
+    if(session->registeredNodes)
+        deleteRegisteredNodes(session->registeredNodes);
+    session->registeredNodes = NULL;
+}
+
+static UA_RegisteredNodes *
+getRegisteredNodes(UA_Session *session) {
+#ifdef UA_ENABLE_MULTITHREADING
+    return rcu_dereference(session->registeredNodes);
+#else
+    return session->registeredNodes;
+#endif
+}
+
+/* Publishes the new table if the table of the session is still the old one.
+ * Otherwise, the new table is deleted. */
+static UA_Boolean
+replaceRegisteredNodes(UA_Session *session, UA_RegisteredNodes *old,
+                       UA_RegisteredNodes *rn) {
+#ifdef UA_ENABLE_MULTITHREADING
+    if(rcu_cmpxchg_pointer(&session->registeredNodes, old, rn) != old) {
+        deleteRegisteredNodes(rn);
+        return false;
+    }
+    if(old)
+        call_rcu(&old->rcu_head, deleteRegisteredNodesRcu);
+#else
+    session->registeredNodes = rn;
+    if(old)
+        deleteRegisteredNodes(old);
+#endif
+    return true;
+}
+
+/* Copies the NodeIds into a table of the given size. The nodes are not
+ * resolved. */
+static UA_RegisteredNodes *
+copyRegisteredNodes(const UA_RegisteredNodes *rn, size_t entriesSize) {
+    UA_RegisteredNodes *copy =
+        UA_malloc(sizeof(UA_RegisteredNodes) + (entriesSize * sizeof(UA_RegisteredNode)));
+    if(!copy)
+        return NULL;
+    copy->resolved = false;
+    copy->nodesVersion = 0;
+    copy->entriesSize = entriesSize;
+    size_t oldSize = rn ? rn->entriesSize : 0;
+    for(size_t i = 0; i < entriesSize; ++i) {
+        copy->entries[i].node = NULL;
+        UA_NodeId_init(&copy->entries[i].nodeId);
+        if(i >= oldSize)
+            continue;
+        if(UA_NodeId_copy(&rn->entries[i].nodeId, &copy->entries[i].nodeId) !=
+           UA_STATUSCODE_GOOD) {
+            copy->entriesSize = i;
+            deleteRegisteredNodes(copy);
+            return NULL;
+        }
+    }
+    return copy;
+}
+
+/* Returns the entry for the alias or NULL */
+static const UA_RegisteredNode *
+findRegisteredNode(const UA_RegisteredNodes *rn, const UA_NodeId *alias) {
+    if(!rn || alias->namespaceIndex != UA_REGISTEREDNODES_NAMESPACE ||
+       alias->identifierType != UA_NODEIDTYPE_NUMERIC ||
+       alias->identifier.numeric >= rn->entriesSize)
+        return NULL;
+    const UA_RegisteredNode *entry = &rn->entries[alias->identifier.numeric];
+    if(UA_NodeId_isNull(&entry->nodeId))
+        return NULL;
+    return entry;
+}
+
+/* Resolves the nodes of the table and publishes the result. Returns NULL if
+ * nodes were replaced or removed in the meantime. Then the old table remains
+ * in place. */
+static UA_RegisteredNodes *
+resolveRegisteredNodes(UA_Server *server, UA_Session *session, UA_RegisteredNodes *rn) {
+    /* Read the version before the counter of changes in progress. A change
+     * that begins after the version was read increases the version again. */
+    UA_UInt32 version = UA_atomic_add(&server->nodesVersion, 0);
+    if(UA_atomic_add(&server->nodesChanging, 0) != 0)
+        return NULL;
+    UA_RegisteredNodes *resolved = copyRegisteredNodes(rn, rn->entriesSize);
+    if(!resolved)
+        return NULL;
+    for(size_t i = 0; i < resolved->entriesSize; ++i) {
+        if(!UA_NodeId_isNull(&resolved->entries[i].nodeId))
+            resolved->entries[i].node =
+                UA_NodeStore_get(server->nodestore, &resolved->entries[i].nodeId);
+    }
+    if(UA_atomic_add(&server->nodesVersion, 0) != version) {
+        deleteRegisteredNodes(resolved);
+        return NULL;
+    }
+    resolved->resolved = true;
+    resolved->nodesVersion = version;
+    if(!replaceRegisteredNodes(session, rn, resolved))
+        return NULL;
+    return resolved;
+}
+
+const UA_Node *
+UA_Server_getSessionNode(UA_Server *server, UA_Session *session, const UA_NodeId *nodeId) {
+    if(nodeId->namespaceIndex != UA_REGISTEREDNODES_NAMESPACE)
+        return UA_NodeStore_get(server->nodestore, nodeId);
+    UA_RegisteredNodes *rn = getRegisteredNodes(session);
+    const UA_RegisteredNode *entry = findRegisteredNode(rn, nodeId);
+    if(!entry)
+        return UA_NodeStore_get(server->nodestore, nodeId);
+    /* Inserting a node does not change the version. Nodes that were missing
+     * during the resolution are looked up again. */
+    if(rn->resolved && rn->nodesVersion == UA_atomic_add(&server->nodesVersion, 0))
+        return entry->node ? entry->node : UA_NodeStore_get(server->nodestore, &entry->nodeId);
+    UA_UInt32 position = nodeId->identifier.numeric;
+    UA_RegisteredNodes *resolved = resolveRegisteredNodes(server, session, rn);
+    if(!resolved)
+        return UA_NodeStore_get(server->nodestore, &entry->nodeId);
+    entry = &resolved->entries[position];
+    return entry->node ? entry->node : UA_NodeStore_get(server->nodestore, &entry->nodeId);
+}
+
+const UA_NodeId *
+UA_Session_resolveNodeId(UA_Session *session, const UA_NodeId *nodeId) {
+    if(nodeId->namespaceIndex != UA_REGISTEREDNODES_NAMESPACE)
+        return nodeId;
+    const UA_RegisteredNode *entry = findRegisteredNode(getRegisteredNodes(session), nodeId);
+    if(!entry)
+        return nodeId;
+    return &entry->nodeId;
+}
+
+/* Adds the existing nodes to a copy of the table (up to the maximum number of
+ * registered nodes) and writes the aliases. Other NodeIds are returned as
+ * they are. */
+static UA_StatusCode
+registerNodes(UA_Server *server, const UA_RegisteredNodes *rn,
+              const UA_RegisterNodesRequest *request, UA_NodeId *aliases,
+              UA_RegisteredNodes **result) {
+    /* Count the used entries and the existing nodes */
+    size_t oldSize = rn ? rn->entriesSize : 0;
+    size_t used = 0;
+    for(size_t i = 0; i < oldSize; ++i) {
+        if(!UA_NodeId_isNull(&rn->entries[i].nodeId))
+            ++used;
+    }
+    size_t added = 0;
+    for(size_t i = 0; i < request->nodesToRegisterSize; ++i) {
+        const UA_NodeId *nodeId = &request->nodesToRegister[i];
+        if(nodeId->namespaceIndex != UA_REGISTEREDNODES_NAMESPACE &&
+           UA_NodeStore_get(server->nodestore, nodeId))
+            ++added;
+    }
+    size_t max = server->config.maxRegisteredNodes;
+    if(used + added > max)
+        added = (used < max) ? max - used : 0;
+    size_t newSize = oldSize;
+    if(used + added > oldSize)
+        newSize = used + added;
+
+    UA_RegisteredNodes *copy = copyRegisteredNodes(rn, newSize);
+    if(!copy)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+
+    /* Fill the free entries */
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    size_t next = 0;
+    for(size_t i = 0; i < request->nodesToRegisterSize; ++i) {
+        const UA_NodeId *nodeId = &request->nodesToRegister[i];
+        if(added > 0 && nodeId->namespaceIndex != UA_REGISTEREDNODES_NAMESPACE &&
+           UA_NodeStore_get(server->nodestore, nodeId)) {
+            while(!UA_NodeId_isNull(&copy->entries[next].nodeId))
+                ++next;
+            retval |= UA_NodeId_copy(nodeId, &copy->entries[next].nodeId);
+            aliases[i] = UA_NODEID_NUMERIC(UA_REGISTEREDNODES_NAMESPACE, (UA_UInt32)next);
+            --added;
+            continue;
+        }
+        retval |= UA_NodeId_copy(nodeId, &aliases[i]);
+    }
+    if(retval != UA_STATUSCODE_GOOD) {
+        deleteRegisteredNodes(copy);
+        return retval;
+    }
+    *result = copy;
+    return UA_STATUSCODE_GOOD;
+}
+
 void Service_RegisterNodes(UA_Server *server, UA_Session *session, const UA_RegisterNodesRequest *request,
                            UA_RegisterNodesResponse *response) {
     UA_LOG_DEBUG_SESSION(server->config.logger, session, "Processing RegisterNodesRequest");
-    //TODO: hang the nodeids to the session if really needed
     response->responseHeader.timestamp = UA_DateTime_now();
-    if(request->nodesToRegisterSize <= 0)
+    if(request->nodesToRegisterSize <= 0) {
         response->responseHeader.serviceResult = UA_STATUSCODE_BADNOTHINGTODO;
-    else {
-        response->responseHeader.serviceResult =
-            UA_Array_copy(request->nodesToRegister, request->nodesToRegisterSize,
-                          (void**)&response->registeredNodeIds, &UA_TYPES[UA_TYPES_NODEID]);
-        if(response->responseHeader.serviceResult == UA_STATUSCODE_GOOD)
-            response->registeredNodeIdsSize = request->nodesToRegisterSize;
+        return;
+    }
+    size_t size = request->nodesToRegisterSize;
+    response->registeredNodeIds = UA_Array_new(size, &UA_TYPES[UA_TYPES_NODEID]);
+    if(!response->registeredNodeIds) {
+        response->responseHeader.serviceResult = UA_STATUSCODE_BADOUTOFMEMORY;
+        return;
     }
+    response->registeredNodeIdsSize = size;
+
+    /* Retry if the table was replaced concurrently */
+    UA_RegisteredNodes *rn, *copy;
+    do {
+        for(size_t i = 0; i < size; ++i) {
+            UA_NodeId_deleteMembers(&response->registeredNodeIds[i]);
+            UA_NodeId_init(&response->registeredNodeIds[i]);
+        }
+        rn = getRegisteredNodes(session);
+        UA_StatusCode retval =
+            registerNodes(server, rn, request, response->registeredNodeIds, &copy);
+        if(retval != UA_STATUSCODE_GOOD) {
+            response->responseHeader.serviceResult = retval;
+            return;
+        }
+    } while(!replaceRegisteredNodes(session, rn, copy));
 }
 
 void Service_UnregisterNodes(UA_Server *server, UA_Session *session, const UA_UnregisterNodesRequest *request,
                              UA_UnregisterNodesResponse *response) {
     UA_LOG_DEBUG_SESSION(server->config.logger, session, "Processing UnRegisterNodesRequest");
-    //TODO: remove the nodeids from the session if really needed
     response->responseHeader.timestamp = UA_DateTime_now();
-    if(request->nodesToUnregisterSize==0)
+    if(request->nodesToUnregisterSize == 0) {
         response->responseHeader.serviceResult = UA_STATUSCODE_BADNOTHINGTODO;
+        return;
+    }
+
+    /* Clear the entries of the aliases in a copy of the table. NodeIds that
+     * are not aliases of the session are ignored. */
+    UA_RegisteredNodes *rn, *copy;
+    do {
+        rn = getRegisteredNodes(session);
+        if(!rn)
+            return;
+        copy = copyRegisteredNodes(rn, rn->entriesSize);
+        if(!copy) {
+            response->responseHeader.serviceResult = UA_STATUSCODE_BADOUTOFMEMORY;
+            return;
+        }
+        for(size_t i = 0; i < request->nodesToUnregisterSize; ++i) {
+            const UA_NodeId *alias = &request->nodesToUnregister[i];
+            if(!findRegisteredNode(copy, alias))
+                continue;
+            UA_NodeId *nodeId = &copy->entries[alias->identifier.numeric].nodeId;
+            UA_NodeId_deleteMembers(nodeId);
+            UA_NodeId_init(nodeId);
+        }
+    } while(!replaceRegisteredNodes(session, rn, copy));
 }
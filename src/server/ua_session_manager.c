@@ -30,7 +30,7 @@ removeSessionEntry(UA_SessionManager *sm, session_list_entry *sentry) {
 #ifndef UA_ENABLE_MULTITHREADING
     UA_free(sentry);
 #else
-    UA_Server_delayedFree(sm->server, sentry);
+    UA_Server_delayedFree(sm->server, sentry, sizeof(session_list_entry));
 #endif
 }
 
@@ -79,6 +79,9 @@ UA_SessionManager_createSession(UA_SessionManager *sm, UA_SecureChannel *channel
 
     UA_atomic_add(&sm->currentSessionCount, 1);
     UA_Session_init(&newentry->session);
+    newentry->session.availableContinuationPoints = sm->server->config.maxContinuationPoints;
+    newentry->session.availableQueryContinuationPoints =
+        sm->server->config.maxQueryContinuationPoints;
     newentry->session.sessionId = UA_NODEID_GUID(1, UA_Guid_random());
     newentry->session.authenticationToken = UA_NODEID_GUID(1, UA_Guid_random());
 
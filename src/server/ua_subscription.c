@@ -150,7 +150,7 @@ void UA_MoniteredItem_SampleCallback(UA_Server *server, UA_MonitoredItem *monito
     rvid.indexRange = monitoredItem->indexRange;
     UA_DataValue value;
     UA_DataValue_init(&value);
-    Service_Read_single(server, sub->session, ts, &rvid, &value);
+    Service_Read_single(server, sub->session, ts, &rvid, &value, NULL);
 
     /* Stack-allocate some memory for the value encoding */
     UA_Byte *stackValueEncoding = UA_alloca(UA_VALUENCODING_MAXSTACK);
@@ -232,9 +232,10 @@ MonitoredItem_registerSampleJob(UA_Server *server, UA_MonitoredItem *mon) {
     job.type = UA_JOBTYPE_METHODCALL;
     job.job.methodCall.method = (UA_ServerCallback)UA_MoniteredItem_SampleCallback;
     job.job.methodCall.data = mon;
-    UA_StatusCode retval = UA_Server_addRepeatedJob(server, job,
-                                                    (UA_UInt32)mon->samplingInterval,
-                                                    &mon->sampleJobGuid);
+    UA_StatusCode retval =
+        UA_Server_addRepeatedJobWithPriority(server, job, (UA_UInt32)mon->samplingInterval,
+                                             server->config.samplingJobPriority,
+                                             &mon->sampleJobGuid);
     if(retval == UA_STATUSCODE_GOOD)
         mon->sampleJobIsRegistered = true;
     return retval;
@@ -559,8 +560,9 @@ Subscription_registerPublishJob(UA_Server *server, UA_Subscription *sub) {
     job.job.methodCall.method = (UA_ServerCallback)UA_Subscription_publishCallback;
     job.job.methodCall.data = sub;
     UA_StatusCode retval =
-        UA_Server_addRepeatedJob(server, job, (UA_UInt32)sub->publishingInterval,
-                                 &sub->publishJobGuid);
+        UA_Server_addRepeatedJobWithPriority(server, job, (UA_UInt32)sub->publishingInterval,
+                                             server->config.publishJobPriority,
+                                             &sub->publishJobGuid);
     if(retval == UA_STATUSCODE_GOOD)
         sub->publishJobIsRegistered = true;
     return retval;
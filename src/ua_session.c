@@ -21,7 +21,7 @@ UA_Session adminSession = {
     .sessionId = {.namespaceIndex = 0, .identifierType = UA_NODEIDTYPE_NUMERIC, .identifier.numeric = 1},
     .maxRequestMessageSize = UA_UINT32_MAX, .maxResponseMessageSize = UA_UINT32_MAX,
     .timeout = (UA_Double)UA_INT64_MAX, .validTill = UA_INT64_MAX, .channel = NULL,
-    .continuationPoints = {NULL}};
+    .continuationPoints = {NULL}, .queryContinuationPoints = {NULL}};
 
 void UA_Session_init(UA_Session *session) {
     UA_ApplicationDescription_init(&session->clientDescription);
@@ -36,6 +36,9 @@ void UA_Session_init(UA_Session *session) {
     session->channel = NULL;
     session->availableContinuationPoints = UA_MAXCONTINUATIONPOINTS;
     LIST_INIT(&session->continuationPoints);
+    session->registeredNodes = NULL;
+    session->availableQueryContinuationPoints = UA_MAXCONTINUATIONPOINTS;
+    LIST_INIT(&session->queryContinuationPoints);
 #ifdef UA_ENABLE_SUBSCRIPTIONS
     LIST_INIT(&session->serverSubscriptions);
     session->lastSubscriptionID = 0;
@@ -55,6 +58,8 @@ void UA_Session_deleteMembersCleanup(UA_Session *session, UA_Server* server) {
         UA_BrowseDescription_deleteMembers(&cp->browseDescription);
         UA_free(cp);
     }
+    UA_Session_deleteRegisteredNodes(session);
+    UA_Session_deleteQueryContinuationPoints(session);
     if(session->channel)
         UA_SecureChannel_detachSession(session->channel, session);
 #ifdef UA_ENABLE_SUBSCRIPTIONS
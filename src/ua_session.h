@@ -10,19 +10,35 @@
 #include "ua_securechannel.h"
 #include "ua_server.h"
 
+/* Default for sessions that are not created by the session manager. The
+ * session manager uses maxContinuationPoints from the server config. */
 #define UA_MAXCONTINUATIONPOINTS 5
 
+/* The continuation point remembers the position in the reference array of the
+ * browsed node where the next browse resumes. The position is only valid as
+ * long as the node was not edited since (same version). Otherwise, the
+ * continuationIndex matching references are skipped from the beginning. */
 struct ContinuationPointEntry {
     LIST_ENTRY(ContinuationPointEntry) pointers;
     UA_ByteString        identifier;
     UA_BrowseDescription browseDescription;
     UA_UInt32            continuationIndex;
     UA_UInt32            maxReferences;
+    size_t               position;
+    UA_UInt32            nodeVersion;
 };
 
 struct UA_Subscription;
 typedef struct UA_Subscription UA_Subscription;
 
+/* The nodes registered with RegisterNodes (defined in ua_server_internal.h) */
+struct UA_RegisteredNodes;
+typedef struct UA_RegisteredNodes UA_RegisteredNodes;
+
+/* The remaining candidates of a query (defined in ua_services_query.c) */
+struct UA_QueryContinuationPoint;
+typedef struct UA_QueryContinuationPoint UA_QueryContinuationPoint;
+
 #ifdef UA_ENABLE_SUBSCRIPTIONS
 typedef struct UA_PublishResponseEntry {
     SIMPLEQ_ENTRY(UA_PublishResponseEntry) listEntry;
@@ -44,6 +60,9 @@ struct UA_Session {
     UA_SecureChannel *channel;
     UA_UInt16 availableContinuationPoints;
     LIST_HEAD(ContinuationPointList, ContinuationPointEntry) continuationPoints;
+    UA_RegisteredNodes *registeredNodes;
+    UA_UInt16 availableQueryContinuationPoints;
+    LIST_HEAD(QueryContinuationPointList, UA_QueryContinuationPoint) queryContinuationPoints;
 #ifdef UA_ENABLE_SUBSCRIPTIONS
     UA_UInt32 lastSubscriptionID;
     LIST_HEAD(UA_ListOfUASubscriptions, UA_Subscription) serverSubscriptions;
@@ -58,6 +77,12 @@ extern UA_Session adminSession;
 void UA_Session_init(UA_Session *session);
 void UA_Session_deleteMembersCleanup(UA_Session *session, UA_Server *server);
 
+/* Frees the registered nodes right away (defined in ua_services_view.c) */
+void UA_Session_deleteRegisteredNodes(UA_Session *session);
+
+/* Defined in ua_services_query.c */
+void UA_Session_deleteQueryContinuationPoints(UA_Session *session);
+
 /* If any activity on a session happens, the timeout is extended */
 void UA_Session_updateLifetime(UA_Session *session);
 
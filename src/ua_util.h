@@ -81,6 +81,24 @@ UA_atomic_cmpxchg(void * volatile * addr, void *expected, void *newptr) {
 #endif
 }
 
+static UA_INLINE uint32_t
+UA_atomic_cmpxchg32(volatile uint32_t *addr, uint32_t expected, uint32_t newval) {
+#ifndef UA_ENABLE_MULTITHREADING
+    uint32_t old = *addr;
+    if(old == expected) {
+        *addr = newval;
+    }
+    return old;
+#else
+# ifdef _MSC_VER /* Visual Studio */
+    return (uint32_t)_InterlockedCompareExchange((volatile long*)addr, (long)newval,
+                                                 (long)expected);
+# else /* GCC/Clang */
+    return __sync_val_compare_and_swap(addr, expected, newval);
+# endif
+#endif
+}
+
 static UA_INLINE uint32_t
 UA_atomic_add(volatile uint32_t *addr, uint32_t increase) {
 #ifndef UA_ENABLE_MULTITHREADING
@@ -2,10 +2,6 @@
 *  License, v. 2.0. If a copy of the MPL was not distributed with this 
 *  file, You can obtain one at http://mozilla.org/MPL/2.0/.*/
 
-#include <stdio.h>
-#include <stdlib.h>
-#include <pthread.h>
-
 #include "ua_types.h"
 #include "ua_server.h"
 #include "ua_client.h"
@@ -13,6 +9,12 @@
 #include "ua_network_tcp.h"
 #include "check.h"
 
+/* After ua_config.h, which selects the POSIX feature level for usleep */
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
 UA_Server *server;
 UA_Boolean *running;
 UA_ServerNetworkLayer nl;
@@ -38,6 +40,7 @@ static void setup(void) {
 
 static void teardown(void) {
     *running = false;
+    UA_Server_wakeup(server);
     pthread_join(server_thread, NULL);
     UA_Server_run_shutdown(server);
     UA_Boolean_delete(running);
@@ -56,11 +59,286 @@ START_TEST(Client_connect) {
 }
 END_TEST
 
+#ifdef UA_ENABLE_METHODCALLS
+static UA_MethodCallToken * volatile pendingToken = NULL;
+static UA_MethodCallToken * volatile lateToken = NULL;
+static volatile UA_Boolean completeLateCall = false;
+static volatile UA_StatusCode lateCallResult = UA_STATUSCODE_GOOD;
+
+static UA_StatusCode
+asyncMethod(void *handle, const UA_NodeId objectId,
+            size_t inputSize, const UA_Variant *input,
+            size_t outputSize, UA_Variant *output,
+            UA_MethodCallToken *token) {
+    if(handle)
+        lateToken = token;
+    else
+        pendingToken = token;
+    return UA_STATUSCODE_GOODCOMPLETESASYNCHRONOUSLY;
+}
+
+/* Completes the pending method call from a repeated job. The late call is
+ * completed only after the response was received. */
+static void
+completeAsyncMethod(UA_Server *serverPtr, void *data) {
+    UA_Int32 result = 42;
+    UA_Variant output;
+    UA_Variant_setScalar(&output, &result, &UA_TYPES[UA_TYPES_INT32]);
+    UA_MethodCallToken *token = pendingToken;
+    if(token) {
+        pendingToken = NULL;
+        UA_Server_completeMethodCall(serverPtr, token, UA_STATUSCODE_GOOD, 1, &output);
+    }
+    token = lateToken;
+    if(token && completeLateCall) {
+        lateToken = NULL;
+        lateCallResult =
+            UA_Server_completeMethodCall(serverPtr, token, UA_STATUSCODE_GOOD, 1, &output);
+    }
+}
+
+/* Completes the token before returning */
+static UA_StatusCode
+completingMethod(void *handle, const UA_NodeId objectId,
+                 size_t inputSize, const UA_Variant *input,
+                 size_t outputSize, UA_Variant *output,
+                 UA_MethodCallToken *token) {
+    UA_Int32 result = 42;
+    UA_Variant out;
+    UA_Variant_setScalar(&out, &result, &UA_TYPES[UA_TYPES_INT32]);
+    UA_Server_completeMethodCall(server, token, UA_STATUSCODE_GOOD, 1, &out);
+    return UA_STATUSCODE_GOODCOMPLETESASYNCHRONOUSLY;
+}
+
+static void
+addAsyncMethod(UA_NodeId methodId, UA_AsyncMethodCallback method, void *handle) {
+    UA_Argument outputArgument;
+    UA_Argument_init(&outputArgument);
+    outputArgument.dataType = UA_TYPES[UA_TYPES_INT32].typeId;
+    outputArgument.name = UA_STRING("result");
+    outputArgument.valueRank = -1;
+    UA_MethodAttributes attr;
+    UA_MethodAttributes_init(&attr);
+    attr.executable = true;
+    attr.userExecutable = true;
+    UA_StatusCode retval =
+        UA_Server_addMethodNode(server, methodId,
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT),
+                                UA_QUALIFIEDNAME(1, "async"), attr, NULL, NULL,
+                                0, NULL, 1, &outputArgument, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    retval = UA_Server_setMethodNode_asyncCallback(server, methodId, method, handle);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+}
+
+START_TEST(Client_asyncMethodCall) {
+    addAsyncMethod(UA_NODEID_NUMERIC(1, 62541), asyncMethod, NULL);
+    UA_Job job = {.type = UA_JOBTYPE_METHODCALL,
+                  .job.methodCall = {.method = completeAsyncMethod, .data = NULL}};
+    UA_Guid jobId;
+    UA_Server_addRepeatedJob(server, job, 10, &jobId);
+
+    UA_Client *client = UA_Client_new(UA_ClientConfig_standard);
+    UA_StatusCode retval = UA_Client_connect(client, "opc.tcp://localhost:16664");
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    size_t outputSize = 0;
+    UA_Variant *output = NULL;
+    retval = UA_Client_call(client, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                            UA_NODEID_NUMERIC(1, 62541), 0, NULL, &outputSize, &output);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(outputSize, 1);
+    ck_assert_int_eq(*(UA_Int32*)output[0].data, 42);
+    UA_Array_delete(output, outputSize, &UA_TYPES[UA_TYPES_VARIANT]);
+
+    UA_Client_disconnect(client);
+    UA_Client_delete(client);
+    UA_Server_removeRepeatedJob(server, jobId);
+}
+END_TEST
+
+START_TEST(Client_asyncMethodCallCompletedInCallback) {
+    addAsyncMethod(UA_NODEID_NUMERIC(1, 62545), completingMethod, NULL);
+    UA_Client *client = UA_Client_new(UA_ClientConfig_standard);
+    UA_StatusCode retval = UA_Client_connect(client, "opc.tcp://localhost:16664");
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    /* The result of the completion is returned, not the return value of the
+     * callback */
+    size_t outputSize = 0;
+    UA_Variant *output = NULL;
+    retval = UA_Client_call(client, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                            UA_NODEID_NUMERIC(1, 62545), 0, NULL, &outputSize, &output);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(outputSize, 1);
+    ck_assert_int_eq(*(UA_Int32*)output[0].data, 42);
+    UA_Array_delete(output, outputSize, &UA_TYPES[UA_TYPES_VARIANT]);
+
+    UA_Client_disconnect(client);
+    UA_Client_delete(client);
+}
+END_TEST
+
+START_TEST(Client_asyncMethodCallTimeout) {
+    addAsyncMethod(UA_NODEID_NUMERIC(1, 62544), asyncMethod, (void*)(uintptr_t)1);
+    UA_Job job = {.type = UA_JOBTYPE_METHODCALL,
+                  .job.methodCall = {.method = completeAsyncMethod, .data = NULL}};
+    UA_Guid jobId;
+    UA_Server_addRepeatedJob(server, job, 10, &jobId);
+
+    UA_Client *client = UA_Client_new(UA_ClientConfig_standard);
+    UA_StatusCode retval = UA_Client_connect(client, "opc.tcp://localhost:16664");
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    UA_CallMethodRequest item;
+    UA_CallMethodRequest_init(&item);
+    item.objectId = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    item.methodId = UA_NODEID_NUMERIC(1, 62544);
+    UA_CallRequest request;
+    UA_CallRequest_init(&request);
+    request.requestHeader.timeoutHint = 100;
+    request.methodsToCall = &item;
+    request.methodsToCallSize = 1;
+    UA_CallResponse response = UA_Client_Service_call(client, request);
+    ck_assert_uint_eq(response.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(response.resultsSize, 1);
+    ck_assert_uint_eq(response.results[0].statusCode, UA_STATUSCODE_BADTIMEOUT);
+    UA_CallResponse_deleteMembers(&response);
+
+    /* Completing the timed out call */
+    completeLateCall = true;
+    for(size_t i = 0; i < 100 && lateToken; ++i)
+        usleep(10000);
+    ck_assert_ptr_eq(lateToken, NULL);
+    ck_assert_uint_eq(lateCallResult, UA_STATUSCODE_BADTIMEOUT);
+
+    UA_Client_disconnect(client);
+    UA_Client_delete(client);
+    UA_Server_removeRepeatedJob(server, jobId);
+}
+END_TEST
+#endif
+
+static UA_ReadToken * volatile pendingRead = NULL;
+static UA_ReadToken * volatile lateRead = NULL;
+static volatile UA_Boolean completeLateRead = false;
+static volatile UA_StatusCode lateReadResult = UA_STATUSCODE_GOOD;
+
+static UA_StatusCode
+readAnswer(void *handle, const UA_NodeId nodeid, UA_Boolean sourceTimeStamp,
+           const UA_NumericRange *range, UA_DataValue *value) {
+    UA_Int32 answer = 42;
+    value->hasValue = true;
+    return UA_Variant_setScalarCopy(&value->value, &answer, &UA_TYPES[UA_TYPES_INT32]);
+}
+
+static UA_StatusCode
+readAnswerAsync(void *handle, const UA_NodeId nodeid, UA_Boolean sourceTimeStamp,
+                const UA_NumericRange *range, UA_DataValue *value, UA_ReadToken *token) {
+    if(handle)
+        lateRead = token;
+    else
+        pendingRead = token;
+    return UA_STATUSCODE_GOODCOMPLETESASYNCHRONOUSLY;
+}
+
+/* Completes the pending read from a repeated job. The late read is completed
+ * only after the response was received. */
+static void
+completeAsyncRead(UA_Server *serverPtr, void *data) {
+    UA_Int32 answer = 42;
+    UA_DataValue value;
+    UA_DataValue_init(&value);
+    value.hasValue = true;
+    UA_Variant_setScalar(&value.value, &answer, &UA_TYPES[UA_TYPES_INT32]);
+    UA_ReadToken *token = pendingRead;
+    if(token) {
+        pendingRead = NULL;
+        UA_Server_completeRead(serverPtr, token, &value);
+    }
+    token = lateRead;
+    if(token && completeLateRead) {
+        lateRead = NULL;
+        lateReadResult = UA_Server_completeRead(serverPtr, token, &value);
+    }
+}
+
+START_TEST(Client_asyncRead) {
+    UA_DataSource dataSource = (UA_DataSource) {
+        .handle = NULL, .read = readAnswer, .readAsync = readAnswerAsync, .write = NULL};
+    UA_VariableAttributes attr;
+    UA_VariableAttributes_init(&attr);
+    UA_StatusCode retval =
+        UA_Server_addDataSourceVariableNode(server, UA_NODEID_NUMERIC(1, 62542),
+                                            UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                            UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                            UA_QUALIFIEDNAME(1, "answer"),
+                                            UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE),
+                                            attr, dataSource, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    dataSource.handle = (void*)(uintptr_t)1;
+    retval = UA_Server_addDataSourceVariableNode(server, UA_NODEID_NUMERIC(1, 62543),
+                                                 UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                                 UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                                 UA_QUALIFIEDNAME(1, "late"),
+                                                 UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE),
+                                            attr, dataSource, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    UA_Job job = {.type = UA_JOBTYPE_METHODCALL,
+                  .job.methodCall = {.method = completeAsyncRead, .data = NULL}};
+    UA_Guid jobId;
+    UA_Server_addRepeatedJob(server, job, 10, &jobId);
+
+    UA_Client *client = UA_Client_new(UA_ClientConfig_standard);
+    retval = UA_Client_connect(client, "opc.tcp://localhost:16664");
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    UA_ReadValueId items[2];
+    UA_ReadValueId_init(&items[0]);
+    items[0].nodeId = UA_NODEID_NUMERIC(1, 62542);
+    items[0].attributeId = UA_ATTRIBUTEID_VALUE;
+    UA_ReadValueId_init(&items[1]);
+    items[1].nodeId = UA_NODEID_NUMERIC(1, 62543);
+    items[1].attributeId = UA_ATTRIBUTEID_VALUE;
+    UA_ReadRequest request;
+    UA_ReadRequest_init(&request);
+    request.requestHeader.timeoutHint = 100;
+    request.nodesToRead = items;
+    request.nodesToReadSize = 2;
+    UA_ReadResponse response = UA_Client_Service_read(client, request);
+    ck_assert_uint_eq(response.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(response.resultsSize, 2);
+    ck_assert(response.results[0].hasValue);
+    ck_assert_int_eq(*(UA_Int32*)response.results[0].value.data, 42);
+    ck_assert(response.results[1].hasStatus);
+    ck_assert_uint_eq(response.results[1].status, UA_STATUSCODE_BADTIMEOUT);
+    UA_ReadResponse_deleteMembers(&response);
+
+    /* Completing the timed out read */
+    completeLateRead = true;
+    for(size_t i = 0; i < 100 && lateRead; ++i)
+        usleep(10000);
+    ck_assert_ptr_eq(lateRead, NULL);
+    ck_assert_uint_eq(lateReadResult, UA_STATUSCODE_BADTIMEOUT);
+
+    UA_Client_disconnect(client);
+    UA_Client_delete(client);
+    UA_Server_removeRepeatedJob(server, jobId);
+}
+END_TEST
+
 static Suite* testSuite_Client(void) {
     Suite *s = suite_create("Client");
     TCase *tc_client = tcase_create("Client Basic");
     tcase_add_checked_fixture(tc_client, setup, teardown);
     tcase_add_test(tc_client, Client_connect);
+    tcase_add_test(tc_client, Client_asyncRead);
+#ifdef UA_ENABLE_METHODCALLS
+    tcase_add_test(tc_client, Client_asyncMethodCall);
+    tcase_add_test(tc_client, Client_asyncMethodCallCompletedInCallback);
+    tcase_add_test(tc_client, Client_asyncMethodCallTimeout);
+#endif
     suite_add_tcase(s,tc_client);
     return s;
 }
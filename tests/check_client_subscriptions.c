@@ -39,6 +39,7 @@ static void setup(void) {
 
 static void teardown(void) {
     *running = false;
+    UA_Server_wakeup(server);
     pthread_join(server_thread, NULL);
     UA_Server_run_shutdown(server);
     UA_Boolean_delete(running);
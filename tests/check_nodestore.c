@@ -31,17 +31,17 @@ static void teardown(void) {
 
 int zeroCnt = 0;
 int visitCnt = 0;
-static void checkZeroVisitor(const UA_Node* node) {
+static void checkZeroVisitor(void *visitorContext, const UA_Node* node) {
     visitCnt++;
     if (node == NULL) zeroCnt++;
 }
 
-static void printVisitor(const UA_Node* node) {
+static void printVisitor(void *visitorContext, const UA_Node* node) {
     printf("%d\n", node->nodeId.identifier.numeric);
 }
 
 static UA_Node* createNode(UA_Int16 nsid, UA_Int32 id) {
-    UA_Node *p = (UA_Node *)UA_NodeStore_newVariableNode();
+    UA_Node *p = (UA_Node *)UA_NodeStore_newVariableNode(ns);
     p->nodeId.identifierType = UA_NODEIDTYPE_NUMERIC;
     p->nodeId.namespaceIndex = nsid;
     p->nodeId.identifier.numeric = id;
@@ -76,6 +76,112 @@ START_TEST(replaceOldNode) {
 }
 END_TEST
 
+START_TEST(replaceImageNodeWithCopy) {
+    UA_StatusCode retval = UA_NodeStore_linkImage(ns, &UA_NodeStoreImage_ns0);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    UA_NodeId in1 = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    const UA_Node *imageNode = UA_NodeStore_get(ns, &in1);
+    ck_assert_ptr_ne(imageNode, NULL);
+    ck_assert(UA_NodeStore_isImmutable(ns, imageNode));
+
+    /* the nodeid is taken */
+    UA_Node *n1 = createNode(0, UA_NS0ID_OBJECTSFOLDER);
+    retval = UA_NodeStore_insert(ns, n1);
+    ck_assert_int_eq(retval, UA_STATUSCODE_BADNODEIDEXISTS);
+
+    /* copy on write */
+    UA_Node *n2 = UA_NodeStore_getCopy(ns, &in1);
+    ck_assert_int_eq(n2->nodeClass, UA_NODECLASS_OBJECT);
+    UA_LocalizedText_deleteMembers(&n2->displayName);
+    n2->displayName = UA_LOCALIZEDTEXT_ALLOC("en_US", "Copied");
+    retval = UA_NodeStore_replace(ns, n2);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    const UA_Node *copied = UA_NodeStore_get(ns, &in1);
+    ck_assert_ptr_ne(copied, imageNode);
+    ck_assert(!UA_NodeStore_isImmutable(ns, copied));
+    UA_String copiedText = UA_STRING("Copied");
+    UA_String objectsText = UA_STRING("Objects");
+    ck_assert(UA_String_equal(&copied->displayName.text, &copiedText));
+    ck_assert(UA_String_equal(&imageNode->displayName.text, &objectsText));
+
+    /* remove an image node */
+    UA_NodeId in2 = UA_NODEID_NUMERIC(0, UA_NS0ID_ROOTFOLDER);
+    retval = UA_NodeStore_remove(ns, &in2);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_ptr_eq(UA_NodeStore_get(ns, &in2), NULL);
+    retval = UA_NodeStore_remove(ns, &in2);
+    ck_assert_int_eq(retval, UA_STATUSCODE_BADNODEIDUNKNOWN);
+
+    /* the copy is visited instead of the image node */
+    zeroCnt = 0;
+    visitCnt = 0;
+    UA_NodeStore_iterate(ns, NULL, checkZeroVisitor);
+    ck_assert_int_eq(zeroCnt, 0);
+    ck_assert_int_eq(visitCnt, UA_NodeStoreImage_ns0.nodesSize - 1);
+}
+END_TEST
+
+/* The copy of a removed image node is not inserted */
+START_TEST(replaceRemovedImageNode) {
+    UA_StatusCode retval = UA_NodeStore_linkImage(ns, &UA_NodeStoreImage_ns0);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    UA_NodeId objects = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    UA_Node *copy = UA_NodeStore_getCopy(ns, &objects);
+    ck_assert_ptr_ne(copy, NULL);
+    retval = UA_NodeStore_remove(ns, &objects);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    retval = UA_NodeStore_replace(ns, copy);
+    ck_assert_int_eq(retval, UA_STATUSCODE_BADNODEIDUNKNOWN);
+    ck_assert_ptr_eq(UA_NodeStore_get(ns, &objects), NULL);
+}
+END_TEST
+
+#ifdef UA_ENABLE_MULTITHREADING
+static volatile size_t copiesTaken;
+
+/* Takes a copy of each image node and signals the removing thread before the
+ * copy is put back. So that the replace and the remove overlap. */
+static void *replaceImageNodesThread(void *arg) {
+    rcu_register_thread();
+    UA_RCU_LOCK();
+    for(size_t i = 0; i < UA_NodeStoreImage_ns0.nodesSize; ++i) {
+        UA_Node *copy = UA_NodeStore_getCopy(ns, &UA_NodeStoreImage_ns0.nodes[i]->nodeId);
+        copiesTaken = i + 1;
+        UA_NodeStore_replace(ns, copy);
+    }
+    UA_RCU_UNLOCK();
+    rcu_unregister_thread();
+    return NULL;
+}
+
+/* A copy of an image node that is inserted while the node is removed does not
+ * survive the removal */
+START_TEST(removeImageNodesWhileReplaced) {
+    UA_StatusCode retval;
+    for(size_t round = 0; round < 20; ++round) {
+        retval = UA_NodeStore_linkImage(ns, &UA_NodeStoreImage_ns0);
+        ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+        copiesTaken = 0;
+        pthread_t t;
+        pthread_create(&t, NULL, replaceImageNodesThread, NULL);
+        for(size_t i = 0; i < UA_NodeStoreImage_ns0.nodesSize; ++i) {
+            while(copiesTaken <= i)
+                UA_atomic_sync();
+            retval = UA_NodeStore_remove(ns, &UA_NodeStoreImage_ns0.nodes[i]->nodeId);
+            ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+        }
+        pthread_join(t, NULL);
+        for(size_t i = 0; i < UA_NodeStoreImage_ns0.nodesSize; ++i) {
+            const UA_NodeId *id = &UA_NodeStoreImage_ns0.nodes[i]->nodeId;
+            ck_assert_ptr_eq(UA_NodeStore_get(ns, id), NULL);
+        }
+        UA_NodeStore_delete(ns);
+        ns = UA_NodeStore_new();
+    }
+}
+END_TEST
+#endif
+
 START_TEST(findNodeInUA_NodeStoreWithSingleEntry) {
     UA_Node* n1 = createNode(0,2253);
     UA_NodeStore_insert(ns, n1);
@@ -130,7 +236,7 @@ START_TEST(iterateOverUA_NodeStoreShallNotVisitEmptyNodes) {
 
     zeroCnt = 0;
     visitCnt = 0;
-    UA_NodeStore_iterate(ns,checkZeroVisitor);
+    UA_NodeStore_iterate(ns, NULL, checkZeroVisitor);
     ck_assert_int_eq(zeroCnt, 0);
     ck_assert_int_eq(visitCnt, 6);
 }
@@ -145,7 +251,7 @@ START_TEST(findNodeInExpandedNamespace) {
     UA_Node *n2 = createNode(0,25);
     const UA_Node* nr = UA_NodeStore_get(ns,&n2->nodeId);
     ck_assert_int_eq(nr->nodeId.identifier.numeric,n2->nodeId.identifier.numeric);
-    UA_NodeStore_deleteNode(n2);
+    UA_NodeStore_deleteNode(ns, n2);
 }
 END_TEST
 
@@ -157,7 +263,7 @@ START_TEST(iterateOverExpandedNamespaceShallNotVisitEmptyNodes) {
     // when
     zeroCnt = 0;
     visitCnt = 0;
-    UA_NodeStore_iterate(ns,checkZeroVisitor);
+    UA_NodeStore_iterate(ns, NULL, checkZeroVisitor);
     // then
     ck_assert_int_eq(zeroCnt, 0);
     ck_assert_int_eq(visitCnt, 200);
@@ -182,6 +288,342 @@ START_TEST(failToFindNonExistantNodeInUA_NodeStoreWithSeveralEntries) {
 }
 END_TEST
 
+START_TEST(findNodeMovedIntoDenseArray) {
+    /* A sparse identifier is stored in the hash-map first */
+    UA_Node* n1 = createNode(2,100000);
+    UA_NodeStore_insert(ns, n1);
+    for(UA_UInt32 i = 1; i <= 20000; i++) {
+        UA_Node* n = createNode(2,i);
+        UA_NodeStore_insert(ns, n);
+    }
+    UA_NodeId in1 = UA_NODEID_NUMERIC(2, 100000);
+    const UA_Node* nr = UA_NodeStore_get(ns, &in1);
+    ck_assert_int_eq((uintptr_t)nr, (uintptr_t)n1);
+
+    /* Inserting the same identifier again fails */
+    UA_Node* n2 = createNode(2,100000);
+    UA_StatusCode retval = UA_NodeStore_insert(ns, n2);
+    ck_assert_int_eq(retval, UA_STATUSCODE_BADNODEIDEXISTS);
+
+    zeroCnt = 0;
+    visitCnt = 0;
+    UA_NodeStore_iterate(ns, NULL, checkZeroVisitor);
+    ck_assert_int_eq(zeroCnt, 0);
+    ck_assert_int_eq(visitCnt, 20001);
+}
+END_TEST
+
+START_TEST(findNodeWithStringAndNumericIds) {
+    UA_Node* n1 = createNode(1,12);
+    UA_NodeStore_insert(ns, n1);
+    UA_Node* n2 = (UA_Node *)UA_NodeStore_newVariableNode(ns);
+    n2->nodeId = UA_NODEID_STRING_ALLOC(1, "12");
+    UA_NodeStore_insert(ns, n2);
+
+    UA_NodeId in1 = UA_NODEID_NUMERIC(1, 12);
+    ck_assert_int_eq((uintptr_t)UA_NodeStore_get(ns, &in1), (uintptr_t)n1);
+    UA_NodeId in2 = UA_NODEID_STRING(1, "12");
+    ck_assert_int_eq((uintptr_t)UA_NodeStore_get(ns, &in2), (uintptr_t)n2);
+
+    /* Removed nodes are not found */
+    UA_StatusCode retval = UA_NodeStore_remove(ns, &in1);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_int_eq((uintptr_t)UA_NodeStore_get(ns, &in1), 0);
+    retval = UA_NodeStore_remove(ns, &in1);
+    ck_assert_int_eq(retval, UA_STATUSCODE_BADNODEIDUNKNOWN);
+}
+END_TEST
+
+START_TEST(saveAndLoadSnapshot) {
+    UA_NodeStore_linkImage(ns, &UA_NodeStoreImage_ns0);
+    UA_NodeId rootId = UA_NODEID_NUMERIC(0, UA_NS0ID_ROOTFOLDER);
+    UA_NodeStore_remove(ns, &rootId);
+
+    UA_VariableNode *vn = UA_NodeStore_newVariableNode(ns);
+    vn->nodeId = UA_NODEID_STRING_ALLOC(1, "snapshot.variable");
+    vn->browseName = UA_QUALIFIEDNAME_ALLOC(1, "Variable");
+    UA_Int32 values[3] = {1, 2, 3};
+    UA_Variant_setArrayCopy(&vn->value.data.value.value, values, 3, &UA_TYPES[UA_TYPES_INT32]);
+    vn->value.data.value.hasValue = true;
+    UA_ExpandedNodeId target = UA_EXPANDEDNODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    UA_NodeId organizes = UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES);
+    UA_Node_addReference((UA_Node*)vn, &organizes, true, &target);
+    UA_StatusCode retval = UA_NodeStore_insert(ns, (UA_Node*)vn);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+
+    zeroCnt = 0;
+    visitCnt = 0;
+    UA_NodeStore_iterate(ns, NULL, checkZeroVisitor);
+    int savedCnt = visitCnt;
+
+    retval = UA_NodeStore_saveSnapshot(ns, "check_nodestore_snapshot.bin");
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+
+    /* Load into a fresh nodestore with the full namespace 0 */
+    UA_NodeStoreSnapshot *snapshot;
+    retval = UA_NodeStoreSnapshot_load("check_nodestore_snapshot.bin", &snapshot);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    UA_NodeStore *ns2 = UA_NodeStore_new();
+    UA_NodeStore_linkImage(ns2, &UA_NodeStoreImage_ns0);
+    retval = UA_NodeStore_linkImage(ns2, UA_NodeStoreSnapshot_getImage(snapshot));
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+
+    const UA_VariableNode *loaded = (const UA_VariableNode*)UA_NodeStore_get(ns2, &vn->nodeId);
+    ck_assert_ptr_ne(loaded, NULL);
+    ck_assert(UA_NodeStore_isImmutable(ns2, (const UA_Node*)loaded));
+    ck_assert(UA_String_equal(&loaded->browseName.name, &vn->browseName.name));
+    const UA_Variant *value = &UA_VariableNode_getValue(loaded)->value;
+    ck_assert_ptr_eq(value->type, &UA_TYPES[UA_TYPES_INT32]);
+    ck_assert_int_eq(value->arrayLength, 3);
+    ck_assert_int_eq(((UA_Int32*)value->data)[2], 3);
+    ck_assert_int_eq(loaded->referencesSize, 1);
+    ck_assert(UA_NodeId_equal(&loaded->references[0].targetId.nodeId, &target.nodeId));
+
+    /* The removed node stays hidden */
+    ck_assert_ptr_eq(UA_NodeStore_get(ns2, &rootId), NULL);
+    zeroCnt = 0;
+    visitCnt = 0;
+    UA_NodeStore_iterate(ns2, NULL, checkZeroVisitor);
+    ck_assert_int_eq(zeroCnt, 0);
+    ck_assert_int_eq(visitCnt, savedCnt);
+
+    /* Copy on write of a snapshot node */
+    UA_Node *copy = UA_NodeStore_getCopy(ns2, &vn->nodeId);
+    ck_assert_ptr_ne(copy, NULL);
+    retval = UA_NodeStore_replace(ns2, copy);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert(!UA_NodeStore_isImmutable(ns2, UA_NodeStore_get(ns2, &vn->nodeId)));
+
+    UA_NodeStore_delete(ns2);
+    UA_NodeStoreSnapshot_delete(snapshot);
+    remove("check_nodestore_snapshot.bin");
+}
+END_TEST
+
+static void
+writeFile(const char *path, const UA_Byte *data, size_t size) {
+    FILE *f = fopen(path, "wb");
+    ck_assert_ptr_ne(f, NULL);
+    ck_assert_uint_eq(fwrite(data, 1, size, f), size);
+    fclose(f);
+}
+
+START_TEST(loadCorruptSnapshot) {
+    UA_VariableNode *vn = UA_NodeStore_newVariableNode(ns);
+    vn->nodeId = UA_NODEID_STRING_ALLOC(1, "snapshot.variable");
+    vn->browseName = UA_QUALIFIEDNAME_ALLOC(1, "Variable");
+    UA_String values[2];
+    values[0] = UA_STRING("a");
+    values[1] = UA_STRING("bc");
+    UA_Variant_setArrayCopy(&vn->value.data.value.value, values, 2, &UA_TYPES[UA_TYPES_STRING]);
+    vn->value.data.value.hasValue = true;
+    UA_ExpandedNodeId target = UA_EXPANDEDNODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    UA_NodeId organizes = UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES);
+    UA_Node_addReference((UA_Node*)vn, &organizes, true, &target);
+    UA_NodeStore_insert(ns, (UA_Node*)vn);
+    UA_NodeStore_insert(ns, createNode(1, 2253));
+    UA_StatusCode retval = UA_NodeStore_saveSnapshot(ns, "check_nodestore_snapshot.bin");
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+
+    FILE *f = fopen("check_nodestore_snapshot.bin", "rb");
+    ck_assert_ptr_ne(f, NULL);
+    fseek(f, 0, SEEK_END);
+    size_t size = (size_t)ftell(f);
+    fseek(f, 0, SEEK_SET);
+    UA_Byte *original = (UA_Byte*)UA_malloc(size);
+    UA_Byte *corrupt = (UA_Byte*)UA_malloc(size);
+    ck_assert_uint_eq(fread(original, 1, size, f), size);
+    fclose(f);
+
+    /* Truncated */
+    UA_NodeStoreSnapshot *snapshot;
+    writeFile("check_nodestore_snapshot.bin", original, size - 8);
+    retval = UA_NodeStoreSnapshot_load("check_nodestore_snapshot.bin", &snapshot);
+    ck_assert_int_eq(retval, UA_STATUSCODE_BADDECODINGERROR);
+
+    /* Every pointer-sized field overwritten. The file is either rejected or
+     * loaded without accessing memory outside of the mapping. */
+    const uintptr_t garbage[3] = {UINTPTR_MAX, 8, size - 8};
+    for(size_t i = 0; i + sizeof(uintptr_t) <= size; i += sizeof(uintptr_t)) {
+        for(size_t j = 0; j < 3; ++j) {
+            memcpy(corrupt, original, size);
+            memcpy(&corrupt[i], &garbage[j], sizeof(uintptr_t));
+            writeFile("check_nodestore_snapshot.bin", corrupt, size);
+            retval = UA_NodeStoreSnapshot_load("check_nodestore_snapshot.bin", &snapshot);
+            if(retval != UA_STATUSCODE_GOOD) {
+                ck_assert(retval == UA_STATUSCODE_BADDECODINGERROR ||
+                          retval == UA_STATUSCODE_BADNOTSUPPORTED);
+                continue;
+            }
+            const UA_NodeStoreImage *image = UA_NodeStoreSnapshot_getImage(snapshot);
+            for(size_t k = 0; k < image->nodesSize; ++k) {
+                UA_Node *copy = UA_NodeStore_newNode(ns, image->nodes[k]->nodeClass);
+                ck_assert_int_eq(UA_Node_copyAnyNodeClass(image->nodes[k], copy),
+                                 UA_STATUSCODE_GOOD);
+                UA_NodeStore_deleteNode(ns, copy);
+            }
+            UA_NodeStoreSnapshot_delete(snapshot);
+        }
+    }
+
+    UA_free(original);
+    UA_free(corrupt);
+    remove("check_nodestore_snapshot.bin");
+}
+END_TEST
+
+START_TEST(insertNodeWithFreshNodeId) {
+    for(UA_UInt32 i = 1; i < 10; i++) {
+        UA_Node* n = createNode(1,i);
+        UA_NodeStore_insert(ns, n);
+    }
+    UA_Node* n1 = createNode(1,0);
+    UA_StatusCode retval = UA_NodeStore_insert(ns, n1);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_int_eq(n1->nodeId.namespaceIndex, 1);
+    ck_assert_int_ne(n1->nodeId.identifier.numeric, 0);
+    ck_assert_int_eq((uintptr_t)UA_NodeStore_get(ns, &n1->nodeId), (uintptr_t)n1);
+}
+END_TEST
+
+START_TEST(insertNodesWithSameNamesSharesStrings) {
+    UA_Node* n1 = createNode(1,1);
+    n1->displayName = UA_LOCALIZEDTEXT_ALLOC("en", "Temperature");
+    UA_NodeStore_insert(ns, n1);
+    UA_Node* n2 = createNode(1,2);
+    n2->displayName = UA_LOCALIZEDTEXT_ALLOC("en", "Temperature");
+    UA_NodeStore_insert(ns, n2);
+    ck_assert_ptr_eq(n1->displayName.text.data, n2->displayName.text.data);
+    ck_assert_ptr_eq(n1->displayName.locale.data, n2->displayName.locale.data);
+
+    /* The other node keeps the shared string */
+    UA_NodeId in1 = UA_NODEID_NUMERIC(1, 1);
+    UA_NodeStore_remove(ns, &in1);
+    UA_String temperature = UA_STRING("Temperature");
+    ck_assert(UA_String_equal(&n2->displayName.text, &temperature));
+}
+END_TEST
+
+static void checkReferenceGroups(const UA_Node *node) {
+    for(size_t i = 0; i < node->referencesSize;) {
+        size_t end = UA_Node_referenceGroupEnd(node, i);
+        ck_assert(end > i && end <= node->referencesSize);
+        for(size_t j = i + 1; j < end; ++j) {
+            ck_assert(node->references[j].isInverse == node->references[i].isInverse);
+            ck_assert(UA_NodeId_equal(&node->references[j].referenceTypeId,
+                                      &node->references[i].referenceTypeId));
+        }
+        i = end;
+    }
+}
+
+/* Removed entries leave tombstones in the hash-map. Insert/remove churn must
+ * not fill the map with them. */
+START_TEST(insertAndRemoveManyTimes) {
+    char name[32];
+    UA_Node *keep = (UA_Node*)UA_NodeStore_newObjectNode(ns);
+    keep->nodeId = UA_NODEID_STRING_ALLOC(1, "keep");
+    ck_assert_int_eq(UA_NodeStore_insert(ns, keep), UA_STATUSCODE_GOOD);
+    for(UA_UInt32 i = 0; i < 10000; ++i) {
+        snprintf(name, sizeof(name), "churn%u", (unsigned)i);
+        UA_Node *n = (UA_Node*)UA_NodeStore_newObjectNode(ns);
+        n->nodeId = UA_NODEID_STRING_ALLOC(1, name);
+        ck_assert_int_eq(UA_NodeStore_insert(ns, n), UA_STATUSCODE_GOOD);
+        UA_NodeId id = UA_NODEID_STRING(1, name);
+        ck_assert_int_eq(UA_NodeStore_remove(ns, &id), UA_STATUSCODE_GOOD);
+        ck_assert_ptr_eq(UA_NodeStore_get(ns, &id), NULL);
+    }
+    UA_NodeId keepId = UA_NODEID_STRING(1, "keep");
+    ck_assert_ptr_ne(UA_NodeStore_get(ns, &keepId), NULL);
+}
+END_TEST
+
+START_TEST(addAndDeleteManyReferences) {
+    UA_Node* n = createNode(1,1);
+    UA_NodeId types[3] = {UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                          UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT),
+                          UA_NODEID_NUMERIC(0, UA_NS0ID_HASPROPERTY)};
+    for(UA_UInt32 i = 0; i < 1000; i++) {
+        UA_ExpandedNodeId target = UA_EXPANDEDNODEID_NUMERIC(1, i);
+        UA_StatusCode retval = UA_Node_addReference(n, &types[i % 3], i % 5 == 0, &target);
+        ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    }
+    ck_assert_int_eq(n->referencesSize, 1000);
+    checkReferenceGroups(n);
+
+    for(UA_UInt32 i = 0; i < 1000; i += 2) {
+        UA_NodeId target = UA_NODEID_NUMERIC(1, i);
+        UA_StatusCode retval = UA_Node_deleteReference(n, &types[i % 3], i % 5 == 0, &target);
+        ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+        retval = UA_Node_deleteReference(n, &types[i % 3], i % 5 == 0, &target);
+        ck_assert_int_eq(retval, UA_STATUSCODE_UNCERTAINREFERENCENOTDELETED);
+    }
+    ck_assert_int_eq(n->referencesSize, 500);
+    checkReferenceGroups(n);
+
+    for(UA_UInt32 i = 1; i < 1000; i += 2) {
+        UA_NodeId target = UA_NODEID_NUMERIC(1, i);
+        UA_StatusCode retval = UA_Node_deleteReference(n, &types[i % 3], i % 5 == 0, &target);
+        ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    }
+    ck_assert_int_eq(n->referencesSize, 0);
+    UA_NodeStore_deleteNode(ns, n);
+}
+END_TEST
+
+START_TEST(insertAndRemoveNodesOfDifferentNodeClasses) {
+    /* More nodes than fit into a single slab */
+    for(UA_UInt32 i = 1; i <= 1000; i++) {
+        UA_Node *n;
+        if(i % 2 == 0)
+            n = (UA_Node*)UA_NodeStore_newObjectNode(ns);
+        else
+            n = (UA_Node*)UA_NodeStore_newVariableNode(ns);
+        n->nodeId = UA_NODEID_NUMERIC(1, i);
+        UA_StatusCode retval = UA_NodeStore_insert(ns, n);
+        ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    }
+    for(UA_UInt32 i = 1; i <= 1000; i += 3) {
+        UA_NodeId id = UA_NODEID_NUMERIC(1, i);
+        UA_StatusCode retval = UA_NodeStore_remove(ns, &id);
+        ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    }
+#ifndef UA_ENABLE_MULTITHREADING
+    /* Removed entries are reused for nodes of the same NodeClass. (In the
+     * multithreaded nodestore, they are freed after the grace period.) */
+    UA_NodeId reusedId = UA_NODEID_NUMERIC(1, 2);
+    const UA_Node *removed = UA_NodeStore_get(ns, &reusedId);
+    ck_assert_int_eq(UA_NodeStore_remove(ns, &reusedId), UA_STATUSCODE_GOOD);
+    UA_Node *reused = (UA_Node*)UA_NodeStore_newObjectNode(ns);
+    ck_assert_ptr_eq(reused, removed);
+    reused->nodeId = reusedId;
+    ck_assert_int_eq(UA_NodeStore_insert(ns, reused), UA_STATUSCODE_GOOD);
+#endif
+    /* Nodes of another NodeClass come from a different pool */
+    for(UA_UInt32 i = 1001; i <= 1500; i++) {
+        UA_Node *n = (UA_Node*)UA_NodeStore_newMethodNode(ns);
+        n->nodeId = UA_NODEID_NUMERIC(1, i);
+        UA_NodeStore_insert(ns, n);
+    }
+    for(UA_UInt32 i = 1; i <= 1500; i++) {
+        UA_NodeId id = UA_NODEID_NUMERIC(1, i);
+        const UA_Node *n = UA_NodeStore_get(ns, &id);
+        if(i <= 1000 && i % 3 == 1) {
+            ck_assert_int_eq((uintptr_t)n, 0);
+            continue;
+        }
+        ck_assert_int_ne((uintptr_t)n, 0);
+        ck_assert(UA_NodeId_equal(&n->nodeId, &id));
+        if(i > 1000)
+            ck_assert_int_eq(n->nodeClass, UA_NODECLASS_METHOD);
+        else if(i % 2 == 0)
+            ck_assert_int_eq(n->nodeClass, UA_NODECLASS_OBJECT);
+        else
+            ck_assert_int_eq(n->nodeClass, UA_NODECLASS_VARIABLE);
+    }
+}
+END_TEST
+
 /************************************/
 /* Performance Profiling Test Cases */
 /************************************/
@@ -257,12 +699,26 @@ static Suite * namespace_suite (void) {
     tcase_add_test (tc_find, findNodeInExpandedNamespace);
     tcase_add_test (tc_find, failToFindNonExistantNodeInUA_NodeStoreWithSeveralEntries);
     tcase_add_test (tc_find, failToFindNodeInOtherUA_NodeStore);
+    tcase_add_test (tc_find, findNodeMovedIntoDenseArray);
+    tcase_add_test (tc_find, findNodeWithStringAndNumericIds);
+    tcase_add_test (tc_find, insertNodeWithFreshNodeId);
+    tcase_add_test (tc_find, insertAndRemoveNodesOfDifferentNodeClasses);
+    tcase_add_test (tc_find, insertNodesWithSameNamesSharesStrings);
+    tcase_add_test (tc_find, addAndDeleteManyReferences);
+    tcase_add_test (tc_find, insertAndRemoveManyTimes);
     suite_add_tcase (s, tc_find);
 
     TCase *tc_replace = tcase_create("Replace");
     tcase_add_checked_fixture(tc_replace, setup, teardown);
     tcase_add_test (tc_replace, replaceExistingNode);
     tcase_add_test (tc_replace, replaceOldNode);
+    tcase_add_test (tc_replace, replaceImageNodeWithCopy);
+    tcase_add_test (tc_replace, replaceRemovedImageNode);
+#ifdef UA_ENABLE_MULTITHREADING
+    tcase_add_test (tc_replace, removeImageNodesWhileReplaced);
+#endif
+    tcase_add_test (tc_replace, saveAndLoadSnapshot);
+    tcase_add_test (tc_replace, loadCorruptSnapshot);
     suite_add_tcase (s, tc_replace);
 
     TCase* tc_iterate = tcase_create ("Iterate");
@@ -4,9 +4,12 @@
 
 #include "ua_server.h"
 #include "server/ua_server_internal.h"
+#include "server/ua_services.h"
 #include "ua_config_standard.h"
+#include "ua_network_tcp.h"
 
 #include "check.h"
+#include <pthread.h>
 #include <unistd.h>
 
 UA_Server *server = NULL;
@@ -74,13 +77,268 @@ START_TEST(Server_repeatedJobRemoveItself) {
 }
 END_TEST
 
+START_TEST(Server_repeatedJobTimeout) {
+    UA_Guid id;
+    UA_Job rj = (UA_Job){
+        .type = UA_JOBTYPE_METHODCALL,
+        .job.methodCall = {.data = NULL, .method = dummyJob}
+    };
+    /* The returned timeout considers the newly added job right away */
+    UA_Server_addRepeatedJob(server, rj, 10, &id);
+    UA_UInt16 timeout = UA_Server_run_iterate(server, false);
+    ck_assert_uint_le(timeout, 10);
+
+    UA_Server_removeRepeatedJob(server, id);
+    UA_Server_run_iterate(server, false);
+}
+END_TEST
+
+START_TEST(Server_jobStatistics) {
+    executed = UA_Boolean_new();
+    UA_Guid id;
+    UA_Job rj = (UA_Job){
+        .type = UA_JOBTYPE_METHODCALL,
+        .job.methodCall = {.data = NULL, .method = dummyJob}
+    };
+    UA_Server_addRepeatedJobWithPriority(server, rj, 10, UA_JOBPRIORITY_REALTIME, &id);
+    UA_Server_run_iterate(server, false);
+    usleep(15*1000);
+    UA_Server_run_iterate(server, false);
+    usleep(15*1000);
+    ck_assert_uint_eq(*executed, true);
+
+    UA_JobStatistics stats;
+    UA_StatusCode retval = UA_Server_getJobStatistics(server, UA_JOBPRIORITY_REALTIME, &stats);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(stats.processedJobs, 1);
+    ck_assert_uint_eq(stats.queueDepth, 0);
+    ck_assert(stats.maxWaitTime >= stats.meanWaitTime);
+
+    retval = UA_Server_getJobStatistics(server, (UA_JobPriority)UA_JOBPRIORITIESSIZE, &stats);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_BADINVALIDARGUMENT);
+
+    UA_Server_removeRepeatedJob(server, id);
+    UA_Boolean_delete(executed);
+}
+END_TEST
+
+START_TEST(Server_delayedCallback) {
+    executed = UA_Boolean_new();
+    UA_StatusCode retval = UA_Server_delayedCallback(server, dummyJob, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    for(size_t i = 0; i < 10 && !*executed; ++i) {
+        UA_Server_run_iterate(server, false);
+        usleep(5*1000);
+    }
+    ck_assert_uint_eq(*executed, true);
+
+    UA_ReclamationStatistics stats;
+    UA_Server_getReclamationStatistics(server, &stats);
+    ck_assert_uint_eq(stats.pendingJobs, 0);
+    ck_assert_uint_eq(stats.pendingBytes, 0);
+    ck_assert_uint_eq(stats.reclaimedJobs, 1);
+    ck_assert(stats.maxLatency >= 0.0);
+    UA_Boolean_delete(executed);
+}
+END_TEST
+
+START_TEST(Server_threadPlacement) {
+    UA_ThreadPlacement placement;
+    UA_StatusCode retval = UA_Server_getThreadPlacement(server, 0, &placement);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(placement.pinned, false);
+#ifdef UA_ENABLE_MULTITHREADING
+    size_t threads = (size_t)server->config.nThreads + 1;
+#else
+    size_t threads = 1;
+#endif
+    for(size_t i = 1; i < threads; ++i) {
+        retval = UA_Server_getThreadPlacement(server, i, &placement);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    }
+    retval = UA_Server_getThreadPlacement(server, threads, &placement);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_BADINVALIDARGUMENT);
+}
+END_TEST
+
+#ifdef __linux__
+#ifdef UA_ENABLE_MULTITHREADING
+# define PINNED_THREADS 3
+#else
+# define PINNED_THREADS 1
+#endif
+
+static UA_ThreadPlacement pinnedPlacements[PINNED_THREADS];
+
+/* Runs in its own thread, since the main loop is pinned to the thread that
+ * starts the server */
+static void *
+startPinnedServer(void *data) {
+    UA_UInt16 cpu = 0;
+    UA_CpuSet cpuSet = {.cpusSize = 1, .cpus = &cpu};
+    UA_ServerConfig config = UA_ServerConfig_standard;
+    config.nThreads = PINNED_THREADS - 1;
+    config.networkCpuSet = cpuSet;
+    config.workerCpuSetsSize = 1;
+    config.workerCpuSets = &cpuSet;
+    UA_Server *pinnedServer = UA_Server_new(config);
+    UA_Server_run_startup(pinnedServer);
+    for(size_t i = 0; i < PINNED_THREADS; ++i)
+        UA_Server_getThreadPlacement(pinnedServer, i, &pinnedPlacements[i]);
+    UA_Server_run_shutdown(pinnedServer);
+    UA_Server_delete(pinnedServer);
+    return NULL;
+}
+
+START_TEST(Server_threadPlacementPinned) {
+    memset(pinnedPlacements, 0, sizeof(pinnedPlacements));
+    pthread_t t;
+    pthread_create(&t, NULL, startPinnedServer, NULL);
+    pthread_join(t, NULL);
+    for(size_t i = 0; i < PINNED_THREADS; ++i) {
+        ck_assert_uint_eq(pinnedPlacements[i].pinned, true);
+        ck_assert_int_eq(pinnedPlacements[i].cpu, 0);
+        ck_assert_uint_eq(pinnedPlacements[i].cpusSize, 1);
+    }
+}
+END_TEST
+#endif
+
+static volatile UA_Boolean loopRunning;
+static volatile UA_Boolean woken;
+
+static void *
+serverLoop(void *data) {
+    UA_Server *loopServer = (UA_Server*)data;
+    while(loopRunning)
+        UA_Server_run_iterate(loopServer, true);
+    return NULL;
+}
+
+#ifdef UA_ENABLE_MULTITHREADING
+static void
+wakeupJob(UA_Server *serverPtr, void *data) {
+    woken = true;
+}
+#endif
+
+/* Without due jobs, the main loop waits in the networklayer until the cleanup
+ * job (every 10s). A wakeup from another thread ends the wait right away. */
+START_TEST(Server_wakeupMainLoop) {
+    UA_ServerConfig config = UA_ServerConfig_standard;
+    UA_ServerNetworkLayer nl = UA_ServerNetworkLayerTCP(UA_ConnectionConfig_standard, 16664);
+    config.networkLayers = &nl;
+    config.networkLayersSize = 1;
+    UA_Server *loopServer = UA_Server_new(config);
+    UA_Server_run_startup(loopServer);
+    ck_assert_ptr_ne(nl.wakeup, NULL);
+    loopRunning = true;
+    pthread_t loopThread;
+    pthread_create(&loopThread, NULL, serverLoop, loopServer);
+    usleep(100*1000); /* The loop is waiting now */
+
+    UA_DateTime start;
+#ifdef UA_ENABLE_MULTITHREADING
+    /* A job for the main loop is run without waiting for the timeout */
+    woken = false;
+    UA_Job job = (UA_Job){
+        .type = UA_JOBTYPE_METHODCALL,
+        .job.methodCall = {.data = NULL, .method = wakeupJob}
+    };
+    start = UA_DateTime_nowMonotonic();
+    UA_StatusCode retval = UA_Server_addMainLoopJob(loopServer, &job);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    while(!woken && UA_DateTime_nowMonotonic() - start < UA_SEC_TO_DATETIME)
+        usleep(1000);
+    ck_assert(woken);
+#endif
+
+    /* The loop returns once the running-flag is cleared */
+    start = UA_DateTime_nowMonotonic();
+    loopRunning = false;
+    UA_Server_wakeup(loopServer);
+    pthread_join(loopThread, NULL);
+    ck_assert(UA_DateTime_nowMonotonic() - start < UA_SEC_TO_DATETIME);
+
+    UA_Server_run_shutdown(loopServer);
+    UA_Server_delete(loopServer);
+    nl.deleteMembers(&nl);
+}
+END_TEST
+
+#define PARALLEL_ITEMS 10000
+
+static void
+countItem(UA_Server *serverPtr, void *context, size_t item) {
+    ++((UA_UInt32*)context)[item];
+}
+
+START_TEST(Server_processItems) {
+    /* Every item is processed exactly once, with and without ranges */
+    UA_UInt32 *counts = calloc(PARALLEL_ITEMS, sizeof(UA_UInt32));
+    size_t sizes[3] = {1, server->config.parallelItemsThreshold - 1, PARALLEL_ITEMS};
+    for(size_t i = 0; i < 3; ++i) {
+        memset(counts, 0, PARALLEL_ITEMS * sizeof(UA_UInt32));
+        UA_RCU_LOCK();
+        UA_Server_processItems(server, sizes[i], countItem, counts);
+        UA_RCU_UNLOCK();
+        for(size_t j = 0; j < PARALLEL_ITEMS; ++j)
+            ck_assert_uint_eq(counts[j], j < sizes[i] ? 1 : 0);
+    }
+    free(counts);
+}
+END_TEST
+
+START_TEST(Server_readManyNodes) {
+    /* The results of a large request are in the order of the items */
+    UA_ReadValueId *items = calloc(PARALLEL_ITEMS, sizeof(UA_ReadValueId));
+    for(size_t i = 0; i < PARALLEL_ITEMS; ++i) {
+        items[i].attributeId = UA_ATTRIBUTEID_NODEID;
+        items[i].nodeId = UA_NODEID_NUMERIC(0, (i % 2 == 0) ? UA_NS0ID_OBJECTSFOLDER :
+                                            UA_NS0ID_SERVER);
+    }
+    UA_ReadRequest request;
+    UA_ReadRequest_init(&request);
+    request.nodesToRead = items;
+    request.nodesToReadSize = PARALLEL_ITEMS;
+    UA_ReadResponse response;
+    UA_ReadResponse_init(&response);
+    UA_RCU_LOCK();
+    Service_Read(server, &adminSession, &request, &response);
+    UA_RCU_UNLOCK();
+    ck_assert_uint_eq(response.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(response.resultsSize, PARALLEL_ITEMS);
+    for(size_t i = 0; i < PARALLEL_ITEMS; ++i) {
+        ck_assert(response.results[i].hasValue);
+        ck_assert(response.results[i].value.type == &UA_TYPES[UA_TYPES_NODEID]);
+        ck_assert(UA_NodeId_equal((UA_NodeId*)response.results[i].value.data,
+                                  &items[i].nodeId));
+    }
+    UA_ReadResponse_deleteMembers(&response);
+    free(items);
+}
+END_TEST
+
 static Suite* testSuite_Client(void) {
     Suite *s = suite_create("Server Jobs");
     TCase *tc_server = tcase_create("Server Repeated Jobs");
     tcase_add_checked_fixture(tc_server, setup, teardown);
     tcase_add_test(tc_server, Server_addRemoveRepeatedJob);
     tcase_add_test(tc_server, Server_repeatedJobRemoveItself);
+    tcase_add_test(tc_server, Server_repeatedJobTimeout);
+    tcase_add_test(tc_server, Server_jobStatistics);
+    tcase_add_test(tc_server, Server_delayedCallback);
+    tcase_add_test(tc_server, Server_threadPlacement);
+#ifdef __linux__
+    tcase_add_test(tc_server, Server_threadPlacementPinned);
+#endif
+    tcase_add_test(tc_server, Server_processItems);
+    tcase_add_test(tc_server, Server_readManyNodes);
     suite_add_tcase(s, tc_server);
+
+    TCase *tc_wakeup = tcase_create("Server Wakeup");
+    tcase_add_test(tc_wakeup, Server_wakeupMainLoop);
+    suite_add_tcase(s, tc_wakeup);
     return s;
 }
 
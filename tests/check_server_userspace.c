@@ -7,6 +7,7 @@
 
 #include "ua_types.h"
 #include "ua_config_standard.h"
+#include "server/ua_nodes.h"
 #include "check.h"
 
 START_TEST(Server_addNamespace_ShallWork)
@@ -26,10 +27,124 @@ START_TEST(Server_addNamespace_ShallWork)
 }
 END_TEST
 
+/* Wraps the default nodestore and counts the lookups. Images are not linked
+ * but copied into the nodestore. */
+static size_t getCount = 0;
+
+static const UA_Node *
+countingGet(void *handle, const UA_NodeId *nodeId) {
+    ++getCount;
+    return UA_NodeStoreInterface_default.get(handle, nodeId);
+}
+
+START_TEST(Server_customNodeStore_ShallWork)
+{
+    UA_ServerConfig config = UA_ServerConfig_standard;
+    config.nodestore = UA_NodeStoreInterface_default;
+    config.nodestore.get = countingGet;
+    config.nodestore.linkImage = NULL;
+    config.nodestore.isImmutable = NULL;
+    getCount = 0;
+    UA_Server *server = UA_Server_new(config);
+
+    /* Namespace 0 was copied into the nodestore */
+    UA_LocalizedText displayName;
+    UA_StatusCode retval =
+        UA_Server_readDisplayName(server, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                  &displayName);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    UA_String objects = UA_STRING("Objects");
+    ck_assert(UA_String_equal(&displayName.text, &objects));
+    UA_LocalizedText_deleteMembers(&displayName);
+    ck_assert_uint_gt(getCount, 0);
+
+    /* The copied nodes are editable */
+    UA_LocalizedText newName = UA_LOCALIZEDTEXT("en_US", "MyObjects");
+    retval = UA_Server_writeDisplayName(server, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                        newName);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    retval = UA_Server_readDisplayName(server, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                       &displayName);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert(UA_String_equal(&displayName.text, &newName.text));
+    UA_LocalizedText_deleteMembers(&displayName);
+
+    UA_Server_delete(server);
+}
+END_TEST
+
+START_TEST(Server_loadSnapshot_ShallRestoreNodes)
+{
+    UA_ServerConfig config = UA_ServerConfig_standard;
+    UA_Server *server = UA_Server_new(config);
+    UA_ObjectAttributes attr;
+    UA_ObjectAttributes_init(&attr);
+    attr.displayName = UA_LOCALIZEDTEXT("en_US", "MyObj");
+    UA_StatusCode retval =
+        UA_Server_addObjectNode(server, UA_NODEID_NUMERIC(1, 1000),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                UA_QUALIFIEDNAME(1, "MyObj"),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE),
+                                attr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    retval = UA_Server_saveSnapshot(server, "check_server_snapshot.bin");
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    UA_Server_delete(server);
+
+    /* The snapshot replaces the nodes the new server created on startup */
+    server = UA_Server_new(config);
+    retval = UA_Server_loadSnapshot(server, "check_server_snapshot.bin");
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    UA_BrowseDescription bd;
+    UA_BrowseDescription_init(&bd);
+    bd.nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    bd.browseDirection = UA_BROWSEDIRECTION_FORWARD;
+    bd.resultMask = UA_BROWSERESULTMASK_BROWSENAME;
+    UA_BrowseResult br = UA_Server_browse(server, 0, &bd);
+    ck_assert_uint_eq(br.statusCode, UA_STATUSCODE_GOOD);
+    UA_String myObj = UA_STRING("MyObj");
+    UA_Boolean found = false;
+    for(size_t i = 0; i < br.referencesSize; ++i) {
+        if(UA_String_equal(&br.references[i].browseName.name, &myObj))
+            found = true;
+    }
+    ck_assert(found);
+    UA_BrowseResult_deleteMembers(&br);
+
+    UA_LocalizedText displayName;
+    retval = UA_Server_readDisplayName(server, UA_NODEID_NUMERIC(1, 1000), &displayName);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert(UA_String_equal(&displayName.text, &myObj));
+    UA_LocalizedText_deleteMembers(&displayName);
+
+    /* The nodes with data sources are kept from the new server */
+    UA_Variant value;
+    retval = UA_Server_readValue(server, UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_NAMESPACEARRAY),
+                                 &value);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_ptr_eq(value.type, &UA_TYPES[UA_TYPES_STRING]);
+    ck_assert_uint_ge(value.arrayLength, 2);
+    UA_Variant_deleteMembers(&value);
+
+    retval = UA_Server_readValue(server,
+                                 UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_CURRENTTIME),
+                                 &value);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_ptr_eq(value.type, &UA_TYPES[UA_TYPES_DATETIME]);
+    UA_Variant_deleteMembers(&value);
+
+    UA_Server_delete(server);
+    remove("check_server_snapshot.bin");
+}
+END_TEST
+
 static Suite* testSuite_ServerUserspace(void) {
     Suite *s = suite_create("ServerUserspace");
     TCase *tc_core = tcase_create("Core");
     tcase_add_test(tc_core, Server_addNamespace_ShallWork);
+    tcase_add_test(tc_core, Server_customNodeStore_ShallWork);
+    tcase_add_test(tc_core, Server_loadSnapshot_ShallRestoreNodes);
 
     suite_add_tcase(s,tc_core);
     return s;
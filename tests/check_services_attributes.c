@@ -15,6 +15,10 @@
 #include "ua_config_standard.h"
 #include "server/ua_server_internal.h"
 
+#ifdef UA_ENABLE_MULTITHREADING
+#include <pthread.h>
+#endif
+
 static UA_StatusCode
 readCPUTemperature(void *handle, const UA_NodeId nodeid, UA_Boolean sourceTimeStamp,
                    const UA_NumericRange *range, UA_DataValue *dataValue) {
@@ -118,8 +122,8 @@ makeTestSequence(void) {
     return server;
 }
 
-static UA_VariableNode* makeCompareSequence(void) {
-    UA_VariableNode *node = UA_NodeStore_newVariableNode();
+static UA_VariableNode* makeCompareSequence(UA_Server *server) {
+    UA_VariableNode *node = UA_NodeStore_newVariableNode(server->nodestore);
 
     UA_Int32 myInteger = 42;
     UA_Variant_setScalarCopy(&node->value.data.value.value, &myInteger, &UA_TYPES[UA_TYPES_INT32]);
@@ -242,14 +246,14 @@ START_TEST(ReadSingleAttributeDisplayNameWithoutTimestamp) {
 
     UA_LocalizedText* respval = (UA_LocalizedText*) resp.value.data;
     const UA_LocalizedText comp = UA_LOCALIZEDTEXT("locale", "the answer");
-    UA_VariableNode* compNode = makeCompareSequence();
+    UA_VariableNode* compNode = makeCompareSequence(server);
     ck_assert_int_eq(0, resp.value.arrayLength);
     ck_assert_ptr_eq(&UA_TYPES[UA_TYPES_LOCALIZEDTEXT], resp.value.type);
     ck_assert(UA_String_equal(&comp.text, &respval->text));
     ck_assert(UA_String_equal(&compNode->displayName.locale, &respval->locale));
-    UA_Server_delete(server);
     UA_DataValue_deleteMembers(&resp);
-    UA_NodeStore_deleteNode((UA_Node*)compNode);
+    UA_NodeStore_deleteNode(server->nodestore, (UA_Node*)compNode);
+    UA_Server_delete(server);
 } END_TEST
 
 START_TEST(ReadSingleAttributeDescriptionWithoutTimestamp) {
@@ -263,13 +267,13 @@ START_TEST(ReadSingleAttributeDescriptionWithoutTimestamp) {
     UA_DataValue resp = UA_Server_read(server, &rvi, UA_TIMESTAMPSTORETURN_NEITHER);
     
     UA_LocalizedText* respval = (UA_LocalizedText*) resp.value.data;
-    UA_VariableNode* compNode = makeCompareSequence();
+    UA_VariableNode* compNode = makeCompareSequence(server);
     ck_assert_int_eq(0, resp.value.arrayLength);
     ck_assert_ptr_eq(&UA_TYPES[UA_TYPES_LOCALIZEDTEXT], resp.value.type);
     ck_assert(UA_String_equal(&compNode->description.locale, &respval->locale));
     ck_assert(UA_String_equal(&compNode->description.text, &respval->text));
     UA_DataValue_deleteMembers(&resp);
-    UA_NodeStore_deleteNode((UA_Node*)compNode);
+    UA_NodeStore_deleteNode(server->nodestore, (UA_Node*)compNode);
     UA_Server_delete(server);
 } END_TEST
 
@@ -502,13 +506,13 @@ START_TEST(ReadSingleAttributeMinimumSamplingIntervalWithoutTimestamp) {
     UA_DataValue resp = UA_Server_read(server, &rvi, UA_TIMESTAMPSTORETURN_NEITHER);
     
     UA_Double* respval = (UA_Double*) resp.value.data;
-    UA_VariableNode *compNode = makeCompareSequence();
+    UA_VariableNode *compNode = makeCompareSequence(server);
     UA_Double comp = (UA_Double) compNode->minimumSamplingInterval;
     ck_assert_int_eq(0, resp.value.arrayLength);
     ck_assert_ptr_eq(&UA_TYPES[UA_TYPES_DOUBLE], resp.value.type);
     ck_assert(*respval == comp);
     UA_DataValue_deleteMembers(&resp);
-    UA_NodeStore_deleteNode((UA_Node*)compNode);
+    UA_NodeStore_deleteNode(server->nodestore, (UA_Node*)compNode);
     UA_Server_delete(server);
 } END_TEST
 
@@ -815,6 +819,132 @@ START_TEST(WriteSingleAttributeValue) {
     UA_Server_delete(server);
 } END_TEST
 
+START_TEST(WriteSingleAttributeValueKeepsNode) {
+    UA_Server *server = makeTestSequence();
+    UA_NodeId nodeId = UA_NODEID_STRING(1, "the.answer");
+    UA_RCU_LOCK();
+    const UA_Node *before = UA_NodeStore_get(server->nodestore, &nodeId);
+    UA_RCU_UNLOCK();
+
+    /* Writing the value does not replace the node */
+    UA_Int32 myInteger = 20;
+    UA_Variant value;
+    UA_Variant_setScalar(&value, &myInteger, &UA_TYPES[UA_TYPES_INT32]);
+    UA_StatusCode retval = UA_Server_writeValue(server, nodeId, value);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    UA_RCU_LOCK();
+    const UA_Node *after = UA_NodeStore_get(server->nodestore, &nodeId);
+    UA_RCU_UNLOCK();
+    ck_assert_ptr_eq(before, after);
+
+    /* Editing another attribute keeps the value */
+    UA_LocalizedText displayName = UA_LOCALIZEDTEXT("locale", "newName");
+    retval = UA_Server_writeDisplayName(server, nodeId, displayName);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    UA_Variant out;
+    retval = UA_Server_readValue(server, nodeId, &out);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_int_eq(20, *(UA_Int32*)out.data);
+    UA_Variant_deleteMembers(&out);
+    UA_Server_delete(server);
+} END_TEST
+
+START_TEST(WriteSingleAttributeValueSubtype) {
+    UA_Server *server = makeTestSequence();
+    UA_VariableAttributes vattr;
+    UA_VariableAttributes_init(&vattr);
+    UA_Double number = 1.0;
+    UA_Variant_setScalar(&vattr.value, &number, &UA_TYPES[UA_TYPES_DOUBLE]);
+    vattr.dataType = UA_NODEID_NUMERIC(0, UA_NS0ID_NUMBER);
+    vattr.valueRank = -1;
+    UA_NodeId nodeId = UA_NODEID_STRING(1, "number");
+    UA_StatusCode retval =
+        UA_Server_addVariableNode(server, nodeId, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                  UA_QUALIFIEDNAME(1, "number"), UA_NODEID_NULL,
+                                  vattr, NULL, NULL);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+
+    /* UInt16 is a subtype of Number (via UInteger) */
+    UA_UInt16 uinteger = 7;
+    UA_Variant value;
+    UA_Variant_setScalar(&value, &uinteger, &UA_TYPES[UA_TYPES_UINT16]);
+    retval = UA_Server_writeValue(server, nodeId, value);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+
+    /* String is not */
+    UA_String string = UA_STRING("seven");
+    UA_Variant_setScalar(&value, &string, &UA_TYPES[UA_TYPES_STRING]);
+    retval = UA_Server_writeValue(server, nodeId, value);
+    ck_assert_int_eq(retval, UA_STATUSCODE_BADTYPEMISMATCH);
+    UA_Server_delete(server);
+} END_TEST
+
+#ifdef UA_ENABLE_MULTITHREADING
+typedef struct {
+    UA_Server *server;
+    volatile UA_Boolean running;
+} ValueWriterContext;
+
+static void * writeIntegerAndDouble(void *context) {
+    ValueWriterContext *ctx = (ValueWriterContext*)context;
+    rcu_register_thread();
+    UA_NodeId nodeId = UA_NODEID_STRING(1, "number");
+    UA_Int32 integer = 1;
+    UA_Double number = 1.5;
+    UA_Variant value;
+    for(size_t i = 0; ctx->running; ++i) {
+        if(i % 2 == 0)
+            UA_Variant_setScalar(&value, &integer, &UA_TYPES[UA_TYPES_INT32]);
+        else
+            UA_Variant_setScalar(&value, &number, &UA_TYPES[UA_TYPES_DOUBLE]);
+        UA_Server_writeValue(ctx->server, nodeId, value);
+    }
+    rcu_unregister_thread();
+    return NULL;
+}
+
+/* While the DataType is Int32, writing a Double fails. So the value remains an
+ * Int32 after the DataType was changed, also with a concurrent writer. */
+START_TEST(WriteSingleAttributeDataTypeConcurrentValue) {
+    UA_Server *server = makeTestSequence();
+    UA_VariableAttributes vattr;
+    UA_VariableAttributes_init(&vattr);
+    UA_Int32 integer = 1;
+    UA_Variant_setScalar(&vattr.value, &integer, &UA_TYPES[UA_TYPES_INT32]);
+    vattr.dataType = UA_NODEID_NUMERIC(0, UA_NS0ID_NUMBER);
+    vattr.valueRank = -1;
+    UA_NodeId nodeId = UA_NODEID_STRING(1, "number");
+    UA_StatusCode retval =
+        UA_Server_addVariableNode(server, nodeId, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                  UA_QUALIFIEDNAME(1, "number"), UA_NODEID_NULL,
+                                  vattr, NULL, NULL);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+
+    ValueWriterContext ctx = {server, true};
+    pthread_t writer;
+    pthread_create(&writer, NULL, writeIntegerAndDouble, &ctx);
+    for(size_t i = 0; i < 2000; ++i) {
+        retval = UA_Server_writeDataType(server, nodeId,
+                                         UA_NODEID_NUMERIC(0, UA_NS0ID_INT32));
+        if(retval != UA_STATUSCODE_GOOD)
+            continue; /* The current value is a Double */
+        UA_Variant value;
+        retval = UA_Server_readValue(server, nodeId, &value);
+        ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+        ck_assert_ptr_eq(value.type, &UA_TYPES[UA_TYPES_INT32]);
+        UA_Variant_deleteMembers(&value);
+        retval = UA_Server_writeDataType(server, nodeId,
+                                         UA_NODEID_NUMERIC(0, UA_NS0ID_NUMBER));
+        ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    }
+    ctx.running = false;
+    pthread_join(writer, NULL);
+    UA_Server_delete(server);
+} END_TEST
+#endif
+
 START_TEST(WriteSingleAttributeValueRangeFromScalar) {
     UA_Server *server = makeTestSequence();
     UA_WriteValue wValue;
@@ -988,6 +1118,169 @@ START_TEST(WriteSingleDataSourceAttributeValue) {
     UA_Server_delete(server);
 } END_TEST
 
+static UA_StatusCode
+readInt32WithSession(UA_Server *server, UA_Session *session, const UA_NodeId *nodeId,
+                     UA_Int32 *value) {
+    UA_ReadValueId rvi;
+    UA_ReadValueId_init(&rvi);
+    rvi.nodeId = *nodeId;
+    rvi.attributeId = UA_ATTRIBUTEID_VALUE;
+    UA_DataValue dv;
+    UA_DataValue_init(&dv);
+    UA_RCU_LOCK();
+    Service_Read_single(server, session, UA_TIMESTAMPSTORETURN_NEITHER, &rvi, &dv, NULL);
+    UA_RCU_UNLOCK();
+    UA_StatusCode retval = dv.hasStatus ? dv.status : UA_STATUSCODE_GOOD;
+    if(retval == UA_STATUSCODE_GOOD) {
+        ck_assert(dv.value.type == &UA_TYPES[UA_TYPES_INT32]);
+        *value = *(UA_Int32*)dv.value.data;
+    }
+    UA_DataValue_deleteMembers(&dv);
+    return retval;
+}
+
+START_TEST(RegisterNodesReadWrite) {
+    UA_Server *server = makeTestSequence();
+    UA_Session session;
+    UA_Session_init(&session);
+
+    /* Existing nodes get an alias. Unknown NodeIds are returned unchanged. */
+    UA_NodeId nodesToRegister[2] = {UA_NODEID_STRING(1, "the.answer"),
+                                    UA_NODEID_NUMERIC(1, 99999)};
+    UA_RegisterNodesRequest request;
+    UA_RegisterNodesRequest_init(&request);
+    request.nodesToRegister = nodesToRegister;
+    request.nodesToRegisterSize = 2;
+    UA_RegisterNodesResponse response;
+    UA_RegisterNodesResponse_init(&response);
+    UA_RCU_LOCK();
+    Service_RegisterNodes(server, &session, &request, &response);
+    UA_RCU_UNLOCK();
+    ck_assert_uint_eq(response.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(response.registeredNodeIdsSize, 2);
+    UA_NodeId alias = response.registeredNodeIds[0];
+    ck_assert_uint_eq(alias.namespaceIndex, UA_REGISTEREDNODES_NAMESPACE);
+    ck_assert(UA_NodeId_equal(&response.registeredNodeIds[1], &nodesToRegister[1]));
+    UA_RegisterNodesResponse_deleteMembers(&response);
+
+    UA_Int32 value = 0;
+    ck_assert_uint_eq(readInt32WithSession(server, &session, &alias, &value),
+                      UA_STATUSCODE_GOOD);
+    ck_assert_int_eq(value, 42);
+
+    /* Write with the alias */
+    UA_WriteValue wValue;
+    UA_WriteValue_init(&wValue);
+    UA_Int32 newValue = 43;
+    UA_Variant_setScalar(&wValue.value.value, &newValue, &UA_TYPES[UA_TYPES_INT32]);
+    wValue.value.hasValue = true;
+    wValue.nodeId = alias;
+    wValue.attributeId = UA_ATTRIBUTEID_VALUE;
+    UA_WriteRequest wRequest;
+    UA_WriteRequest_init(&wRequest);
+    wRequest.nodesToWrite = &wValue;
+    wRequest.nodesToWriteSize = 1;
+    UA_WriteResponse wResponse;
+    UA_WriteResponse_init(&wResponse);
+    UA_RCU_LOCK();
+    Service_Write(server, &session, &wRequest, &wResponse);
+    UA_RCU_UNLOCK();
+    ck_assert_uint_eq(wResponse.resultsSize, 1);
+    ck_assert_uint_eq(wResponse.results[0], UA_STATUSCODE_GOOD);
+    UA_WriteResponse_deleteMembers(&wResponse);
+    ck_assert_uint_eq(readInt32WithSession(server, &session, &nodesToRegister[0], &value),
+                      UA_STATUSCODE_GOOD);
+    ck_assert_int_eq(value, 43);
+
+    /* The alias follows the node when it is removed and added again */
+    UA_StatusCode retval = UA_Server_deleteNode(server, nodesToRegister[0], true);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(readInt32WithSession(server, &session, &alias, &value),
+                      UA_STATUSCODE_BADNODEIDUNKNOWN);
+    UA_VariableAttributes vattr;
+    UA_VariableAttributes_init(&vattr);
+    UA_Int32 otherValue = 7;
+    UA_Variant_setScalar(&vattr.value, &otherValue, &UA_TYPES[UA_TYPES_INT32]);
+    retval = UA_Server_addVariableNode(server, nodesToRegister[0],
+                                       UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                       UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                       UA_QUALIFIEDNAME(1, "the answer"),
+                                       UA_NODEID_NULL, vattr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(readInt32WithSession(server, &session, &alias, &value),
+                      UA_STATUSCODE_GOOD);
+    ck_assert_int_eq(value, 7);
+
+    /* Unknown after unregistering */
+    UA_UnregisterNodesRequest uRequest;
+    UA_UnregisterNodesRequest_init(&uRequest);
+    uRequest.nodesToUnregister = &alias;
+    uRequest.nodesToUnregisterSize = 1;
+    UA_UnregisterNodesResponse uResponse;
+    UA_UnregisterNodesResponse_init(&uResponse);
+    UA_RCU_LOCK();
+    Service_UnregisterNodes(server, &session, &uRequest, &uResponse);
+    UA_RCU_UNLOCK();
+    ck_assert_uint_eq(uResponse.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+    UA_UnregisterNodesResponse_deleteMembers(&uResponse);
+    ck_assert_uint_eq(readInt32WithSession(server, &session, &alias, &value),
+                      UA_STATUSCODE_BADNODEIDUNKNOWN);
+
+    UA_Session_deleteMembersCleanup(&session, server);
+    UA_Server_delete(server);
+} END_TEST
+
+static UA_ReadToken *asyncReadToken;
+
+static UA_StatusCode
+readAsyncPending(void *handle, const UA_NodeId nodeid, UA_Boolean sourceTimeStamp,
+                 const UA_NumericRange *range, UA_DataValue *value, UA_ReadToken *token) {
+    asyncReadToken = token;
+    return UA_STATUSCODE_GOODCOMPLETESASYNCHRONOUSLY;
+}
+
+/* The pending reads of a closed session time out in the next iteration of the
+ * main loop, not only at the deadline */
+START_TEST(ReadAsyncOfClosedSession) {
+    UA_Server *server = makeTestSequence();
+    UA_DataSource dataSource = (UA_DataSource) {
+        .handle = NULL, .read = readCPUTemperature, .readAsync = readAsyncPending, .write = NULL};
+    UA_VariableAttributes attr;
+    UA_VariableAttributes_init(&attr);
+    UA_StatusCode retval =
+        UA_Server_addDataSourceVariableNode(server, UA_NODEID_STRING(1, "async"),
+                                            UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                            UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                            UA_QUALIFIEDNAME(1, "async"),
+                                            UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE),
+                                            attr, dataSource, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    /* The session is not known to the session manager */
+    UA_Session session;
+    UA_Session_init(&session);
+    UA_ReadValueId rvi;
+    UA_ReadValueId_init(&rvi);
+    rvi.nodeId = UA_NODEID_STRING(1, "async");
+    rvi.attributeId = UA_ATTRIBUTEID_VALUE;
+    UA_ReadRequest request;
+    UA_ReadRequest_init(&request);
+    request.nodesToRead = &rvi;
+    request.nodesToReadSize = 1;
+    asyncReadToken = NULL;
+    UA_RCU_LOCK();
+    Service_ReadAsync(server, &session, &request, 1);
+    UA_RCU_UNLOCK();
+    ck_assert_ptr_ne(asyncReadToken, NULL);
+    UA_Server_run_iterate(server, false);
+
+    UA_DataValue value;
+    UA_DataValue_init(&value);
+    retval = UA_Server_completeRead(server, asyncReadToken, &value);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_BADTIMEOUT);
+    UA_Server_delete(server);
+} END_TEST
+
 static Suite * testSuite_services_attributes(void) {
     Suite *s = suite_create("services_attributes_read");
 
@@ -1019,6 +1312,9 @@ static Suite * testSuite_services_attributes(void) {
     tcase_add_test(tc_readSingleAttributes, ReadSingleDataSourceAttributeDataTypeWithoutTimestamp);
     tcase_add_test(tc_readSingleAttributes, ReadSingleDataSourceAttributeArrayDimensionsWithoutTimestamp);
 
+    tcase_add_test(tc_readSingleAttributes, RegisterNodesReadWrite);
+    tcase_add_test(tc_readSingleAttributes, ReadAsyncOfClosedSession);
+
     suite_add_tcase(s, tc_readSingleAttributes);
 
     TCase *tc_writeSingleAttributes = tcase_create("writeSingleAttributes");
@@ -1038,6 +1334,11 @@ static Suite * testSuite_services_attributes(void) {
     tcase_add_test(tc_writeSingleAttributes, WriteSingleAttributeDataType);
     tcase_add_test(tc_writeSingleAttributes, WriteSingleAttributeValueRangeFromScalar);
     tcase_add_test(tc_writeSingleAttributes, WriteSingleAttributeValueRangeFromArray);
+    tcase_add_test(tc_writeSingleAttributes, WriteSingleAttributeValueKeepsNode);
+    tcase_add_test(tc_writeSingleAttributes, WriteSingleAttributeValueSubtype);
+#ifdef UA_ENABLE_MULTITHREADING
+    tcase_add_test(tc_writeSingleAttributes, WriteSingleAttributeDataTypeConcurrentValue);
+#endif
     tcase_add_test(tc_writeSingleAttributes, WriteSingleAttributeValueRank);
     tcase_add_test(tc_writeSingleAttributes, WriteSingleAttributeArrayDimensions);
     tcase_add_test(tc_writeSingleAttributes, WriteSingleAttributeAccessLevel);
@@ -244,6 +244,160 @@ START_TEST(DeleteObjectAndReferences) {
     UA_Server_delete(server);
 } END_TEST
 
+static void
+setBulkItem(UA_AddNodesItem *item, UA_NodeClass nodeClass, char *id, UA_NodeId parent,
+            UA_UInt32 referenceType, void *attr, const UA_DataType *attrType) {
+    UA_AddNodesItem_init(item);
+    item->requestedNewNodeId.nodeId = UA_NODEID_STRING(1, id);
+    item->parentNodeId.nodeId = parent;
+    item->referenceTypeId = UA_NODEID_NUMERIC(0, referenceType);
+    item->browseName = UA_QUALIFIEDNAME(1, id);
+    item->nodeClass = nodeClass;
+    item->nodeAttributes.encoding = UA_EXTENSIONOBJECT_DECODED_NODELETE;
+    item->nodeAttributes.content.decoded.type = attrType;
+    item->nodeAttributes.content.decoded.data = attr;
+}
+
+static size_t
+countReferences(UA_Server *server, UA_NodeId source, UA_UInt32 referenceType,
+                UA_NodeId target) {
+    UA_BrowseDescription bd;
+    UA_BrowseDescription_init(&bd);
+    bd.nodeId = source;
+    bd.referenceTypeId = UA_NODEID_NUMERIC(0, referenceType);
+    bd.browseDirection = UA_BROWSEDIRECTION_FORWARD;
+    UA_BrowseResult br = UA_Server_browse(server, 0, &bd);
+    ck_assert_int_eq(br.statusCode, UA_STATUSCODE_GOOD);
+    size_t refCount = 0;
+    for(size_t i = 0; i < br.referencesSize; ++i) {
+        if(UA_NodeId_equal(&br.references[i].nodeId.nodeId, &target))
+            refCount++;
+    }
+    UA_BrowseResult_deleteMembers(&br);
+    return refCount;
+}
+
+START_TEST(AddNodesBulk) {
+    UA_Server *server = UA_Server_new(UA_ServerConfig_standard);
+
+    UA_ObjectAttributes oattr;
+    UA_ObjectAttributes_init(&oattr);
+    oattr.displayName = UA_LOCALIZEDTEXT("en_US", "bulk object");
+    UA_VariableAttributes vattr;
+    UA_VariableAttributes_init(&vattr);
+    UA_Int32 value = 42;
+    UA_Variant_setScalar(&vattr.value, &value, &UA_TYPES[UA_TYPES_INT32]);
+    vattr.displayName = UA_LOCALIZEDTEXT("en_US", "bulk variable");
+
+    UA_NodeId objectsFolder = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    UA_NodeId folder = UA_NODEID_STRING(1, "bulk.folder");
+    UA_NodeId child = UA_NODEID_STRING(1, "bulk.child");
+    UA_NodeId var = UA_NODEID_STRING(1, "bulk.var");
+    UA_NodeId orphan = UA_NODEID_STRING(1, "bulk.orphan");
+
+    /* The parent of the first node is defined later in the batch */
+    UA_AddNodesItem items[6];
+    setBulkItem(&items[0], UA_NODECLASS_OBJECT, "bulk.child", folder,
+                UA_NS0ID_HASCOMPONENT, &oattr, &UA_TYPES[UA_TYPES_OBJECTATTRIBUTES]);
+    setBulkItem(&items[1], UA_NODECLASS_OBJECT, "bulk.folder", objectsFolder,
+                UA_NS0ID_ORGANIZES, &oattr, &UA_TYPES[UA_TYPES_OBJECTATTRIBUTES]);
+    items[1].typeDefinition.nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_FOLDERTYPE);
+    setBulkItem(&items[2], UA_NODECLASS_VARIABLE, "bulk.var", folder,
+                UA_NS0ID_HASCOMPONENT, &vattr, &UA_TYPES[UA_TYPES_VARIABLEATTRIBUTES]);
+    setBulkItem(&items[3], UA_NODECLASS_OBJECT, "bulk.orphan", UA_NODEID_STRING(1, "unknown"),
+                UA_NS0ID_HASCOMPONENT, &oattr, &UA_TYPES[UA_TYPES_OBJECTATTRIBUTES]);
+    setBulkItem(&items[4], UA_NODECLASS_OBJECT, "bulk.orphanchild", orphan,
+                UA_NS0ID_HASCOMPONENT, &oattr, &UA_TYPES[UA_TYPES_OBJECTATTRIBUTES]);
+    setBulkItem(&items[5], UA_NODECLASS_OBJECT, "bulk.folder", objectsFolder,
+                UA_NS0ID_ORGANIZES, &oattr, &UA_TYPES[UA_TYPES_OBJECTATTRIBUTES]);
+
+    UA_AddReferencesItem refs[2];
+    UA_AddReferencesItem_init(&refs[0]);
+    refs[0].sourceNodeId = child;
+    refs[0].referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES);
+    refs[0].isForward = true;
+    refs[0].targetNodeId.nodeId = var;
+    refs[1] = refs[0];
+    refs[1].targetNodeId.nodeId = orphan;
+
+    UA_StatusCode nodeResults[6];
+    UA_StatusCode refResults[2];
+    UA_StatusCode res = UA_Server_addNodesBulk(server, 6, items, 2, refs,
+                                               nodeResults, refResults);
+    ck_assert_int_eq(res, UA_STATUSCODE_BADPARENTNODEIDINVALID);
+    ck_assert_int_eq(nodeResults[0], UA_STATUSCODE_GOOD);
+    ck_assert_int_eq(nodeResults[1], UA_STATUSCODE_GOOD);
+    ck_assert_int_eq(nodeResults[2], UA_STATUSCODE_GOOD);
+    ck_assert_int_eq(nodeResults[3], UA_STATUSCODE_BADPARENTNODEIDINVALID);
+    ck_assert_int_eq(nodeResults[4], UA_STATUSCODE_BADPARENTNODEIDINVALID);
+    ck_assert_int_eq(nodeResults[5], UA_STATUSCODE_BADNODEIDEXISTS);
+    ck_assert_int_eq(refResults[0], UA_STATUSCODE_GOOD);
+    ck_assert_int_eq(refResults[1], UA_STATUSCODE_BADTARGETNODEIDINVALID);
+
+    /* The references are linked in both directions */
+    ck_assert_uint_eq(countReferences(server, objectsFolder, UA_NS0ID_ORGANIZES, folder), 1);
+    ck_assert_uint_eq(countReferences(server, folder, UA_NS0ID_HASCOMPONENT, child), 1);
+    ck_assert_uint_eq(countReferences(server, folder, UA_NS0ID_HASCOMPONENT, var), 1);
+    ck_assert_uint_eq(countReferences(server, child, UA_NS0ID_ORGANIZES, var), 1);
+    ck_assert_uint_eq(countReferences(server, folder, UA_NS0ID_HASTYPEDEFINITION,
+                                      UA_NODEID_NUMERIC(0, UA_NS0ID_FOLDERTYPE)), 1);
+    ck_assert_uint_eq(countReferences(server, var, UA_NS0ID_HASTYPEDEFINITION,
+                                      UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE)), 1);
+
+    UA_Variant out;
+    res = UA_Server_readValue(server, var, &out);
+    ck_assert_int_eq(res, UA_STATUSCODE_GOOD);
+    ck_assert_int_eq(*(UA_Int32*)out.data, 42);
+    UA_Variant_deleteMembers(&out);
+
+    UA_QualifiedName name;
+    res = UA_Server_readBrowseName(server, orphan, &name);
+    ck_assert_int_ne(res, UA_STATUSCODE_GOOD);
+
+    UA_Server_delete(server);
+} END_TEST
+
+/* The type of the object fails after the object was checked. The object must
+ * fail as well. */
+START_TEST(AddNodesBulkFailedType) {
+    UA_Server *server = UA_Server_new(UA_ServerConfig_standard);
+
+    UA_ObjectAttributes oattr;
+    UA_ObjectAttributes_init(&oattr);
+    UA_ObjectTypeAttributes otattr;
+    UA_ObjectTypeAttributes_init(&otattr);
+
+    UA_NodeId object = UA_NODEID_STRING(1, "bulk.object");
+    UA_NodeId subType = UA_NODEID_STRING(1, "bulk.subtype");
+    UA_NodeId type = UA_NODEID_STRING(1, "bulk.type");
+    UA_AddNodesItem items[3];
+    setBulkItem(&items[0], UA_NODECLASS_OBJECT, "bulk.object",
+                UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER), UA_NS0ID_ORGANIZES,
+                &oattr, &UA_TYPES[UA_TYPES_OBJECTATTRIBUTES]);
+    items[0].typeDefinition.nodeId = subType;
+    setBulkItem(&items[1], UA_NODECLASS_OBJECTTYPE, "bulk.subtype", type,
+                UA_NS0ID_HASSUBTYPE, &otattr, &UA_TYPES[UA_TYPES_OBJECTTYPEATTRIBUTES]);
+    setBulkItem(&items[2], UA_NODECLASS_OBJECTTYPE, "bulk.type", UA_NODEID_NUMERIC(1, 999),
+                UA_NS0ID_HASSUBTYPE, &otattr, &UA_TYPES[UA_TYPES_OBJECTTYPEATTRIBUTES]);
+
+    UA_StatusCode nodeResults[3];
+    UA_StatusCode res = UA_Server_addNodesBulk(server, 3, items, 0, NULL, nodeResults, NULL);
+    ck_assert_int_ne(res, UA_STATUSCODE_GOOD);
+    ck_assert_int_eq(nodeResults[0], UA_STATUSCODE_BADTYPEDEFINITIONINVALID);
+    ck_assert_int_eq(nodeResults[1], UA_STATUSCODE_BADPARENTNODEIDINVALID);
+    ck_assert_int_eq(nodeResults[2], UA_STATUSCODE_BADPARENTNODEIDINVALID);
+
+    /* No node was added */
+    UA_QualifiedName name;
+    ck_assert_int_ne(UA_Server_readBrowseName(server, object, &name), UA_STATUSCODE_GOOD);
+    ck_assert_int_ne(UA_Server_readBrowseName(server, subType, &name), UA_STATUSCODE_GOOD);
+    ck_assert_int_ne(UA_Server_readBrowseName(server, type, &name), UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(countReferences(server, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                      UA_NS0ID_ORGANIZES, object), 0);
+
+    UA_Server_delete(server);
+} END_TEST
+
 static Suite * testSuite_services_nodemanagement(void) {
     Suite *s = suite_create("services_nodemanagement");
 
@@ -252,6 +406,8 @@ static Suite * testSuite_services_nodemanagement(void) {
     tcase_add_test(tc_addnodes, AddComplexTypeWithInheritance);
     tcase_add_test(tc_addnodes, AddNodeTwiceGivesError);
     tcase_add_test(tc_addnodes, AddObjectWithConstructor);
+    tcase_add_test(tc_addnodes, AddNodesBulk);
+    tcase_add_test(tc_addnodes, AddNodesBulkFailedType);
 
     TCase *tc_deletenodes = tcase_create("deletenodes");
     tcase_add_test(tc_addnodes, DeleteObjectWithDestructor);
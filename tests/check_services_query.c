@@ -0,0 +1,387 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+*  License, v. 2.0. If a copy of the MPL was not distributed with this
+*  file, You can obtain one at http://mozilla.org/MPL/2.0/.*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "check.h"
+#include "server/ua_services.h"
+#include "ua_types.h"
+#include "ua_config_standard.h"
+#include "server/ua_server_internal.h"
+
+#define PUMPS 30
+#define BIGPUMPS 5
+
+static UA_NodeId pumpType = {1, UA_NODEIDTYPE_NUMERIC, {5000}};
+static UA_NodeId bigPumpType = {1, UA_NODEIDTYPE_NUMERIC, {5001}};
+
+static void
+addPump(UA_Server *server, UA_UInt32 id, const UA_NodeId typeId, UA_Int32 speed) {
+    UA_ObjectAttributes oattr;
+    UA_ObjectAttributes_init(&oattr);
+    UA_StatusCode retval =
+        UA_Server_addObjectNode(server, UA_NODEID_NUMERIC(1, id),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                UA_QUALIFIEDNAME(1, "pump"), typeId, oattr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    UA_VariableAttributes vattr;
+    UA_VariableAttributes_init(&vattr);
+    UA_Variant_setScalar(&vattr.value, &speed, &UA_TYPES[UA_TYPES_INT32]);
+    retval = UA_Server_addVariableNode(server, UA_NODEID_NUMERIC(1, id + 1),
+                                       UA_NODEID_NUMERIC(1, id),
+                                       UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT),
+                                       UA_QUALIFIEDNAME(1, "Speed"), UA_NODEID_NULL,
+                                       vattr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+}
+
+/* Pump i has the speed i. The big pumps have the speeds 100 and above. */
+static UA_Server *
+makePumps(void) {
+    UA_Server *server = UA_Server_new(UA_ServerConfig_standard);
+    UA_ObjectTypeAttributes otattr;
+    UA_ObjectTypeAttributes_init(&otattr);
+    UA_StatusCode retval =
+        UA_Server_addObjectTypeNode(server, pumpType,
+                                    UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE),
+                                    UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE),
+                                    UA_QUALIFIEDNAME(1, "PumpType"), otattr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    retval = UA_Server_addObjectTypeNode(server, bigPumpType, pumpType,
+                                         UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE),
+                                         UA_QUALIFIEDNAME(1, "BigPumpType"), otattr,
+                                         NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    for(UA_UInt32 i = 0; i < PUMPS; ++i)
+        addPump(server, 10000 + (i * 2), pumpType, (UA_Int32)i);
+    for(UA_UInt32 i = 0; i < BIGPUMPS; ++i)
+        addPump(server, 20000 + (i * 2), bigPumpType, 100 + (UA_Int32)i);
+    return server;
+}
+
+/* Speed >= minSpeed */
+static void
+setSpeedFilter(UA_ContentFilterElement *element, UA_SimpleAttributeOperand *speed,
+               UA_LiteralOperand *minSpeed, UA_ExtensionObject *operands) {
+    static UA_QualifiedName speedName = {1, {5, (UA_Byte*)"Speed"}};
+    UA_SimpleAttributeOperand_init(speed);
+    speed->typeDefinitionId = pumpType;
+    speed->browsePathSize = 1;
+    speed->browsePath = &speedName;
+    speed->attributeId = UA_ATTRIBUTEID_VALUE;
+    operands[0].encoding = UA_EXTENSIONOBJECT_DECODED_NODELETE;
+    operands[0].content.decoded.type = &UA_TYPES[UA_TYPES_SIMPLEATTRIBUTEOPERAND];
+    operands[0].content.decoded.data = speed;
+    operands[1].encoding = UA_EXTENSIONOBJECT_DECODED_NODELETE;
+    operands[1].content.decoded.type = &UA_TYPES[UA_TYPES_LITERALOPERAND];
+    operands[1].content.decoded.data = minSpeed;
+    element->filterOperator = UA_FILTEROPERATOR_GREATERTHANOREQUAL;
+    element->filterOperandsSize = 2;
+    element->filterOperands = operands;
+}
+
+/* Returns the number of data sets over all QueryFirst/QueryNext calls and
+ * checks the returned speeds */
+static size_t
+queryPumps(UA_Server *server, UA_Session *session, UA_QueryFirstRequest *request,
+           UA_Int32 minSpeed) {
+    UA_QueryFirstResponse response;
+    UA_QueryFirstResponse_init(&response);
+    UA_RCU_LOCK();
+    Service_QueryFirst(server, session, request, &response);
+    UA_RCU_UNLOCK();
+    ck_assert_uint_eq(response.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+
+    size_t found = response.queryDataSetsSize;
+    size_t calls = 1;
+    UA_QueryDataSet *dataSets = response.queryDataSets;
+    size_t dataSetsSize = response.queryDataSetsSize;
+    UA_ByteString cp = response.continuationPoint;
+    UA_ByteString_init(&response.continuationPoint);
+    UA_QueryNextResponse nextResponse;
+    UA_QueryNextResponse_init(&nextResponse);
+    while(true) {
+        ck_assert(dataSetsSize <= request->maxDataSetsToReturn);
+        for(size_t i = 0; i < dataSetsSize; ++i) {
+            ck_assert_uint_eq(dataSets[i].valuesSize, 1);
+            ck_assert(UA_Variant_hasScalarType(&dataSets[i].values[0], &UA_TYPES[UA_TYPES_INT32]));
+            ck_assert_int_ge(*(UA_Int32*)dataSets[i].values[0].data, minSpeed);
+        }
+        UA_QueryFirstResponse_deleteMembers(&response);
+        UA_QueryNextResponse_deleteMembers(&nextResponse);
+        if(cp.length == 0)
+            break;
+
+        UA_QueryNextRequest nextRequest;
+        UA_QueryNextRequest_init(&nextRequest);
+        nextRequest.continuationPoint = cp;
+        UA_RCU_LOCK();
+        Service_QueryNext(server, session, &nextRequest, &nextResponse);
+        UA_RCU_UNLOCK();
+        UA_ByteString_deleteMembers(&cp);
+        ck_assert_uint_eq(nextResponse.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+        dataSets = nextResponse.queryDataSets;
+        dataSetsSize = nextResponse.queryDataSetsSize;
+        found += dataSetsSize;
+        cp = nextResponse.revisedContinuationPoint;
+        UA_ByteString_init(&nextResponse.revisedContinuationPoint);
+        ++calls;
+    }
+    ck_assert_uint_ge(calls, found / request->maxDataSetsToReturn);
+    return found;
+}
+
+START_TEST(QueryInstancesWithFilter) {
+    UA_Server *server = makePumps();
+    UA_Session session;
+    UA_Session_init(&session);
+
+    static UA_QualifiedName speedName = {1, {5, (UA_Byte*)"Speed"}};
+    UA_RelativePathElement pathElement;
+    UA_RelativePathElement_init(&pathElement);
+    pathElement.referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT);
+    pathElement.targetName = speedName;
+    UA_QueryDataDescription dataToReturn;
+    UA_QueryDataDescription_init(&dataToReturn);
+    dataToReturn.relativePath.elementsSize = 1;
+    dataToReturn.relativePath.elements = &pathElement;
+    dataToReturn.attributeId = UA_ATTRIBUTEID_VALUE;
+    UA_NodeTypeDescription nodeType;
+    UA_NodeTypeDescription_init(&nodeType);
+    nodeType.typeDefinitionNode.nodeId = pumpType;
+    nodeType.includeSubTypes = true;
+    nodeType.dataToReturnSize = 1;
+    nodeType.dataToReturn = &dataToReturn;
+
+    UA_Int32 minSpeed = 10;
+    UA_LiteralOperand literal;
+    UA_LiteralOperand_init(&literal);
+    UA_Variant_setScalar(&literal.value, &minSpeed, &UA_TYPES[UA_TYPES_INT32]);
+    UA_SimpleAttributeOperand speed;
+    UA_ExtensionObject operands[2];
+    UA_ContentFilterElement element;
+    setSpeedFilter(&element, &speed, &literal, operands);
+
+    UA_QueryFirstRequest request;
+    UA_QueryFirstRequest_init(&request);
+    request.nodeTypesSize = 1;
+    request.nodeTypes = &nodeType;
+    request.filter.elementsSize = 1;
+    request.filter.elements = &element;
+    request.maxDataSetsToReturn = 7;
+
+    /* Pumps 10..29 and all big pumps */
+    ck_assert_uint_eq(queryPumps(server, &session, &request, minSpeed),
+                      PUMPS - 10 + BIGPUMPS);
+
+    /* Without the subtypes */
+    nodeType.includeSubTypes = false;
+    ck_assert_uint_eq(queryPumps(server, &session, &request, minSpeed), PUMPS - 10);
+
+    /* Removed instances are no longer found */
+    UA_StatusCode retval = UA_Server_deleteNode(server, UA_NODEID_NUMERIC(1, 10000 + (15 * 2)), true);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(queryPumps(server, &session, &request, minSpeed), PUMPS - 11);
+
+    /* Without a filter */
+    request.filter.elementsSize = 0;
+    ck_assert_uint_eq(queryPumps(server, &session, &request, 0), PUMPS - 1);
+
+    /* All continuation points were released */
+    ck_assert_uint_eq(session.availableQueryContinuationPoints, UA_MAXCONTINUATIONPOINTS);
+    UA_Session_deleteMembersCleanup(&session, server);
+    UA_Server_delete(server);
+} END_TEST
+
+/* Every element is the AND of the next element with itself. Without
+ * evaluating each element only once, the cost doubles with every element. */
+#define SHAREDELEMENTS 64
+
+START_TEST(QuerySharedOperands) {
+    UA_Server *server = makePumps();
+    UA_Session session;
+    UA_Session_init(&session);
+
+    UA_NodeTypeDescription nodeType;
+    UA_NodeTypeDescription_init(&nodeType);
+    nodeType.typeDefinitionNode.nodeId = pumpType;
+    nodeType.includeSubTypes = true;
+
+    UA_ContentFilterElement elements[SHAREDELEMENTS];
+    UA_ElementOperand next[SHAREDELEMENTS];
+    UA_ExtensionObject operands[SHAREDELEMENTS][2];
+    for(size_t i = 0; i < SHAREDELEMENTS - 1; ++i) {
+        next[i].index = (UA_UInt32)i + 1;
+        for(size_t j = 0; j < 2; ++j) {
+            operands[i][j].encoding = UA_EXTENSIONOBJECT_DECODED_NODELETE;
+            operands[i][j].content.decoded.type = &UA_TYPES[UA_TYPES_ELEMENTOPERAND];
+            operands[i][j].content.decoded.data = &next[i];
+        }
+        elements[i].filterOperator = UA_FILTEROPERATOR_AND;
+        elements[i].filterOperandsSize = 2;
+        elements[i].filterOperands = operands[i];
+    }
+    UA_Int32 minSpeed = 10;
+    UA_LiteralOperand literal;
+    UA_LiteralOperand_init(&literal);
+    UA_Variant_setScalar(&literal.value, &minSpeed, &UA_TYPES[UA_TYPES_INT32]);
+    UA_SimpleAttributeOperand speed;
+    setSpeedFilter(&elements[SHAREDELEMENTS - 1], &speed, &literal,
+                   operands[SHAREDELEMENTS - 1]);
+
+    UA_QueryFirstRequest request;
+    UA_QueryFirstRequest_init(&request);
+    request.nodeTypesSize = 1;
+    request.nodeTypes = &nodeType;
+    request.filter.elementsSize = SHAREDELEMENTS;
+    request.filter.elements = elements;
+    UA_QueryFirstResponse response;
+    UA_QueryFirstResponse_init(&response);
+    UA_RCU_LOCK();
+    Service_QueryFirst(server, &session, &request, &response);
+    UA_RCU_UNLOCK();
+    ck_assert_uint_eq(response.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(response.queryDataSetsSize, PUMPS - 10 + BIGPUMPS);
+    UA_QueryFirstResponse_deleteMembers(&response);
+
+    UA_Session_deleteMembersCleanup(&session, server);
+    UA_Server_delete(server);
+} END_TEST
+
+START_TEST(QueryNextRelease) {
+    UA_Server *server = makePumps();
+    UA_Session session;
+    UA_Session_init(&session);
+
+    UA_NodeTypeDescription nodeType;
+    UA_NodeTypeDescription_init(&nodeType);
+    nodeType.typeDefinitionNode.nodeId = pumpType;
+    UA_QueryFirstRequest request;
+    UA_QueryFirstRequest_init(&request);
+    request.nodeTypesSize = 1;
+    request.nodeTypes = &nodeType;
+    request.maxDataSetsToReturn = 10;
+    UA_QueryFirstResponse response;
+    UA_QueryFirstResponse_init(&response);
+    UA_RCU_LOCK();
+    Service_QueryFirst(server, &session, &request, &response);
+    UA_RCU_UNLOCK();
+    ck_assert_uint_eq(response.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(response.queryDataSetsSize, 10);
+    ck_assert(UA_NodeId_equal(&response.queryDataSets[0].typeDefinitionNode.nodeId, &pumpType));
+    ck_assert_uint_ne(response.continuationPoint.length, 0);
+    ck_assert_uint_eq(session.availableQueryContinuationPoints, UA_MAXCONTINUATIONPOINTS - 1);
+
+    UA_QueryNextRequest nextRequest;
+    UA_QueryNextRequest_init(&nextRequest);
+    nextRequest.continuationPoint = response.continuationPoint;
+    nextRequest.releaseContinuationPoint = true;
+    UA_QueryNextResponse nextResponse;
+    UA_QueryNextResponse_init(&nextResponse);
+    UA_RCU_LOCK();
+    Service_QueryNext(server, &session, &nextRequest, &nextResponse);
+    UA_RCU_UNLOCK();
+    ck_assert_uint_eq(nextResponse.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(nextResponse.queryDataSetsSize, 0);
+    ck_assert_uint_eq(session.availableQueryContinuationPoints, UA_MAXCONTINUATIONPOINTS);
+    UA_QueryNextResponse_deleteMembers(&nextResponse);
+
+    /* The continuation point is gone */
+    nextRequest.releaseContinuationPoint = false;
+    UA_RCU_LOCK();
+    Service_QueryNext(server, &session, &nextRequest, &nextResponse);
+    UA_RCU_UNLOCK();
+    ck_assert_uint_eq(nextResponse.responseHeader.serviceResult,
+                      UA_STATUSCODE_BADCONTINUATIONPOINTINVALID);
+    UA_QueryNextResponse_deleteMembers(&nextResponse);
+    UA_QueryFirstResponse_deleteMembers(&response);
+
+    UA_Session_deleteMembersCleanup(&session, server);
+    UA_Server_delete(server);
+} END_TEST
+
+START_TEST(QueryInvalidRequests) {
+    UA_Server *server = makePumps();
+    UA_Session session;
+    UA_Session_init(&session);
+
+    /* Unknown type */
+    UA_NodeTypeDescription nodeTypes[2];
+    UA_NodeTypeDescription_init(&nodeTypes[0]);
+    UA_NodeTypeDescription_init(&nodeTypes[1]);
+    nodeTypes[0].typeDefinitionNode.nodeId = pumpType;
+    nodeTypes[1].typeDefinitionNode.nodeId = UA_NODEID_NUMERIC(1, 99999);
+    UA_QueryFirstRequest request;
+    UA_QueryFirstRequest_init(&request);
+    request.nodeTypesSize = 2;
+    request.nodeTypes = nodeTypes;
+    UA_QueryFirstResponse response;
+    UA_QueryFirstResponse_init(&response);
+    UA_RCU_LOCK();
+    Service_QueryFirst(server, &session, &request, &response);
+    UA_RCU_UNLOCK();
+    ck_assert_uint_eq(response.responseHeader.serviceResult, UA_STATUSCODE_BADINVALIDARGUMENT);
+    ck_assert_uint_eq(response.parsingResultsSize, 2);
+    ck_assert_uint_eq(response.parsingResults[0].statusCode, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(response.parsingResults[1].statusCode,
+                      UA_STATUSCODE_BADTYPEDEFINITIONINVALID);
+    UA_QueryFirstResponse_deleteMembers(&response);
+
+    /* Unsupported operator and an element operand that refers backwards */
+    UA_ElementOperand back;
+    back.index = 0;
+    UA_ExtensionObject operand;
+    operand.encoding = UA_EXTENSIONOBJECT_DECODED_NODELETE;
+    operand.content.decoded.type = &UA_TYPES[UA_TYPES_ELEMENTOPERAND];
+    operand.content.decoded.data = &back;
+    UA_ExtensionObject operands[2] = {operand, operand};
+    UA_ContentFilterElement elements[2];
+    elements[0].filterOperator = UA_FILTEROPERATOR_LIKE;
+    elements[0].filterOperandsSize = 2;
+    elements[0].filterOperands = operands;
+    elements[1].filterOperator = UA_FILTEROPERATOR_NOT;
+    elements[1].filterOperandsSize = 1;
+    elements[1].filterOperands = operands;
+    request.nodeTypesSize = 1;
+    request.filter.elementsSize = 2;
+    request.filter.elements = elements;
+    UA_RCU_LOCK();
+    Service_QueryFirst(server, &session, &request, &response);
+    UA_RCU_UNLOCK();
+    ck_assert_uint_eq(response.responseHeader.serviceResult,
+                      UA_STATUSCODE_BADCONTENTFILTERINVALID);
+    ck_assert_uint_eq(response.filterResult.elementResultsSize, 2);
+    ck_assert_uint_eq(response.filterResult.elementResults[0].statusCode,
+                      UA_STATUSCODE_BADFILTEROPERATORUNSUPPORTED);
+    ck_assert_uint_eq(response.filterResult.elementResults[1].statusCode,
+                      UA_STATUSCODE_BADFILTEROPERANDINVALID);
+    UA_QueryFirstResponse_deleteMembers(&response);
+
+    UA_Session_deleteMembersCleanup(&session, server);
+    UA_Server_delete(server);
+} END_TEST
+
+static Suite * testSuite_services_query(void) {
+    Suite *s = suite_create("services_query");
+    TCase *tc_query = tcase_create("query");
+    tcase_add_test(tc_query, QueryInstancesWithFilter);
+    tcase_add_test(tc_query, QuerySharedOperands);
+    tcase_add_test(tc_query, QueryNextRelease);
+    tcase_add_test(tc_query, QueryInvalidRequests);
+    suite_add_tcase(s, tc_query);
+    return s;
+}
+
+int main(void) {
+    int number_failed = 0;
+    Suite *s = testSuite_services_query();
+    SRunner *sr = srunner_create(s);
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed += srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
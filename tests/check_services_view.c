@@ -39,6 +39,7 @@ static void setup_server(void) {
 
 static void teardown_server(void) {
     *running_translate_browse = false;
+    UA_Server_wakeup(server_translate_browse);
     pthread_join(server_thread_translate_browse, NULL);
     UA_Server_run_shutdown(server_translate_browse);
     UA_Boolean_delete(running_translate_browse);
@@ -70,6 +71,416 @@ START_TEST(Service_Browse_WithBrowseName)
     }
 END_TEST
 
+START_TEST(Service_Browse_ResultMask)
+    {
+        UA_Server *server = UA_Server_new(UA_ServerConfig_standard);
+
+        UA_BrowseDescription bd;
+        UA_BrowseDescription_init(&bd);
+        bd.nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+        bd.referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES);
+        bd.browseDirection = UA_BROWSEDIRECTION_FORWARD;
+        bd.resultMask = UA_BROWSERESULTMASK_REFERENCETYPEID | UA_BROWSERESULTMASK_ISFORWARD;
+        UA_BrowseResult idsOnly = UA_Server_browse(server, 0, &bd);
+        bd.resultMask = UA_BROWSERESULTMASK_ALL;
+        UA_BrowseResult all = UA_Server_browse(server, 0, &bd);
+
+        ck_assert_int_eq(idsOnly.statusCode, UA_STATUSCODE_GOOD);
+        ck_assert_int_eq(all.statusCode, UA_STATUSCODE_GOOD);
+        ck_assert(all.referencesSize > 0);
+        ck_assert_uint_eq(idsOnly.referencesSize, all.referencesSize);
+
+        UA_NodeId serverId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER);
+        UA_Boolean serverFound = false;
+        for(size_t i = 0; i < all.referencesSize; ++i) {
+            UA_ReferenceDescription *r1 = &idsOnly.references[i];
+            UA_ReferenceDescription *r2 = &all.references[i];
+            ck_assert(UA_NodeId_equal(&r1->nodeId.nodeId, &r2->nodeId.nodeId));
+            ck_assert(UA_NodeId_equal(&r1->referenceTypeId, &r2->referenceTypeId));
+            ck_assert(r1->isForward && r2->isForward);
+
+            /* the attributes of the target are only returned when requested */
+            ck_assert_int_eq(r1->nodeClass, UA_NODECLASS_UNSPECIFIED);
+            ck_assert_uint_eq(r1->browseName.name.length, 0);
+            ck_assert_uint_eq(r1->displayName.text.length, 0);
+            ck_assert(UA_NodeId_isNull(&r1->typeDefinition.nodeId));
+            ck_assert_int_ne(r2->nodeClass, UA_NODECLASS_UNSPECIFIED);
+            ck_assert(r2->browseName.name.length > 0);
+
+            if(!UA_NodeId_equal(&r2->nodeId.nodeId, &serverId))
+                continue;
+            serverFound = true;
+            ck_assert_uint_eq(r2->typeDefinition.nodeId.identifier.numeric,
+                              UA_NS0ID_SERVERTYPE);
+        }
+        ck_assert(serverFound);
+
+        UA_BrowseResult_deleteMembers(&idsOnly);
+        UA_BrowseResult_deleteMembers(&all);
+        UA_Server_delete(server);
+    }
+END_TEST
+
+/* Browses the Organizes references of the objects folder. Returns the number
+ * of references and whether the target has the DisplayName. */
+static size_t
+browseObjectsFolderNames(UA_Server *server, const UA_NodeId *target,
+                         const char *displayName, UA_Boolean *found) {
+    UA_BrowseDescription bd;
+    UA_BrowseDescription_init(&bd);
+    bd.nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    bd.referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES);
+    bd.browseDirection = UA_BROWSEDIRECTION_FORWARD;
+    bd.resultMask = UA_BROWSERESULTMASK_ALL;
+    UA_BrowseResult br = UA_Server_browse(server, 0, &bd);
+    ck_assert_int_eq(br.statusCode, UA_STATUSCODE_GOOD);
+    UA_String name = UA_STRING((char*)(uintptr_t)displayName);
+    *found = false;
+    for(size_t i = 0; i < br.referencesSize; ++i) {
+        if(UA_NodeId_equal(&br.references[i].nodeId.nodeId, target) &&
+           UA_String_equal(&br.references[i].displayName.text, &name))
+            *found = true;
+    }
+    size_t size = br.referencesSize;
+    UA_BrowseResult_deleteMembers(&br);
+    return size;
+}
+
+START_TEST(Service_Browse_Cache)
+    {
+        UA_ServerConfig config = UA_ServerConfig_standard;
+        config.browseCacheSize = 100;
+        UA_Server *server = UA_Server_new(config);
+        UA_BrowseCacheStatistics stats;
+        UA_Server_getBrowseCacheStatistics(server, &stats);
+        ck_assert_uint_eq(stats.size, 64);
+
+        /* The second browse is answered from the cache */
+        UA_NodeId object = UA_NODEID_NUMERIC(1, 5000);
+        UA_Boolean found;
+        size_t size = browseObjectsFolderNames(server, &object, "Object", &found);
+        ck_assert(size > 0);
+        UA_Server_getBrowseCacheStatistics(server, &stats);
+        UA_UInt32 misses = stats.misses;
+        UA_UInt32 hits = stats.hits;
+        ck_assert_uint_eq(browseObjectsFolderNames(server, &object, "Object", &found), size);
+        UA_Server_getBrowseCacheStatistics(server, &stats);
+        ck_assert_uint_eq(stats.hits, hits + 1);
+        ck_assert_uint_eq(stats.misses, misses);
+
+        /* A new reference changes the version of the folder */
+        UA_ObjectAttributes oattr;
+        UA_ObjectAttributes_init(&oattr);
+        oattr.displayName = UA_LOCALIZEDTEXT("en_US", "Object");
+        UA_StatusCode retval =
+            UA_Server_addObjectNode(server, object, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                    UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                    UA_QUALIFIEDNAME(1, "Object"), UA_NODEID_NULL,
+                                    oattr, NULL, NULL);
+        ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+        ck_assert_uint_eq(browseObjectsFolderNames(server, &object, "Object", &found), size + 1);
+        ck_assert(found);
+        UA_Server_getBrowseCacheStatistics(server, &stats);
+        hits = stats.hits;
+        ck_assert_uint_eq(browseObjectsFolderNames(server, &object, "Object", &found), size + 1);
+        UA_Server_getBrowseCacheStatistics(server, &stats);
+        ck_assert_uint_eq(stats.hits, hits + 1);
+
+        /* Renaming the target invalidates the cached result */
+        retval = UA_Server_writeDisplayName(server, object, UA_LOCALIZEDTEXT("en_US", "Renamed"));
+        ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+        browseObjectsFolderNames(server, &object, "Renamed", &found);
+        ck_assert(found);
+
+        /* Removing the target as well */
+        retval = UA_Server_deleteNode(server, object, true);
+        ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+        ck_assert_uint_eq(browseObjectsFolderNames(server, &object, "Renamed", &found), size);
+        ck_assert(!found);
+
+        UA_Server_delete(server);
+    }
+END_TEST
+
+static size_t
+browseObjectsFolder(UA_Server *server, UA_UInt32 referenceType,
+                    UA_Boolean includeSubtypes, const UA_NodeId *target) {
+    UA_BrowseDescription bd;
+    UA_BrowseDescription_init(&bd);
+    bd.nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    bd.referenceTypeId = UA_NODEID_NUMERIC(0, referenceType);
+    bd.includeSubtypes = includeSubtypes;
+    bd.browseDirection = UA_BROWSEDIRECTION_FORWARD;
+    UA_BrowseResult br = UA_Server_browse(server, 0, &bd);
+    ck_assert_int_eq(br.statusCode, UA_STATUSCODE_GOOD);
+    size_t found = br.referencesSize;
+    if(target) {
+        found = 0;
+        for(size_t i = 0; i < br.referencesSize; ++i) {
+            if(UA_NodeId_equal(&br.references[i].nodeId.nodeId, target))
+                ++found;
+        }
+    }
+    UA_BrowseResult_deleteMembers(&br);
+    return found;
+}
+
+START_TEST(Service_Browse_WithSubtypes)
+    {
+        UA_Server *server = UA_Server_new(UA_ServerConfig_standard);
+
+        /* Organizes is a subtype of HierarchicalReferences */
+        size_t organizes = browseObjectsFolder(server, UA_NS0ID_ORGANIZES, false, NULL);
+        ck_assert(organizes > 0);
+        ck_assert_uint_eq(browseObjectsFolder(server, UA_NS0ID_HIERARCHICALREFERENCES,
+                                              false, NULL), 0);
+        ck_assert(browseObjectsFolder(server, UA_NS0ID_HIERARCHICALREFERENCES,
+                                      true, NULL) >= organizes);
+        ck_assert_uint_eq(browseObjectsFolder(server, UA_NS0ID_HASCOMPONENT, true, NULL), 0);
+
+        /* A new subtype of Organizes is found after the closure was built */
+        UA_ReferenceTypeAttributes rattr;
+        UA_ReferenceTypeAttributes_init(&rattr);
+        rattr.inverseName = UA_LOCALIZEDTEXT("en_US", "OrganizedBy2");
+        UA_NodeId refType = UA_NODEID_NUMERIC(1, 5000);
+        UA_StatusCode retval =
+            UA_Server_addReferenceTypeNode(server, refType, UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                           UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE),
+                                           UA_QUALIFIEDNAME(1, "Organizes2"), rattr, NULL, NULL);
+        ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+
+        UA_ObjectAttributes oattr;
+        UA_ObjectAttributes_init(&oattr);
+        UA_NodeId object = UA_NODEID_NUMERIC(1, 5001);
+        retval = UA_Server_addObjectNode(server, object, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                         refType, UA_QUALIFIEDNAME(1, "Organized"),
+                                         UA_NODEID_NULL, oattr, NULL, NULL);
+        ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+        ck_assert_uint_eq(browseObjectsFolder(server, UA_NS0ID_ORGANIZES, true, &object), 1);
+        ck_assert_uint_eq(browseObjectsFolder(server, UA_NS0ID_ORGANIZES, false, &object), 0);
+        ck_assert_uint_eq(browseObjectsFolder(server, UA_NS0ID_HIERARCHICALREFERENCES,
+                                              true, &object), 1);
+
+        /* Without the HasSubtype reference, the type is no longer a subtype */
+        retval = UA_Server_deleteReference(server, UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                           UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE), true,
+                                           UA_EXPANDEDNODEID_NUMERIC(1, 5000), true);
+        ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+        ck_assert_uint_eq(browseObjectsFolder(server, UA_NS0ID_ORGANIZES, true, &object), 0);
+
+        UA_Server_delete(server);
+    }
+END_TEST
+
+/* Browses the children of the folder in steps of maxrefs with continuation
+ * points. Every child is returned exactly once. */
+static void
+browseChildrenWithContinuation(UA_Server *server, UA_Session *session,
+                               UA_UInt32 childrenSize, UA_UInt32 maxrefs,
+                               UA_Boolean addChildInBetween) {
+    UA_Boolean *seen = calloc(childrenSize + 1, sizeof(UA_Boolean));
+    UA_BrowseDescription descr;
+    UA_BrowseDescription_init(&descr);
+    descr.nodeId = UA_NODEID_NUMERIC(1, 1000);
+    descr.browseDirection = UA_BROWSEDIRECTION_FORWARD;
+    descr.referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT);
+    descr.resultMask = UA_BROWSERESULTMASK_NONE;
+    UA_BrowseResult result;
+    UA_BrowseResult_init(&result);
+    UA_RCU_LOCK();
+    Service_Browse_single(server, session, NULL, &descr, maxrefs, &result);
+    UA_RCU_UNLOCK();
+
+    size_t steps = 0;
+    while(true) {
+        ck_assert_uint_eq(result.statusCode, UA_STATUSCODE_GOOD);
+        ck_assert_uint_le(result.referencesSize, maxrefs);
+        for(size_t i = 0; i < result.referencesSize; ++i) {
+            UA_UInt32 id = result.references[i].nodeId.nodeId.identifier.numeric - 2000;
+            ck_assert_uint_le(id, childrenSize);
+            ck_assert(!seen[id]);
+            seen[id] = true;
+        }
+        ++steps;
+        if(result.continuationPoint.length == 0)
+            break;
+
+        /* The folder is edited. The continuation point no longer knows the
+         * position and skips the references returned so far. */
+        if(addChildInBetween && steps == 2) {
+            UA_ObjectAttributes oattr;
+            UA_ObjectAttributes_init(&oattr);
+            UA_StatusCode retval =
+                UA_Server_addObjectNode(server, UA_NODEID_NUMERIC(1, 2000 + childrenSize),
+                                        UA_NODEID_NUMERIC(1, 1000),
+                                        UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT),
+                                        UA_QUALIFIEDNAME(1, "added"), UA_NODEID_NULL,
+                                        oattr, NULL, NULL);
+            ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+        }
+
+        struct ContinuationPointEntry *cp;
+        LIST_FOREACH(cp, &session->continuationPoints, pointers) {
+            if(UA_ByteString_equal(&cp->identifier, &result.continuationPoint))
+                break;
+        }
+        ck_assert_ptr_ne(cp, NULL);
+        UA_BrowseResult_deleteMembers(&result);
+        UA_BrowseResult_init(&result);
+        UA_RCU_LOCK();
+        Service_Browse_single(server, session, cp, NULL, 0, &result);
+        UA_RCU_UNLOCK();
+    }
+    UA_BrowseResult_deleteMembers(&result);
+
+    ck_assert_uint_ge(steps, childrenSize / maxrefs);
+    for(UA_UInt32 i = 0; i < childrenSize; ++i)
+        ck_assert(seen[i]);
+    ck_assert(seen[childrenSize] == addChildInBetween);
+    ck_assert(LIST_EMPTY(&session->continuationPoints));
+    ck_assert_uint_eq(session->availableContinuationPoints,
+                      server->config.maxContinuationPoints);
+    free(seen);
+}
+
+START_TEST(Service_Browse_ContinuationPoints)
+    {
+        UA_ServerConfig config = UA_ServerConfig_standard;
+        config.maxContinuationPoints = 2;
+        UA_Server *server = UA_Server_new(config);
+
+        UA_ObjectAttributes oattr;
+        UA_ObjectAttributes_init(&oattr);
+        UA_StatusCode retval =
+            UA_Server_addObjectNode(server, UA_NODEID_NUMERIC(1, 1000),
+                                    UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                    UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                    UA_QUALIFIEDNAME(1, "Folder"), UA_NODEID_NULL,
+                                    oattr, NULL, NULL);
+        ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+        for(UA_UInt32 i = 0; i < 100; ++i) {
+            retval = UA_Server_addObjectNode(server, UA_NODEID_NUMERIC(1, 2000 + i),
+                                             UA_NODEID_NUMERIC(1, 1000),
+                                             UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT),
+                                             UA_QUALIFIEDNAME(1, "child"), UA_NODEID_NULL,
+                                             oattr, NULL, NULL);
+            ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+        }
+
+        UA_Session session;
+        UA_Session_init(&session);
+        session.availableContinuationPoints = config.maxContinuationPoints;
+        browseChildrenWithContinuation(server, &session, 100, 7, false);
+        browseChildrenWithContinuation(server, &session, 100, 10, true);
+
+        /* No more continuation points than configured */
+        UA_BrowseDescription descr;
+        UA_BrowseDescription_init(&descr);
+        descr.nodeId = UA_NODEID_NUMERIC(1, 1000);
+        descr.browseDirection = UA_BROWSEDIRECTION_FORWARD;
+        UA_BrowseResult result;
+        for(size_t i = 0; i < 3; ++i) {
+            UA_BrowseResult_init(&result);
+            UA_RCU_LOCK();
+            Service_Browse_single(server, &session, NULL, &descr, 5, &result);
+            UA_RCU_UNLOCK();
+            if(i < 2)
+                ck_assert_uint_eq(result.statusCode, UA_STATUSCODE_GOOD);
+            else
+                ck_assert_uint_eq(result.statusCode, UA_STATUSCODE_BADNOCONTINUATIONPOINTS);
+            UA_BrowseResult_deleteMembers(&result);
+        }
+
+        UA_Session_deleteMembersCleanup(&session, server);
+        UA_Server_delete(server);
+    }
+END_TEST
+
+/* Translates the path Objects/Folder/<name> */
+static UA_StatusCode
+translateChild(UA_Server *server, char *name, UA_NodeId *target) {
+    UA_RelativePathElement elements[2];
+    for(size_t i = 0; i < 2; ++i) {
+        UA_RelativePathElement_init(&elements[i]);
+        elements[i].referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_HIERARCHICALREFERENCES);
+        elements[i].includeSubtypes = true;
+    }
+    elements[0].targetName = UA_QUALIFIEDNAME(1, "Folder");
+    elements[1].targetName = UA_QUALIFIEDNAME(1, name);
+    UA_BrowsePath bp;
+    UA_BrowsePath_init(&bp);
+    bp.startingNode = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    bp.relativePath.elements = elements;
+    bp.relativePath.elementsSize = 2;
+    UA_BrowsePathResult bpr = UA_Server_translateBrowsePathToNodeIds(server, &bp);
+    UA_StatusCode retval = bpr.statusCode;
+    if(retval == UA_STATUSCODE_GOOD) {
+        ck_assert_int_eq(bpr.targetsSize, 1);
+        UA_NodeId_copy(&bpr.targets[0].targetId.nodeId, target);
+    }
+    UA_BrowsePathResult_deleteMembers(&bpr);
+    return retval;
+}
+
+START_TEST(Service_TranslateBrowsePathsToNodeIds_ManyChildren)
+    {
+        UA_Server *server = UA_Server_new(UA_ServerConfig_standard);
+
+        /* A folder with more children than needed for the child index */
+        UA_ObjectAttributes oattr;
+        UA_ObjectAttributes_init(&oattr);
+        UA_StatusCode retval =
+            UA_Server_addObjectNode(server, UA_NODEID_NUMERIC(1, 1000),
+                                    UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                    UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                    UA_QUALIFIEDNAME(1, "Folder"), UA_NODEID_NULL,
+                                    oattr, NULL, NULL);
+        ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+        char name[16];
+        for(UA_UInt32 i = 0; i < 100; ++i) {
+            snprintf(name, sizeof(name), "child%u", i);
+            retval = UA_Server_addObjectNode(server, UA_NODEID_NUMERIC(1, 2000 + i),
+                                             UA_NODEID_NUMERIC(1, 1000),
+                                             UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT),
+                                             UA_QUALIFIEDNAME(1, name), UA_NODEID_NULL,
+                                             oattr, NULL, NULL);
+            ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+        }
+
+        UA_NodeId target;
+        for(UA_UInt32 i = 0; i < 100; ++i) {
+            snprintf(name, sizeof(name), "child%u", i);
+            retval = translateChild(server, name, &target);
+            ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+            ck_assert_int_eq(target.identifier.numeric, 2000 + i);
+        }
+        ck_assert_int_eq(translateChild(server, "child100", &target), UA_STATUSCODE_BADNOMATCH);
+
+        /* Renamed, removed and added children are found after the change */
+        retval = UA_Server_writeBrowseName(server, UA_NODEID_NUMERIC(1, 2005),
+                                           UA_QUALIFIEDNAME(1, "renamed"));
+        ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+        ck_assert_int_eq(translateChild(server, "child5", &target), UA_STATUSCODE_BADNOMATCH);
+        ck_assert_int_eq(translateChild(server, "renamed", &target), UA_STATUSCODE_GOOD);
+        ck_assert_int_eq(target.identifier.numeric, 2005);
+
+        retval = UA_Server_deleteNode(server, UA_NODEID_NUMERIC(1, 2006), true);
+        ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+        ck_assert_int_eq(translateChild(server, "child6", &target), UA_STATUSCODE_BADNOMATCH);
+
+        retval = UA_Server_addObjectNode(server, UA_NODEID_NUMERIC(1, 3000),
+                                         UA_NODEID_NUMERIC(1, 1000),
+                                         UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT),
+                                         UA_QUALIFIEDNAME(1, "child100"), UA_NODEID_NULL,
+                                         oattr, NULL, NULL);
+        ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+        ck_assert_int_eq(translateChild(server, "child100", &target), UA_STATUSCODE_GOOD);
+        ck_assert_int_eq(target.identifier.numeric, 3000);
+
+        UA_Server_delete(server);
+    }
+END_TEST
+
 #define BROWSE_PATHS_SIZE 3
 
 START_TEST(Service_TranslateBrowsePathsToNodeIds)
@@ -135,6 +546,11 @@ static Suite *testSuite_Service_TranslateBrowsePathsToNodeIds(void) {
     Suite *s = suite_create("Service_TranslateBrowsePathsToNodeIds");
     TCase *tc_browse = tcase_create("Browse Service");
     tcase_add_test(tc_browse, Service_Browse_WithBrowseName);
+    tcase_add_test(tc_browse, Service_Browse_ResultMask);
+    tcase_add_test(tc_browse, Service_Browse_Cache);
+    tcase_add_test(tc_browse, Service_Browse_WithSubtypes);
+    tcase_add_test(tc_browse, Service_Browse_ContinuationPoints);
+    tcase_add_test(tc_browse, Service_TranslateBrowsePathsToNodeIds_ManyChildren);
     suite_add_tcase(s, tc_browse);
 
     TCase *tc_translate = tcase_create("TranslateBrowsePathsToNodeIds");
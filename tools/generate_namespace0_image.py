@@ -0,0 +1,273 @@
+# This Source Code Form is subject to the terms of the Mozilla Public
+# License, v. 2.0. If a copy of the MPL was not distributed with this
+# file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+# Generates the read-only image of the namespace 0 bootstrap nodes. The nodes
+# are emitted as static const structures that the nodestore references in
+# place. The references are computed the same way as if the nodes were added
+# one after the other with the AddNodes / AddReferences services.
+
+from __future__ import print_function
+import sys
+import platform
+import getpass
+import time
+import argparse
+
+parser = argparse.ArgumentParser()
+parser.add_argument('nodeids', help='path/to/NodeIds.csv')
+parser.add_argument('outfile', help='outfile w/o extension')
+args = parser.parse_args()
+
+f = open(args.nodeids)
+input_str = f.read() + "\nHasModelParent,50,ReferenceType"
+f.close()
+input_str = input_str.replace('\r','')
+nodeids = {}
+for row in input_str.split('\n'):
+    row = row.split(',')
+    if len(row) < 3:
+        continue
+    nodeids[row[0]] = int(row[1])
+
+##########################
+# Namespace 0 definition #
+##########################
+
+# Every entry is one step of the bootstrap. The steps are replayed in order to
+# compute the references of the nodes.
+#
+# ("node", symbol, nodeclass, browsename, attributes, parent, referencetype, typedefinition)
+#     Adds a node. Without a parent, the node is inserted without references.
+# ("reference", source, referencetype, target, isForward)
+#     Adds a reference in both directions.
+
+steps = []
+
+def node(symbol, nodeclass, name=None, parent=None, reftype="HasSubtype",
+         typedef=None, **attributes):
+    if name is None:
+        name = symbol
+    steps.append(("node", symbol, nodeclass, name, attributes, parent, reftype, typedef))
+
+def reference(source, reftype, target, isForward=True):
+    steps.append(("reference", source, reftype, target, isForward))
+
+# Reference hierarchy
+node("References", "ReferenceType", isAbstract=True, symmetric=True, inverseName="References")
+node("HasSubtype", "ReferenceType", inverseName="HasSupertype")
+node("HierarchicalReferences", "ReferenceType", parent="References", isAbstract=True)
+node("NonHierarchicalReferences", "ReferenceType", parent="References", isAbstract=True)
+node("HasChild", "ReferenceType", parent="HierarchicalReferences")
+node("Organizes", "ReferenceType", parent="HierarchicalReferences", inverseName="OrganizedBy")
+node("HasEventSource", "ReferenceType", parent="HierarchicalReferences", inverseName="EventSourceOf")
+node("HasModellingRule", "ReferenceType", parent="NonHierarchicalReferences", inverseName="ModellingRuleOf")
+node("HasEncoding", "ReferenceType", parent="NonHierarchicalReferences", inverseName="EncodingOf")
+node("HasDescription", "ReferenceType", parent="NonHierarchicalReferences", inverseName="DescriptionOf")
+node("HasTypeDefinition", "ReferenceType", parent="NonHierarchicalReferences", inverseName="TypeDefinitionOf")
+node("GeneratesEvent", "ReferenceType", parent="NonHierarchicalReferences", inverseName="GeneratedBy")
+node("Aggregates", "ReferenceType", parent="HasChild", inverseName="AggregatedBy")
+reference("HasChild", "HasSubtype", "HasSubtype") # complete bootstrap of hassubtype
+node("HasProperty", "ReferenceType", parent="Aggregates", inverseName="PropertyOf")
+node("HasComponent", "ReferenceType", parent="Aggregates", inverseName="ComponentOf")
+node("HasNotifier", "ReferenceType", parent="HasEventSource", inverseName="NotifierOf")
+node("HasOrderedComponent", "ReferenceType", parent="HasComponent", inverseName="OrderedComponentOf")
+node("HasModelParent", "ReferenceType", parent="NonHierarchicalReferences", inverseName="ModelParentOf")
+node("FromState", "ReferenceType", parent="NonHierarchicalReferences", inverseName="ToTransition")
+node("ToState", "ReferenceType", parent="NonHierarchicalReferences", inverseName="FromTransition")
+node("HasCause", "ReferenceType", parent="NonHierarchicalReferences", inverseName="MayBeCausedBy")
+node("HasEffect", "ReferenceType", parent="NonHierarchicalReferences", inverseName="MayBeEffectedBy")
+node("HasHistoricalConfiguration", "ReferenceType", parent="Aggregates",
+     inverseName="HistoricalConfigurationOf")
+
+# Data types
+node("BaseDataType", "DataType", isAbstract=True)
+node("Boolean", "DataType", parent="BaseDataType")
+node("Number", "DataType", parent="BaseDataType", isAbstract=True)
+node("Float", "DataType", parent="Number")
+node("Double", "DataType", parent="Number")
+node("Integer", "DataType", parent="Number", isAbstract=True)
+node("SByte", "DataType", parent="Integer")
+node("Int16", "DataType", parent="Integer")
+node("Int32", "DataType", parent="Integer")
+node("Int64", "DataType", parent="Integer")
+node("UInteger", "DataType", parent="Integer", isAbstract=True)
+node("Byte", "DataType", parent="UInteger")
+node("UInt16", "DataType", parent="UInteger")
+node("UInt32", "DataType", parent="UInteger")
+node("UInt64", "DataType", parent="UInteger")
+node("String", "DataType", parent="BaseDataType")
+node("DateTime", "DataType", parent="BaseDataType")
+node("Guid", "DataType", parent="BaseDataType")
+node("ByteString", "DataType", parent="BaseDataType")
+node("XmlElement", "DataType", parent="BaseDataType")
+node("NodeId", "DataType", parent="BaseDataType")
+node("ExpandedNodeId", "DataType", parent="BaseDataType")
+node("StatusCode", "DataType", parent="BaseDataType")
+node("QualifiedName", "DataType", parent="BaseDataType")
+node("LocalizedText", "DataType", parent="BaseDataType")
+node("Structure", "DataType", parent="BaseDataType", isAbstract=True)
+node("ServerStatusDataType", "DataType", parent="Structure")
+node("BuildInfo", "DataType", parent="Structure")
+node("DataValue", "DataType", parent="BaseDataType")
+node("DiagnosticInfo", "DataType", parent="BaseDataType")
+node("Enumeration", "DataType", parent="BaseDataType", isAbstract=True)
+node("ServerState", "DataType", parent="Enumeration")
+
+# Variable types
+node("BaseVariableType", "VariableType", isAbstract=True, valueRank=-2, dataType="BaseDataType")
+node("BaseDataVariableType", "VariableType", parent="BaseVariableType",
+     valueRank=-2, dataType="BaseDataType")
+node("PropertyType", "VariableType", parent="BaseVariableType",
+     valueRank=-2, dataType="BaseDataType")
+node("BuildInfoType", "VariableType", parent="BaseDataVariableType",
+     valueRank=-1, dataType="BuildInfo")
+node("ServerStatusType", "VariableType", parent="BaseDataVariableType",
+     valueRank=-1, dataType="ServerStatusDataType")
+
+# Object types
+node("BaseObjectType", "ObjectType")
+node("FolderType", "ObjectType", parent="BaseObjectType")
+node("ServerType", "ObjectType", parent="BaseObjectType")
+node("ServerDiagnosticsType", "ObjectType", parent="BaseObjectType")
+node("ServerCapabilitiesType", "ObjectType", "ServerCapatilitiesType", parent="BaseObjectType")
+
+# Root and below
+node("RootFolder", "Object", "Root")
+reference("RootFolder", "HasTypeDefinition", "FolderType")
+node("ObjectsFolder", "Object", "Objects", parent="RootFolder", reftype="Organizes",
+     typedef="FolderType")
+node("TypesFolder", "Object", "Types", parent="RootFolder", reftype="Organizes",
+     typedef="FolderType")
+node("ReferenceTypesFolder", "Object", "ReferenceTypes", parent="TypesFolder",
+     reftype="Organizes", typedef="FolderType")
+reference("ReferenceTypesFolder", "Organizes", "References")
+node("DataTypesFolder", "Object", "DataTypes", parent="TypesFolder",
+     reftype="Organizes", typedef="FolderType")
+reference("DataTypesFolder", "Organizes", "BaseDataType")
+node("VariableTypesFolder", "Object", "VariableTypes", parent="TypesFolder",
+     reftype="Organizes", typedef="FolderType")
+reference("VariableTypesFolder", "Organizes", "BaseVariableType")
+node("ObjectTypesFolder", "Object", "ObjectTypes", parent="TypesFolder",
+     reftype="Organizes", typedef="FolderType")
+reference("ObjectTypesFolder", "Organizes", "BaseObjectType")
+node("EventTypesFolder", "Object", "EventTypes", parent="TypesFolder",
+     reftype="Organizes", typedef="FolderType")
+node("ViewsFolder", "Object", "Views", parent="RootFolder", reftype="Organizes",
+     typedef="FolderType")
+
+########################
+# Replay the bootstrap #
+########################
+
+class Node(object):
+    def __init__(self, symbol, nodeclass, name, attributes):
+        if not symbol in nodeids:
+            raise Exception("Unknown NodeId " + symbol)
+        self.id = nodeids[symbol]
+        self.symbol = symbol
+        self.nodeclass = nodeclass
+        self.name = name
+        self.attributes = attributes
+        self.references = [] # (reftype, isInverse, target)
+
+nodes = {}
+
+def addOneWayReference(source, reftype, target, isForward):
+    nodes[source].references.append((nodeids[reftype], not isForward, nodeids[target]))
+
+def addReference(source, reftype, target, isForward):
+    addOneWayReference(source, reftype, target, isForward)
+    addOneWayReference(target, reftype, source, not isForward)
+
+for step in steps:
+    if step[0] == "reference":
+        addReference(step[1], step[2], step[3], step[4])
+        continue
+    (_, symbol, nodeclass, name, attributes, parent, reftype, typedef) = step
+    nodes[symbol] = Node(symbol, nodeclass, name, attributes)
+    if parent is None:
+        continue
+    # the reference back to the parent is added first
+    addReference(symbol, reftype, parent, False)
+    if nodeclass == "Object" or nodeclass == "Variable":
+        if typedef is None:
+            typedef = "BaseObjectType" if nodeclass == "Object" else "BaseDataVariableType"
+        addReference(symbol, "HasTypeDefinition", typedef, True)
+
+#######################
+# Generate the C code #
+#######################
+
+fc = open(args.outfile + ".c",'w')
+def printc(string):
+    print(string, end='\n', file=fc)
+
+def nodeid(i):
+    return "UA_NS0IMAGE_NODEID(%i)" % i
+
+def string(s):
+    return "UA_NS0IMAGE_STRING(\"%s\")" % s
+
+def localizedtext(s):
+    return "{%s, %s}" % (string("en_US"), string(s))
+
+def boolean(b):
+    return "true" if b else "false"
+
+printc('''/**********************************************************
+ * '''+args.outfile+'''.cgen -- do not modify
+ **********************************************************
+ * Generated from '''+args.nodeids+''' with script '''+sys.argv[0]+'''
+ * on host '''+platform.uname()[1]+''' by user '''+getpass.getuser()+''' at '''+
+       time.strftime("%Y-%m-%d %I:%M:%S")+'''
+ **********************************************************/
+
+#include "server/ua_nodestore.h"
+
+#define UA_NS0IMAGE_NODEID(ID) {.namespaceIndex = 0, .identifierType = UA_NODEIDTYPE_NUMERIC, \\
+                                .identifier.numeric = ID}
+#define UA_NS0IMAGE_STRING(S) {.length = sizeof(S)-1, .data = (UA_Byte*)S}
+''')
+
+sortednodes = sorted(nodes.values(), key=lambda n: n.id)
+for n in sortednodes:
+    # the references are not const. they are never written to, but the
+    # node structure has a pointer to non-const references.
+    printc("/* %s */" % n.symbol)
+    printc("static UA_ReferenceNode ns0image_refs_%i[%i] = {" % (n.id, max(len(n.references), 1)))
+    for (reftype, isInverse, target) in n.references:
+        printc("    {.referenceTypeId = %s, .isInverse = %s, .targetId = {.nodeId = %s}}," %
+               (nodeid(reftype), boolean(isInverse), nodeid(target)))
+    printc("};")
+    printc("static const UA_%sNode ns0image_node_%i = {" % (n.nodeclass, n.id))
+    printc("    .nodeId = %s," % nodeid(n.id))
+    printc("    .nodeClass = UA_NODECLASS_%s," % n.nodeclass.upper())
+    printc("    .browseName = {.namespaceIndex = 0, .name = %s}," % string(n.name))
+    printc("    .displayName = %s," % localizedtext(n.name))
+    printc("    .description = %s," % localizedtext(n.name))
+    printc("    .referencesSize = %i, .references = ns0image_refs_%i," % (len(n.references), n.id))
+    a = n.attributes
+    if n.nodeclass in ["ReferenceType", "DataType", "VariableType"]:
+        printc("    .isAbstract = %s," % boolean(a.get("isAbstract", False)))
+    if n.nodeclass == "ReferenceType":
+        printc("    .symmetric = %s," % boolean(a.get("symmetric", False)))
+        if "inverseName" in a:
+            printc("    .inverseName = %s," % localizedtext(a["inverseName"]))
+    if n.nodeclass == "VariableType":
+        printc("    .dataType = %s, .valueRank = %i," % (nodeid(nodeids[a["dataType"]]), a["valueRank"]))
+        printc("    .valueSource = UA_VALUESOURCE_DATA,")
+    printc("};\n")
+
+printc('''static const UA_Node * const ns0image_nodes[%i] = {''' % len(sortednodes))
+for n in sortednodes:
+    printc("    (const UA_Node*)&ns0image_node_%i," % n.id)
+printc('''};
+
+const UA_NodeStoreImage UA_NodeStoreImage_ns0 = {
+    .nodesSize = %i, .nodes = ns0image_nodes};
+
+#undef UA_NS0IMAGE_NODEID
+#undef UA_NS0IMAGE_STRING''' % len(sortednodes))
+
+fc.close()